@@ -1,11 +1,61 @@
 #include "app_window.hpp"
 
-#include <fstream>
+#include "buffer_search.hpp"
+#include "content_hash.hpp"
+#include "json_format.hpp"
+#include "line_ops.hpp"
+#include "text_stats.hpp"
+#include "startup_profile.hpp"
+#include "trace.hpp"
+
+#include <glib/gstdio.h>
+
+#include <algorithm>
 #include <iostream>
-#include <sstream>
+
+namespace
+{
+// Roughly a screenful of text; inserted before the first frame is drawn.
+constexpr std::size_t kFirstScreenBytes = 16 * 1024;
+// Pastes and drops larger than this stream in over several frames.
+constexpr std::size_t kChunkedPasteBytes = 1u << 20;
+// How often the status line follows a running task.
+constexpr unsigned kTaskTickMs = 100;
+// Selection statistics read the buffer this many characters at a time.
+constexpr int kStatsChunkChars = 64 * 1024;
+// The bracket index gives up on documents with more structural characters
+// than this (16 bytes each).
+constexpr std::size_t kMaxBracketTokens = 16u << 20;
+// Edits larger than this drop the word index, which is rebuilt on a worker
+// the next time completion needs it.
+constexpr std::size_t kWordRebuildBytes = 1u << 20;
+// Completion needs this many typed bytes and lists at most this many words.
+constexpr std::size_t kMinCompletionPrefix = 2;
+constexpr std::size_t kCompletionRows = 8;
+// Edits spanning more lines than this rebuild the outline on a worker
+// instead of rescanning the lines in place.
+constexpr int kOutlineRescanLines = 10000;
+// Line indexes are cached for files with at least this many lines; smaller
+// ones index faster than the cache file reads.
+constexpr std::size_t kMinCachedLines = 100000;
+// Encoding and line endings are detected from this much of the file.
+constexpr std::size_t kFormatSampleBytes = 64 * 1024;
+// Edits touching more saved text than this are not compared with it; the
+// document just stays modified.
+constexpr std::uint64_t kMaxSavedCheckBytes = 8u << 20;
+// Spaces per level in formatted JSON.
+constexpr int kJsonIndent = 2;
+// The session is written this long after the first change since the last
+// write.
+constexpr unsigned kSessionSaveDelayMs = 2000;
+// Unsaved edits larger than this are not kept in the session.
+constexpr std::uint64_t kMaxSessionEditBytes = 16u << 20;
+} // namespace
 
 AppWindow::AppWindow()
 {
+    startup_profile::mark("AppWindow: enter");
+
     auto theme = Gtk::IconTheme::get_for_display(Gdk::Display::get_default());
     if (theme)
         theme->add_search_path("assets");
@@ -16,19 +66,112 @@ AppWindow::AppWindow()
     set_default_size(1100, 700);
 
     set_child(m_root);
+    startup_profile::mark("window setup");
 
     build_header();
+    startup_profile::mark("build_header");
     build_layout();
+    startup_profile::mark("build_layout");
     build_editor(); // ✅ IMPORTANT: actually create/pack editor widgets
-    build_menu();
+    startup_profile::mark("build_editor");
     install_actions();
-    install_shortcuts();
+    startup_profile::mark("install_actions");
+    install_memory_stats();
+    m_recent.load();
+    startup_profile::mark("recent files");
+
+    // Coming back to the window is when an external change is most likely.
+    property_is_active().signal_changed().connect([this]()
+                                                  {
+        if (is_active() && changed_on_disk())
+            set_status("Changed on disk: " + m_current_path); });
+
+    // Menus, shortcuts and the CSS provider do not contribute to the first
+    // frame; they are set up once it has been painted (finish_startup).
+    signal_realize().connect([this]()
+                             {
+        m_first_frame.disconnect();
+        if (!m_startup_scheduled)
+            m_first_frame = get_frame_clock()->signal_after_paint().connect(
+                sigc::mem_fun(*this, &AppWindow::on_first_frame));
+        if (trace::enabled())
+            install_frame_tracing(); });
+}
 
+void AppWindow::install_frame_tracing()
+{
+    // One "frame" span per frame-clock cycle, split into layout and paint.
+    auto clock = get_frame_clock();
+    clock->signal_before_paint().connect([this]()
+                                         { m_frame_begin_us = trace::now_us(); });
+    clock->signal_layout().connect([this]()
+                                   { m_layout_begin_us = trace::now_us(); });
+    clock->signal_paint().connect([this]()
+                                  {
+        m_paint_begin_us = trace::now_us();
+        trace::record("frame.layout", m_layout_begin_us, m_paint_begin_us); });
+    clock->signal_after_paint().connect([this]()
+                                        {
+        const auto now = trace::now_us();
+        trace::record("frame.paint", m_paint_begin_us, now);
+        trace::record("frame", m_frame_begin_us, now); });
+}
+
+void AppWindow::on_first_frame()
+{
+    m_first_frame.disconnect();
+    if (m_startup_scheduled)
+        return;
+    m_startup_scheduled = true;
+    startup_profile::first_frame();
+    Glib::signal_idle().connect_once(sigc::mem_fun(*this, &AppWindow::finish_startup));
+}
+
+void AppWindow::finish_startup()
+{
+    startup_profile::begin_deferred();
+    build_menu();
+    startup_profile::mark("build_menu (deferred)");
+    install_shortcuts();
+    startup_profile::mark("install_shortcuts (deferred)");
     apply_theme();
+    startup_profile::mark("apply_theme (deferred)");
+    startup_profile::end_deferred();
 }
 
 AppWindow::~AppWindow()
 {
+    m_paste.cancel();
+    remember_current();
+    save_session();
+    m_loader.cancel();
+    stop_task_thread();
+    m_bracket_task.stop();
+    m_word_task.stop();
+    m_outline_task.stop();
+    m_hash_task.stop();
+    m_selection_idle.disconnect();
+    m_saved_check_idle.disconnect();
+    m_session_timer.disconnect();
+    m_completion_idle.disconnect();
+    m_outline_idle.disconnect();
+    m_completion.unparent();
+
+    if (m_log_filter)
+    {
+        m_editor_paned.unset_end_child();
+        m_log_filter.reset();
+    }
+    if (m_outline_panel)
+    {
+        m_outline_paned.unset_start_child();
+        m_outline_panel.reset();
+    }
+    set_view(ViewMode::Text);
+    m_hex.reset();
+    m_csv.reset();
+    m_diff.reset();
+
     // ✅ avoid lifetime crashes if dialog touches the buffer on shutdown
     m_find_text.reset();
 }
@@ -46,6 +189,10 @@ void AppWindow::build_header()
     m_header.pack_start(m_file_menu_btn);
     m_header.pack_start(m_help_menu_btn);
 
+    m_btn_cancel_task.set_visible(false);
+    m_btn_cancel_task.signal_clicked().connect(sigc::mem_fun(*this, &AppWindow::on_cancel_task));
+    m_header.pack_end(m_btn_cancel_task);
+
     set_titlebar(m_header);
 }
 
@@ -82,7 +229,7 @@ void AppWindow::build_layout()
     m_footer_left.set_hexpand(true);
 
     m_footer_left.set_text("Ready.");
-    m_footer_right.set_text("gtkmm-4.0");
+    update_stats_footer();
 
     m_footer.append(m_footer_left);
     m_footer.append(m_footer_right);
@@ -99,16 +246,131 @@ void AppWindow::build_editor()
     m_buffer = Gtk::TextBuffer::create();
     m_textview.set_buffer(m_buffer);
     m_textview.set_monospace(true);
-    m_buffer = Gtk::TextBuffer::create();
-    m_textview.set_buffer(m_buffer);
 
     // Track modifications
-    m_buffer->signal_changed().connect([this]()
-                                       {
-    if (!m_modified) {
-        m_modified = true;
-        m_footer_left.set_text("Modified");
-    } });
+    m_buffer->signal_changed().connect(sigc::mem_fun(*this, &AppWindow::on_buffer_changed));
+
+    // Pastes and drops of large texts stream in (see insert_text_chunked);
+    // the view's own handlers would insert them in one go.
+    m_textview.signal_paste_clipboard().connect([this]()
+                                                {
+        g_signal_stop_emission_by_name(m_textview.gobj(), "paste-clipboard");
+        on_paste(); }, false);
+    auto drop = Gtk::DropTarget::create(G_TYPE_STRING, Gdk::DragAction::COPY);
+    drop->set_propagation_phase(Gtk::PropagationPhase::CAPTURE);
+    // Drags from inside the view (moving a selection) stay with the view.
+    drop->signal_accept().connect([](const Glib::RefPtr<Gdk::Drop> &drop)
+                                  { return !drop->get_drag(); }, false);
+    drop->signal_drop().connect([this](const Glib::ValueBase &value, double x, double y)
+                                { return on_drop_text(value, x, y); }, false);
+    m_textview.add_controller(drop);
+
+    // Document statistics, the undo counter and the bracket index, kept
+    // exact from the edit stream: only the inserted or erased text is
+    // counted, plus the two characters around it for words that join or
+    // split.
+    m_brackets.build({}, kMaxBracketTokens);
+    BracketIndex::LineOf line_of = [this](int offset)
+    { return m_buffer->get_iter_at_offset(offset).get_line(); };
+
+    m_buffer->signal_insert().connect([this, line_of](const Gtk::TextBuffer::iterator &pos, const Glib::ustring &text, int bytes)
+                                      {
+        TRACE_SCOPE("stats.insert");
+        const auto piece = text_stats::count(std::string_view(text.data(), static_cast<std::size_t>(bytes)));
+        const int begin = pos.get_offset() - static_cast<int>(piece.chars);
+        const gunichar before = begin > 0 ? m_buffer->get_iter_at_offset(begin - 1).get_char() : 0;
+        const auto delta = text_stats::word_delta(piece, before, pos.get_char());
+
+        m_counts.bytes += piece.bytes;
+        m_counts.chars += piece.chars;
+        m_counts.newlines += piece.newlines;
+        m_counts.words = static_cast<std::size_t>(static_cast<long long>(m_counts.words) + delta);
+        if (!m_loading)
+            m_undo_bytes += piece.bytes;
+        update_stats_footer();
+
+        if (m_bracket_task.running())
+            m_brackets_stale = true;
+        else
+            m_brackets.insert(begin, static_cast<int>(piece.chars),
+                              std::string_view(text.data(), static_cast<std::size_t>(bytes)), line_of);
+
+        // Buffer lines, which also break on "\r" and U+2029 (see DirtyLines).
+        const int first_line = m_buffer->get_iter_at_offset(begin).get_line();
+        if (!m_loading)
+        {
+            m_dirty.insert(first_line, pos.get_line() - first_line);
+            m_dirty.check(m_buffer->get_line_count());
+        }
+        m_overview.insert(static_cast<std::uint64_t>(begin), piece.chars, !m_loading);
+        m_overview_ruler.queue_draw();
+
+        update_words_for_insert(begin, pos, std::string_view(text.data(), static_cast<std::size_t>(bytes)));
+        update_outline_for_insert(first_line, piece.newlines);
+        // A word character typed at the cursor (re)opens completion.
+        if (!m_loading && piece.chars == 1 && WordIndex::is_word_char(text[0]))
+            queue_completion();
+        else
+            m_completion.popdown(); });
+    m_buffer->signal_erase().connect([this, line_of](const Gtk::TextBuffer::iterator &s, const Gtk::TextBuffer::iterator &e)
+                                     {
+        TRACE_SCOPE("stats.erase");
+        std::size_t bytes = m_counts.bytes;
+        if (s.is_start() && e.is_end())
+        {
+            m_counts = TextCounts{};
+        }
+        else
+        {
+            const auto text = m_buffer->get_text(s, e, true);
+            const auto piece = text_stats::count(text.raw());
+            auto prev = s;
+            const gunichar before = prev.backward_char() ? prev.get_char() : 0;
+            const auto delta = text_stats::word_delta(piece, before, e.get_char());
+
+            bytes = piece.bytes;
+            m_counts.bytes -= std::min(piece.bytes, m_counts.bytes);
+            m_counts.chars -= std::min(piece.chars, m_counts.chars);
+            m_counts.newlines -= std::min(piece.newlines, m_counts.newlines);
+            m_counts.words = static_cast<std::size_t>(
+                std::max(0LL, static_cast<long long>(m_counts.words) - delta));
+        }
+        if (!m_loading)
+            m_undo_bytes += bytes;
+        update_stats_footer();
+
+        if (m_bracket_task.running())
+            m_brackets_stale = true;
+        else
+            m_brackets.erase(s.get_offset(), e.get_offset() - s.get_offset(), line_of);
+
+        if (!m_loading)
+            m_dirty.erase(s.get_line(), e.get_line());
+        m_overview.erase(static_cast<std::uint64_t>(s.get_offset()),
+                         static_cast<std::uint64_t>(e.get_offset() - s.get_offset()), !m_loading);
+        m_overview_ruler.queue_draw();
+
+        update_words_for_erase(s, e);
+        update_outline_for_erase(s, e);
+        if (m_completion.get_visible())
+            queue_completion(); }, false);
+    // Once the text is gone, the line count the erase left.
+    m_buffer->signal_erase().connect([this](const Gtk::TextBuffer::iterator &, const Gtk::TextBuffer::iterator &)
+                                     {
+        if (!m_loading)
+            m_dirty.check(m_buffer->get_line_count()); });
+
+    // Selection counts and the matching bracket are computed on demand,
+    // once the cursor settles.
+    m_buffer->signal_mark_set().connect([this](const Gtk::TextBuffer::iterator &, const Glib::RefPtr<Gtk::TextBuffer::Mark> &mark)
+                                        {
+        if (mark == m_buffer->get_insert() || mark == m_buffer->get_selection_bound())
+            queue_cursor_update();
+        if (mark == m_buffer->get_insert())
+            queue_session_save();
+        if (mark == m_buffer->get_insert() && m_completion.get_visible() &&
+            !m_completion_idle.connected() && mark->get_iter().get_offset() != m_completion_offset)
+            m_completion.popdown(); });
 
     // Highlight tag for search
     auto tagtable = m_buffer->get_tag_table();
@@ -119,11 +381,80 @@ void AppWindow::build_editor()
         tag->property_foreground() = "black";
         tagtable->add(tag);
     }
+    if (!tagtable->lookup("bracket_match"))
+    {
+        auto tag = Gtk::TextBuffer::Tag::create("bracket_match");
+        tag->property_background() = "#b4d5fe";
+        tag->property_foreground() = "black";
+        tag->property_weight() = static_cast<int>(Pango::Weight::BOLD);
+        tagtable->add(tag);
+    }
 
     m_editor_scroller.set_child(m_textview);
 
+    // Completion list: keys go to the view, which hands navigation keys to
+    // the list while it is shown.
+    m_completion.set_parent(m_textview);
+    m_completion.signal_chosen().connect(sigc::mem_fun(*this, &AppWindow::accept_completion));
+    auto keys = Gtk::EventControllerKey::create();
+    keys->set_propagation_phase(Gtk::PropagationPhase::CAPTURE);
+    keys->signal_key_pressed().connect([this](guint keyval, guint, Gdk::ModifierType)
+                                       { return on_completion_key(keyval); },
+                                       false);
+    m_textview.add_controller(keys);
+    m_editor_scroller.get_vadjustment()->signal_value_changed().connect([this]()
+                                                                        {
+        m_completion.popdown();
+        update_overview_viewport(); });
+    m_editor_scroller.get_vadjustment()->signal_changed().connect(sigc::mem_fun(*this, &AppWindow::update_overview_viewport));
+
+    // Overview ruler: "Highlight all" density, edits and the visible part.
+    m_overview_ruler.set_histogram(&m_overview);
+    m_overview_ruler.signal_seek().connect([this](std::uint64_t offset)
+                                           {
+        auto it = m_buffer->get_iter_at_offset(static_cast<int>(offset));
+        m_textview.scroll_to(it, 0.0, 0.0, 0.5); });
+    m_match_index.set_listener([this]()
+                               {
+        m_overview.set_matches(m_match_index.matches());
+        m_overview_ruler.queue_draw(); });
+    m_editor_box.append(m_editor_scroller);
+    m_editor_box.append(m_overview_ruler);
+
+    m_editor_paned.set_start_child(m_editor_box);
+    m_editor_paned.set_resize_start_child(true);
+    m_editor_paned.set_shrink_start_child(false);
+    m_editor_paned.set_vexpand(true);
+
+    m_outline_paned.set_end_child(m_editor_paned);
+    m_outline_paned.set_resize_end_child(true);
+    m_outline_paned.set_shrink_end_child(false);
+    m_outline_paned.set_vexpand(true);
+
     // ✅ Pack into center container
-    m_editor_container.append(m_editor_scroller);
+    m_editor_container.append(m_outline_paned);
+}
+
+void AppWindow::on_buffer_changed()
+{
+    TRACE_SCOPE("buffer.changed");
+    m_session_edit_stale = true;
+    if (m_loading)
+        return;
+    if (m_log_filter)
+        m_log_filter->set_stale();
+    if (m_time_index_ready)
+        drop_time_index();
+    if (m_csv)
+        m_csv->set_stale();
+    queue_cursor_update();
+    if (!m_modified)
+    {
+        m_modified = true;
+        m_footer_left.set_text("Modified");
+    }
+    queue_saved_check();
+    queue_session_save();
 }
 
 void AppWindow::build_menu()
@@ -133,14 +464,46 @@ void AppWindow::build_menu()
 
     auto file_section = Gio::Menu::create();
     file_section->append("Open", "win.open");
+    m_recent_menu = Gio::Menu::create();
+    update_recent_menu();
+    file_section->append_submenu("Open Recent", m_recent_menu);
+    file_section->append("Quick Open…", "win.quick_open");
+    file_section->append("Compare with File…", "win.compare");
     file_section->append("Save", "win.save");
     file_section->append("Find…", "win.find_text");
     file_section->append("Replace…", "win.replace_text");
 
+    auto edit_section = Gio::Menu::create();
+    edit_section->append("Filter Through Command…", "win.filter_command");
+    edit_section->append("Filter Lines…", "win.log_filter");
+    edit_section->append("Outline", "win.outline");
+    edit_section->append("Go to Time…", "win.goto_time");
+    edit_section->append("Jump to Matching Bracket", "win.jump_to_bracket");
+    edit_section->append("Select Enclosing Block", "win.select_block");
+    edit_section->append("Complete Word", "win.complete_word");
+    edit_section->append("Hex View", "win.hex_view");
+    edit_section->append("Column View (CSV/TSV)", "win.csv_view");
+
+    auto lines_menu = Gio::Menu::create();
+    lines_menu->append("Sort", "win.line_op::sort");
+    lines_menu->append("Sort Numerically", "win.line_op::sort-numeric");
+    lines_menu->append("Sort Naturally", "win.line_op::sort-natural");
+    lines_menu->append("Sort Ignoring Case", "win.line_op::sort-caseless");
+    lines_menu->append("Remove Duplicates", "win.line_op::unique");
+    lines_menu->append("Reverse", "win.line_op::reverse");
+    lines_menu->append("Shuffle", "win.line_op::shuffle");
+    edit_section->append_submenu("Lines", lines_menu);
+
+    auto json_menu = Gio::Menu::create();
+    json_menu->append("Format", "win.json::format");
+    json_menu->append("Minify", "win.json::minify");
+    edit_section->append_submenu("JSON", json_menu);
+
     auto quit_section = Gio::Menu::create();
     quit_section->append("Quit", "win.quit");
 
     m_file_menu->append_section(file_section);
+    m_file_menu->append_section(edit_section);
     m_file_menu->append_section(quit_section);
     m_file_menu_btn.set_menu_model(m_file_menu);
 
@@ -148,6 +511,7 @@ void AppWindow::build_menu()
     m_help_menu = Gio::Menu::create();
     m_help_menu->append("Preferences", "win.preferences");
     m_help_menu->append("Toggle Theme", "win.toggle_theme");
+    m_help_menu->append("Memory…", "win.memory");
     m_help_menu->append("About", "win.about");
 
     m_help_menu_btn.set_menu_model(m_help_menu);
@@ -162,6 +526,16 @@ void AppWindow::install_actions()
                                     { on_open(); });
     m_actions->add_action(open);
 
+    auto open_recent = Gio::SimpleAction::create("open_recent", Glib::VARIANT_TYPE_STRING);
+    open_recent->signal_activate().connect([this](const Glib::VariantBase &param)
+                                           { on_open_recent(Glib::VariantBase::cast_dynamic<Glib::Variant<Glib::ustring>>(param).get().raw()); });
+    m_actions->add_action(open_recent);
+
+    auto quick_open = Gio::SimpleAction::create("quick_open");
+    quick_open->signal_activate().connect([this](auto &)
+                                          { on_quick_open(); });
+    m_actions->add_action(quick_open);
+
     auto save = Gio::SimpleAction::create("save");
     save->signal_activate().connect([this](auto &)
                                     { on_save(); });
@@ -177,6 +551,66 @@ void AppWindow::install_actions()
                                             { on_replace_text(); });
     m_actions->add_action(replace_text);
 
+    auto filter_command = Gio::SimpleAction::create("filter_command");
+    filter_command->signal_activate().connect([this](auto &)
+                                              { on_filter_command(); });
+    m_actions->add_action(filter_command);
+
+    auto log_filter = Gio::SimpleAction::create("log_filter");
+    log_filter->signal_activate().connect([this](auto &)
+                                          { on_log_filter(); });
+    m_actions->add_action(log_filter);
+
+    auto outline = Gio::SimpleAction::create("outline");
+    outline->signal_activate().connect([this](auto &)
+                                       { on_outline(); });
+    m_actions->add_action(outline);
+
+    auto goto_time = Gio::SimpleAction::create("goto_time");
+    goto_time->signal_activate().connect([this](auto &)
+                                         { on_goto_time(); });
+    m_actions->add_action(goto_time);
+
+    auto jump_to_bracket = Gio::SimpleAction::create("jump_to_bracket");
+    jump_to_bracket->signal_activate().connect([this](auto &)
+                                               { on_jump_to_bracket(); });
+    m_actions->add_action(jump_to_bracket);
+
+    auto select_block = Gio::SimpleAction::create("select_block");
+    select_block->signal_activate().connect([this](auto &)
+                                            { on_select_block(); });
+    m_actions->add_action(select_block);
+
+    auto complete_word = Gio::SimpleAction::create("complete_word");
+    complete_word->signal_activate().connect([this](auto &)
+                                             { update_completion(); });
+    m_actions->add_action(complete_word);
+
+    auto hex_view = Gio::SimpleAction::create("hex_view");
+    hex_view->signal_activate().connect([this](auto &)
+                                        { on_hex_view(); });
+    m_actions->add_action(hex_view);
+
+    auto csv_view = Gio::SimpleAction::create("csv_view");
+    csv_view->signal_activate().connect([this](auto &)
+                                        { on_csv_view(); });
+    m_actions->add_action(csv_view);
+
+    auto compare = Gio::SimpleAction::create("compare");
+    compare->signal_activate().connect([this](auto &)
+                                       { on_compare(); });
+    m_actions->add_action(compare);
+
+    auto line_op = Gio::SimpleAction::create("line_op", Glib::VARIANT_TYPE_STRING);
+    line_op->signal_activate().connect([this](const Glib::VariantBase &param)
+                                       { on_line_op(Glib::VariantBase::cast_dynamic<Glib::Variant<Glib::ustring>>(param).get()); });
+    m_actions->add_action(line_op);
+
+    auto json = Gio::SimpleAction::create("json", Glib::VARIANT_TYPE_STRING);
+    json->signal_activate().connect([this](const Glib::VariantBase &param)
+                                    { on_json(Glib::VariantBase::cast_dynamic<Glib::Variant<Glib::ustring>>(param).get()); });
+    m_actions->add_action(json);
+
     auto prefs = Gio::SimpleAction::create("preferences");
     prefs->signal_activate().connect([this](auto &)
                                      { on_preferences(); });
@@ -192,6 +626,11 @@ void AppWindow::install_actions()
                                      { on_about(); });
     m_actions->add_action(about);
 
+    auto memory = Gio::SimpleAction::create("memory");
+    memory->signal_activate().connect([this](auto &)
+                                      { on_memory(); });
+    m_actions->add_action(memory);
+
     auto quit = Gio::SimpleAction::create("quit");
     quit->signal_activate().connect([this](auto &)
                                     { on_quit(); });
@@ -214,16 +653,196 @@ void AppWindow::install_shortcuts()
     };
 
     add(GDK_KEY_o, Gdk::ModifierType::CONTROL_MASK, "win.open");         // Ctrl+O
+    add(GDK_KEY_p, Gdk::ModifierType::CONTROL_MASK, "win.quick_open");   // Ctrl+P
     add(GDK_KEY_s, Gdk::ModifierType::CONTROL_MASK, "win.save");         // Ctrl+S
     add(GDK_KEY_f, Gdk::ModifierType::CONTROL_MASK, "win.find_text");    // Ctrl+F
     add(GDK_KEY_h, Gdk::ModifierType::CONTROL_MASK, "win.replace_text"); // Ctrl+H (common “Replace”)
     add(GDK_KEY_q, Gdk::ModifierType::CONTROL_MASK, "win.quit");         // Ctrl+Q
+    add(GDK_KEY_L, Gdk::ModifierType::CONTROL_MASK | Gdk::ModifierType::SHIFT_MASK, "win.log_filter"); // Ctrl+Shift+L
+    add(GDK_KEY_O, Gdk::ModifierType::CONTROL_MASK | Gdk::ModifierType::SHIFT_MASK, "win.outline");    // Ctrl+Shift+O
+    add(GDK_KEY_T, Gdk::ModifierType::CONTROL_MASK | Gdk::ModifierType::SHIFT_MASK, "win.goto_time");  // Ctrl+Shift+T
+    add(GDK_KEY_X, Gdk::ModifierType::CONTROL_MASK | Gdk::ModifierType::SHIFT_MASK, "win.hex_view");   // Ctrl+Shift+X
+    add(GDK_KEY_m, Gdk::ModifierType::CONTROL_MASK, "win.jump_to_bracket");                            // Ctrl+M
+    add(GDK_KEY_M, Gdk::ModifierType::CONTROL_MASK | Gdk::ModifierType::SHIFT_MASK, "win.select_block"); // Ctrl+Shift+M
+    add(GDK_KEY_space, Gdk::ModifierType::CONTROL_MASK, "win.complete_word");                          // Ctrl+Space
 
     add_controller(m_shortcuts);
 }
 
+void AppWindow::install_memory_stats()
+{
+    // GTK keeps two toggle segments per tagged range; this is an estimate.
+    constexpr std::size_t kTagRangeBytes = 2 * 48;
+
+    m_memory.add({"Text buffer",
+                  [this]()
+                  { return m_counts.bytes; },
+                  [this]()
+                  { return std::to_string(m_buffer->get_char_count()) + " chars"; },
+                  nullptr});
+
+    m_memory.add({"Tags \"hl\"",
+                  [this]()
+                  { return m_hl_segments * kTagRangeBytes; },
+                  [this]()
+                  { return std::to_string(m_hl_segments) + " ranges"; },
+                  [this]()
+                  {
+                      m_buffer->remove_tag_by_name("hl", m_buffer->begin(), m_buffer->end());
+                      m_hl_segments = 0;
+                  }});
+
+    m_memory.add({"Tags \"find_hl\"",
+                  [this]()
+                  { return m_match_index.tagged() * kTagRangeBytes; },
+                  [this]()
+                  { return std::to_string(m_match_index.tagged()) + " ranges"; },
+                  [this]()
+                  {
+                      m_buffer->remove_tag_by_name("find_hl", m_buffer->begin(), m_buffer->end());
+                      m_match_index.set_tagged(0);
+                  }});
+
+    m_memory.add({"Match cache",
+                  [this]()
+                  { return m_match_index.bytes(); },
+                  [this]()
+                  { return std::to_string(m_match_index.size()) + " matches"; },
+                  [this]()
+                  { m_match_index.drop(); }});
+
+    m_memory.add({"Overview ruler",
+                  [this]()
+                  { return m_overview.bytes(); },
+                  [this]()
+                  { return std::to_string(m_overview.bucket_count()) + " buckets of " +
+                           std::to_string(m_overview.bucket_chars()) + " chars"; },
+                  nullptr});
+
+    m_memory.add({"Quick open index",
+                  [this]()
+                  { return m_quick_open ? m_quick_open->bytes() : 0; },
+                  [this]()
+                  { return std::to_string(m_quick_open ? m_quick_open->file_count() : 0) + " files"; },
+                  [this]()
+                  {
+                      if (m_quick_open)
+                          m_quick_open->drop();
+                  }});
+
+    m_memory.add({"Line index",
+                  [this]()
+                  { return m_line_index.bytes(); },
+                  [this]()
+                  { return std::to_string(m_line_index.line_count()) + " lines"; },
+                  [this]()
+                  { m_line_index.clear(); }});
+
+    m_memory.add({"Line filter",
+                  [this]()
+                  { return m_log_filter ? m_log_filter->bytes() : 0; },
+                  nullptr,
+                  [this]()
+                  {
+                      if (m_log_filter)
+                          m_log_filter->clear();
+                  }});
+
+    m_memory.add({"Time index",
+                  [this]()
+                  { return m_time_index.bytes(); },
+                  [this]()
+                  { return std::string(LogTimeIndex::format_name(m_time_index.format())) + " timestamps"; },
+                  [this]()
+                  { drop_time_index(); }});
+
+    m_memory.add({"Bracket index",
+                  [this]()
+                  { return m_brackets.bytes(); },
+                  [this]()
+                  { return std::string(m_brackets.valid() ? "ready" : m_brackets_oversize ? "too many brackets" : "not built"); },
+                  [this]()
+                  {
+                      m_bracket_task.stop();
+                      m_brackets.clear();
+                      clear_bracket_match();
+                  }});
+
+    m_memory.add({"Word index",
+                  [this]()
+                  { return m_words.bytes(); },
+                  [this]()
+                  { return std::to_string(m_words.size()) + " words"; },
+                  [this]()
+                  {
+                      m_word_task.stop();
+                      m_words.clear();
+                  }});
+
+    m_memory.add({"Outline",
+                  [this]()
+                  { return m_outline.bytes(); },
+                  [this]()
+                  { return std::to_string(m_outline.size()) + " entries"; },
+                  [this]()
+                  {
+                      m_outline_task.stop();
+                      clear_outline();
+                  }});
+
+    m_memory.add({"Saved-state hashes",
+                  [this]()
+                  { return m_saved_hashes.bytes(); },
+                  [this]()
+                  { return std::to_string(m_saved_hashes.block_count()) + " blocks"; },
+                  [this]()
+                  {
+                      // Edits then keep the document modified until saved.
+                      m_hash_task.stop();
+                      m_saved_hashes.clear();
+                  }});
+
+    m_memory.add({"CSV index",
+                  [this]()
+                  { return m_csv ? m_csv->bytes() : 0; },
+                  nullptr,
+                  [this]()
+                  {
+                      if (m_csv)
+                          m_csv->clear();
+                  }});
+
+    m_memory.add({"Diff",
+                  [this]()
+                  { return m_diff ? m_diff->bytes() : 0; },
+                  nullptr,
+                  [this]()
+                  {
+                      if (m_diff)
+                          set_view(ViewMode::Text);
+                  }});
+
+    // GTK owns the undo stack; we count the text it has been handed.
+    // Toggling undo off and on empties it.
+    m_memory.add({"Undo history",
+                  [this]()
+                  { return m_undo_bytes; },
+                  nullptr,
+                  [this]()
+                  {
+                      m_buffer->set_enable_undo(false);
+                      m_buffer->set_enable_undo(true);
+                      m_undo_bytes = 0;
+                  }});
+}
+
 // -------- File helpers --------
-void AppWindow::load_file(const std::string &path)
+void AppWindow::open_file(const std::string &path)
+{
+    load_file(path);
+}
+
+void AppWindow::load_file(const std::string &path, bool detect_binary)
 {
     if (!m_buffer)
     {
@@ -231,248 +850,2014 @@ void AppWindow::load_file(const std::string &path)
         return;
     }
 
-    std::ifstream in(path);
-    if (!in)
+    TRACE_SCOPE("load.open");
+
+    std::string error;
+    auto mapped = MappedFile::open(path, error);
+    if (!mapped)
     {
         set_status("Failed to open: " + path);
         return;
     }
 
-    std::stringstream ss;
-    ss << in.rdbuf();
+    m_paste.cancel();
+    remember_current();
+    m_loader.cancel();
+    stop_task_thread();
 
-    m_buffer->set_text(ss.str()); // ✅ only once
+    m_document = mapped;
     m_current_path = path;
+    m_line_index.clear();
+
+    // A file opened before with the same identity gets its format, view and
+    // (for large files) line index back from the cache.
+    m_recent_current = RecentEntry{};
+    m_recent_current.path = path;
+    m_recent_current.size = mapped->size();
+    m_recent_known = RecentCache::stat_file(path, m_recent_current.size, m_recent_current.mtime);
+    m_recent_current.fingerprint = content_hash::fingerprint(mapped->view());
+    m_restore = PendingView{};
+    const RecentEntry *cached = m_recent_known ? m_recent.find(path, m_recent_current.size, m_recent_current.mtime,
+                                                               m_recent_current.fingerprint)
+                                               : nullptr;
+    if (cached)
+    {
+        m_recent_current.format = cached->format;
+        m_restore = PendingView{true, cached->cursor_line, cached->cursor_column, cached->top_line};
+        if (cached->has_line_index && m_recent.load_line_index(*cached, m_line_index))
+            m_recent_current.has_line_index = true;
+    }
+    else
+    {
+        m_recent_current.format = detect_text_format(mapped->view().substr(0, kFormatSampleBytes));
+    }
+    m_format = m_recent_current.format;
+    m_recent_lines_ok = true;
+
+    drop_time_index();
+    m_bracket_task.stop();
+    m_brackets.clear();
+    m_brackets_stale = false;
+    m_brackets_oversize = false;
+    m_word_task.stop();
+    m_words.clear();
+    m_words_stale = false;
+    m_completion.popdown();
+    m_outline_task.stop();
+    m_outline.clear();
+    m_outline.set_language(outline_language_for(path));
+    m_outline_stale = false;
+    if (m_outline_panel)
+        m_outline_panel->refresh();
+    m_hash_task.stop();
+    m_saved_hashes.clear();
+    m_dirty.reset(1);
+    m_saved_is_document = true;
+    m_partial_load = false;
+    m_overview.reset(0);
+    if (m_csv)
+        m_csv->clear();
+    m_loading = true;
+    m_modified = false;
+    m_textview.set_editable(false);
 
-    set_status("Opened: " + path);
+    m_buffer->begin_irreversible_action();
+    m_buffer->set_text("");
+    m_buffer->end_irreversible_action();
 
-    m_modified = false;
+    // Binary content would stop the text load at the first invalid byte;
+    // show it as hex straight from the mapping instead.
+    if (detect_binary && HexPanel::looks_binary(mapped->view()))
+    {
+        m_loading = false;
+        set_view(ViewMode::Hex);
+        set_status("Opened in hex view: " + path + " (" + std::to_string(mapped->size()) + " bytes)");
+        return;
+    }
+    set_view(ViewMode::Text);
+    m_buffer->place_cursor(m_buffer->begin());
+
+    // The first screenful goes in now; the rest streams in from idle
+    // callbacks after the window has painted, so time-to-first-paint does
+    // not depend on the file size.
+    m_loader.start(
+        m_buffer, m_buffer->begin(), mapped, mapped->view(), kFirstScreenBytes,
+        [this, path](std::size_t done, std::size_t total)
+        {
+            // Index lines of what has just been inserted (still hot in cache).
+            const auto indexed = static_cast<std::size_t>(m_line_index.indexed());
+            if (m_document && done > indexed)
+                m_line_index.append(m_document->view().substr(indexed, done - indexed));
+
+            restore_view(done);
+
+            if (total > 0)
+                set_status("Loading " + path + "… " + std::to_string(done * 100 / total) + "%");
+        },
+        [this, path](bool complete)
+        {
+            m_loading = false;
+            m_textview.set_editable(true);
+            m_modified = false;
+            // The buffer holds only a prefix of the file; saving it under the
+            // same name would cut the file short.
+            m_partial_load = !complete;
+            m_undo_bytes = 0;
+            m_dirty.reset(m_buffer->get_line_count());
+            ensure_bracket_index();
+            ensure_word_index();
+            hash_saved_document();
+            if (m_outline_panel && m_outline_panel->get_visible())
+                ensure_outline_index();
+
+            if (complete)
+            {
+                restore_view(m_recent_current.size);
+                remember_current();
+                set_status("Opened: " + path + " (" + std::to_string(m_line_index.line_count()) + " lines, " +
+                           encoding_name(m_format) + ", " + line_ending_name(m_format.eol) + ")");
+            }
+            if (complete && (path.ends_with(".csv") || path.ends_with(".tsv")))
+                set_view(ViewMode::Csv);
+            else if (m_loader.invalid_utf8())
+                set_status("Opened: " + path + " (stopped at invalid UTF-8, byte " +
+                           std::to_string(m_loader.error_offset()) +
+                           "; only that part is loaded, so Save asks for a new name)");
+            if (m_session_edit.has_edit && m_session_edit.path == path)
+                apply_session_edit(complete);
+            queue_session_save();
+        });
 }
 
 void AppWindow::save_file_to(const std::string &path)
 {
     if (!m_buffer)
         return;
-
-    std::ofstream out(path);
-    if (!out)
+    if (m_partial_load && path == m_current_path)
     {
-        set_status("Failed to save: " + path);
+        set_status("Not saved: only part of " + path + " is loaded; use a new name.");
         return;
     }
 
-    out << m_buffer->get_text();
-    m_current_path = path;
+    TRACE_SCOPE("save");
 
-    set_status("Saved: " + path);
-}
+    // The hashing worker reads the mapping of the file being replaced.
+    m_hash_task.stop();
 
-// -------- Actions --------
-void AppWindow::on_find_text()
-{
-    if (!m_find_text)
+    // Written to a temporary file and renamed over the original: the open
+    // file and every snapshot of it (filters, hex view, previews, diffs)
+    // stay mapped to the old contents instead of seeing them truncated.
+    int mode = 0666;
+    GStatBuf st;
+    if (g_stat(path.c_str(), &st) == 0)
+        mode = static_cast<int>(st.st_mode & 0777);
+
+    const auto text = m_buffer->get_text();
+    GError *error = nullptr;
+    if (!g_file_set_contents_full(path.c_str(), text.data(), static_cast<gssize>(text.bytes()),
+                                  G_FILE_SET_CONTENTS_CONSISTENT, mode, &error))
     {
-        m_find_text = std::make_unique<FindTextDialog>(*this, m_textview);
+        set_status("Failed to save: " + path + (error ? std::string(" (") + error->message + ")" : std::string()));
+        if (error)
+            g_error_free(error);
+        hash_saved_document();
+        return;
     }
-    m_find_text->present();
+    m_current_path = path;
+
+    m_saved_hashes.build(text.raw());
+    m_dirty.reset(m_buffer->get_line_count());
+    m_saved_is_document = false;
+    m_partial_load = false;
+    m_modified = false;
+    m_overview.clear_edited();
+    m_overview_ruler.queue_draw();
+
+    // The saved file is a new identity; its view state is remembered now and
+    // its line index is no longer the one in m_line_index.
+    m_recent_current = RecentEntry{};
+    m_recent_current.path = path;
+    m_recent_current.format = m_format;
+    m_recent_current.fingerprint = content_hash::fingerprint(text.raw());
+    m_recent_known = RecentCache::stat_file(path, m_recent_current.size, m_recent_current.mtime);
+    m_recent_lines_ok = false;
+    remember_current();
+    // Nothing unsaved is left to keep.
+    m_session_edit_stale = true;
+    queue_session_save();
+
+    set_status("Saved: " + path);
 }
 
-void AppWindow::on_open()
+// -------- Paste --------
+void AppWindow::on_paste()
 {
-    auto dlg = Gtk::FileDialog::create();
-    dlg->set_title("Open File");
+    if (!m_textview.get_editable())
+        return;
 
-    dlg->open(*this, [this, dlg](const Glib::RefPtr<Gio::AsyncResult> &res)
-              {
+    // Read asynchronously: a large clipboard arrives through a pipe over
+    // many main loop iterations.
+    auto clipboard = m_textview.get_clipboard();
+    clipboard->read_text_async([this, clipboard](const Glib::RefPtr<Gio::AsyncResult> &result)
+                               {
         try {
-            auto file = dlg->open_finish(res);
-            if (!file) return;
-            load_file(file->get_path());
+            auto text = std::make_shared<const Glib::ustring>(clipboard->read_text_finish(result));
+            insert_text_chunked(text, text->raw(), "Paste");
         } catch (const Glib::Error &e) {
-            set_status(Glib::ustring("Open canceled/failed: ") + e.what());
+            set_status(Glib::ustring("Paste failed: ") + e.what());
         } });
 }
 
-void AppWindow::on_replace_text()
+bool AppWindow::on_drop_text(const Glib::ValueBase &value, double x, double y)
 {
-    if (!m_replace_text)
-    {
-        m_replace_text = std::make_unique<ReplaceTextDialog>(*this, m_textview);
-    }
-    m_replace_text->present();
+    if (!m_textview.get_editable() || !G_VALUE_HOLDS(value.gobj(), G_TYPE_STRING))
+        return false;
+
+    Glib::Value<Glib::ustring> text;
+    text.init(value.gobj());
+
+    int bx = 0, by = 0;
+    m_textview.window_to_buffer_coords(Gtk::TextWindowType::WIDGET, static_cast<int>(x), static_cast<int>(y), bx, by);
+    Gtk::TextBuffer::iterator at;
+    m_textview.get_iter_at_location(at, bx, by);
+    m_buffer->place_cursor(at);
+
+    auto copy = std::make_shared<const Glib::ustring>(text.get());
+    insert_text_chunked(copy, copy->raw(), "Drop");
+    return true;
 }
 
-void AppWindow::on_save()
+void AppWindow::update_overview_viewport()
 {
-    if (!m_modified)
-        return; // No changes to save
+    Gdk::Rectangle rect;
+    m_textview.get_visible_rect(rect);
+    Gtk::TextBuffer::iterator top, bottom;
+    m_textview.get_iter_at_location(top, rect.get_x(), rect.get_y());
+    m_textview.get_iter_at_location(bottom, rect.get_x(), rect.get_y() + rect.get_height());
+    bottom.forward_to_line_end();
+    m_overview_ruler.set_viewport(static_cast<std::uint64_t>(top.get_offset()),
+                                  static_cast<std::uint64_t>(bottom.get_offset()));
+}
+
+void AppWindow::insert_text_chunked(std::shared_ptr<const void> owner, std::string_view text,
+                                    const Glib::ustring &label)
+{
+    if (!m_textview.get_editable() || m_loading || text.empty())
+        return;
 
-    if (!m_current_path.empty())
+    m_buffer->begin_user_action();
+    m_buffer->erase_selection(true, true);
+    if (text.size() < kChunkedPasteBytes)
     {
-        save_file_to(m_current_path);
+        m_buffer->insert_interactive_at_cursor(text.data(), text.data() + text.size());
+        m_buffer->end_user_action();
+        m_textview.scroll_to(m_buffer->get_insert());
         return;
     }
 
-    auto dlg = Gtk::FileDialog::create();
-    dlg->set_title("Save File");
-
-    dlg->save(*this, [this, dlg](const Glib::RefPtr<Gio::AsyncResult> &res)
-              {
-        try {
-            auto file = dlg->save_finish(res);
-            if (!file) return;
-            save_file_to(file->get_path());
-        } catch (const Glib::Error &e) {
-            set_status(Glib::ustring("Save canceled/failed: ") + e.what());
-        } });
+    // Streamed like a file load, under one user action, so a single undo
+    // takes it out. Per-slice work is kept to the counters: the indexes are
+    // dropped now and rebuilt on workers once, at the end, and the
+    // change-driven updates (on_buffer_changed) run once too.
+    TRACE_SCOPE("paste.start");
+    m_loading = true;
+    m_textview.set_editable(false);
+    m_completion.popdown();
+    m_bracket_task.stop();
+    m_brackets.clear();
+    m_word_task.stop();
+    m_words.clear();
+    m_outline_task.stop();
+    clear_outline();
+
+    const auto at = m_buffer->get_insert()->get_iter();
+    const int first_line = at.get_line();
+    const int first_char = at.get_offset();
+    const int lines_before = m_buffer->get_line_count();
+    const std::size_t chars_before = m_counts.chars;
+    m_paste.start(
+        m_buffer, at, std::move(owner), text, 0,
+        [this, label](std::size_t done, std::size_t total)
+        {
+            m_footer_left.set_text(label + "… " + std::to_string(done * 100 / total) + "%");
+        },
+        [this, label, first_line, first_char, lines_before, chars_before](bool complete)
+        {
+            m_buffer->end_user_action();
+            m_loading = false;
+            m_textview.set_editable(true);
+            m_undo_bytes += m_paste.inserted();
+            m_dirty.insert(first_line, m_buffer->get_line_count() - lines_before);
+            m_dirty.check(m_buffer->get_line_count());
+            m_overview.mark_edited(static_cast<std::uint64_t>(first_char),
+                                   static_cast<std::uint64_t>(first_char) + m_counts.chars - chars_before);
+            on_buffer_changed();
+
+            ensure_bracket_index();
+            ensure_word_index();
+            if (m_outline_panel && m_outline_panel->get_visible())
+                ensure_outline_index();
+            else if (m_outline_panel)
+                m_outline_panel->refresh();
+            m_textview.scroll_to(m_buffer->get_insert());
+
+            if (m_paste.invalid_utf8())
+                set_status(label + " stopped at invalid UTF-8, byte " + std::to_string(m_paste.error_offset()));
+            else if (!complete)
+                set_status(label + " cancelled after " + std::to_string(m_paste.inserted()) + " bytes");
+            else
+                set_status(label + ": " + std::to_string(m_paste.inserted()) + " bytes");
+        },
+        /*undoable=*/true);
 }
 
-void AppWindow::on_search_changed()
+// -------- Saved state --------
+void AppWindow::hash_saved_document()
 {
+    if (!m_saved_is_document || !m_document || m_saved_hashes.valid() || m_hash_task.running())
+        return;
+
+    auto document = m_document;
+    auto hashes = std::make_shared<BlockHashes>();
+    m_hash_task.start([document, hashes](BackgroundTask::Control &control)
+                      { hashes->build(document->view(), &control.cancel); },
+                      [this, hashes](bool cancelled)
+                      {
+                          if (cancelled)
+                              return;
+                          m_saved_hashes = std::move(*hashes);
+                          if (m_modified)
+                              queue_saved_check();
+                      });
 }
 
-void AppWindow::highlight_matches(const Glib::ustring &term)
+void AppWindow::queue_saved_check()
 {
-    if (!m_buffer)
+    if (m_saved_check_idle.connected() || m_loading)
         return;
+    m_saved_check_idle = Glib::signal_idle().connect([this]()
+                                                     {
+            if (m_modified && !m_loading && matches_saved())
+            {
+                m_modified = false;
+                m_overview.clear_edited();
+                m_overview_ruler.queue_draw();
+                m_footer_left.set_text("Unmodified");
+            }
+            return false; });
+}
 
-    auto start = m_buffer->begin();
-    auto end = m_buffer->end();
-    m_buffer->remove_tag_by_name("hl", start, end);
+bool AppWindow::matches_saved()
+{
+    if (m_dirty.empty())
+        return true;
+    // Any difference in size or line count settles it without hashing.
+    // Both count lines as the buffer does; a range that lost track of that
+    // (an edit joining or splitting "\r\n") proves nothing.
+    if (!m_saved_hashes.valid() || !m_dirty.exact() || m_dirty.delta() != 0 ||
+        m_counts.bytes != m_saved_hashes.size() ||
+        static_cast<std::uint64_t>(m_buffer->get_line_count()) != m_saved_hashes.lines())
+        return false;
+
+    constexpr auto kLines = BlockHashes::kLinesPerBlock;
+    const auto first = static_cast<std::size_t>(m_dirty.first() / kLines);
+    const auto last = std::min(static_cast<std::size_t>(m_dirty.last() / kLines), m_saved_hashes.block_count() - 1);
+    if (first > last)
+        return false;
+    std::uint64_t bytes = 0;
+    for (auto b = first; b <= last; ++b)
+        bytes += m_saved_hashes.block_bytes(b);
+    if (bytes > kMaxSavedCheckBytes)
+        return false;
+
+    // Lines outside the dirty range are the saved ones, so the blocks
+    // covering it decide.
+    TRACE_SCOPE("hashes.check");
+    for (auto b = first; b <= last; ++b)
+    {
+        const auto start = m_buffer->get_iter_at_line(static_cast<int>(b * kLines));
+        const auto end = m_buffer->get_iter_at_line(static_cast<int>((b + 1) * kLines));
+        const auto text = m_buffer->get_text(start, end, true);
+        if (BlockHashes::hash_block(text.raw()) != m_saved_hashes.block_hash(b))
+            return false;
+    }
+    m_dirty.reset(m_buffer->get_line_count());
+    return true;
+}
 
-    if (term.empty())
+bool AppWindow::changed_on_disk()
+{
+    // Size and mtime as of the last load or save; the file is not read.
+    if (!m_recent_known || m_recent_current.path != m_current_path)
+        return false;
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    if (!RecentCache::stat_file(m_current_path, size, mtime))
+        return false;
+    return size != m_recent_current.size || mtime != m_recent_current.mtime;
+}
+
+void AppWindow::confirm_overwrite(std::function<void()> save)
+{
+    auto *dialog = new Gtk::MessageDialog(*this, "The file has changed on disk.", false, Gtk::MessageType::WARNING,
+                                          Gtk::ButtonsType::NONE, true);
+    dialog->set_secondary_text("Another program modified " + m_current_path +
+                               " after it was opened. Saving will overwrite those changes.");
+    dialog->add_button("_Cancel", Gtk::ResponseType::CANCEL);
+    dialog->add_button("_Overwrite", Gtk::ResponseType::ACCEPT);
+    dialog->set_default_response(Gtk::ResponseType::CANCEL);
+
+    dialog->signal_response().connect([dialog, save](int response)
+                                      {
+        dialog->hide();
+        delete dialog;
+        if (static_cast<Gtk::ResponseType>(response) == Gtk::ResponseType::ACCEPT)
+            save(); });
+    dialog->present();
+}
+
+// -------- Recent files --------
+void AppWindow::remember_current()
+{
+    if (!m_recent_known)
         return;
 
-    auto it = m_buffer->begin();
-    while (true)
+    RecentEntry entry = m_recent_current;
+    PendingView view;
+    if (view_state(view))
     {
-        auto match_start = it;
-        auto match_end = it;
+        entry.cursor_line = view.cursor_line;
+        entry.cursor_column = view.cursor_column;
+        entry.top_line = view.top_line;
+    }
 
-        if (!match_start.forward_search(term,
-                                        Gtk::TextSearchFlags::CASE_INSENSITIVE,
-                                        match_start, match_end))
-            break;
+    // The line index is written once per identity, and only when it is
+    // complete and large enough to be worth reading back.
+    const LineIndex *lines = nullptr;
+    if (!entry.has_line_index && m_recent_lines_ok && m_line_index.indexed() == entry.size &&
+        m_line_index.line_count() >= kMinCachedLines)
+    {
+        lines = &m_line_index;
+    }
 
-        m_buffer->apply_tag_by_name("hl", match_start, match_end);
-        it = match_end;
+    {
+        TRACE_SCOPE("recent.remember");
+        m_recent.remember(entry, lines);
+        m_recent.save();
     }
+    m_recent_current.has_line_index = m_recent.entries().front().has_line_index;
+    update_recent_menu();
 }
 
-void AppWindow::on_preferences()
+bool AppWindow::view_state(PendingView &out)
 {
-    auto prefs = Gtk::make_managed<Gtk::Window>();
-    prefs->set_title("Preferences");
-    prefs->set_transient_for(*this);
-    prefs->set_modal(true);
-    prefs->set_default_size(420, 160);
-
-    auto box = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL);
-    box->set_margin(16);
-    box->set_spacing(12);
+    if (m_restore.active)
+    {
+        // Not applied yet (still loading, or shown as hex): keep what was
+        // remembered last time.
+        out = m_restore;
+        return true;
+    }
+    if (m_loading || m_view != ViewMode::Text)
+        return false;
+
+    const auto cursor = m_buffer->get_insert()->get_iter();
+    out.cursor_line = static_cast<std::uint32_t>(cursor.get_line());
+    out.cursor_column = static_cast<std::uint32_t>(cursor.get_line_offset());
+
+    Gdk::Rectangle visible;
+    m_textview.get_visible_rect(visible);
+    Gtk::TextBuffer::iterator top;
+    int line_top = 0;
+    m_textview.get_line_at_y(top, visible.get_y(), line_top);
+    out.top_line = static_cast<std::uint32_t>(top.get_line());
+    return true;
+}
 
-    auto title = Gtk::make_managed<Gtk::Label>();
-    title->set_markup("<b>Theme</b>");
-    title->set_halign(Gtk::Align::START);
+void AppWindow::restore_view(std::size_t loaded_bytes)
+{
+    if (!m_restore.active)
+        return;
 
-    auto dark = Gtk::make_managed<Gtk::CheckButton>("Enable darker look (simple CSS)");
-    dark->set_active(m_dark);
-    dark->signal_toggled().connect([this, dark]()
-                                   {
-        m_dark = dark->get_active();
-        apply_theme(); });
+    // Wait until both lines have streamed in; with a cached line index that
+    // is known long before the load completes.
+    if (loaded_bytes < m_recent_current.size)
+    {
+        const std::size_t last = std::max(m_restore.cursor_line, m_restore.top_line) + 1;
+        if (last >= m_line_index.line_count() || loaded_bytes < m_line_index.line_start(last))
+            return;
+    }
+    m_restore.active = false;
+
+    m_buffer->place_cursor(m_buffer->get_iter_at_line_offset(static_cast<int>(m_restore.cursor_line),
+                                                            static_cast<int>(m_restore.cursor_column)));
+
+    // Scrolling to a mark waits for the lines above it to be measured.
+    const auto top = m_buffer->get_iter_at_line(static_cast<int>(m_restore.top_line));
+    if (!m_restore_mark)
+        m_restore_mark = m_buffer->create_mark(top);
+    else
+        m_buffer->move_mark(m_restore_mark, top);
+    m_textview.scroll_to(m_restore_mark, 0.0, 0.0, 0.0);
+}
 
-    box->append(*title);
-    box->append(*dark);
+void AppWindow::update_recent_menu()
+{
+    if (!m_recent_menu)
+        return;
 
-    prefs->set_child(*box);
-    prefs->present();
+    m_recent_menu->remove_all();
+    for (const auto &entry : m_recent.entries())
+    {
+        const auto label = Glib::path_get_basename(entry.path) + "  —  " + Glib::path_get_dirname(entry.path);
+        auto item = Gio::MenuItem::create(label, "");
+        item->set_action_and_target("win.open_recent", Glib::Variant<Glib::ustring>::create(entry.path));
+        m_recent_menu->append_item(item);
+    }
 }
 
-void AppWindow::on_toggle_theme()
+// -------- Session --------
+void AppWindow::queue_session_save()
 {
-    m_dark = !m_dark;
-    apply_theme();
+    // At most one write per delay, however fast the changes come.
+    if (!m_session_owner || m_session_timer.connected())
+        return;
+    m_session_timer = Glib::signal_timeout().connect(
+        [this]()
+        {
+            // Not in the middle of a load or large paste: the edit would be missing.
+            if (m_loading)
+                return true;
+            save_session();
+            return false;
+        },
+        kSessionSaveDelayMs);
 }
 
-void AppWindow::apply_theme()
+void AppWindow::save_session()
 {
-    if (!m_css)
-        m_css = Gtk::CssProvider::create();
+    m_session_timer.disconnect();
+    // A restored edit still waiting for its file is only in the old session.
+    if (!m_session_owner || m_session_edit.has_edit)
+        return;
 
-    const char *css_light = "textview { font-size: 12pt; }";
-    const char *css_dark =
-        "* { background-color: #1e1e1e; color: #e6e6e6; }"
-        "entry, textview { background-color: #2a2a2a; color: #e6e6e6; }"
-        "textview text { background-color: #2a2a2a; color: #e6e6e6; }";
+    // The cursor moves far more often than the text changes; the edit is
+    // only copied and written again after a change.
+    const bool with_edit = m_session_edit_stale;
+    SessionState state;
+    capture_session(state, with_edit);
+    if (m_session.save(state, with_edit) && with_edit)
+        m_session_edit_stale = false;
+}
 
-    try
+void AppWindow::capture_session(SessionState &out, bool with_edit)
+{
+    TRACE_SCOPE("session.capture");
+    out.dark = m_dark;
+    out.find_term = m_find_text ? m_find_text->term().raw() : m_find_term;
+    out.replace_find = m_replace_text ? m_replace_text->find_term().raw() : m_replace_find;
+    out.replace_with = m_replace_text ? m_replace_text->replacement().raw() : m_replace_with;
+
+    out.path = m_current_path;
+    if (m_recent_known)
     {
-        m_css->load_from_data(m_dark ? css_dark : css_light);
+        out.size = m_recent_current.size;
+        out.mtime = m_recent_current.mtime;
+        out.fingerprint = m_recent_current.fingerprint;
     }
-    catch (...)
+    PendingView view;
+    if (view_state(view))
     {
+        out.cursor_line = view.cursor_line;
+        out.cursor_column = view.cursor_column;
+        out.top_line = view.top_line;
     }
 
-    if (auto display = Gdk::Display::get_default())
+    if (!with_edit || !m_modified || m_loading || m_session_discard)
+        return;
+
+    // An untitled buffer is kept whole; a file only as the lines edited
+    // since it was loaded or saved (see DirtyLines), which stay small for
+    // the usual few edits in a large file.
+    Gtk::TextBuffer::iterator start = m_buffer->begin(), end = m_buffer->end();
+    if (out.path.empty())
+    {
+        if (m_counts.bytes > kMaxSessionEditBytes)
+            return;
+    }
+    else
     {
-        Gtk::StyleContext::add_provider_for_display(
-            display, m_css, GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+        // Buffer lines, as apply_session_edit() counts them in the reloaded
+        // file; a range that lost track of them is not kept.
+        if (!m_recent_known || m_dirty.empty() || !m_dirty.exact())
+            return;
+        const auto first = m_dirty.first();
+        const auto last = std::min<std::int64_t>(m_dirty.last(), m_buffer->get_line_count() - 1);
+        const auto removed = last - m_dirty.delta() - first + 1;
+        if (first < 0 || last < first || removed < 0)
+            return;
+        start = m_buffer->get_iter_at_line(static_cast<int>(first));
+        if (last + 1 < m_buffer->get_line_count())
+            end = m_buffer->get_iter_at_line(static_cast<int>(last + 1));
+        // Characters are a lower bound on bytes; the check is repeated below.
+        if (static_cast<std::uint64_t>(end.get_offset() - start.get_offset()) > kMaxSessionEditBytes)
+            return;
+        out.first_line = static_cast<std::uint32_t>(first);
+        out.removed_lines = static_cast<std::uint32_t>(removed);
     }
 
-    set_status(m_dark ? "Theme: dark" : "Theme: light");
+    out.text = snapshot_text(start, end);
+    out.has_edit = out.text.text.size() <= kMaxSessionEditBytes;
 }
 
-void AppWindow::on_about()
+void AppWindow::own_session()
 {
-    auto about = Gtk::make_managed<Gtk::AboutDialog>();
-    about->set_transient_for(*this);
-    about->set_modal(true);
-    about->set_program_name("Text Editor");
-    about->set_version("1.0");
-    about->set_comments("gtkmm-4.0 editor demo with File/Help menus + Find dialog.");
-    about->present();
+    TRACE_SCOPE("session.own");
+    m_session_owner = true;
+    SessionState state;
+    if (!m_session.load(state))
+        return;
+
+    // The file being opened takes the place of the last session's, whose
+    // unsaved edit would otherwise be gone with the first save.
+    restore_session_settings(state);
+    if (state.has_edit)
+        keep_session_backup(state, "because another file was opened");
 }
 
-void AppWindow::on_quit()
+void AppWindow::restore_session_settings(const SessionState &state)
 {
-    if (!m_modified) {
-        close();
-        return;
+    m_find_term = state.find_term;
+    m_replace_find = state.replace_find;
+    m_replace_with = state.replace_with;
+    if (state.dark)
+    {
+        // Now rather than after the first frame, so it is not painted light.
+        m_dark = true;
+        apply_theme();
     }
-
-    query_unsaved_changes([this](bool should_close) {
-        if (should_close)
-            close();
-    });
 }
 
-void AppWindow::query_unsaved_changes(std::function<void(bool should_close)> done)
+void AppWindow::restore_session()
 {
-    auto* dialog = new Gtk::MessageDialog(
-        *this,
-        "The document has unsaved changes.",
-        false,
-        Gtk::MessageType::QUESTION,
-        Gtk::ButtonsType::NONE,
-        true
-    );
+    TRACE_SCOPE("session.restore");
+    m_session_owner = true;
+    SessionState state;
+    if (!m_session.load(state))
+        return;
 
-    dialog->set_secondary_text("Do you want to save your changes before exiting?");
+    restore_session_settings(state);
 
-    dialog->add_button("_Cancel", Gtk::ResponseType::CANCEL);
-    dialog->add_button("_Discard", Gtk::ResponseType::REJECT);
-    dialog->add_button("_Save", Gtk::ResponseType::ACCEPT);
-    dialog->set_default_response(Gtk::ResponseType::ACCEPT);
+    if (state.path.empty())
+    {
+        if (!state.has_edit)
+            return;
+        // Streamed in like a paste when large, from the mapped session.
+        insert_text_chunked(state.text.owner, state.text.text, "Restore session");
+        if (!m_loading)
+        {
+            m_restore = PendingView{true, state.cursor_line, state.cursor_column, state.top_line};
+            restore_view(0);
+        }
+        return;
+    }
 
-    dialog->signal_response().connect(
-        [this, dialog, done](int response) mutable {
-            dialog->hide();
-            delete dialog;
+    if (!Glib::file_test(state.path, Glib::FileTest::IS_REGULAR))
+    {
+        if (state.has_edit)
+            keep_session_backup(state, "no longer exists");
+        return;
+    }
+    // Handed over before loading: a file of a screenful or less has loaded
+    // by the time load_file() returns, and the done callback applies it.
+    const std::string path = state.path;
+    const bool has_edit = state.has_edit;
+    const PendingView view{true, state.cursor_line, state.cursor_column, state.top_line};
+    if (has_edit)
+        m_session_edit = std::move(state);
+    load_file(path);
+    if (m_current_path != path)
+    {
+        if (m_session_edit.has_edit)
+        {
+            keep_session_backup(m_session_edit, "could not be opened");
+            m_session_edit = SessionState{};
+        }
+        return;
+    }
+
+    if (!has_edit)
+    {
+        m_restore = view;
+        restore_view(m_loading ? 0 : m_recent_current.size);
+        return;
+    }
+    // Binary content opens in the hex view without a text load, so nothing
+    // would ever apply the edit.
+    if (m_session_edit.has_edit && m_view == ViewMode::Hex)
+    {
+        keep_session_backup(m_session_edit, "opened as binary");
+        m_session_edit = SessionState{};
+    }
+}
+
+void AppWindow::apply_session_edit(bool complete)
+{
+    SessionState state = std::move(m_session_edit);
+    m_session_edit = SessionState{};
+    if (m_recent_current.size != state.size || m_recent_current.mtime != state.mtime ||
+        m_recent_current.fingerprint != state.fingerprint)
+    {
+        keep_session_backup(state, "changed on disk");
+        return;
+    }
+    if (!complete || m_loader.invalid_utf8())
+    {
+        keep_session_backup(state, "did not load completely");
+        return;
+    }
+
+    const auto lines = static_cast<std::uint64_t>(m_buffer->get_line_count());
+    const std::uint64_t end_line = std::uint64_t{state.first_line} + state.removed_lines;
+    if (state.first_line >= lines || end_line > lines)
+    {
+        keep_session_backup(state, "does not match the edit");
+        return;
+    }
+
+    // One user action, so a single undo goes back to the file on disk.
+    const auto start = m_buffer->get_iter_at_line(static_cast<int>(state.first_line));
+    const auto end = end_line < lines ? m_buffer->get_iter_at_line(static_cast<int>(end_line)) : m_buffer->end();
+    if (state.text.text.empty())
+    {
+        m_buffer->begin_user_action();
+        m_buffer->erase_interactive(start, end, true);
+        m_buffer->end_user_action();
+    }
+    else
+    {
+        m_buffer->select_range(start, end);
+        insert_text_chunked(state.text.owner, state.text.text, "Restore session");
+    }
+    if (!m_loading)
+    {
+        m_restore = PendingView{true, state.cursor_line, state.cursor_column, state.top_line};
+        restore_view(m_recent_current.size);
+    }
+    set_status("Restored unsaved changes: " + m_current_path);
+}
+
+void AppWindow::keep_session_backup(const SessionState &loaded, const Glib::ustring &why)
+{
+    Glib::ustring message = "Unsaved changes from the last session not restored: " + loaded.path + " ";
+    message += why;
+    if (m_session.keep_backup(loaded))
+        message += "; kept in " + m_session.backup_path();
+    set_status(message);
+}
+
+// -------- Actions --------
+void AppWindow::on_find_text()
+{
+    if (!m_find_text)
+    {
+        m_find_text = std::make_unique<FindTextDialog>(*this, m_textview, m_match_index);
+        if (!m_find_term.empty())
+            m_find_text->set_term(m_find_term);
+    }
+    m_find_text->present();
+}
+
+void AppWindow::on_open()
+{
+    auto dlg = Gtk::FileDialog::create();
+    dlg->set_title("Open File");
+
+    dlg->open(*this, [this, dlg](const Glib::RefPtr<Gio::AsyncResult> &res)
+              {
+        try {
+            auto file = dlg->open_finish(res);
+            if (!file) return;
+            load_file(file->get_path());
+        } catch (const Glib::Error &e) {
+            set_status(Glib::ustring("Open canceled/failed: ") + e.what());
+        } });
+}
+
+void AppWindow::on_open_recent(const std::string &path)
+{
+    if (!Glib::file_test(path, Glib::FileTest::IS_REGULAR))
+    {
+        m_recent.forget(path);
+        m_recent.save();
+        update_recent_menu();
+        set_status("No longer exists: " + path);
+        return;
+    }
+    load_file(path);
+}
+
+void AppWindow::on_quick_open()
+{
+    if (!m_quick_open)
+    {
+        m_quick_open = std::make_unique<QuickOpenDialog>(*this, [this](const std::string &path)
+                                                         { load_file(path); });
+    }
+    // The project of the open file, or of the working directory.
+    m_quick_open->present(m_current_path.empty() ? Glib::get_current_dir()
+                                                 : Glib::path_get_dirname(m_current_path));
+}
+
+void AppWindow::on_replace_text()
+{
+    if (!m_replace_text)
+    {
+        m_replace_text = std::make_unique<ReplaceTextDialog>(*this, m_textview, m_match_index, [this]()
+                                                             { return snapshot_text(m_buffer->begin(), m_buffer->end()); });
+        if (!m_replace_find.empty() || !m_replace_with.empty())
+            m_replace_text->set_terms(m_replace_find, m_replace_with);
+    }
+    m_replace_text->present();
+}
+
+void AppWindow::on_filter_command()
+{
+    if (!m_filter_command)
+    {
+        m_filter_command = std::make_unique<FilterCommandDialog>(*this, m_textview);
+    }
+    m_filter_command->present();
+}
+
+void AppWindow::on_line_op(const Glib::ustring &name)
+{
+    LineOp op;
+    if (!parse_line_op(name.raw(), op))
+        return;
+    if (m_loading || m_task.running())
+    {
+        set_status("Busy; try again when the current task has finished.");
+        return;
+    }
+
+    // Selection extended to whole lines, or the whole document.
+    Gtk::TextBuffer::iterator s, e;
+    if (m_buffer->get_selection_bounds(s, e))
+    {
+        s.set_line_offset(0);
+        if (!e.starts_line())
+            e.forward_line();
+    }
+    else
+    {
+        s = m_buffer->begin();
+        e = m_buffer->end();
+    }
+
+    auto snapshot = snapshot_text(s, e);
+    auto result = std::make_shared<std::string>();
+    auto start = m_buffer->create_mark(s, /*left_gravity=*/true);
+    auto end = m_buffer->create_mark(e, /*left_gravity=*/false);
+    const Glib::ustring label = line_op_label(op);
+
+    run_task(
+        label,
+        [snapshot, result, op](BackgroundTask::Control &control)
+        { apply_line_op(snapshot.text, op, *result, &control.cancel, &control.progress); },
+        [this, result, start, end, label](bool cancelled)
+        {
+            auto from = m_buffer->get_iter_at_mark(start);
+            auto to = m_buffer->get_iter_at_mark(end);
+            m_buffer->delete_mark(start);
+            m_buffer->delete_mark(end);
+
+            if (cancelled)
+            {
+                set_status(label + " cancelled; document unchanged.");
+                return;
+            }
+
+            // Replaces the lines as one undoable step, streamed in when large
+            // so ten million lines do not stall the window.
+            TRACE_SCOPE("lines.replace");
+            if (result->empty())
+            {
+                m_buffer->begin_user_action();
+                m_buffer->erase(from, to);
+                m_buffer->end_user_action();
+            }
+            else
+            {
+                m_buffer->select_range(from, to);
+                insert_text_chunked(result, *result, label);
+            }
+            if (!m_paste.running())
+            {
+                const auto lines = std::count(result->begin(), result->end(), '\n');
+                set_status(label + ": " + std::to_string(lines) + " lines.");
+            }
+        });
+}
+
+void AppWindow::on_json(const Glib::ustring &name)
+{
+    JsonStyle style;
+    if (!parse_json_style(name.raw(), style))
+        return;
+    if (m_loading || m_task.running())
+    {
+        set_status("Busy; try again when the current task has finished.");
+        return;
+    }
+
+    // The selection, or the whole document.
+    Gtk::TextBuffer::iterator s, e;
+    if (!m_buffer->get_selection_bounds(s, e))
+    {
+        s = m_buffer->begin();
+        e = m_buffer->end();
+    }
+
+    auto snapshot = snapshot_text(s, e);
+    auto result = std::make_shared<std::string>();
+    auto error = std::make_shared<JsonError>();
+    auto start = m_buffer->create_mark(s, /*left_gravity=*/true);
+    auto end = m_buffer->create_mark(e, /*left_gravity=*/false);
+    const Glib::ustring label = json_style_label(style);
+
+    run_task(
+        label,
+        [snapshot, result, error, style](BackgroundTask::Control &control)
+        { format_json(snapshot.text, style, kJsonIndent, *result, *error, &control.cancel, &control.progress); },
+        [this, snapshot, result, error, start, end, label](bool cancelled)
+        {
+            auto from = m_buffer->get_iter_at_mark(start);
+            auto to = m_buffer->get_iter_at_mark(end);
+            m_buffer->delete_mark(start);
+            m_buffer->delete_mark(end);
+
+            if (cancelled)
+            {
+                set_status(label + " cancelled; document unchanged.");
+            }
+            else if (!error->message.empty())
+            {
+                // Byte offset in the snapshot to a character in the buffer.
+                const auto chars = text_stats::count(snapshot.text.substr(0, error->offset)).chars;
+                auto at = from;
+                at.forward_chars(static_cast<int>(chars));
+                m_buffer->place_cursor(at);
+                m_textview.scroll_to(at, 0.2);
+                m_textview.grab_focus();
+                set_status("Invalid JSON at line " + std::to_string(at.get_line() + 1) + ", column " +
+                           std::to_string(at.get_line_offset() + 1) + ": " + error->message);
+            }
+            else if (*result == snapshot.text)
+            {
+                set_status(label + ": already in that form.");
+            }
+            else
+            {
+                // Replaces the range as one undoable step, streamed in when large.
+                m_buffer->select_range(from, to);
+                insert_text_chunked(result, *result, label);
+                if (!m_paste.running())
+                    set_status(label + ": " + std::to_string(result->size()) + " bytes.");
+            }
+        });
+}
+
+void AppWindow::on_cancel_task()
+{
+    m_task.cancel();
+    set_status(m_task_label + ": cancelling…");
+}
+
+void AppWindow::on_log_filter()
+{
+    if (!m_log_filter)
+    {
+        m_log_filter = std::make_unique<LogFilterPanel>();
+        m_log_filter->signal_apply().connect(sigc::mem_fun(*this, &AppWindow::on_log_filter_apply));
+        m_log_filter->signal_line_activated().connect(sigc::mem_fun(*this, &AppWindow::on_log_filter_line));
+        m_editor_paned.set_end_child(*m_log_filter);
+        m_editor_paned.set_shrink_end_child(false);
+        m_editor_paned.set_position(m_editor_paned.get_width() * 3 / 5);
+        return;
+    }
+    m_log_filter->set_visible(!m_log_filter->get_visible());
+}
+
+void AppWindow::on_log_filter_apply()
+{
+    const unsigned levels = m_log_filter->levels();
+    const auto term = m_log_filter->term();
+    if (levels == 0 && term.empty())
+    {
+        m_log_filter->set_status("Pick at least one level or enter a term.");
+        return;
+    }
+    if (m_loading || m_task.running())
+    {
+        m_log_filter->set_status("Busy; try again when the current task has finished.");
+        return;
+    }
+
+    std::shared_ptr<SearchEngine> engine;
+    if (!term.empty())
+    {
+        engine = std::make_shared<SearchEngine>(term.raw(), SearchOptions{});
+        if (!engine->valid())
+        {
+            m_log_filter->set_status("Invalid pattern: " + engine->error());
+            return;
+        }
+    }
+
+    // The panel keeps the snapshot: rows are drawn from it, so no line is
+    // ever copied out of the document.
+    auto snapshot = snapshot_text(m_buffer->begin(), m_buffer->end());
+    auto result = std::make_shared<LineFilterResult>();
+    m_log_filter->set_status("Filtering…");
+
+    run_task(
+        "Filtering lines",
+        [snapshot, engine, levels, result](BackgroundTask::Control &control)
+        { filter_lines(snapshot.text, levels, engine.get(), *result, &control.cancel, &control.progress); },
+        [this, snapshot, result](bool cancelled)
+        {
+            if (cancelled)
+            {
+                m_log_filter->set_status("Cancelled.");
+                set_status("Filtering lines cancelled.");
+                return;
+            }
+            m_log_filter->set_result(snapshot, std::move(*result));
+            set_status("Ready.");
+        });
+}
+
+void AppWindow::on_log_filter_line(std::uint32_t line)
+{
+    auto it = m_buffer->get_iter_at_line(static_cast<int>(line));
+    m_buffer->place_cursor(it);
+    m_textview.scroll_to(it, 0.2);
+    m_textview.grab_focus();
+}
+
+// -------- Outline --------
+namespace
+{
+// End of the first `chars` characters of the line `it` is on, from `it`.
+Gtk::TextBuffer::iterator line_prefix_end(const Gtk::TextBuffer::iterator &it, int chars)
+{
+    auto end = it;
+    end.forward_chars(chars);
+    if (end.get_line() != it.get_line())
+    {
+        // The line is shorter than that, so finding its end is cheap.
+        end = it;
+        end.forward_to_line_end();
+    }
+    return end;
+}
+
+constexpr int kOutlinePrefixChars = static_cast<int>(OutlineIndex::kLinePrefixBytes);
+} // namespace
+
+void AppWindow::on_outline()
+{
+    if (!m_outline_panel)
+    {
+        m_outline_panel = std::make_unique<OutlinePanel>();
+        m_outline_panel->set_index(&m_outline);
+        m_outline_panel->signal_line_activated().connect(sigc::mem_fun(*this, &AppWindow::on_outline_line));
+        m_outline_paned.set_start_child(*m_outline_panel);
+        m_outline_paned.set_shrink_start_child(false);
+        m_outline_paned.set_position(260);
+    }
+    else
+    {
+        m_outline_panel->set_visible(!m_outline_panel->get_visible());
+        if (!m_outline_panel->get_visible())
+            return;
+    }
+
+    if (m_outline.valid())
+        m_outline_panel->refresh();
+    else
+        ensure_outline_index();
+}
+
+void AppWindow::on_outline_line(std::uint32_t line)
+{
+    set_view(ViewMode::Text);
+    auto it = m_buffer->get_iter_at_line(static_cast<int>(line));
+    m_buffer->place_cursor(it);
+    m_textview.scroll_to(it, 0.2);
+    m_textview.grab_focus();
+}
+
+void AppWindow::ensure_outline_index()
+{
+    if (m_outline.valid() || m_outline_task.running() || m_loading)
+        return;
+    if (m_outline.language() == OutlineLanguage::None)
+    {
+        if (m_outline_panel)
+            m_outline_panel->set_status("No outline for this file type.");
+        return;
+    }
+
+    auto snapshot = snapshot_text(m_buffer->begin(), m_buffer->end());
+    auto index = std::make_shared<OutlineIndex>();
+    index->set_language(m_outline.language());
+    m_outline_stale = false;
+    if (m_outline_panel)
+        m_outline_panel->set_status("Scanning…");
+    m_outline_task.start([snapshot, index](BackgroundTask::Control &control)
+                         { index->build(snapshot.text, &control.cancel, &control.progress); },
+                         [this, index](bool cancelled)
+                         {
+                             if (cancelled)
+                                 return;
+                             if (m_outline_stale)
+                             {
+                                 ensure_outline_index();
+                                 return;
+                             }
+                             m_outline = std::move(*index);
+                             if (m_outline_panel)
+                                 m_outline_panel->refresh();
+                         });
+}
+
+// The panel's rows point into the entries, so they go too.
+void AppWindow::clear_outline()
+{
+    m_outline.clear();
+    if (m_outline_panel)
+        m_outline_panel->refresh();
+}
+
+std::string AppWindow::line_prefixes(int first_line, int count)
+{
+    std::string text;
+    for (int line = first_line; line < first_line + count; ++line)
+    {
+        const auto start = m_buffer->get_iter_at_line(line);
+        if (line > first_line)
+            text += '\n';
+        text += m_buffer->get_text(start, line_prefix_end(start, kOutlinePrefixChars), true).raw();
+    }
+    return text;
+}
+
+void AppWindow::update_outline_for_insert(int first_line, std::size_t newlines)
+{
+    if (m_outline_task.running())
+    {
+        m_outline_stale = true;
+        return;
+    }
+    if (!m_outline.valid())
+        return;
+
+    // The line the text went into is now 1 + `newlines` lines.
+    if (newlines > static_cast<std::size_t>(kOutlineRescanLines))
+        clear_outline();
+    else
+        m_outline.replace_lines(static_cast<std::uint32_t>(first_line), 1,
+                                line_prefixes(first_line, static_cast<int>(newlines) + 1));
+    queue_outline_refresh();
+}
+
+void AppWindow::update_outline_for_erase(const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end)
+{
+    if (m_outline_task.running())
+    {
+        m_outline_stale = true;
+        return;
+    }
+    if (!m_outline.valid())
+        return;
+
+    const int first = start.get_line();
+    const int last = end.get_line();
+    if (last - first > kOutlineRescanLines)
+    {
+        clear_outline();
+        queue_outline_refresh();
+        return;
+    }
+
+    // Lines first..last become one: what precedes `start` on its line
+    // followed by what follows `end` on its.
+    auto line_start = start;
+    line_start.set_line_offset(0);
+    std::string merged;
+    const int head = start.get_line_offset();
+    if (head >= kOutlinePrefixChars)
+        merged = m_buffer->get_text(line_start, line_prefix_end(line_start, kOutlinePrefixChars), true).raw();
+    else
+        merged = m_buffer->get_text(line_start, start, true).raw() +
+                 m_buffer->get_text(end, line_prefix_end(end, kOutlinePrefixChars - head), true).raw();
+
+    m_outline.replace_lines(static_cast<std::uint32_t>(first), static_cast<std::uint32_t>(last - first + 1), merged);
+    queue_outline_refresh();
+}
+
+void AppWindow::queue_outline_refresh()
+{
+    if (m_outline_idle.connected() || !m_outline_panel)
+        return;
+    m_outline_idle = Glib::signal_idle().connect([this]()
+                                                 {
+        if (!m_outline_panel->get_visible())
+            return false;
+        if (m_outline.valid())
+            m_outline_panel->refresh();
+        else
+            ensure_outline_index();
+        return false; });
+}
+
+void AppWindow::on_goto_time()
+{
+    auto win = Gtk::make_managed<Gtk::Window>();
+    win->set_title("Go to Time");
+    win->set_transient_for(*this);
+    win->set_default_size(380, -1);
+
+    auto box = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL);
+    box->set_margin(12);
+    box->set_spacing(8);
+
+    auto row = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::HORIZONTAL);
+    row->set_spacing(8);
+    auto entry = Gtk::make_managed<Gtk::Entry>();
+    entry->set_placeholder_text("14:03:20 or 2024-05-01 14:03:20");
+    entry->set_hexpand(true);
+    auto go = Gtk::make_managed<Gtk::Button>("Go");
+    row->append(*entry);
+    row->append(*go);
+
+    auto status = Gtk::make_managed<Gtk::Label>("First line at or after the time; the index is built on first use.");
+    status->set_halign(Gtk::Align::START);
+
+    box->append(*row);
+    box->append(*status);
+    win->set_child(*box);
+
+    // The label goes with the window when it is closed, which can happen
+    // while the index is still building; the slot is emptied with it.
+    const sigc::slot<void(const Glib::ustring &)> report = sigc::track_obj([status](const Glib::ustring &msg)
+                                                                           { status->set_text(msg); },
+                                                                           *status);
+    auto run = [this, entry, report]()
+    {
+        goto_time(entry->get_text(), report);
+    };
+    go->signal_clicked().connect(run);
+    entry->signal_activate().connect(run);
+
+    win->present();
+}
+
+void AppWindow::goto_time(const Glib::ustring &query, std::function<void(const Glib::ustring &)> report)
+{
+    if (m_time_index_ready)
+    {
+        seek_time(query, report);
+        return;
+    }
+    if (m_loading || m_task.running())
+    {
+        report("Busy; try again when the current task has finished.");
+        return;
+    }
+
+    auto snapshot = snapshot_text(m_buffer->begin(), m_buffer->end());
+    auto index = std::make_shared<LogTimeIndex>();
+    report("Indexing timestamps…");
+
+    run_task(
+        "Indexing timestamps",
+        [snapshot, index](BackgroundTask::Control &control)
+        { index->build(snapshot.text, &control.cancel, &control.progress); },
+        [this, snapshot, index, query, report](bool cancelled)
+        {
+            if (cancelled)
+            {
+                report("Cancelled.");
+                set_status("Indexing timestamps cancelled.");
+                return;
+            }
+            m_time_index = std::move(*index);
+            m_time_snapshot = snapshot;
+            m_time_index_ready = true;
+            set_status("Ready.");
+            seek_time(query, report);
+        });
+}
+
+void AppWindow::seek_time(const Glib::ustring &query, const std::function<void(const Glib::ustring &)> &report)
+{
+    TRACE_SCOPE("goto_time");
+
+    LogTimeIndex::Position pos;
+    std::string error;
+    if (!m_time_index.seek(m_time_snapshot.text, query.raw(), pos, error))
+    {
+        report(error);
+        return;
+    }
+
+    auto it = m_buffer->get_iter_at_line(static_cast<int>(pos.line));
+    m_buffer->place_cursor(it);
+    m_textview.scroll_to(it, 0.1);
+    report("Line " + std::to_string(pos.line + 1) + " (" + LogTimeIndex::format_name(m_time_index.format()) +
+           " timestamps).");
+}
+
+void AppWindow::drop_time_index()
+{
+    m_time_index.clear();
+    m_time_snapshot = {};
+    m_time_index_ready = false;
+}
+
+void AppWindow::ensure_bracket_index()
+{
+    if (m_brackets.valid() || m_bracket_task.running() || m_loading || m_brackets_oversize)
+        return;
+
+    // Built aside so editing goes on; edits made meanwhile mean indexing again.
+    auto snapshot = snapshot_text(m_buffer->begin(), m_buffer->end());
+    auto index = std::make_shared<BracketIndex>();
+    m_brackets_stale = false;
+    m_bracket_task.start([snapshot, index](BackgroundTask::Control &control)
+                         { index->build(snapshot.text, kMaxBracketTokens, &control.cancel); },
+                         [this, index](bool cancelled)
+                         {
+                             if (cancelled)
+                                 return;
+                             if (m_brackets_stale)
+                             {
+                                 ensure_bracket_index();
+                                 return;
+                             }
+                             if (!index->valid())
+                             {
+                                 m_brackets_oversize = true;
+                                 return;
+                             }
+                             m_brackets = std::move(*index);
+                             update_bracket_match();
+                         });
+}
+
+void AppWindow::clear_bracket_match()
+{
+    if (!m_bracket_shown)
+        return;
+    m_bracket_shown = false;
+    for (const auto &mark : m_bracket_marks)
+    {
+        auto s = mark->get_iter();
+        auto e = s;
+        e.forward_char();
+        m_buffer->remove_tag_by_name("bracket_match", s, e);
+    }
+}
+
+void AppWindow::update_bracket_match()
+{
+    TRACE_SCOPE("bracket.match");
+    clear_bracket_match();
+    if (!m_brackets.valid())
+    {
+        ensure_bracket_index();
+        return;
+    }
+
+    // The bracket after the cursor, else the one before it.
+    const int cursor = m_buffer->get_insert()->get_iter().get_offset();
+    int at = cursor;
+    int other = m_brackets.match(at);
+    if (other < 0 && cursor > 0)
+        other = m_brackets.match(at = cursor - 1);
+    if (other < 0)
+        return;
+
+    // Marked, so the next cursor move clears just these two characters
+    // wherever edits have moved them.
+    const int offsets[2] = {at, other};
+    for (int i = 0; i < 2; ++i)
+    {
+        auto s = m_buffer->get_iter_at_offset(offsets[i]);
+        auto e = s;
+        e.forward_char();
+        m_buffer->apply_tag_by_name("bracket_match", s, e);
+        if (!m_bracket_marks[i])
+            m_bracket_marks[i] = m_buffer->create_mark(s, /*left_gravity=*/false);
+        else
+            m_buffer->move_mark(m_bracket_marks[i], s);
+    }
+    m_bracket_shown = true;
+}
+
+void AppWindow::on_jump_to_bracket()
+{
+    if (m_view != ViewMode::Text)
+        return;
+    if (!m_brackets.valid())
+    {
+        ensure_bracket_index();
+        set_status(m_brackets_oversize ? "Too many brackets to index." : "Indexing brackets…");
+        return;
+    }
+
+    // On a bracket: its partner. Inside a block: the block's opening bracket.
+    const int cursor = m_buffer->get_insert()->get_iter().get_offset();
+    int target = m_brackets.match(cursor);
+    if (target < 0 && cursor > 0)
+        target = m_brackets.match(cursor - 1);
+    int open, close;
+    if (target < 0 && m_brackets.enclosing(cursor, open, close))
+        target = open;
+    if (target < 0)
+    {
+        set_status("No matching bracket.");
+        return;
+    }
+
+    m_buffer->place_cursor(m_buffer->get_iter_at_offset(target));
+    m_textview.scroll_to(m_buffer->get_insert());
+}
+
+void AppWindow::on_select_block()
+{
+    if (m_view != ViewMode::Text)
+        return;
+    if (!m_brackets.valid())
+    {
+        ensure_bracket_index();
+        set_status(m_brackets_oversize ? "Too many brackets to index." : "Indexing brackets…");
+        return;
+    }
+
+    Gtk::TextBuffer::iterator s, e;
+    m_buffer->get_selection_bounds(s, e);
+    const int from = s.get_offset();
+    const int to = e.get_offset();
+
+    // Inside of the innermost block first, then the block with its
+    // brackets, then the next block out.
+    int open, close;
+    bool found = m_brackets.enclosing(from, open, close);
+    while (found && to > close)
+        found = m_brackets.enclosing(open, open, close);
+    if (!found)
+    {
+        set_status("No enclosing block.");
+        return;
+    }
+
+    const bool inside = from == open + 1 && to == close;
+    m_buffer->select_range(m_buffer->get_iter_at_offset(inside ? open : open + 1),
+                           m_buffer->get_iter_at_offset(inside ? close + 1 : close));
+    m_textview.scroll_to(m_buffer->get_insert());
+}
+
+// -------- Word completion --------
+namespace
+{
+// Moves `it` over the word characters before (or after) it, giving up after
+// the longest indexed word; `open` tells that it gave up.
+void extend_word(Gtk::TextBuffer::iterator &it, bool backward, bool &open)
+{
+    open = false;
+    for (std::size_t n = 0;; ++n)
+    {
+        auto probe = it;
+        if (backward && !probe.backward_char())
+            return;
+        if (!WordIndex::is_word_char(probe.get_char()))
+            return;
+        if (n == WordIndex::kMaxWordBytes)
+        {
+            open = true;
+            return;
+        }
+        if (backward)
+            it = probe;
+        else
+            it.forward_char();
+    }
+}
+} // namespace
+
+void AppWindow::ensure_word_index()
+{
+    if (m_words.valid() || m_word_task.running() || m_loading)
+        return;
+
+    auto snapshot = snapshot_text(m_buffer->begin(), m_buffer->end());
+    auto index = std::make_shared<WordIndex>();
+    m_words_stale = false;
+    m_word_task.start([snapshot, index](BackgroundTask::Control &control)
+                      { index->build(snapshot.text, &control.cancel, &control.progress); },
+                      [this, index](bool cancelled)
+                      {
+                          if (cancelled)
+                              return;
+                          if (m_words_stale)
+                          {
+                              ensure_word_index();
+                              return;
+                          }
+                          m_words = std::move(*index);
+                      });
+}
+
+void AppWindow::update_words_for_insert(int begin, const Gtk::TextBuffer::iterator &end, std::string_view text)
+{
+    if (m_word_task.running())
+    {
+        m_words_stale = true;
+        return;
+    }
+    if (!m_words.valid())
+        return;
+    if (text.size() > kWordRebuildBytes)
+    {
+        m_words.clear();
+        return;
+    }
+
+    // The words touching the edit are recounted: before it they were
+    // `left` + `right`, now they are `left` + `text` + `right`.
+    TRACE_SCOPE("words.insert");
+    auto ws = m_buffer->get_iter_at_offset(begin);
+    auto we = end;
+    bool open_left, open_right;
+    extend_word(ws, true, open_left);
+    extend_word(we, false, open_right);
+    const auto left = m_buffer->get_text(ws, m_buffer->get_iter_at_offset(begin), true).raw();
+    const auto right = m_buffer->get_text(end, we, true).raw();
+
+    m_words.remove(left + right, open_left, open_right);
+    m_words.add(left + std::string(text) + right, open_left, open_right);
+}
+
+void AppWindow::update_words_for_erase(const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end)
+{
+    if (m_word_task.running())
+    {
+        m_words_stale = true;
+        return;
+    }
+    if (!m_words.valid())
+        return;
+    if (start.is_start() && end.is_end())
+    {
+        m_words.build({});
+        return;
+    }
+    if (end.get_offset() - start.get_offset() > static_cast<int>(kWordRebuildBytes))
+    {
+        m_words.clear();
+        return;
+    }
+
+    TRACE_SCOPE("words.erase");
+    auto ws = start;
+    auto we = end;
+    bool open_left, open_right;
+    extend_word(ws, true, open_left);
+    extend_word(we, false, open_right);
+    const auto left = m_buffer->get_text(ws, start, true).raw();
+    const auto right = m_buffer->get_text(end, we, true).raw();
+
+    m_words.remove(m_buffer->get_text(ws, we, true).raw(), open_left, open_right);
+    m_words.add(left + right, open_left, open_right);
+}
+
+void AppWindow::queue_completion()
+{
+    if (!m_completion_idle.connected())
+        m_completion_idle = Glib::signal_idle().connect([this]()
+                                                        {
+            update_completion();
+            return false; });
+}
+
+void AppWindow::update_completion()
+{
+    m_completion_idle.disconnect();
+    if (m_view != ViewMode::Text || !m_textview.get_editable())
+    {
+        m_completion.popdown();
+        return;
+    }
+    if (!m_words.valid())
+    {
+        ensure_word_index();
+        m_completion.popdown();
+        return;
+    }
+
+    // Only at the end of a word: the prefix is what precedes the cursor.
+    const auto cursor = m_buffer->get_insert()->get_iter();
+    auto start = cursor;
+    bool open;
+    extend_word(start, true, open);
+    const auto prefix = m_buffer->get_text(start, cursor, true).raw();
+    if (open || WordIndex::is_word_char(cursor.get_char()) || prefix.size() < kMinCompletionPrefix)
+    {
+        m_completion.popdown();
+        return;
+    }
+
+    const auto words = m_words.complete(prefix, kCompletionRows);
+    if (words.empty())
+    {
+        m_completion.popdown();
+        return;
+    }
+
+    m_completion_prefix = prefix;
+    m_completion_offset = cursor.get_offset();
+    Gdk::Rectangle at;
+    m_textview.get_iter_location(cursor, at);
+    int x = 0, y = 0;
+    m_textview.buffer_to_window_coords(Gtk::TextWindowType::WIDGET, at.get_x(), at.get_y(), x, y);
+    m_completion.show_words(words, Gdk::Rectangle(x, y, 1, at.get_height()));
+}
+
+void AppWindow::accept_completion(const std::string &word)
+{
+    m_completion.popdown();
+    if (!word.starts_with(m_completion_prefix) || !m_textview.get_editable())
+        return;
+
+    m_buffer->begin_user_action();
+    m_buffer->insert_at_cursor(word.substr(m_completion_prefix.size()));
+    m_buffer->end_user_action();
+    m_completion_idle.disconnect();
+    m_textview.scroll_to(m_buffer->get_insert());
+}
+
+bool AppWindow::on_completion_key(guint keyval)
+{
+    if (!m_completion.get_visible())
+        return false;
+
+    switch (keyval)
+    {
+    case GDK_KEY_Up:
+        m_completion.move_selection(-1);
+        return true;
+    case GDK_KEY_Down:
+        m_completion.move_selection(1);
+        return true;
+    case GDK_KEY_Tab:
+    case GDK_KEY_Return:
+    case GDK_KEY_KP_Enter:
+        accept_completion(m_completion.selected());
+        return true;
+    case GDK_KEY_Escape:
+        m_completion.popdown();
+        return true;
+    default:
+        return false;
+    }
+}
+
+void AppWindow::on_hex_view()
+{
+    if (m_view == ViewMode::Hex)
+    {
+        // A binary file never went into the buffer; try it as text now. It
+        // usually loads only up to its first invalid byte, and load_file
+        // then marks the load partial, so Save cannot cut the file down to
+        // that prefix.
+        if (m_document && m_document->size() > 0 && m_buffer->get_char_count() == 0)
+            load_file(m_current_path, /*detect_binary=*/false);
+        else
+            set_view(ViewMode::Text);
+        return;
+    }
+
+    if (!m_document)
+    {
+        set_status("Hex view shows a file on disk; open one first.");
+        return;
+    }
+    set_view(ViewMode::Hex);
+    if (m_modified)
+        set_status("Hex view shows the file on disk, not unsaved edits.");
+}
+
+void AppWindow::on_csv_view()
+{
+    if (m_view == ViewMode::Csv)
+    {
+        set_view(ViewMode::Text);
+        return;
+    }
+    if (m_loading)
+    {
+        set_status("Wait for the file to finish loading.");
+        return;
+    }
+    set_view(ViewMode::Csv);
+}
+
+void AppWindow::on_compare()
+{
+    if (m_loading || m_task.running())
+    {
+        set_status("Busy; try again when the current task has finished.");
+        return;
+    }
+
+    auto dlg = Gtk::FileDialog::create();
+    dlg->set_title("Compare with File");
+    dlg->open(*this, [this, dlg](const Glib::RefPtr<Gio::AsyncResult> &res)
+              {
+        try {
+            auto file = dlg->open_finish(res);
+            if (!file) return;
+            const auto path = file->get_path();
+            std::string error;
+            auto mapped = MappedFile::open(path, error);
+            if (!mapped)
+            {
+                set_status("Failed to open: " + path);
+                return;
+            }
+            if (m_loading)
+            {
+                set_status("Wait for the file to finish loading.");
+                return;
+            }
+            if (!m_diff)
+            {
+                m_diff = std::make_unique<DiffPanel>();
+                m_diff->signal_close().connect([this]()
+                                               { set_view(ViewMode::Text); });
+            }
+            // The document as it is now (unsaved edits included) on the
+            // left, the file on the right, straight from its mapping.
+            std::string name = m_current_path.empty() ? "Untitled" : Glib::path_get_basename(m_current_path);
+            if (m_modified)
+                name += " (unsaved)";
+            m_diff->compare(snapshot_text(m_buffer->begin(), m_buffer->end()), name,
+                            TextSnapshot{mapped, mapped->view()}, Glib::path_get_basename(path));
+            set_view(ViewMode::Diff);
+        } catch (const Glib::Error &e) {
+            set_status(Glib::ustring("Compare canceled/failed: ") + e.what());
+        } });
+}
+
+void AppWindow::set_view(ViewMode mode)
+{
+    if (mode == ViewMode::Hex)
+    {
+        if (!m_hex)
+            m_hex = std::make_unique<HexPanel>();
+        if (m_hex->file() != m_document)
+            m_hex->set_file(m_document);
+    }
+    else if (m_hex)
+    {
+        m_hex->set_file(nullptr);
+    }
+
+    if (mode == ViewMode::Csv)
+    {
+        if (!m_csv)
+            m_csv = std::make_unique<CsvPanel>();
+        if (!m_csv->has_snapshot() || m_csv->stale())
+            m_csv->set_snapshot(snapshot_text(m_buffer->begin(), m_buffer->end()));
+    }
+
+    // The comparison holds a copy of the document; it goes with the view.
+    if (mode != ViewMode::Diff && m_diff)
+        m_diff->clear();
+
+    if (mode == m_view)
+        return;
+    switch (mode)
+    {
+    case ViewMode::Text:
+        m_editor_paned.set_start_child(m_editor_box);
+        break;
+    case ViewMode::Hex:
+        m_editor_paned.set_start_child(*m_hex);
+        break;
+    case ViewMode::Csv:
+        m_editor_paned.set_start_child(*m_csv);
+        break;
+    case ViewMode::Diff:
+        m_editor_paned.set_start_child(*m_diff);
+        break;
+    }
+    m_view = mode;
+}
+
+void AppWindow::on_save()
+{
+    if (!m_modified)
+        return; // No changes to save
+    if (matches_saved())
+    {
+        // Edited back to what is on disk; nothing to write.
+        m_modified = false;
+        set_status("No changes to save");
+        return;
+    }
+
+    if (!m_current_path.empty() && !m_partial_load)
+    {
+        if (changed_on_disk())
+            confirm_overwrite([this]()
+                              { save_file_to(m_current_path); });
+        else
+            save_file_to(m_current_path);
+        return;
+    }
+
+    auto dlg = Gtk::FileDialog::create();
+    dlg->set_title("Save File");
+
+    dlg->save(*this, [this, dlg](const Glib::RefPtr<Gio::AsyncResult> &res)
+              {
+        try {
+            auto file = dlg->save_finish(res);
+            if (!file) return;
+            save_file_to(file->get_path());
+        } catch (const Glib::Error &e) {
+            set_status(Glib::ustring("Save canceled/failed: ") + e.what());
+        } });
+}
+
+void AppWindow::on_search_changed()
+{
+}
+
+void AppWindow::highlight_matches(const Glib::ustring &term)
+{
+    if (!m_buffer)
+        return;
+
+    auto start = m_buffer->begin();
+    auto end = m_buffer->end();
+    m_buffer->remove_tag_by_name("hl", start, end);
+    m_hl_segments = 0;
+
+    if (term.empty())
+        return;
+
+    TRACE_SCOPE("highlight_matches");
+
+    SearchEngine engine(term.raw(), SearchOptions{});
+    for (const auto &[s, e] : buffer_search::match_offsets(m_buffer, engine, start, end))
+    {
+        m_buffer->apply_tag_by_name("hl", m_buffer->get_iter_at_offset(s), m_buffer->get_iter_at_offset(e));
+        ++m_hl_segments;
+    }
+}
+
+void AppWindow::on_preferences()
+{
+    auto prefs = Gtk::make_managed<Gtk::Window>();
+    prefs->set_title("Preferences");
+    prefs->set_transient_for(*this);
+    prefs->set_modal(true);
+    prefs->set_default_size(420, 160);
+
+    auto box = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL);
+    box->set_margin(16);
+    box->set_spacing(12);
+
+    auto title = Gtk::make_managed<Gtk::Label>();
+    title->set_markup("<b>Theme</b>");
+    title->set_halign(Gtk::Align::START);
+
+    auto dark = Gtk::make_managed<Gtk::CheckButton>("Enable darker look (simple CSS)");
+    dark->set_active(m_dark);
+    dark->signal_toggled().connect([this, dark]()
+                                   {
+        m_dark = dark->get_active();
+        apply_theme();
+        queue_session_save();
+        set_status(m_dark ? "Theme: dark" : "Theme: light"); });
+
+    box->append(*title);
+    box->append(*dark);
+
+    prefs->set_child(*box);
+    prefs->present();
+}
+
+void AppWindow::on_toggle_theme()
+{
+    m_dark = !m_dark;
+    apply_theme();
+    queue_session_save();
+    set_status(m_dark ? "Theme: dark" : "Theme: light");
+}
+
+void AppWindow::apply_theme()
+{
+    // Registering a display-wide provider restyles every widget, so do it
+    // once; later theme switches only reload the CSS.
+    if (!m_css)
+    {
+        m_css = Gtk::CssProvider::create();
+        if (auto display = Gdk::Display::get_default())
+        {
+            Gtk::StyleContext::add_provider_for_display(
+                display, m_css, GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+        }
+    }
+
+    const char *css_light = "textview { font-size: 12pt; }";
+    const char *css_dark =
+        "* { background-color: #1e1e1e; color: #e6e6e6; }"
+        "entry, textview { background-color: #2a2a2a; color: #e6e6e6; }"
+        "textview text { background-color: #2a2a2a; color: #e6e6e6; }";
+
+    try
+    {
+        m_css->load_from_data(m_dark ? css_dark : css_light);
+    }
+    catch (...)
+    {
+    }
+}
+
+void AppWindow::on_about()
+{
+    auto about = Gtk::make_managed<Gtk::AboutDialog>();
+    about->set_transient_for(*this);
+    about->set_modal(true);
+    about->set_program_name("Text Editor");
+    about->set_version("1.0");
+    about->set_comments("gtkmm-4.0 editor demo with File/Help menus + Find dialog.");
+    about->present();
+}
+
+void AppWindow::on_memory()
+{
+    if (!m_memory_panel)
+        m_memory_panel = std::make_unique<MemoryPanel>(*this, m_memory);
+    m_memory_panel->present();
+}
+
+void AppWindow::on_quit()
+{
+    if (!m_modified) {
+        close();
+        return;
+    }
+
+    query_unsaved_changes([this](bool should_close) {
+        if (should_close)
+            close();
+    });
+}
+
+void AppWindow::query_unsaved_changes(std::function<void(bool should_close)> done)
+{
+    auto* dialog = new Gtk::MessageDialog(
+        *this,
+        "The document has unsaved changes.",
+        false,
+        Gtk::MessageType::QUESTION,
+        Gtk::ButtonsType::NONE,
+        true
+    );
+
+    dialog->set_secondary_text("Do you want to save your changes before exiting?");
+
+    dialog->add_button("_Cancel", Gtk::ResponseType::CANCEL);
+    dialog->add_button("_Discard", Gtk::ResponseType::REJECT);
+    dialog->add_button("_Save", Gtk::ResponseType::ACCEPT);
+    dialog->set_default_response(Gtk::ResponseType::ACCEPT);
+
+    dialog->signal_response().connect(
+        [this, dialog, done](int response) mutable {
+            dialog->hide();
+            delete dialog;
 
             switch (static_cast<Gtk::ResponseType>(response)) {
             case Gtk::ResponseType::ACCEPT: { // Save
-                if (!m_current_path.empty()) {
+                if (!m_current_path.empty() && !m_partial_load) {
                     save_file_to(m_current_path);
                     done(true);  // close after save
                 } else {
@@ -495,6 +2880,8 @@ void AppWindow::query_unsaved_changes(std::function<void(bool should_close)> don
             }
 
             case Gtk::ResponseType::REJECT: // Discard
+                m_session_discard = true;
+                m_session_edit_stale = true;
                 done(true);
                 break;
 
@@ -509,6 +2896,114 @@ void AppWindow::query_unsaved_changes(std::function<void(bool should_close)> don
 }
 
 
+// -------- Run Task --------
+bool AppWindow::run_task(const Glib::ustring &label, BackgroundTask::Work work, BackgroundTask::DoneFn on_done)
+{
+    const bool started = m_task.start(std::move(work), [this, on_done = std::move(on_done)](bool cancelled)
+                                      {
+        end_task();
+        if (on_done)
+            on_done(cancelled); });
+    if (!started)
+        return false;
+
+    m_task_label = label;
+    m_textview.set_editable(false);
+    m_btn_cancel_task.set_visible(true);
+    m_task_tick = Glib::signal_timeout().connect(sigc::mem_fun(*this, &AppWindow::on_tick), kTaskTickMs);
+    set_status(label + "…");
+    return true;
+}
+
+bool AppWindow::on_tick()
+{
+    if (!m_task.running())
+        return false;
+    set_status(m_task_label + "… " + std::to_string(static_cast<int>(m_task.progress() * 100)) + "%");
+    return true;
+}
+
+void AppWindow::end_task()
+{
+    m_task_tick.disconnect();
+    m_btn_cancel_task.set_visible(false);
+    m_textview.set_editable(!m_loading);
+}
+
+void AppWindow::stop_task_thread()
+{
+    if (!m_task.running())
+        return;
+    m_task.stop();
+    end_task();
+}
+
+TextSnapshot AppWindow::snapshot_text(const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end)
+{
+    // The mapped file is the buffer text until the first edit or save (and
+    // unless loading stopped early at invalid UTF-8).
+    if (m_document && !m_loading && !m_modified && m_saved_is_document && start.is_start() && end.is_end() &&
+        m_counts.bytes == m_document->size())
+        return {m_document, m_document->view()};
+
+    TRACE_SCOPE("snapshot.copy");
+    auto copy = std::make_shared<const Glib::ustring>(m_buffer->get_text(start, end, true));
+    return {copy, copy->raw()};
+}
+
+// -------- Statistics --------
+TextCounts AppWindow::count_range(const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end)
+{
+    if (start.is_start() && end.is_end())
+        return m_counts;
+
+    // Chunked views keep the copy small however large the selection is.
+    TRACE_SCOPE("stats.selection");
+    TextCounts total;
+    auto from = start;
+    while (from < end)
+    {
+        auto to = from;
+        to.forward_chars(kStatsChunkChars);
+        if (to > end)
+            to = end;
+        total.append(text_stats::count(m_buffer->get_text(from, to, true).raw()));
+        from = to;
+    }
+    return total;
+}
+
+void AppWindow::update_selection_stats()
+{
+    Gtk::TextBuffer::iterator s, e;
+    m_has_selection = m_buffer->get_selection_bounds(s, e);
+    if (m_has_selection)
+        m_selection_counts = count_range(s, e);
+    update_stats_footer();
+}
+
+void AppWindow::queue_cursor_update()
+{
+    if (!m_selection_idle.connected())
+        m_selection_idle = Glib::signal_idle().connect([this]()
+                                                       {
+            update_selection_stats();
+            update_bracket_match();
+            return false; });
+}
+
+void AppWindow::update_stats_footer()
+{
+    Glib::ustring text;
+    if (m_has_selection)
+        text = "Selection: " + std::to_string(m_selection_counts.newlines + 1) + " lines, " +
+               std::to_string(m_selection_counts.words) + " words, " +
+               std::to_string(m_selection_counts.chars) + " chars  |  ";
+    text += std::to_string(m_counts.lines()) + " lines, " + std::to_string(m_counts.words) + " words, " +
+            std::to_string(m_counts.chars) + " chars, " + std::to_string(m_counts.bytes) + " bytes";
+    m_footer_right.set_text(text);
+}
+
 void AppWindow::set_status(const Glib::ustring &s)
 {
     // ✅ show status in footer (you removed dashboard status label)
@@ -1,10 +1,38 @@
 #pragma once
 
+#include "background_task.hpp"
+#include "block_hashes.hpp"
+#include "bracket_index.hpp"
+#include "chunked_inserter.hpp"
+#include "completion_popup.hpp"
+#include "csv_panel.hpp"
+#include "diff_panel.hpp"
+#include "filter_command_dialog.hpp"
 #include "find_text_dialog.hpp"
+#include "hex_panel.hpp"
+#include "line_index.hpp"
+#include "log_filter_panel.hpp"
+#include "log_time_index.hpp"
+#include "mapped_file.hpp"
+#include "match_index.hpp"
+#include "memory_panel.hpp"
+#include "memory_stats.hpp"
+#include "outline_index.hpp"
+#include "outline_panel.hpp"
+#include "overview_histogram.hpp"
+#include "overview_ruler.hpp"
+#include "quick_open_dialog.hpp"
+#include "recent_cache.hpp"
 #include "replace_text_dialog.hpp"
+#include "session_file.hpp"
+#include "text_snapshot.hpp"
+#include "text_format.hpp"
+#include "text_stats.hpp"
+#include "word_index.hpp"
 
 #include <gtkmm.h>
 #include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <thread>
@@ -15,6 +43,17 @@ public:
   AppWindow();
   ~AppWindow() override;
 
+  // Starts loading `path`; used for files passed on the command line.
+  void open_file(const std::string &path);
+  // Makes this window the one whose workspace is kept as the session (one
+  // per process, so windows do not overwrite each other's). For a window
+  // opening a file: keeps the theme and search terms of the last session,
+  // and its unsaved edit as session.bak.
+  void own_session();
+  // Owns the session and brings back its workspace; called before the
+  // window is first shown.
+  void restore_session();
+
 private:
   // Root + header
   Gtk::Box m_root{Gtk::Orientation::VERTICAL};
@@ -22,24 +61,77 @@ private:
 
   Gtk::Button m_btn_open{"Open"};
   Gtk::Button m_btn_save{"Save"};
-  Gtk::Button m_btn_run{"Run Task"};
+  Gtk::Button m_btn_cancel_task{"Cancel Task"};
   Gtk::MenuButton m_file_menu_btn;
   Gtk::MenuButton m_help_menu_btn;
 
   Glib::RefPtr<Gio::Menu> m_file_menu;
   Glib::RefPtr<Gio::Menu> m_help_menu;
+  Glib::RefPtr<Gio::Menu> m_recent_menu; // File > Open Recent
 
   // Actions
   Glib::RefPtr<Gio::SimpleActionGroup> m_actions;
 
   Glib::RefPtr<Gtk::ShortcutController> m_shortcuts;
 
-  // Editor area
+  // Editor area: the outline (when open), then the editor and the line
+  // filter (when open) side by side
+  Gtk::Paned m_outline_paned{Gtk::Orientation::HORIZONTAL};
+  Gtk::Paned m_editor_paned{Gtk::Orientation::HORIZONTAL};
+  Gtk::Box m_editor_box{Gtk::Orientation::HORIZONTAL}; // scroller + overview ruler
   Gtk::ScrolledWindow m_editor_scroller;
+  OverviewRuler m_overview_ruler;
+  OverviewHistogram m_overview;    // what the ruler draws, kept from the edit stream
   Gtk::TextView m_textview;
   Glib::RefPtr<Gtk::TextBuffer> m_buffer;
   bool m_modified = false;
 
+  // Change tracking against the file as last loaded or saved: an edit that
+  // returns to it clears m_modified, found by rehashing only the edited
+  // blocks.
+  BlockHashes m_saved_hashes;
+  BackgroundTask m_hash_task;      // hashes a loaded file off the main thread
+  DirtyLines m_dirty;              // lines edited since then
+  bool m_saved_is_document = false; // no save since m_document was loaded
+  bool m_partial_load = false;     // the load stopped early: Save must not write over the file
+  sigc::connection m_saved_check_idle;
+
+  // Progressive loading: the mapped file stays alive while it streams in.
+  std::shared_ptr<MappedFile> m_document;
+  ChunkedInserter m_loader;
+  ChunkedInserter m_paste;         // large pastes and drops, streamed the same way
+  bool m_loading = false;          // also set while a large paste streams in
+
+  // Indexes and counters (see install_memory_stats)
+  LineIndex m_line_index;          // line starts of m_document
+  MatchIndex m_match_index;        // "Highlight all" results
+  LogTimeIndex m_time_index;       // "Go to time", over m_time_snapshot
+  TextSnapshot m_time_snapshot;
+  bool m_time_index_ready = false; // cleared by any edit
+  TextCounts m_counts;             // whole buffer, kept from the edit stream
+  BracketIndex m_brackets;         // bracket/quote pairs, kept from the edit stream
+  BackgroundTask m_bracket_task;   // initial build, off the main thread
+  bool m_brackets_stale = false;   // edited while the build was running
+  bool m_brackets_oversize = false;
+  Glib::RefPtr<Gtk::TextBuffer::Mark> m_bracket_marks[2]; // the highlighted pair
+  bool m_bracket_shown = false;
+  WordIndex m_words;               // completion candidates, kept from the edit stream
+  BackgroundTask m_word_task;      // initial build, off the main thread
+  bool m_words_stale = false;      // edited while the build was running
+  OutlineIndex m_outline;          // outline panel entries, rescanned around edits
+  BackgroundTask m_outline_task;   // initial build, off the main thread
+  bool m_outline_stale = false;    // edited while the build was running
+  sigc::connection m_outline_idle;
+  std::size_t m_undo_bytes = 0;    // text recorded by undoable edits
+  std::size_t m_hl_segments = 0;   // ranges tagged "hl"
+  MemoryStats m_memory;
+
+  // Run Task: one long operation at a time on a worker thread; the editor
+  // is read-only until it finishes.
+  BackgroundTask m_task;
+  Glib::ustring m_task_label;
+  sigc::connection m_task_tick;
+
   Gtk::CenterBox m_center;
   Gtk::Box m_editor_container{Gtk::Orientation::VERTICAL};
 
@@ -49,15 +141,82 @@ private:
   Gtk::Separator m_sep{Gtk::Orientation::HORIZONTAL};
   Gtk::Box m_footer{Gtk::Orientation::HORIZONTAL};
   Gtk::Label m_footer_left;
-  Gtk::Label m_footer_right;
+  Gtk::Label m_footer_right;       // document / selection statistics
+
+  TextCounts m_selection_counts;
+  bool m_has_selection = false;
+  sigc::connection m_selection_idle; // selection stats and bracket match, once the cursor settles
+
+  // Word completion under the cursor
+  CompletionPopup m_completion;
+  std::string m_completion_prefix;
+  int m_completion_offset = -1;    // cursor the list was computed for
+  sigc::connection m_completion_idle;
 
   // State
   std::string m_current_path;
+  TextFormat m_format;             // of the file as opened
+
+  // Recent files: identity and view state of the open file, persisted when
+  // another file is opened, on save and on close.
+  RecentCache m_recent;
+  RecentEntry m_recent_current;
+  bool m_recent_known = false;     // m_recent_current describes m_current_path
+  bool m_recent_lines_ok = false;  // m_line_index describes that file
+  struct PendingView
+  {
+    bool active = false;
+    std::uint32_t cursor_line = 0;
+    std::uint32_t cursor_column = 0;
+    std::uint32_t top_line = 0;
+  };
+  PendingView m_restore;           // applied once those lines have loaded
+  Glib::RefPtr<Gtk::TextBuffer::Mark> m_restore_mark;
   Glib::RefPtr<Gtk::CssProvider> m_css;
   bool m_dark = false;
 
+  // Session: theme, search terms, the open file with its view and unsaved
+  // edits, written a little after any change and on close.
+  SessionFile m_session;
+  sigc::connection m_session_timer;
+  SessionState m_session_edit;     // restored edit, applied once its file has loaded
+  bool m_session_owner = false;
+  bool m_session_discard = false;  // "Discard" on quit: the edits are not kept
+  bool m_session_edit_stale = true; // the buffer changed since the edit was last written
+  std::string m_find_term;         // restored terms, for dialogs not created yet
+  std::string m_replace_find;
+  std::string m_replace_with;
+
+  // Start-up: non-critical UI is built after the first frame, once; a
+  // later realize (a new frame clock) does not run it again.
+  sigc::connection m_first_frame;
+  bool m_startup_scheduled = false;
+
+  // Frame-clock timestamps for trace spans (only used when tracing).
+  std::uint64_t m_frame_begin_us = 0;
+  std::uint64_t m_layout_begin_us = 0;
+  std::uint64_t m_paint_begin_us = 0;
+
   std::unique_ptr<FindTextDialog> m_find_text;
   std::unique_ptr<ReplaceTextDialog> m_replace_text;
+  std::unique_ptr<QuickOpenDialog> m_quick_open;
+  std::unique_ptr<MemoryPanel> m_memory_panel;
+  std::unique_ptr<FilterCommandDialog> m_filter_command;
+  std::unique_ptr<LogFilterPanel> m_log_filter;
+  std::unique_ptr<OutlinePanel> m_outline_panel;
+
+  // What occupies the editor slot: the text view or one of the panels.
+  enum class ViewMode
+  {
+    Text,
+    Hex,
+    Csv,
+    Diff,
+  };
+  ViewMode m_view = ViewMode::Text;
+  std::unique_ptr<HexPanel> m_hex;
+  std::unique_ptr<CsvPanel> m_csv;
+  std::unique_ptr<DiffPanel> m_diff;
 
 private:
   void build_header();
@@ -66,32 +225,124 @@ private:
   void build_menu();
   void install_actions();
   void install_shortcuts();
+  void on_first_frame();
+  void finish_startup();
+  void install_frame_tracing();
+  void install_memory_stats();
 
   // Actions
   void on_find_text();
   void on_open();
+  void on_open_recent(const std::string &path);
+  void on_quick_open();
+  void on_paste();
+  bool on_drop_text(const Glib::ValueBase &value, double x, double y);
   void on_replace_text();
+  void on_filter_command();
+  void on_log_filter();
+  void on_log_filter_apply();
+  void on_log_filter_line(std::uint32_t line);
+  void on_goto_time();
+  void on_outline();
+  void on_outline_line(std::uint32_t line);
+  void on_hex_view();
+  void on_jump_to_bracket();
+  void on_select_block();
+  void on_csv_view();
+  void on_compare();
+  void set_view(ViewMode mode);
   void on_save();
-  void on_run_task();
+  void on_line_op(const Glib::ustring &name);
+  void on_json(const Glib::ustring &name);
+  void on_cancel_task();
   void on_quit();
   void on_about();
+  void on_memory();
   void on_preferences();
   void on_search_changed();
   void on_toggle_theme();
 
   // Editor
   void highlight_matches(const Glib::ustring &term);
+  void on_buffer_changed();
+  // Puts `text` (kept alive by `owner`) over the selection as one undoable
+  // step; large texts stream in (m_paste). `label` names it in the footer.
+  void insert_text_chunked(std::shared_ptr<const void> owner, std::string_view text, const Glib::ustring &label);
+  // Tells the overview ruler which characters are on screen.
+  void update_overview_viewport();
 
   // Task updates
+  bool run_task(const Glib::ustring &label, BackgroundTask::Work work, BackgroundTask::DoneFn on_done);
   bool on_tick();
+  void end_task();
   void stop_task_thread();
 
+  // Text of [start, end) for a worker thread; no copy when it is the whole
+  // unmodified file.
+  TextSnapshot snapshot_text(const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end);
+
+  // Go to time: builds the timestamp index on first use, then seeks.
+  void goto_time(const Glib::ustring &query, std::function<void(const Glib::ustring &)> report);
+  void seek_time(const Glib::ustring &query, const std::function<void(const Glib::ustring &)> &report);
+  void drop_time_index();
+
+  // Statistics
+  TextCounts count_range(const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end);
+  void update_selection_stats();
+  void update_stats_footer();
+  void queue_cursor_update();
+
+  // Bracket matching
+  void ensure_bracket_index();
+  void update_bracket_match();
+  void clear_bracket_match();
+
+  // Word completion
+  void ensure_word_index();
+  void update_words_for_insert(int begin, const Gtk::TextBuffer::iterator &end, std::string_view text);
+  void update_words_for_erase(const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end);
+  void queue_completion();
+  void update_completion();
+  void accept_completion(const std::string &word);
+  bool on_completion_key(guint keyval);
+
+  // Outline
+  void ensure_outline_index();
+  void clear_outline();
+  void update_outline_for_insert(int first_line, std::size_t newlines);
+  void update_outline_for_erase(const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end);
+  std::string line_prefixes(int first_line, int count);
+  void queue_outline_refresh();
+
+  // Saved state
+  void hash_saved_document();
+  void queue_saved_check();
+  bool matches_saved();
+  bool changed_on_disk();
+  void confirm_overwrite(std::function<void()> save);
+
+  // Recent files
+  void remember_current();
+  void restore_view(std::size_t loaded_bytes);
+  void update_recent_menu();
+  // Cursor and top line of the open file, if known.
+  bool view_state(PendingView &out);
+
+  // Session
+  void queue_session_save();
+  void save_session();
+  void capture_session(SessionState &out, bool with_edit);
+  void restore_session_settings(const SessionState &state);
+  void apply_session_edit(bool complete);
+  void keep_session_backup(const SessionState &loaded, const Glib::ustring &why);
+
   // Helpers
   void set_status(const Glib::ustring &s);
   void apply_theme();
 
   // File helpers
-  void load_file(const std::string &path);
+  // Binary files open in the hex view unless `detect_binary` is false.
+  void load_file(const std::string &path, bool detect_binary = true);
   void save_file_to(const std::string &path);
 
   //
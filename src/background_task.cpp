@@ -0,0 +1,62 @@
+#include "background_task.hpp"
+
+BackgroundTask::BackgroundTask()
+{
+    m_finished.connect(sigc::mem_fun(*this, &BackgroundTask::on_finished));
+}
+
+BackgroundTask::~BackgroundTask()
+{
+    stop();
+}
+
+bool BackgroundTask::start(Work work, DoneFn on_done)
+{
+    if (running())
+        return false;
+
+    auto control = std::make_shared<Control>();
+    m_control = control;
+    m_on_done = std::move(on_done);
+    m_thread = std::thread([this, control, work = std::move(work)]()
+                           {
+        work(*control);
+        control->finished.store(true, std::memory_order_release);
+        m_finished.emit(); });
+    return true;
+}
+
+void BackgroundTask::cancel()
+{
+    if (m_control)
+        m_control->cancel.store(true, std::memory_order_relaxed);
+}
+
+void BackgroundTask::stop()
+{
+    cancel();
+    if (m_thread.joinable())
+        m_thread.join();
+    m_control.reset();
+    m_on_done = nullptr;
+}
+
+double BackgroundTask::progress() const
+{
+    return m_control ? m_control->progress.load(std::memory_order_relaxed) : 0.0;
+}
+
+void BackgroundTask::on_finished()
+{
+    // Stale emission from a job that stop() already joined.
+    if (!m_control || !m_control->finished.load(std::memory_order_acquire))
+        return;
+    m_thread.join();
+
+    const bool cancelled = m_control->cancel.load(std::memory_order_relaxed);
+    m_control.reset();
+    auto done = std::move(m_on_done);
+    m_on_done = nullptr;
+    if (done)
+        done(cancelled);
+}
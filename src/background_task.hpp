@@ -0,0 +1,52 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+// One job at a time on a worker thread (the window's "Run Task" slot).
+//
+// The job gets a Control it polls for cancellation and advances with
+// progress; completion is delivered back on the GTK main loop through a
+// Glib::Dispatcher, so `done` may touch widgets. The owner polls progress()
+// from a timeout to drive its status line.
+class BackgroundTask
+{
+public:
+  struct Control
+  {
+    std::atomic<bool> cancel{false};
+    std::atomic<double> progress{0.0};
+    std::atomic<bool> finished{false};
+  };
+
+  using Work = std::function<void(Control &control)>;
+  // Runs on the main loop after the worker has been joined.
+  using DoneFn = std::function<void(bool cancelled)>;
+
+  BackgroundTask();
+  ~BackgroundTask();
+
+  BackgroundTask(const BackgroundTask &) = delete;
+  BackgroundTask &operator=(const BackgroundTask &) = delete;
+
+  // False if a job is already running.
+  bool start(Work work, DoneFn on_done);
+
+  void cancel();
+  // Cancels and joins; `done` is not called.
+  void stop();
+
+  bool running() const { return static_cast<bool>(m_control); }
+  double progress() const;
+
+private:
+  Glib::Dispatcher m_finished;
+  std::thread m_thread;
+  std::shared_ptr<Control> m_control;
+  DoneFn m_on_done;
+
+  void on_finished();
+};
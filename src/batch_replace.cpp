@@ -0,0 +1,210 @@
+#include "batch_replace.hpp"
+
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "search_engine.hpp"
+#include "trace.hpp"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct FileResult
+{
+    std::size_t replacements = 0;
+    std::size_t bytes = 0;
+    bool written = false;
+    std::string error;
+};
+
+void print_usage(std::ostream &os)
+{
+    os << "Usage: sophisticated --replace [options] PATTERN REPLACEMENT FILE...\n"
+          "\n"
+          "Options:\n"
+          "  -i, --ignore-case   case-insensitive match\n"
+          "  -w, --word          match whole words only\n"
+          "  -E, --regex         PATTERN is a regular expression (\\1, \\g<name> in REPLACEMENT)\n"
+          "  -n, --dry-run       count matches, do not write files\n"
+          "  -j, --jobs N        worker threads (default: one per core)\n";
+}
+
+FileResult process_file(const std::string &path, const SearchEngine &engine,
+                        const std::string &replacement, bool dry_run)
+{
+    TRACE_SCOPE("batch.file");
+
+    FileResult r;
+
+    std::string err;
+    auto mapped = MappedFile::open(path, err);
+    if (!mapped)
+    {
+        r.error = err;
+        return r;
+    }
+
+    auto text = mapped->view();
+    r.bytes = text.size();
+
+    if (!g_utf8_validate(text.data(), static_cast<gssize>(text.size()), nullptr))
+    {
+        r.error = "not valid UTF-8, skipped";
+        return r;
+    }
+
+    if (dry_run)
+    {
+        engine.for_each(text, [&](const SearchMatch &)
+                        {
+            ++r.replacements;
+            return true; });
+        return r;
+    }
+
+    std::string out;
+    out.reserve(text.size());
+    r.replacements = engine.replace_all(text, replacement, out);
+    if (r.replacements == 0)
+        return r;
+
+    // Keep the original permissions; the temp file + rename happens in
+    // g_file_set_contents_full, so readers never see a half-written file.
+    int mode = 0666;
+    GStatBuf st;
+    if (g_stat(path.c_str(), &st) == 0)
+        mode = static_cast<int>(st.st_mode & 0777);
+
+    // Drop the mapping before the rename (required on Windows).
+    mapped.reset();
+
+    GError *gerr = nullptr;
+    if (!g_file_set_contents_full(path.c_str(), out.data(), static_cast<gssize>(out.size()),
+                                  G_FILE_SET_CONTENTS_CONSISTENT, mode, &gerr))
+    {
+        r.error = gerr ? gerr->message : "write failed";
+        if (gerr)
+            g_error_free(gerr);
+        return r;
+    }
+
+    r.written = true;
+    return r;
+}
+} // namespace
+
+bool is_batch_replace(int argc, char *argv[])
+{
+    return argc > 1 && std::string(argv[1]) == "--replace";
+}
+
+int run_batch_replace(int argc, char *argv[])
+{
+    SearchOptions opts;
+    opts.case_sensitive = true;
+    bool dry_run = false;
+    unsigned jobs = 0;
+
+    std::vector<std::string> positional;
+    bool options_done = false;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string a = argv[i];
+        if (!options_done && a.size() > 1 && a[0] == '-')
+        {
+            if (a == "--")
+                options_done = true;
+            else if (a == "-i" || a == "--ignore-case")
+                opts.case_sensitive = false;
+            else if (a == "-w" || a == "--word")
+                opts.whole_word = true;
+            else if (a == "-E" || a == "--regex")
+                opts.regex = true;
+            else if (a == "-n" || a == "--dry-run")
+                dry_run = true;
+            else if ((a == "-j" || a == "--jobs") && i + 1 < argc)
+                jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+            else if (a == "-h" || a == "--help")
+            {
+                print_usage(std::cout);
+                return 0;
+            }
+            else
+            {
+                std::cerr << "Unknown option: " << a << "\n";
+                print_usage(std::cerr);
+                return 2;
+            }
+            continue;
+        }
+        positional.push_back(std::move(a));
+    }
+
+    if (positional.size() < 3)
+    {
+        print_usage(std::cerr);
+        return 2;
+    }
+
+    SearchEngine engine(positional[0], opts);
+    if (!engine.valid())
+    {
+        std::cerr << "Invalid pattern: " << engine.error() << "\n";
+        return 2;
+    }
+
+    const std::string &replacement = positional[1];
+    const std::vector<std::string> files(positional.begin() + 2, positional.end());
+    std::vector<FileResult> results(files.size());
+
+    const auto t0 = std::chrono::steady_clock::now();
+
+    parallel_for(
+        files.size(),
+        [&](std::size_t i)
+        { results[i] = process_file(files[i], engine, replacement, dry_run); },
+        jobs ? jobs : worker_count(files.size()));
+
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::size_t total_repl = 0;
+    std::size_t total_bytes = 0;
+    std::size_t changed = 0;
+    std::size_t failed = 0;
+
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        const auto &r = results[i];
+        total_bytes += r.bytes;
+        if (!r.error.empty())
+        {
+            ++failed;
+            std::cerr << files[i] << ": " << r.error << "\n";
+            continue;
+        }
+        total_repl += r.replacements;
+        if (r.written)
+            ++changed;
+        std::cout << files[i] << ": " << r.replacements
+                  << (dry_run ? " match(es)\n" : " replacement(s)\n");
+    }
+
+    const double mib = static_cast<double>(total_bytes) / (1024.0 * 1024.0);
+    char summary[256];
+    std::snprintf(summary, sizeof(summary),
+                  "%zu file(s), %zu %s, %zu changed, %zu failed; %.1f MiB in %.3f s (%.1f MiB/s)\n",
+                  files.size(), total_repl, dry_run ? "match(es)" : "replacement(s)", changed, failed,
+                  mib, secs, secs > 0 ? mib / secs : 0.0);
+    std::cout << summary;
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Headless bulk find/replace:
+//
+//   sophisticated --replace [-i] [-w] [-E] [-n] [-j N] PATTERN REPLACEMENT FILE...
+//
+// Uses the same SearchEngine as the Find/Replace dialogs and never touches
+// a display, so it can run on servers.
+bool is_batch_replace(int argc, char *argv[]);
+int run_batch_replace(int argc, char *argv[]);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// The small binary files kept between runs (recent.bin and its line
+// indexes, session.bin): fields are written back to back in host byte
+// order, and a file is replaced through a temporary file and a rename, so
+// a crash leaves either the old contents or the new ones.
+namespace binary_io
+{
+template <typename T>
+void put(std::string &out, const T &value)
+{
+  out.append(reinterpret_cast<const char *>(&value), sizeof value);
+}
+
+// A 32-bit length, then the bytes.
+inline void put_string(std::string &out, std::string_view s)
+{
+  put(out, static_cast<std::uint32_t>(s.size()));
+  out.append(s.data(), s.size());
+}
+
+// Reads consecutive fields from a byte range; fails once it runs dry.
+class Reader
+{
+public:
+  explicit Reader(std::string_view data) : m_data(data) {}
+
+  template <typename T>
+  bool get(T &value)
+  {
+    if (m_data.size() < sizeof value)
+      return false;
+    std::memcpy(&value, m_data.data(), sizeof value);
+    m_data.remove_prefix(sizeof value);
+    return true;
+  }
+
+  // The next `n` bytes, in place.
+  bool get_view(std::string_view &out, std::uint64_t n)
+  {
+    if (m_data.size() < n)
+      return false;
+    out = m_data.substr(0, static_cast<std::size_t>(n));
+    m_data.remove_prefix(static_cast<std::size_t>(n));
+    return true;
+  }
+
+  bool get_bytes(std::string &out, std::uint64_t n)
+  {
+    std::string_view bytes;
+    if (!get_view(bytes, n))
+      return false;
+    out.assign(bytes);
+    return true;
+  }
+
+  // As written by put_string(); a length over `max_bytes` is corruption.
+  bool get_string(std::string &out, std::uint32_t max_bytes)
+  {
+    std::uint32_t n = 0;
+    return get(n) && n <= max_bytes && get_bytes(out, n);
+  }
+
+  std::string_view rest() const { return m_data; }
+
+private:
+  std::string_view m_data;
+};
+
+inline bool write_file(const std::string &path, std::string_view data, int mode)
+{
+  GError *error = nullptr;
+  if (!g_file_set_contents_full(path.c_str(), data.data(), static_cast<gssize>(data.size()),
+                                G_FILE_SET_CONTENTS_CONSISTENT, mode, &error))
+  {
+    if (error)
+      g_error_free(error);
+    return false;
+  }
+  return true;
+}
+} // namespace binary_io
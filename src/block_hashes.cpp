@@ -0,0 +1,105 @@
+#include "block_hashes.hpp"
+
+#include "content_hash.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+
+void BlockHashes::clear()
+{
+    m_hashes.clear();
+    m_hashes.shrink_to_fit();
+    m_offsets.clear();
+    m_offsets.shrink_to_fit();
+    m_size = 0;
+    m_lines = 0;
+    m_valid = false;
+}
+
+bool BlockHashes::build(std::string_view text, const std::atomic<bool> *cancel)
+{
+    TRACE_SCOPE("hashes.build");
+    clear();
+
+    // Block boundaries first (one pass over the bytes), then the blocks are hashed
+    // in parallel.
+    m_offsets.push_back(0);
+    std::uint64_t lines = 1;
+    for (std::size_t p = next_line(text, 0); p != std::string_view::npos; p = next_line(text, p))
+    {
+        if (lines++ % kLinesPerBlock == 0)
+            m_offsets.push_back(p);
+        if ((lines & 0xfffff) == 0 && cancel && cancel->load(std::memory_order_relaxed))
+            return false;
+    }
+    m_offsets.push_back(text.size());
+
+    m_hashes.resize(m_offsets.size() - 1);
+    parallel_for(m_hashes.size(), [&](std::size_t b)
+                 { m_hashes[b] = hash_block(text.substr(m_offsets[b], m_offsets[b + 1] - m_offsets[b])); });
+    if (cancel && cancel->load(std::memory_order_relaxed))
+        return false;
+
+    m_size = text.size();
+    m_lines = lines;
+    m_valid = true;
+    return true;
+}
+
+std::uint64_t BlockHashes::hash_block(std::string_view text)
+{
+    return content_hash::xxh64(text);
+}
+
+std::size_t BlockHashes::next_line(std::string_view text, std::size_t from)
+{
+    for (std::size_t i = from; i < text.size(); ++i)
+    {
+        const char c = text[i];
+        if (c == '\n')
+            return i + 1;
+        if (c == '\r')
+            return i + 1 < text.size() && text[i + 1] == '\n' ? i + 2 : i + 1;
+        // U+2029 PARAGRAPH SEPARATOR.
+        if (c == '\xE2' && i + 2 < text.size() && text[i + 1] == '\x80' && text[i + 2] == '\xA9')
+            return i + 3;
+    }
+    return std::string_view::npos;
+}
+
+std::size_t BlockHashes::bytes() const
+{
+    return m_hashes.capacity() * sizeof(std::uint64_t) + m_offsets.capacity() * sizeof(std::uint64_t);
+}
+
+void DirtyLines::insert(std::int64_t line, std::int64_t newlines)
+{
+    if (empty())
+    {
+        m_first = line;
+        m_last = line + newlines;
+    }
+    else
+    {
+        m_first = std::min(m_first, line);
+        m_last = m_last >= line ? m_last + newlines : line + newlines;
+    }
+    m_delta += newlines;
+}
+
+void DirtyLines::erase(std::int64_t first, std::int64_t last)
+{
+    const std::int64_t removed = last - first;
+    if (empty())
+    {
+        m_first = first;
+        m_last = first;
+    }
+    else
+    {
+        m_first = std::min(m_first, first);
+        m_last = m_last > last ? m_last - removed : first;
+    }
+    m_delta -= removed;
+}
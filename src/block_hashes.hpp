@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// XXH64 of a document in blocks of kLinesPerBlock whole lines.
+//
+// Lines end where a Gtk::TextBuffer ends them: at "\n", "\r\n", a lone
+// "\r" or U+2029, so block b starts at buffer line b * kLinesPerBlock
+// whatever the file's line endings.
+//
+// Blocks are cut at line numbers, not byte offsets, so after an edit the
+// blocks outside the edited lines still line up with the old ones (the
+// editor knows line numbers cheaply; absolute byte offsets it does not).
+// Comparing a buffer with the saved file then means rehashing only the
+// blocks that DirtyLines says were touched.
+class BlockHashes
+{
+public:
+  static constexpr std::uint32_t kLinesPerBlock = 1024;
+
+  void clear();
+
+  // Hashes all of `text` on all cores. Returns false if cancelled.
+  bool build(std::string_view text, const std::atomic<bool> *cancel = nullptr);
+
+  bool valid() const { return m_valid; }
+
+  // Total size and line count (line breaks + 1) of the text.
+  std::uint64_t size() const { return m_size; }
+  std::uint64_t lines() const { return m_lines; }
+
+  std::size_t block_count() const { return m_hashes.size(); }
+  std::uint64_t block_hash(std::size_t block) const { return m_hashes[block]; }
+  std::uint64_t block_bytes(std::size_t block) const { return m_offsets[block + 1] - m_offsets[block]; }
+
+  static std::uint64_t hash_block(std::string_view text);
+  // Offset just past the first line break at or after `from`, or npos.
+  static std::size_t next_line(std::string_view text, std::size_t from);
+
+  std::size_t bytes() const;
+
+private:
+  std::vector<std::uint64_t> m_hashes;
+  std::vector<std::uint64_t> m_offsets; // block starts, plus the end
+  std::uint64_t m_size = 0;
+  std::uint64_t m_lines = 0;
+  bool m_valid = false;
+};
+
+// Lines touched since a reference version, in current buffer line numbers.
+//
+// Lines before first() are unchanged; lines after last() are the
+// reference's lines shifted by delta(). Each edit only widens the range.
+//
+// An edit that joins or splits a "\r\n" pair changes the line count by one
+// more or less than the breaks it inserts or erases, so after every edit
+// the buffer's count is checked against the reference's plus delta();
+// once they disagree the range is not exact() until the next reset().
+class DirtyLines
+{
+public:
+  // Starts over from a reference version of `lines` lines.
+  void reset(std::int64_t lines)
+  {
+    *this = DirtyLines{};
+    m_base_lines = lines;
+  }
+
+  // `newlines` line breaks were inserted on `line`.
+  void insert(std::int64_t line, std::int64_t newlines);
+  // The text from line `first` to line `last` (inclusive, joined) was
+  // erased, leaving one line.
+  void erase(std::int64_t first, std::int64_t last);
+
+  // The buffer has `lines` lines after an edit.
+  void check(std::int64_t lines)
+  {
+    if (lines != m_base_lines + m_delta)
+      m_exact = false;
+  }
+
+  bool empty() const { return m_first < 0; }
+  bool exact() const { return m_exact; }
+  std::int64_t first() const { return m_first; }
+  std::int64_t last() const { return m_last; }
+  std::int64_t delta() const { return m_delta; }
+
+private:
+  std::int64_t m_first = -1;
+  std::int64_t m_last = -1;
+  std::int64_t m_delta = 0;
+  std::int64_t m_base_lines = 1;
+  bool m_exact = true;
+};
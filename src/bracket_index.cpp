@@ -0,0 +1,671 @@
+#include "bracket_index.hpp"
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BRACKET_INDEX_SSE2 1
+#endif
+
+namespace
+{
+// build() polls for cancellation between slices.
+constexpr std::size_t kSliceBytes = 4u << 20;
+// Tokens per block; a block is split once it holds twice as many.
+constexpr std::size_t kBlockTokens = 1024;
+
+bool is_structural(unsigned char c)
+{
+    switch (c)
+    {
+    case '(':
+    case ')':
+    case '[':
+    case ']':
+    case '{':
+    case '}':
+    case '"':
+    case '\\':
+        return true;
+    default:
+        return false;
+    }
+}
+
+char opener_of(char close)
+{
+    switch (close)
+    {
+    case ')':
+        return '(';
+    case ']':
+        return '[';
+    case '}':
+        return '{';
+    default:
+        return 0;
+    }
+}
+
+bool is_opener(char c)
+{
+    return c == '(' || c == '[' || c == '{';
+}
+
+// Passes the tokens of `text` to `out.add(offset, ch, nl_before)`. `chars`
+// is the character offset of its first byte on entry and just past it on
+// return; `pending_nl` carries "a line break since the last token" across
+// calls. `limit` stops early once `out.size()` reaches it.
+template <typename Out>
+void classify(std::string_view text, int &chars, bool &pending_nl, Out &out, std::size_t limit)
+{
+    const auto *p = reinterpret_cast<const unsigned char *>(text.data());
+    const std::size_t n = text.size();
+    std::size_t i = 0;
+
+    auto emit = [&](std::size_t at, int offset)
+    {
+        const auto c = p[at];
+        if (c == '\n')
+        {
+            pending_nl = true;
+            return;
+        }
+        out.add(offset, static_cast<char>(c), pending_nl);
+        pending_nl = false;
+    };
+
+#ifdef BRACKET_INDEX_SSE2
+    const __m128i targets[] = {
+        _mm_set1_epi8('('), _mm_set1_epi8(')'), _mm_set1_epi8('['), _mm_set1_epi8(']'),
+        _mm_set1_epi8('{'), _mm_set1_epi8('}'), _mm_set1_epi8('"'), _mm_set1_epi8('\\'),
+        _mm_set1_epi8('\n'),
+    };
+    const __m128i top2 = _mm_set1_epi8(static_cast<char>(0xC0));
+    const __m128i cont = _mm_set1_epi8(static_cast<char>(0x80));
+
+    for (; i + 16 <= n && out.size() < limit; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        __m128i hit = _mm_cmpeq_epi8(v, targets[0]);
+        for (int t = 1; t < 9; ++t)
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, targets[t]));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        const auto cont_mask =
+            static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, top2), cont)));
+
+        // Most blocks of ordinary text have nothing to report.
+        while (mask)
+        {
+            const int bit = std::countr_zero(mask);
+            const int before = std::popcount(cont_mask & ((1u << bit) - 1u));
+            emit(i + static_cast<std::size_t>(bit), chars + bit - before);
+            mask &= mask - 1;
+        }
+        chars += 16 - std::popcount(cont_mask);
+    }
+#endif
+    for (; i < n && out.size() < limit; ++i)
+    {
+        const auto c = p[i];
+        if (c == '\n' || is_structural(c))
+            emit(i, chars);
+        if ((c & 0xC0) != 0x80)
+            ++chars;
+    }
+}
+} // namespace
+
+// Tokens for insert(), in absolute offsets.
+struct BracketIndex::TokenList
+{
+    std::vector<Token> tokens;
+
+    std::size_t size() const { return tokens.size(); }
+    void add(int offset, char ch, bool nl_before)
+    {
+        auto &t = tokens.emplace_back();
+        t.offset = offset;
+        t.ch = ch;
+        t.nl_before = nl_before;
+    }
+};
+
+// Tokens for build(), straight into the blocks: fills the last block and
+// opens a new one when it is full.
+struct BracketIndex::Appender
+{
+    BracketIndex &index;
+
+    std::size_t size() const { return index.m_token_count; }
+    void add(int offset, char ch, bool nl_before)
+    {
+        if (index.m_blocks.back().tokens.size() >= kBlockTokens)
+        {
+            Block block;
+            block.id = index.m_next_block_id++;
+            block.start = offset;
+            block.tokens.reserve(kBlockTokens);
+            index.m_blocks.push_back(std::move(block));
+            index.m_block_index.push_back(index.m_blocks.size() - 1);
+        }
+        auto &block = index.m_blocks.back();
+        auto &t = block.tokens.emplace_back();
+        t.offset = offset - block.start;
+        t.ch = ch;
+        t.nl_before = nl_before;
+        t.id = static_cast<std::uint32_t>(index.m_locations.size());
+        index.m_locations.push_back(Location{block.id, static_cast<std::uint32_t>(block.tokens.size() - 1)});
+        ++index.m_token_count;
+    }
+};
+
+void BracketIndex::clear()
+{
+    m_blocks.clear();
+    m_blocks.shrink_to_fit();
+    m_block_index.clear();
+    m_block_index.shrink_to_fit();
+    m_locations.clear();
+    m_locations.shrink_to_fit();
+    m_free_ids.clear();
+    m_free_ids.shrink_to_fit();
+    m_released.clear();
+    m_released.shrink_to_fit();
+    m_next_block_id = 0;
+    m_token_count = 0;
+    m_valid = false;
+    m_dirty = false;
+}
+
+void BracketIndex::reset_blocks()
+{
+    clear();
+    m_blocks.emplace_back();
+    m_block_index.push_back(0);
+    m_next_block_id = 1;
+}
+
+bool BracketIndex::build(std::string_view text, std::size_t max_tokens, const std::atomic<bool> *cancel)
+{
+    TRACE_SCOPE("bracket_index.build");
+    reset_blocks();
+
+    int chars = 0;
+    bool pending_nl = false;
+    Appender out{*this};
+    for (std::size_t at = 0; at < text.size(); at += kSliceBytes)
+    {
+        if (m_token_count > max_tokens || (cancel && cancel->load(std::memory_order_relaxed)))
+        {
+            clear();
+            return false;
+        }
+        classify(text.substr(at, kSliceBytes), chars, pending_nl, out, max_tokens + 1);
+    }
+    if (m_token_count > max_tokens)
+    {
+        clear();
+        return false;
+    }
+    m_valid = true;
+    m_dirty = true;
+    return true;
+}
+
+std::size_t BracketIndex::bytes() const
+{
+    std::size_t total = m_blocks.capacity() * sizeof(Block) + m_block_index.capacity() * sizeof(std::size_t) +
+                        m_locations.capacity() * sizeof(Location) +
+                        (m_free_ids.capacity() + m_released.capacity()) * sizeof(std::uint32_t);
+    for (const auto &block : m_blocks)
+        total += block.tokens.capacity() * sizeof(Token);
+    return total;
+}
+
+// -------- Blocks --------
+std::size_t BracketIndex::block_at(int offset) const
+{
+    // The last block starting at or before `offset`; the first one starts at 0.
+    const auto it = std::upper_bound(m_blocks.begin(), m_blocks.end(), offset,
+                                     [](int o, const Block &b)
+                                     { return o < b.start; });
+    return it == m_blocks.begin() ? 0 : static_cast<std::size_t>(it - m_blocks.begin()) - 1;
+}
+
+BracketIndex::Pos BracketIndex::token_at_or_after(int offset) const
+{
+    Pos pos;
+    pos.block = block_at(offset);
+    const auto &block = m_blocks[pos.block];
+    pos.index = static_cast<std::size_t>(
+        std::lower_bound(block.tokens.begin(), block.tokens.end(), offset - block.start,
+                         [](const Token &t, int o)
+                         { return t.offset < o; }) -
+        block.tokens.begin());
+    skip_empty(pos);
+    return pos;
+}
+
+bool BracketIndex::skip_empty(Pos &pos) const
+{
+    while (pos.block < m_blocks.size() && pos.index >= m_blocks[pos.block].tokens.size())
+    {
+        ++pos.block;
+        pos.index = 0;
+    }
+    return pos.block < m_blocks.size();
+}
+
+bool BracketIndex::prev(Pos &pos) const
+{
+    if (pos.index > 0)
+    {
+        --pos.index;
+        return true;
+    }
+    for (std::size_t b = pos.block; b > 0; --b)
+    {
+        if (!m_blocks[b - 1].tokens.empty())
+        {
+            pos = Pos{b - 1, m_blocks[b - 1].tokens.size() - 1};
+            return true;
+        }
+    }
+    return false;
+}
+
+int BracketIndex::offset_of(const Pos &pos) const
+{
+    const auto &block = m_blocks[pos.block];
+    return block.start + block.tokens[pos.index].offset;
+}
+
+BracketIndex::Token &BracketIndex::token(std::uint32_t id) const
+{
+    const auto &loc = m_locations[id];
+    return m_blocks[m_block_index[loc.block]].tokens[loc.index];
+}
+
+int BracketIndex::offset_of_id(std::uint32_t id) const
+{
+    const auto &loc = m_locations[id];
+    const auto &block = m_blocks[m_block_index[loc.block]];
+    return block.start + block.tokens[loc.index].offset;
+}
+
+std::uint32_t BracketIndex::new_id()
+{
+    if (!m_free_ids.empty())
+    {
+        const auto id = m_free_ids.back();
+        m_free_ids.pop_back();
+        return id;
+    }
+    m_locations.emplace_back();
+    return static_cast<std::uint32_t>(m_locations.size() - 1);
+}
+
+void BracketIndex::relocate(std::size_t block, std::size_t from)
+{
+    const auto &b = m_blocks[block];
+    for (std::size_t i = from; i < b.tokens.size(); ++i)
+        m_locations[b.tokens[i].id] = Location{b.id, static_cast<std::uint32_t>(i)};
+}
+
+void BracketIndex::split(std::size_t block)
+{
+    const std::size_t n = m_blocks[block].tokens.size();
+    if (n <= 2 * kBlockTokens)
+        return;
+
+    std::vector<Block> pieces;
+    for (std::size_t from = kBlockTokens; from < n; from += kBlockTokens)
+    {
+        const auto &source = m_blocks[block];
+        const auto to = std::min(n, from + kBlockTokens);
+        Block piece;
+        piece.id = m_next_block_id++;
+        piece.start = source.start + source.tokens[from].offset;
+        piece.tokens.assign(source.tokens.begin() + static_cast<std::ptrdiff_t>(from),
+                            source.tokens.begin() + static_cast<std::ptrdiff_t>(to));
+        for (auto &t : piece.tokens)
+            t.offset -= piece.start - source.start;
+        pieces.push_back(std::move(piece));
+    }
+    m_blocks[block].tokens.resize(kBlockTokens);
+    m_blocks[block].dirty = true;
+
+    m_blocks.insert(m_blocks.begin() + static_cast<std::ptrdiff_t>(block + 1),
+                    std::make_move_iterator(pieces.begin()), std::make_move_iterator(pieces.end()));
+    m_block_index.resize(m_next_block_id);
+    for (std::size_t b = block + 1; b < m_blocks.size(); ++b)
+        m_block_index[m_blocks[b].id] = b;
+    for (std::size_t b = block + 1; b <= block + pieces.size(); ++b)
+        relocate(b, 0);
+}
+
+void BracketIndex::remove_block(std::size_t block)
+{
+    m_blocks.erase(m_blocks.begin() + static_cast<std::ptrdiff_t>(block));
+    for (std::size_t b = block; b < m_blocks.size(); ++b)
+        m_block_index[m_blocks[b].id] = b;
+}
+
+// -------- Edits --------
+void BracketIndex::insert(int offset, int chars, std::string_view text, const LineOf &line_of)
+{
+    if (!m_valid || chars <= 0)
+        return;
+
+    TokenList list;
+    int chars_seen = offset;
+    bool pending_nl = false;
+    classify(text, chars_seen, pending_nl, list, SIZE_MAX);
+    auto &added = list.tokens;
+
+    // Only this block's tokens move; the blocks after it just start later.
+    const std::size_t b = block_at(offset);
+    auto &block = m_blocks[b];
+    const std::size_t at = static_cast<std::size_t>(
+        std::lower_bound(block.tokens.begin(), block.tokens.end(), offset - block.start,
+                         [](const Token &t, int o)
+                         { return t.offset < o; }) -
+        block.tokens.begin());
+    for (std::size_t i = at; i < block.tokens.size(); ++i)
+        block.tokens[i].offset += chars;
+    for (std::size_t k = b + 1; k < m_blocks.size(); ++k)
+        m_blocks[k].start += chars;
+
+    for (auto &t : added)
+    {
+        t.offset -= block.start;
+        t.id = new_id();
+    }
+    block.tokens.insert(block.tokens.begin() + static_cast<std::ptrdiff_t>(at), added.begin(), added.end());
+    block.dirty = true;
+    m_token_count += added.size();
+    relocate(b, at);
+    m_dirty = true;
+
+    // Line-break flags at the two seams come from the buffer itself; the
+    // token after the edit now stands at another distance from the one
+    // before, so its block is paired again too.
+    auto fix = [&](Pos pos)
+    {
+        if (!skip_empty(pos))
+            return;
+        Pos before = pos;
+        const bool nl = prev(before) && line_of(offset_of(pos)) != line_of(offset_of(before));
+        m_blocks[pos.block].tokens[pos.index].nl_before = nl;
+        m_blocks[pos.block].dirty = true;
+    };
+    fix(Pos{b, at});
+    fix(Pos{b, at + added.size()});
+
+    split(b);
+}
+
+void BracketIndex::erase(int offset, int chars, const LineOf &line_of)
+{
+    if (!m_valid || chars <= 0)
+        return;
+    const int end = offset + chars;
+
+    // The seam's flag, judged before the text goes: a line break survives
+    // between the previous token and the edit, or between the edit and the
+    // next token.
+    bool seam_nl = false;
+    {
+        Pos from = token_at_or_after(offset);
+        const Pos to = token_at_or_after(end);
+        if (to.block < m_blocks.size() && prev(from))
+            seam_nl = line_of(offset) != line_of(offset_of(from)) || line_of(offset_of(to)) != line_of(end);
+    }
+
+    const std::size_t first = block_at(offset);
+    std::size_t b = first;
+    for (; b < m_blocks.size() && m_blocks[b].start < end; ++b)
+    {
+        // Overlaps the erased range: drop its tokens there, move the rest.
+        auto &block = m_blocks[b];
+        const int start = std::min(block.start, offset);
+        std::size_t kept = 0;
+        for (const auto &t : block.tokens)
+        {
+            const int at = block.start + t.offset;
+            if (at >= offset && at < end)
+            {
+                m_released.push_back(t.id);
+                continue;
+            }
+            auto &moved = block.tokens[kept++];
+            moved = t;
+            moved.offset = (at >= end ? at - chars : at) - start;
+        }
+        m_token_count -= block.tokens.size() - kept;
+        block.tokens.resize(kept);
+        block.start = start;
+        block.dirty = true;
+        relocate(b, 0);
+    }
+    for (std::size_t k = b; k < m_blocks.size(); ++k)
+        m_blocks[k].start -= chars;
+
+    // Blocks emptied by the edit go, except the first, which starts at 0.
+    for (std::size_t k = b; k-- > first + 1;)
+    {
+        if (m_blocks[k].tokens.empty())
+            remove_block(k);
+    }
+    m_dirty = true;
+
+    Pos seam = token_at_or_after(offset);
+    if (seam.block < m_blocks.size())
+    {
+        Pos before = seam;
+        auto &t = m_blocks[seam.block].tokens[seam.index];
+        if (prev(before))
+            t.nl_before = seam_nl;
+        m_blocks[seam.block].dirty = true;
+    }
+}
+
+// -------- Pairing --------
+void BracketIndex::pair() const
+{
+    if (!m_dirty)
+        return;
+    TRACE_SCOPE("bracket_index.pair");
+
+    std::size_t b = 0;
+    for (;;)
+    {
+        while (b < m_blocks.size() && !m_blocks[b].dirty)
+            ++b;
+        if (b == m_blocks.size())
+            break;
+        b = pair_from(b);
+    }
+
+    // Nothing refers to erased tokens any more; their ids can be reused.
+    m_free_ids.insert(m_free_ids.end(), m_released.begin(), m_released.end());
+    m_released.clear();
+    m_dirty = false;
+}
+
+std::size_t BracketIndex::pair_from(std::size_t first) const
+{
+    // The state after the last token before `first`, from its pairing.
+    std::uint32_t top = kNone; // innermost open token
+    bool escaping = false;     // previous token was a backslash that escapes
+    int last_offset = -2;
+    Pos pos{first, 0};
+    if (prev(pos))
+    {
+        const auto &t = m_blocks[pos.block].tokens[pos.index];
+        top = t.pushed ? t.id : t.parent;
+        escaping = t.ch == '\\' && !t.escaped;
+        last_offset = offset_of(pos);
+    }
+    // An open quote is always innermost.
+    std::uint32_t string_open = top != kNone && token(top).ch == '"' ? top : kNone;
+
+    // Open tokens this run pushed under another parent than before (or for
+    // the first time): while there are any, the stack is not the old one.
+    const std::uint32_t run = ++m_run;
+    std::size_t repushed = 0;
+    auto push = [&](Token &t, bool was_pushed, std::uint32_t old_parent)
+    {
+        t.pushed = true;
+        if (!was_pushed || old_parent != t.parent)
+        {
+            t.repushed = run;
+            ++repushed;
+        }
+        top = t.id;
+    };
+    auto pop = [&](Token &open)
+    {
+        if (open.repushed == run)
+            --repushed;
+        top = open.parent;
+    };
+
+    for (std::size_t b = first; b < m_blocks.size(); ++b)
+    {
+        auto &block = m_blocks[b];
+        // Caught up: from here on everything pairs as it did before.
+        if (b > first && !block.dirty && repushed == 0 && block.entry_top == top &&
+            block.entry_escaping == escaping)
+            return b;
+        block.entry_top = top;
+        block.entry_escaping = escaping;
+        block.dirty = false;
+
+        for (auto &t : block.tokens)
+        {
+            const int offset = block.start + t.offset;
+
+            // A string never spans a line break; drop the unterminated one.
+            if (string_open != kNone && t.nl_before)
+            {
+                auto &open = token(string_open);
+                open.match = kNone;
+                pop(open);
+                string_open = kNone;
+            }
+
+            const bool was_pushed = t.pushed;
+            const std::uint32_t old_parent = t.parent;
+            t.escaped = escaping && last_offset == offset - 1;
+            escaping = false;
+            last_offset = offset;
+            t.parent = top;
+            t.pushed = false;
+            // An open token's partner is set when it closes (or stays as
+            // it was, if the run stops while it is still open).
+            if (t.escaped)
+            {
+                t.match = kNone;
+                continue;
+            }
+
+            switch (t.ch)
+            {
+            case '\\':
+                escaping = true;
+                t.match = kNone;
+                break;
+            case '"':
+                if (string_open != kNone)
+                {
+                    auto &open = token(string_open);
+                    t.match = string_open;
+                    t.parent = open.parent;
+                    open.match = t.id;
+                    pop(open);
+                    string_open = kNone;
+                }
+                else
+                {
+                    push(t, was_pushed, old_parent);
+                    string_open = t.id;
+                }
+                break;
+            case '(':
+            case '[':
+            case '{':
+                if (string_open == kNone)
+                    push(t, was_pushed, old_parent);
+                else
+                    t.match = kNone;
+                break;
+            default: // closers
+                if (string_open == kNone && top != kNone && token(top).ch == opener_of(t.ch))
+                {
+                    auto &open = token(top);
+                    t.match = open.id;
+                    t.parent = open.parent;
+                    open.match = t.id;
+                    pop(open);
+                }
+                else
+                {
+                    t.match = kNone;
+                }
+                break;
+            }
+        }
+    }
+
+    // Still open at the end of the text: unmatched.
+    for (auto id = top; id != kNone; id = token(id).parent)
+        token(id).match = kNone;
+    return m_blocks.size();
+}
+
+// -------- Queries --------
+int BracketIndex::match(int offset) const
+{
+    if (!m_valid)
+        return -1;
+    pair();
+
+    const Pos pos = token_at_or_after(offset);
+    if (pos.block >= m_blocks.size() || offset_of(pos) != offset)
+        return -1;
+    const auto &t = m_blocks[pos.block].tokens[pos.index];
+    return t.match == kNone ? -1 : offset_of_id(t.match);
+}
+
+bool BracketIndex::enclosing(int offset, int &open, int &close) const
+{
+    if (!m_valid)
+        return false;
+    pair();
+
+    // Last token before `offset`: an open token there encloses `offset`;
+    // anything else is enclosed by its parent.
+    Pos last = token_at_or_after(offset);
+    if (!prev(last))
+        return false;
+
+    const auto &t = m_blocks[last.block].tokens[last.index];
+    const bool is_open = t.match != kNone ? offset_of_id(t.match) > offset_of(last) : is_opener(t.ch);
+    std::uint32_t candidate = is_open ? t.id : t.parent;
+
+    // Skip unmatched openers on the way out.
+    while (candidate != kNone && token(candidate).match == kNone)
+        candidate = token(candidate).parent;
+    if (candidate == kNone)
+        return false;
+
+    open = offset_of_id(candidate);
+    close = offset_of_id(token(candidate).match);
+    return true;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+// Structural index of brackets and double-quoted strings, in character
+// offsets of the buffer.
+//
+// Every ( ) [ ] { } " and \ in the text is kept as a token, found with a
+// SIMD classifier (16 bytes at a time, simdjson's stage 1 in spirit). A
+// pairing pass over the tokens alone (not the text) then works out which
+// brackets match, which sit inside strings or after an escape, and the
+// innermost pair around every token. Strings end at a line break, so a
+// stray quote cannot swallow the rest of the file.
+//
+// Tokens live in blocks of about kBlockTokens, each with offsets relative
+// to the block's start, so an edit renumbers the tokens of one block and
+// moves the start of the blocks after it. Pairing results name tokens by a
+// stable id rather than by position. After an edit, pairing reruns lazily
+// from the first block edited and stops at the first later block whose
+// entry state (the stack of open tokens, and a pending escape) is the same
+// as before: a typed letter, or a balanced pair, re-pairs a block or two.
+// The stack needs no storage of its own: each open token's parent is the
+// one below it.
+//
+// match() and enclosing() are binary searches, O(log n).
+class BracketIndex
+{
+public:
+  // 0-based line of a character offset (in the buffer as it is now).
+  using LineOf = std::function<int(int offset)>;
+
+  void clear();
+
+  // Indexes `text` from scratch. Returns false (and stays empty) if it has
+  // more than `max_tokens` structural characters or `cancel` is set.
+  bool build(std::string_view text, std::size_t max_tokens, const std::atomic<bool> *cancel = nullptr);
+
+  bool valid() const { return m_valid; }
+
+  // `text` (`chars` characters) has just been inserted at `offset`.
+  void insert(int offset, int chars, std::string_view text, const LineOf &line_of);
+  // `chars` characters at `offset` are about to be erased.
+  void erase(int offset, int chars, const LineOf &line_of);
+
+  // Offset of the bracket or quote paired with the one at `offset`, or -1.
+  int match(int offset) const;
+
+  // Innermost matched pair strictly around `offset` (open < offset <= close).
+  bool enclosing(int offset, int &open, int &close) const;
+
+  std::size_t bytes() const;
+
+private:
+  static constexpr std::uint32_t kNone = UINT32_MAX;
+
+  struct Token
+  {
+    int offset = 0; // from the block's start
+    std::uint32_t id = 0;
+    // Pairing, by token id.
+    std::uint32_t match = kNone;  // partner
+    std::uint32_t parent = kNone; // innermost matched-or-open token around this one
+    std::uint32_t repushed = 0;   // pairing run that opened it under another parent
+    char ch = 0;
+    bool nl_before = false; // a line break lies between the previous token and this one
+    bool pushed = false;    // opened a bracket or string
+    bool escaped = false;   // follows an escaping backslash
+  };
+
+  struct Block
+  {
+    std::uint32_t id = 0;
+    int start = 0; // character offset; the block's tokens lie before the next block's start
+    std::vector<Token> tokens;
+    bool dirty = true; // edited since it was last paired
+    // Pairing state on entry, to tell when a rerun has caught up.
+    bool entry_escaping = false;
+    std::uint32_t entry_top = kNone; // innermost open token
+  };
+
+  // Where a token is: block id and index within the block.
+  struct Location
+  {
+    std::uint32_t block = 0;
+    std::uint32_t index = 0;
+  };
+
+  // Where classify() puts the tokens it finds.
+  struct TokenList;
+  struct Appender;
+
+  // A token position while walking: block index and index within it.
+  struct Pos
+  {
+    std::size_t block = 0;
+    std::size_t index = 0;
+  };
+
+  // Pairing fields are filled in lazily, by const queries.
+  mutable std::vector<Block> m_blocks;
+  std::vector<std::size_t> m_block_index; // by block id
+  std::vector<Location> m_locations;      // by token id
+  // Ids of erased tokens; reused only once pairing no longer refers to them.
+  mutable std::vector<std::uint32_t> m_free_ids;
+  mutable std::vector<std::uint32_t> m_released;
+  std::uint32_t m_next_block_id = 0;
+  std::size_t m_token_count = 0;
+  bool m_valid = false;
+  mutable bool m_dirty = false; // some block needs pairing
+  mutable std::uint32_t m_run = 0; // pairing runs so far (see Token::repushed)
+
+  void reset_blocks();
+  std::size_t block_at(int offset) const;
+  Pos token_at_or_after(int offset) const;
+  bool prev(Pos &pos) const;
+  bool skip_empty(Pos &pos) const;
+  int offset_of(const Pos &pos) const;
+  Token &token(std::uint32_t id) const;
+  int offset_of_id(std::uint32_t id) const;
+
+  std::uint32_t new_id();
+  void relocate(std::size_t block, std::size_t from);
+  void split(std::size_t block);
+  void remove_block(std::size_t block);
+
+  void pair() const;
+  std::size_t pair_from(std::size_t block) const;
+};
@@ -0,0 +1,236 @@
+#include "buffer_search.hpp"
+
+#include "trace.hpp"
+
+#include <limits>
+
+namespace
+{
+// Characters read at first when searching forward.
+constexpr int kWindowChars = 64 * 1024;
+// Most characters read past either end of a range so ^, $, \b and
+// look-arounds see what surrounds it. Kept to the same line and bounded,
+// so a scope deep inside one long line (minified JSON) costs its own size.
+constexpr int kContextChars = 256;
+
+// Up to kContextChars past `it`, stopping at the end of its line.
+Gtk::TextBuffer::iterator context_end(const Gtk::TextBuffer::iterator &it)
+{
+    if (it.ends_line())
+        return it;
+    auto end = it;
+    end.forward_chars(kContextChars);
+    if (end.get_line() != it.get_line())
+    {
+        end = it;
+        end.forward_to_line_end();
+    }
+    return end;
+}
+
+int char_count(const std::string &text, std::size_t from, std::size_t to)
+{
+    return static_cast<int>(g_utf8_strlen(text.data() + from, static_cast<gssize>(to - from)));
+}
+
+// Every match from `from` on that can be selected, i.e. is not empty. The
+// walk itself is the engine's, the same one Replace All takes, so both step
+// over empty matches (`x*`, `^`) alike and see the same non-empty ones.
+void for_each_selectable(const SearchEngine &engine, std::string_view text, std::size_t from,
+                         const std::function<bool(const SearchMatch &)> &fn)
+{
+    engine.for_each(text, [&](const SearchMatch &m)
+                    { return m.end == m.begin || fn(m); }, from);
+}
+} // namespace
+
+namespace buffer_search
+{
+Gtk::TextBuffer::iterator context_start(const Gtk::TextBuffer::iterator &it)
+{
+    auto start = it;
+    start.backward_chars(kContextChars);
+    if (start.get_line() != it.get_line())
+        start.set_line(it.get_line());
+    return start;
+}
+
+bool find_forward(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const SearchEngine &engine,
+                  const Gtk::TextBuffer::iterator &from, const Gtk::TextBuffer::iterator &limit,
+                  Gtk::TextBuffer::iterator &out_start, Gtk::TextBuffer::iterator &out_end)
+{
+    TRACE_SCOPE("search.find_forward");
+
+    if (limit.compare(from) < 0)
+        return false;
+
+    const auto base = context_start(from);
+    const std::size_t skip = buffer->get_text(base, from, true).bytes();
+
+    // Read a window plus some context after it, doubling it until it holds
+    // a match that ends inside the window proper (one that reaches into the
+    // context might run on), or until it reaches `limit`.
+    constexpr int kMaxWindow = std::numeric_limits<int>::max();
+    for (int window = kWindowChars;; window = window > kMaxWindow / 2 ? kMaxWindow : window * 2)
+    {
+        auto edge = from;
+        edge.forward_chars(window);
+        auto window_end = context_end(edge);
+        if (window_end.compare(limit) > 0)
+            window_end = limit;
+        const bool whole = window_end.compare(limit) == 0;
+        const std::size_t context = whole || edge.compare(window_end) >= 0
+                                        ? 0
+                                        : buffer->get_text(edge, window_end, true).bytes();
+
+        const auto text = buffer->get_text(base, window_end, true);
+        const auto &raw = text.raw();
+
+        bool found = false;
+        SearchMatch hit;
+        for_each_selectable(engine, raw, skip, [&](const SearchMatch &m)
+                            {
+            hit = m;
+            found = true;
+            return false; });
+
+        if (found && (whole || hit.end + context < raw.size()))
+        {
+            const int s = base.get_offset() + char_count(raw, 0, hit.begin);
+            const int e = s + char_count(raw, hit.begin, hit.end);
+            out_start = buffer->get_iter_at_offset(s);
+            out_end = buffer->get_iter_at_offset(e);
+            return true;
+        }
+        if (whole)
+            return false;
+    }
+}
+
+bool find_backward(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const SearchEngine &engine,
+                   const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &before,
+                   const Gtk::TextBuffer::iterator &end,
+                   Gtk::TextBuffer::iterator &out_start, Gtk::TextBuffer::iterator &out_end)
+{
+    TRACE_SCOPE("search.find_backward");
+
+    if (before.compare(start) <= 0)
+        return false;
+
+    auto base = context_start(start);
+    const auto text = buffer->get_text(base, end, true);
+    const auto &raw = text.raw();
+    const std::size_t skip = buffer->get_text(base, start, true).bytes();
+    const std::size_t limit = skip + buffer->get_text(start, before, true).bytes();
+
+    bool found = false;
+    SearchMatch hit;
+    for_each_selectable(engine, raw, skip, [&](const SearchMatch &m)
+                        {
+        if (m.begin >= limit)
+            return false;
+        hit = m;
+        found = true;
+        return true; });
+
+    if (!found)
+        return false;
+
+    const int s = base.get_offset() + char_count(raw, 0, hit.begin);
+    const int e = s + char_count(raw, hit.begin, hit.end);
+    out_start = buffer->get_iter_at_offset(s);
+    out_end = buffer->get_iter_at_offset(e);
+    return true;
+}
+
+std::vector<std::pair<int, int>> match_offsets(const Glib::RefPtr<Gtk::TextBuffer> &buffer,
+                                               const SearchEngine &engine,
+                                               const Gtk::TextBuffer::iterator &start,
+                                               const Gtk::TextBuffer::iterator &end)
+{
+    TRACE_SCOPE("search.match_offsets");
+
+    std::vector<std::pair<int, int>> out;
+    const auto base = context_start(start);
+    const auto text = buffer->get_text(base, end, true);
+    const auto &raw = text.raw();
+
+    // Matches come in order, so byte->char conversion is one running count.
+    std::size_t byte_pos = 0;
+    int char_pos = base.get_offset();
+
+    for_each_selectable(engine, raw, buffer->get_text(base, start, true).bytes(), [&](const SearchMatch &m)
+                        {
+        char_pos += char_count(raw, byte_pos, m.begin);
+        const int s = char_pos;
+        char_pos += char_count(raw, m.begin, m.end);
+        byte_pos = m.end;
+        out.emplace_back(s, char_pos);
+        return true; });
+
+    return out;
+}
+
+std::size_t replace_all(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const SearchEngine &engine,
+                        const std::string &replacement,
+                        const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end)
+{
+    std::vector<Edit> edits;
+    {
+        TRACE_SCOPE("replace.scan");
+
+        const auto base = context_start(start);
+        const auto text = buffer->get_text(base, end, true);
+        const auto &raw = text.raw();
+
+        std::size_t byte_pos = 0;
+        int char_pos = base.get_offset();
+
+        engine.for_each_replacement(raw, replacement, [&](const SearchMatch &m, const std::string &with)
+                                    {
+            char_pos += char_count(raw, byte_pos, m.begin);
+            const int s = char_pos;
+            char_pos += char_count(raw, m.begin, m.end);
+            byte_pos = m.end;
+            edits.push_back(Edit{s, char_pos, with});
+            return true; }, buffer->get_text(base, start, true).bytes());
+    }
+
+    apply_edits(buffer, edits);
+    return edits.size();
+}
+
+void apply_edits(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const std::vector<Edit> &edits)
+{
+    if (edits.empty())
+        return;
+
+    TRACE_SCOPE("replace.apply");
+
+    // Apply back to front: earlier offsets stay valid without marks.
+    buffer->begin_user_action();
+    for (auto it = edits.rbegin(); it != edits.rend(); ++it)
+    {
+        auto pos = buffer->get_iter_at_offset(it->start);
+        if (it->end != it->start)
+            pos = buffer->erase(pos, buffer->get_iter_at_offset(it->end));
+        if (!it->with.empty())
+            buffer->insert(pos, it->with);
+    }
+    buffer->end_user_action();
+}
+
+std::string expand(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const SearchEngine &engine,
+                   const Gtk::TextBuffer::iterator &s, const Gtk::TextBuffer::iterator &e,
+                   const std::string &replacement)
+{
+    if (!engine.options().regex)
+        return replacement;
+
+    const auto base = context_start(s);
+    const auto text = buffer->get_text(base, context_end(e), true);
+    const std::size_t b = buffer->get_text(base, s, true).bytes();
+    const std::size_t len = buffer->get_text(s, e, true).bytes();
+    return engine.expand(text.raw(), SearchMatch{b, b + len}, replacement);
+}
+} // namespace buffer_search
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "search_engine.hpp"
+
+#include <gtkmm.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Glue between SearchEngine (byte offsets over UTF-8 text) and a
+// Gtk::TextBuffer (character iterators). Shared by the Find and Replace
+// dialogs.
+namespace buffer_search
+{
+// Where to start reading for a search from `it`: a few hundred characters
+// back, never past the start of its line, so ^, \b and look-behinds see
+// the text before `it` at a bounded cost. The searches below all read from
+// here; a copy searched elsewhere should too.
+Gtk::TextBuffer::iterator context_start(const Gtk::TextBuffer::iterator &it);
+
+// First match starting at or after `from` and ending by `limit`. The text
+// is read in windows that grow until one holds the match, so a nearby
+// match costs a short read however far `limit` is.
+//
+// Every search here skips empty matches, which cannot be selected or
+// shown, but walks the same matches as the engine: a non-empty match is
+// found by Next exactly when Replace All replaces it.
+bool find_forward(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const SearchEngine &engine,
+                  const Gtk::TextBuffer::iterator &from, const Gtk::TextBuffer::iterator &limit,
+                  Gtk::TextBuffer::iterator &out_start, Gtk::TextBuffer::iterator &out_end);
+
+// Last match in [start, end) starting before `before`. Only that range
+// (from context_start()) is read.
+bool find_backward(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const SearchEngine &engine,
+                   const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &before,
+                   const Gtk::TextBuffer::iterator &end,
+                   Gtk::TextBuffer::iterator &out_start, Gtk::TextBuffer::iterator &out_end);
+
+// Every non-empty match in [start, end) as (start, end) character offsets.
+// Like find_forward(), the text is read from context_start().
+std::vector<std::pair<int, int>> match_offsets(const Glib::RefPtr<Gtk::TextBuffer> &buffer,
+                                               const SearchEngine &engine,
+                                               const Gtk::TextBuffer::iterator &start,
+                                               const Gtk::TextBuffer::iterator &end);
+
+// One replacement: characters [start, end) become `with`.
+struct Edit
+{
+  int start = 0;
+  int end = 0;
+  std::string with;
+};
+
+// Applies `edits` (in document order, not overlapping) as a single user
+// action.
+void apply_edits(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const std::vector<Edit> &edits);
+
+// Replaces every match in [start, end) as a single user action; returns the
+// count. Unlike match_offsets() this includes empty matches (`^`, `x*`),
+// which become insertions though they are never highlighted or selected;
+// the non-empty ones are the same.
+std::size_t replace_all(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const SearchEngine &engine,
+                        const std::string &replacement,
+                        const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end);
+
+// Replacement text for the match [s, e) (regex back-references expanded).
+std::string expand(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const SearchEngine &engine,
+                   const Gtk::TextBuffer::iterator &s, const Gtk::TextBuffer::iterator &e,
+                   const std::string &replacement);
+} // namespace buffer_search
@@ -0,0 +1,112 @@
+#include "byte_search.hpp"
+
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BYTE_SEARCH_SSE2 1
+#endif
+
+namespace byte_search
+{
+std::size_t find(std::string_view hay, std::string_view needle, std::size_t from)
+{
+    const std::size_t n = needle.size();
+    if (from > hay.size() || n > hay.size() - from)
+        return std::string_view::npos;
+    if (n == 0)
+        return from;
+    if (n == 1)
+    {
+        auto p = static_cast<const char *>(std::memchr(hay.data() + from, needle[0], hay.size() - from));
+        return p ? static_cast<std::size_t>(p - hay.data()) : std::string_view::npos;
+    }
+
+    std::size_t i = from;
+#ifdef BYTE_SEARCH_SSE2
+    const __m128i first = _mm_set1_epi8(needle.front());
+    const __m128i last = _mm_set1_epi8(needle.back());
+    const char *data = hay.data();
+
+    // 16 candidate starts per step; the loads for the last byte reach n - 1
+    // further, so stop while both stay inside the haystack.
+    for (; i + n + 15 <= hay.size(); i += 16)
+    {
+        const __m128i bf = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i bl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + n - 1));
+        auto mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bf, first), _mm_cmpeq_epi8(bl, last))));
+        while (mask)
+        {
+            const unsigned bit = static_cast<unsigned>(std::countr_zero(mask));
+            if (std::memcmp(data + i + bit + 1, needle.data() + 1, n - 2) == 0)
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    return hay.find(needle, i);
+}
+
+bool parse_pattern(std::string_view text, std::string &bytes, std::string &error)
+{
+    bytes.clear();
+    while (!text.empty() && text.front() == ' ')
+        text.remove_prefix(1);
+    while (!text.empty() && text.back() == ' ')
+        text.remove_suffix(1);
+
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"')
+    {
+        bytes.assign(text.substr(1, text.size() - 2));
+        if (bytes.empty())
+            error = "Empty pattern.";
+        return !bytes.empty();
+    }
+
+    auto nibble = [](char c) -> int
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+
+    int high = -1;
+    for (const char c : text)
+    {
+        if (c == ' ' || c == '\t')
+            continue;
+        const int v = nibble(c);
+        if (v < 0)
+        {
+            error = "Not a hex digit: '" + std::string(1, c) + "' (quote text, e.g. \"GET\").";
+            return false;
+        }
+        if (high < 0)
+        {
+            high = v;
+        }
+        else
+        {
+            bytes.push_back(static_cast<char>((high << 4) | v));
+            high = -1;
+        }
+    }
+    if (high >= 0)
+    {
+        error = "Odd number of hex digits.";
+        return false;
+    }
+    if (bytes.empty())
+    {
+        error = "Empty pattern.";
+        return false;
+    }
+    return true;
+}
+} // namespace byte_search
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace byte_search
+{
+// Offset of the first occurrence of `needle` in `hay` at or after `from`,
+// or std::string_view::npos. Binary safe. On x86-64 candidates are found
+// 16 positions at a time by comparing the needle's first and last bytes
+// (SSE2), and only those are checked with memcmp.
+std::size_t find(std::string_view hay, std::string_view needle, std::size_t from = 0);
+
+// Parses a byte pattern: hex pairs with optional blanks ("de ad be ef",
+// "DEADBEEF") or a quoted literal ("\"GET /\""). Returns false with
+// `error` set on bad input.
+bool parse_pattern(std::string_view text, std::string &bytes, std::string &error);
+} // namespace byte_search
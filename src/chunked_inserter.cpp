@@ -0,0 +1,148 @@
+#include "chunked_inserter.hpp"
+
+#include "trace.hpp"
+
+#include <utility>
+
+namespace
+{
+constexpr std::size_t kSliceBytes = 256 * 1024;
+constexpr gint64 kStepBudgetUs = 8000; // leave most of a 60 Hz frame for painting
+} // namespace
+
+ChunkedInserter::~ChunkedInserter()
+{
+    m_idle.disconnect();
+    if (m_buffer && m_mark)
+        m_buffer->delete_mark(m_mark);
+}
+
+std::size_t ChunkedInserter::cut(std::string_view text, std::size_t max)
+{
+    if (text.size() <= max)
+        return text.size();
+
+    auto nl = text.substr(0, max).rfind('\n');
+    if (nl != std::string_view::npos)
+        return nl + 1;
+
+    // No line break: back off to the start of a UTF-8 sequence.
+    std::size_t n = max;
+    while (n > 0 && (static_cast<unsigned char>(text[n]) & 0xC0) == 0x80)
+        --n;
+    return n;
+}
+
+void ChunkedInserter::start(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const Gtk::TextBuffer::iterator &pos,
+                            std::shared_ptr<const void> owner, std::string_view text,
+                            std::size_t first_chunk, ProgressFn on_progress, DoneFn on_done, bool undoable)
+{
+    cancel();
+
+    m_buffer = buffer;
+    m_owner = std::move(owner);
+    m_text = text;
+    m_done = 0;
+    m_error_offset = 0;
+    m_invalid = false;
+    m_undoable = undoable;
+    m_on_progress = std::move(on_progress);
+    m_on_done = std::move(on_done);
+
+    // Right gravity: the mark stays after each slice we insert.
+    m_mark = m_buffer->create_mark(pos, /*left_gravity=*/false);
+
+    if (first_chunk > 0 && !insert_slice(first_chunk))
+    {
+        finish(false);
+        return;
+    }
+
+    if (m_done == m_text.size())
+    {
+        finish(true);
+        return;
+    }
+
+    m_idle = Glib::signal_idle().connect(sigc::mem_fun(*this, &ChunkedInserter::on_idle));
+}
+
+void ChunkedInserter::cancel()
+{
+    if (running())
+        finish(false);
+}
+
+bool ChunkedInserter::insert_slice(std::size_t max)
+{
+    TRACE_SCOPE("insert.slice");
+
+    auto rest = m_text.substr(m_done);
+    auto n = cut(rest, max);
+
+    const gchar *bad = nullptr;
+    const bool valid = g_utf8_validate(rest.data(), static_cast<gssize>(n), &bad);
+    if (!valid)
+        n = static_cast<std::size_t>(bad - rest.data());
+
+    if (n > 0)
+    {
+        // Loading is not an edit the user should be able to undo.
+        if (!m_undoable)
+            m_buffer->begin_irreversible_action();
+        m_buffer->insert(m_buffer->get_iter_at_mark(m_mark), rest.data(), rest.data() + n);
+        if (!m_undoable)
+            m_buffer->end_irreversible_action();
+        m_done += n;
+    }
+
+    if (m_on_progress)
+        m_on_progress(m_done, m_text.size());
+
+    if (!valid)
+    {
+        m_error_offset = m_done;
+        m_invalid = true;
+        return false;
+    }
+    return true;
+}
+
+bool ChunkedInserter::on_idle()
+{
+    const gint64 deadline = g_get_monotonic_time() + kStepBudgetUs;
+    do
+    {
+        if (!insert_slice(kSliceBytes))
+        {
+            finish(false);
+            return false;
+        }
+        if (m_done == m_text.size())
+        {
+            finish(true);
+            return false;
+        }
+    } while (g_get_monotonic_time() < deadline);
+
+    return true;
+}
+
+void ChunkedInserter::finish(bool complete)
+{
+    m_idle.disconnect();
+    if (m_mark)
+    {
+        m_buffer->delete_mark(m_mark);
+        m_mark.reset();
+    }
+
+    // The callback may start another run on this inserter.
+    auto done = std::move(m_on_done);
+    m_on_done = nullptr;
+    m_on_progress = nullptr;
+    m_owner.reset();
+
+    if (done)
+        done(complete);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+// Streams a large UTF-8 text into a Gtk::TextBuffer a slice at a time from
+// idle callbacks, so the window keeps painting while a big file or paste
+// goes in. The first slice can be inserted synchronously, which puts the
+// first screenful on screen before the rest has been touched.
+//
+// `owner` keeps the bytes behind `text` alive (a MappedFile, a std::string…).
+class ChunkedInserter
+{
+public:
+  using ProgressFn = std::function<void(std::size_t inserted, std::size_t total)>;
+  // `complete` is false when cancelled or stopped at invalid UTF-8 (see invalid_utf8()).
+  using DoneFn = std::function<void(bool complete)>;
+
+  ChunkedInserter() = default;
+  ~ChunkedInserter();
+
+  ChunkedInserter(const ChunkedInserter &) = delete;
+  ChunkedInserter &operator=(const ChunkedInserter &) = delete;
+
+  // Inserts at `pos`; up to `first_chunk` bytes go in before this returns.
+  // Loads are irreversible; an `undoable` run (a paste) adds to the undo
+  // history, inside whatever user action the caller has open.
+  void start(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const Gtk::TextBuffer::iterator &pos,
+             std::shared_ptr<const void> owner, std::string_view text,
+             std::size_t first_chunk, ProgressFn on_progress, DoneFn on_done, bool undoable = false);
+
+  void cancel();
+
+  bool running() const { return m_idle.connected(); }
+  std::size_t inserted() const { return m_done; }
+  std::size_t total() const { return m_text.size(); }
+  // Set when the run stopped at a byte that is not valid UTF-8 (at error_offset()).
+  bool invalid_utf8() const { return m_invalid; }
+  std::size_t error_offset() const { return m_error_offset; }
+
+  // Largest prefix of `text` of at most `max` bytes that ends on a line
+  // break when possible and never splits a UTF-8 sequence.
+  static std::size_t cut(std::string_view text, std::size_t max);
+
+private:
+  Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+  Glib::RefPtr<Gtk::TextBuffer::Mark> m_mark;
+  std::shared_ptr<const void> m_owner;
+  std::string_view m_text;
+  std::size_t m_done = 0;
+  std::size_t m_error_offset = 0;
+  bool m_invalid = false;
+  bool m_undoable = false;
+  ProgressFn m_on_progress;
+  DoneFn m_on_done;
+  sigc::connection m_idle;
+
+  bool insert_slice(std::size_t max);
+  bool on_idle();
+  void finish(bool complete);
+};
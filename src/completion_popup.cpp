@@ -0,0 +1,60 @@
+#include "completion_popup.hpp"
+
+CompletionPopup::CompletionPopup()
+{
+    set_autohide(false);
+    set_has_arrow(false);
+    set_can_focus(false);
+    set_position(Gtk::PositionType::BOTTOM);
+
+    m_list.set_selection_mode(Gtk::SelectionMode::BROWSE);
+    m_list.set_activate_on_single_click(true);
+    m_list.set_can_focus(false);
+    m_list.signal_row_activated().connect([this](Gtk::ListBoxRow *row)
+                                          {
+        const auto i = static_cast<std::size_t>(row->get_index());
+        if (i < m_words.size())
+            m_chosen.emit(m_words[i]); });
+    set_child(m_list);
+}
+
+void CompletionPopup::show_words(const std::vector<std::string> &words, const Gdk::Rectangle &at)
+{
+    m_words = words;
+    if (m_words.empty())
+    {
+        popdown();
+        return;
+    }
+    while (auto *row = m_list.get_row_at_index(0))
+        m_list.remove(*row);
+    for (const auto &w : m_words)
+    {
+        auto label = Gtk::make_managed<Gtk::Label>(w);
+        label->set_halign(Gtk::Align::START);
+        label->add_css_class("monospace");
+        m_list.append(*label);
+    }
+    m_list.select_row(*m_list.get_row_at_index(0));
+
+    set_pointing_to(at);
+    popup();
+}
+
+void CompletionPopup::move_selection(int delta)
+{
+    if (m_words.empty())
+        return;
+    const int n = static_cast<int>(m_words.size());
+    const auto *row = m_list.get_selected_row();
+    const int i = ((row ? row->get_index() : 0) + delta + n) % n;
+    m_list.select_row(*m_list.get_row_at_index(i));
+}
+
+std::string CompletionPopup::selected() const
+{
+    const auto *row = m_list.get_selected_row();
+    if (!row || static_cast<std::size_t>(row->get_index()) >= m_words.size())
+        return {};
+    return m_words[static_cast<std::size_t>(row->get_index())];
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <string>
+#include <vector>
+
+// Word completion list shown under the cursor of a text view.
+//
+// It never takes focus: the view keeps receiving keys and its owner calls
+// move_selection()/selected() for Up/Down and Tab/Enter. Clicking a row
+// also chooses it.
+class CompletionPopup : public Gtk::Popover
+{
+public:
+  CompletionPopup();
+
+  // Shows `words` pointing at `at` (widget coordinates of the parent).
+  void show_words(const std::vector<std::string> &words, const Gdk::Rectangle &at);
+
+  void move_selection(int delta);
+  std::string selected() const;
+
+  sigc::signal<void(std::string)> &signal_chosen() { return m_chosen; }
+
+private:
+  Gtk::ListBox m_list;
+  std::vector<std::string> m_words;
+
+  sigc::signal<void(std::string)> m_chosen;
+};
@@ -0,0 +1,122 @@
+#include "content_hash.hpp"
+
+#include <bit>
+#include <cstring>
+
+namespace
+{
+constexpr std::uint64_t kPrime1 = 11400714785074694791ULL;
+constexpr std::uint64_t kPrime2 = 14029467366897019727ULL;
+constexpr std::uint64_t kPrime3 = 1609587929392839161ULL;
+constexpr std::uint64_t kPrime4 = 9650029242287828579ULL;
+constexpr std::uint64_t kPrime5 = 2870177450012600261ULL;
+
+// Bytes of each sample taken by fingerprint().
+constexpr std::size_t kSampleBytes = 64 * 1024;
+
+// Unaligned little-endian loads (the mapping may start anywhere).
+std::uint64_t read64(const unsigned char *p)
+{
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof v);
+    if constexpr (std::endian::native == std::endian::big)
+        v = std::byteswap(v);
+    return v;
+}
+
+std::uint32_t read32(const unsigned char *p)
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof v);
+    if constexpr (std::endian::native == std::endian::big)
+        v = std::byteswap(v);
+    return v;
+}
+
+std::uint64_t round(std::uint64_t acc, std::uint64_t input)
+{
+    acc += input * kPrime2;
+    acc = std::rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+std::uint64_t merge_round(std::uint64_t acc, std::uint64_t val)
+{
+    acc ^= round(0, val);
+    return acc * kPrime1 + kPrime4;
+}
+} // namespace
+
+namespace content_hash
+{
+std::uint64_t xxh64(std::string_view data, std::uint64_t seed)
+{
+    const auto *p = reinterpret_cast<const unsigned char *>(data.data());
+    const auto *const end = p + data.size();
+    std::uint64_t h;
+
+    if (data.size() >= 32)
+    {
+        // Four independent lanes over 32-byte stripes.
+        std::uint64_t v1 = seed + kPrime1 + kPrime2;
+        std::uint64_t v2 = seed + kPrime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - kPrime1;
+        const auto *const limit = end - 32;
+        do
+        {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    }
+    else
+    {
+        h = seed + kPrime5;
+    }
+
+    h += static_cast<std::uint64_t>(data.size());
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= round(0, read64(p));
+        h = std::rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end)
+    {
+        h ^= static_cast<std::uint64_t>(read32(p)) * kPrime1;
+        h = std::rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        h ^= (*p) * kPrime5;
+        h = std::rotl(h, 11) * kPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+std::uint64_t fingerprint(std::string_view data)
+{
+    if (data.size() <= 3 * kSampleBytes)
+        return xxh64(data, data.size());
+
+    std::uint64_t h = xxh64(data.substr(0, kSampleBytes), data.size());
+    h = xxh64(data.substr(data.size() / 2 - kSampleBytes / 2, kSampleBytes), h);
+    return xxh64(data.substr(data.size() - kSampleBytes), h);
+}
+} // namespace content_hash
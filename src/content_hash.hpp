@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Content hashing for caches and change detection.
+namespace content_hash
+{
+// XXH64 (xxHash, 64-bit). Several GB/s per core; not cryptographic.
+std::uint64_t xxh64(std::string_view data, std::uint64_t seed = 0);
+
+// Cheap identity of a large file: its size and XXH64 of its first, middle
+// and last 64 KiB. Together with size and mtime it tells whether a file is
+// the one seen before without reading all of it.
+std::uint64_t fingerprint(std::string_view data);
+} // namespace content_hash
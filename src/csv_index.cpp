@@ -0,0 +1,259 @@
+#include "csv_index.hpp"
+
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <map>
+
+namespace
+{
+constexpr std::size_t kChunkBytes = 4 * 1024 * 1024;
+constexpr int kDetectLines = 50;
+
+struct Chunk
+{
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  bool starts_quoted = false;
+  std::vector<std::uint64_t> row_start;
+  std::vector<std::uint32_t> field_count;
+  std::vector<std::uint32_t> field_ends;
+};
+
+// Parses the row at `pos`, appending its field ends (relative to `pos`).
+// Returns the offset of the next row.
+std::size_t parse_row(std::string_view text, std::size_t pos, const CsvDialect &d,
+                      std::vector<std::uint32_t> &ends)
+{
+    const std::size_t n = text.size();
+    bool quoted = false;
+    std::size_t i = pos;
+    while (i < n)
+    {
+        const char c = text[i];
+        if (quoted)
+        {
+            if (c == d.quote)
+            {
+                if (i + 1 < n && text[i + 1] == d.quote)
+                {
+                    i += 2;
+                    continue;
+                }
+                quoted = false;
+            }
+        }
+        else if (c == d.delimiter)
+        {
+            ends.push_back(static_cast<std::uint32_t>(i - pos));
+        }
+        else if (c == '\n')
+        {
+            std::size_t end = i;
+            if (end > pos && text[end - 1] == '\r')
+                --end;
+            ends.push_back(static_cast<std::uint32_t>(end - pos));
+            return i + 1;
+        }
+        else if (c == d.quote && d.quote != '\0')
+        {
+            quoted = true;
+        }
+        ++i;
+    }
+    std::size_t end = n;
+    if (end > pos && text[end - 1] == '\r')
+        --end;
+    ends.push_back(static_cast<std::uint32_t>(end - pos));
+    return n;
+}
+
+// First row start at or after `begin`, given the quote state at `begin`.
+std::size_t first_row_at(std::string_view text, std::size_t begin, bool quoted, char quote)
+{
+    if (begin == 0)
+        return 0;
+    if (!quoted && text[begin - 1] == '\n')
+        return begin;
+    for (std::size_t i = begin; i < text.size(); ++i)
+    {
+        if (text[i] == quote && quote != '\0')
+            quoted = !quoted;
+        else if (text[i] == '\n' && !quoted)
+            return i + 1;
+    }
+    return text.size();
+}
+} // namespace
+
+CsvDialect CsvIndex::detect(std::string_view sample)
+{
+    CsvDialect best;
+    best.quote = sample.find('"') != std::string_view::npos ? '"' : '\0';
+
+    // Drop a trailing partial line.
+    const auto last_nl = sample.rfind('\n');
+    if (last_nl != std::string_view::npos)
+        sample = sample.substr(0, last_nl + 1);
+
+    int best_score = 0;
+    for (const char delim : {',', '\t', ';', '|'})
+    {
+        CsvDialect d{delim, best.quote};
+        std::map<std::size_t, int> counts;
+        std::vector<std::uint32_t> ends;
+        std::size_t pos = 0;
+        for (int line = 0; line < kDetectLines && pos < sample.size(); ++line)
+        {
+            ends.clear();
+            pos = parse_row(sample, pos, d, ends);
+            if (ends.size() > 1)
+                ++counts[ends.size()];
+        }
+        // Lines agreeing on the most common field count.
+        int score = 0;
+        for (const auto &[fields, lines] : counts)
+            score = std::max(score, lines);
+        if (score > best_score)
+        {
+            best_score = score;
+            best.delimiter = delim;
+        }
+    }
+    return best;
+}
+
+void CsvIndex::clear()
+{
+    m_row_start.clear();
+    m_row_start.shrink_to_fit();
+    m_row_fields.clear();
+    m_row_fields.shrink_to_fit();
+    m_field_ends.clear();
+    m_field_ends.shrink_to_fit();
+    m_max_fields = 0;
+}
+
+bool CsvIndex::build(std::string_view text, const CsvDialect &dialect, const std::atomic<bool> *cancel,
+                     std::atomic<double> *progress)
+{
+    TRACE_SCOPE("csv_index.build");
+    clear();
+    m_dialect = dialect;
+
+    std::vector<Chunk> chunks((text.size() + kChunkBytes - 1) / kChunkBytes);
+    for (std::size_t i = 0; i < chunks.size(); ++i)
+    {
+        chunks[i].begin = i * kChunkBytes;
+        chunks[i].end = std::min(text.size(), chunks[i].begin + kChunkBytes);
+    }
+
+    // Pass 1: quote parity of every chunk, so each knows its start state.
+    // Doubled quotes toggle twice and cancel out.
+    if (dialect.quote != '\0')
+    {
+        std::vector<std::size_t> quotes(chunks.size());
+        parallel_for(chunks.size(), [&](std::size_t i)
+                     { quotes[i] = static_cast<std::size_t>(std::count(text.begin() + static_cast<std::ptrdiff_t>(chunks[i].begin),
+                                                                       text.begin() + static_cast<std::ptrdiff_t>(chunks[i].end),
+                                                                       dialect.quote)); });
+        bool quoted = false;
+        for (std::size_t i = 0; i < chunks.size(); ++i)
+        {
+            chunks[i].starts_quoted = quoted;
+            quoted ^= (quotes[i] & 1) != 0;
+        }
+    }
+
+    // Pass 2: every chunk parses the rows that start inside it (the last
+    // one may run on past its end).
+    std::atomic<std::size_t> done{0};
+    parallel_for(chunks.size(), [&](std::size_t i)
+                 {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return;
+        auto &c = chunks[i];
+        std::size_t pos = first_row_at(text, c.begin, c.starts_quoted, dialect.quote);
+        while (pos < c.end)
+        {
+            const auto before = c.field_ends.size();
+            c.row_start.push_back(pos);
+            pos = parse_row(text, pos, dialect, c.field_ends);
+            c.field_count.push_back(static_cast<std::uint32_t>(c.field_ends.size() - before));
+        }
+        const auto n = done.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (progress)
+            progress->store(static_cast<double>(n) / static_cast<double>(chunks.size()), std::memory_order_relaxed); });
+
+    if (cancel && cancel->load(std::memory_order_relaxed))
+    {
+        clear();
+        return false;
+    }
+
+    std::size_t rows = 0, fields = 0;
+    for (const auto &c : chunks)
+    {
+        rows += c.row_start.size();
+        fields += c.field_ends.size();
+    }
+    m_row_start.reserve(rows);
+    m_row_fields.reserve(rows + 1);
+    m_field_ends.reserve(fields);
+
+    m_row_fields.push_back(0);
+    for (auto &c : chunks)
+    {
+        m_row_start.insert(m_row_start.end(), c.row_start.begin(), c.row_start.end());
+        m_field_ends.insert(m_field_ends.end(), c.field_ends.begin(), c.field_ends.end());
+        for (const auto count : c.field_count)
+        {
+            m_row_fields.push_back(m_row_fields.back() + count);
+            m_max_fields = std::max<std::size_t>(m_max_fields, count);
+        }
+        c = Chunk{};
+    }
+    return true;
+}
+
+std::string_view CsvIndex::field(std::string_view text, std::size_t row, std::size_t col) const
+{
+    if (col >= field_count(row))
+        return {};
+
+    const auto first = m_row_fields[row];
+    const std::size_t begin = col == 0 ? 0 : m_field_ends[first + col - 1] + 1;
+    const std::size_t end = m_field_ends[first + col];
+    auto raw = text.substr(static_cast<std::size_t>(m_row_start[row]) + begin, end - begin);
+
+    if (m_dialect.quote != '\0' && raw.size() >= 2 && raw.front() == m_dialect.quote &&
+        raw.back() == m_dialect.quote)
+        raw = raw.substr(1, raw.size() - 2);
+    return raw;
+}
+
+std::string CsvIndex::display(std::string_view text, std::size_t row, std::size_t col) const
+{
+    const auto raw = field(text, row, col);
+    std::string out;
+    out.reserve(raw.size());
+    for (std::size_t i = 0; i < raw.size(); ++i)
+    {
+        const char c = raw[i];
+        if (c == m_dialect.quote && m_dialect.quote != '\0' && i + 1 < raw.size() && raw[i + 1] == m_dialect.quote)
+        {
+            out.push_back(c);
+            ++i;
+        }
+        else if (c == '\n' || c == '\r' || c == '\t')
+        {
+            out.push_back(' ');
+        }
+        else
+        {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct CsvDialect
+{
+  char delimiter = ',';
+  char quote = '"'; // '\0' when the sample had no quotes
+};
+
+// Field-offset index of delimited text (CSV, TSV, …).
+//
+// Per row it keeps the row's byte offset and where its fields start in a
+// shared array; per field one 32-bit end offset relative to the row. No
+// field is ever copied: callers read them out of the text on demand, so
+// memory is bounded by the offsets, not by a materialised table.
+//
+// Quoted fields may contain delimiters, doubled quotes and line breaks.
+class CsvIndex
+{
+public:
+  // Picks the delimiter (, tab ; |) that splits the sample's lines into the
+  // most consistent number of fields.
+  static CsvDialect detect(std::string_view sample);
+
+  void clear();
+
+  // Indexes `text` on all cores: chunks are scanned in parallel after a
+  // quote-parity pass tells each chunk whether it starts inside a quoted
+  // field. Returns false if cancelled.
+  bool build(std::string_view text, const CsvDialect &dialect, const std::atomic<bool> *cancel = nullptr,
+             std::atomic<double> *progress = nullptr);
+
+  const CsvDialect &dialect() const { return m_dialect; }
+  std::size_t row_count() const { return m_row_start.size(); }
+  std::size_t max_fields() const { return m_max_fields; }
+  std::uint64_t row_offset(std::size_t row) const { return m_row_start[row]; }
+
+  std::size_t field_count(std::size_t row) const
+  {
+    return static_cast<std::size_t>(m_row_fields[row + 1] - m_row_fields[row]);
+  }
+
+  // Field as it appears in `text` (the text build() ran over), without its
+  // enclosing quotes; doubled quotes are left as they are. Empty if the row
+  // has fewer fields.
+  std::string_view field(std::string_view text, std::size_t row, std::size_t col) const;
+
+  // Field for display: doubled quotes undone, line breaks and tabs as spaces.
+  std::string display(std::string_view text, std::size_t row, std::size_t col) const;
+
+  std::size_t bytes() const
+  {
+    return m_row_start.capacity() * sizeof(std::uint64_t) + m_row_fields.capacity() * sizeof(std::uint64_t) +
+           m_field_ends.capacity() * sizeof(std::uint32_t);
+  }
+
+private:
+  CsvDialect m_dialect;
+  std::vector<std::uint64_t> m_row_start;  // byte offset of each row
+  std::vector<std::uint64_t> m_row_fields; // first entry in m_field_ends per row; rows + 1 entries
+  std::vector<std::uint32_t> m_field_ends; // end of each field, relative to its row
+  std::size_t m_max_fields = 0;
+};
@@ -0,0 +1,407 @@
+#include "csv_panel.hpp"
+
+#include "parallel.hpp"
+#include "search_engine.hpp"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <charconv>
+
+namespace
+{
+// Dialect detection looks at this much of the text.
+constexpr std::size_t kSampleBytes = 64 * 1024;
+// Column widths come from the header and this many rows.
+constexpr std::size_t kWidthSampleRows = 1000;
+constexpr int kMinColumnChars = 3;
+constexpr int kMaxColumnChars = 40;
+constexpr int kColumnGap = 2;
+// View rows per parallel search job.
+constexpr std::size_t kRowsPerJob = 1 << 15;
+
+// Whole field as a number (blanks around it allowed).
+bool parse_number(std::string_view s, double &out)
+{
+    while (!s.empty() && s.front() == ' ')
+        s.remove_prefix(1);
+    while (!s.empty() && s.back() == ' ')
+        s.remove_suffix(1);
+    if (!s.empty() && s.front() == '+')
+        s.remove_prefix(1);
+    if (s.empty())
+        return false;
+    const auto res = std::from_chars(s.data(), s.data() + s.size(), out);
+    return res.ec == std::errc() && res.ptr == s.data() + s.size();
+}
+
+int display_chars(const std::string &s)
+{
+    return static_cast<int>(g_utf8_strlen(s.data(), static_cast<gssize>(s.size())));
+}
+
+// At most `chars` characters, with an ellipsis when cut.
+std::string fit(const std::string &s, int chars)
+{
+    if (display_chars(s) <= chars)
+        return s;
+    const char *end = g_utf8_offset_to_pointer(s.data(), std::max(0, chars - 1));
+    return std::string(s.data(), end) + "…";
+}
+
+std::string dialect_name(const CsvDialect &d)
+{
+    std::string name = d.delimiter == '\t' ? "tab" : std::string(1, d.delimiter);
+    return "Delimiter: " + name + (d.quote ? ", quoted" : "");
+}
+} // namespace
+
+CsvPanel::CsvPanel() : Gtk::Box(Gtk::Orientation::VERTICAL)
+{
+    set_spacing(6);
+
+    m_columns = Gtk::StringList::create({});
+    m_column.set_model(m_columns);
+
+    m_bar.set_spacing(6);
+    m_find.set_placeholder_text("Find in column");
+    m_find.set_hexpand(true);
+    m_bar.append(m_dialect);
+    m_bar.append(m_column);
+    m_bar.append(m_sort_up);
+    m_bar.append(m_sort_down);
+    m_bar.append(m_unsort);
+    m_bar.append(m_find);
+    m_bar.append(m_find_next);
+
+    m_grid.set_vexpand(true);
+    m_status.set_halign(Gtk::Align::START);
+
+    append(m_bar);
+    append(m_grid);
+    append(m_status);
+
+    m_sort_up.signal_clicked().connect([this]()
+                                       { on_sort(true); });
+    m_sort_down.signal_clicked().connect([this]()
+                                         { on_sort(false); });
+    m_unsort.signal_clicked().connect(sigc::mem_fun(*this, &CsvPanel::on_unsort));
+    m_find_next.signal_clicked().connect(sigc::mem_fun(*this, &CsvPanel::on_find));
+    m_find.signal_activate().connect(sigc::mem_fun(*this, &CsvPanel::on_find));
+    m_find.signal_changed().connect([this]()
+                                    { m_matches.clear(); });
+    m_column.property_selected().signal_changed().connect([this]()
+                                                          { m_matches.clear(); });
+
+    set_busy(false);
+}
+
+CsvPanel::~CsvPanel()
+{
+    m_task.stop();
+}
+
+std::size_t CsvPanel::bytes() const
+{
+    return m_index.bytes() + m_order.capacity() * sizeof(std::uint32_t) +
+           m_matches.capacity() * sizeof(std::uint32_t);
+}
+
+void CsvPanel::clear()
+{
+    m_task.stop();
+    m_snapshot = {};
+    m_index.clear();
+    m_order = {};
+    m_matches = {};
+    m_grid.highlight = SIZE_MAX;
+    m_grid.set_row_count(0);
+    m_columns->splice(0, m_columns->get_n_items(), {});
+    set_busy(false);
+    set_status("");
+}
+
+void CsvPanel::set_busy(bool busy)
+{
+    const bool ready = !busy && m_index.row_count() > 0;
+    m_column.set_sensitive(ready);
+    m_sort_up.set_sensitive(ready);
+    m_sort_down.set_sensitive(ready);
+    m_unsort.set_sensitive(ready && !m_order.empty());
+    m_find_next.set_sensitive(ready);
+}
+
+void CsvPanel::set_snapshot(TextSnapshot snapshot)
+{
+    clear();
+    m_snapshot = std::move(snapshot);
+    m_stale = false;
+
+    const auto dialect = CsvIndex::detect(m_snapshot.text.substr(0, kSampleBytes));
+    m_dialect.set_text(dialect_name(dialect));
+    set_status("Indexing…");
+    set_busy(true);
+
+    // Built aside and moved in when done: the grid keeps drawing meanwhile.
+    auto text = m_snapshot.text;
+    auto index = std::make_shared<CsvIndex>();
+    m_task.start([text, dialect, index](BackgroundTask::Control &control)
+                 { index->build(text, dialect, &control.cancel, &control.progress); },
+                 [this, index](bool cancelled)
+                 {
+                     if (cancelled)
+                     {
+                         set_busy(false);
+                         set_status("Indexing cancelled.");
+                         return;
+                     }
+                     m_index = std::move(*index);
+                     on_indexed();
+                 });
+}
+
+void CsvPanel::on_indexed()
+{
+    std::vector<Glib::ustring> names;
+    for (std::size_t c = 0; c < m_index.max_fields(); ++c)
+    {
+        auto name = m_index.row_count() > 0 ? m_index.display(m_snapshot.text, 0, c) : std::string();
+        names.push_back(name.empty() ? "Column " + std::to_string(c + 1) : name);
+    }
+    m_columns->splice(0, m_columns->get_n_items(), names);
+
+    m_grid.layout_columns();
+    m_grid.set_row_count(data_rows());
+    m_grid.scroll_to_row(0);
+    set_busy(false);
+    set_status(std::to_string(data_rows()) + " rows, " + std::to_string(m_index.max_fields()) + " columns.");
+}
+
+void CsvPanel::on_sort(bool ascending)
+{
+    if (m_task.running())
+        return;
+
+    const std::size_t col = m_column.get_selected();
+    struct Key
+    {
+        double number = 0.0;
+        bool is_number = false;
+        std::string_view text;
+        std::uint32_t row = 0;
+    };
+    auto order = std::make_shared<std::vector<std::uint32_t>>();
+
+    set_busy(true);
+    set_status("Sorting…");
+    m_task.start(
+        [this, col, ascending, order](BackgroundTask::Control &control)
+        {
+            // Keys straight from the index; numbers sort before text.
+            const std::size_t n = data_rows();
+            std::vector<Key> keys(n);
+            parallel_for((n + kRowsPerJob - 1) / kRowsPerJob, [&](std::size_t job)
+                         {
+                const std::size_t end = std::min(n, (job + 1) * kRowsPerJob);
+                for (std::size_t i = job * kRowsPerJob; i < end; ++i)
+                {
+                    auto &k = keys[i];
+                    k.row = static_cast<std::uint32_t>(i + 1);
+                    k.text = m_index.field(m_snapshot.text, i + 1, col);
+                    k.is_number = parse_number(k.text, k.number);
+                } });
+
+            auto less = [](const Key &a, const Key &b)
+            {
+                if (a.is_number != b.is_number)
+                    return a.is_number;
+                if (a.is_number && a.number != b.number)
+                    return a.number < b.number;
+                return a.text < b.text;
+            };
+            const bool ok = ascending ? parallel_stable_sort(keys, less, &control.cancel, &control.progress)
+                                      : parallel_stable_sort(keys, [&](const Key &a, const Key &b)
+                                                             { return less(b, a); },
+                                                             &control.cancel, &control.progress);
+            if (!ok)
+                return;
+
+            order->resize(n);
+            for (std::size_t i = 0; i < n; ++i)
+                (*order)[i] = keys[i].row;
+        },
+        [this, order, ascending](bool cancelled)
+        {
+            set_busy(false);
+            if (cancelled)
+            {
+                set_status("Sort cancelled.");
+                return;
+            }
+            m_order = std::move(*order);
+            m_matches.clear();
+            m_grid.highlight = SIZE_MAX;
+            m_grid.scroll_to_row(0);
+            m_grid.redraw();
+            set_busy(false);
+            set_status(std::string("Sorted ") + (ascending ? "ascending" : "descending") + " (view only).");
+        });
+}
+
+void CsvPanel::on_unsort()
+{
+    m_order = {};
+    m_matches.clear();
+    m_grid.highlight = SIZE_MAX;
+    m_grid.redraw();
+    set_busy(false);
+    set_status("File order.");
+}
+
+void CsvPanel::on_find()
+{
+    if (m_task.running())
+        return;
+    if (!m_matches.empty())
+    {
+        m_match_cursor = (m_match_cursor + 1) % m_matches.size();
+        show_match();
+        return;
+    }
+
+    const auto term = m_find.get_text();
+    if (term.empty())
+        return;
+    auto engine = std::make_shared<SearchEngine>(term.raw(), SearchOptions{});
+    if (!engine->valid())
+    {
+        set_status("Invalid pattern: " + engine->error());
+        return;
+    }
+
+    const std::size_t col = m_column.get_selected();
+    auto matches = std::make_shared<std::vector<std::uint32_t>>();
+
+    set_busy(true);
+    set_status("Searching…");
+    m_task.start(
+        [this, col, engine, matches](BackgroundTask::Control &control)
+        {
+            const std::size_t n = data_rows();
+            const std::size_t jobs = (n + kRowsPerJob - 1) / kRowsPerJob;
+            std::vector<std::vector<std::uint32_t>> found(jobs);
+            parallel_for(jobs, [&](std::size_t job)
+                         {
+                if (control.cancel.load(std::memory_order_relaxed))
+                    return;
+                const std::size_t end = std::min(n, (job + 1) * kRowsPerJob);
+                SearchMatch m;
+                for (std::size_t v = job * kRowsPerJob; v < end; ++v)
+                {
+                    if (engine->find(m_index.field(m_snapshot.text, index_row(v), col), 0, m))
+                        found[job].push_back(static_cast<std::uint32_t>(v));
+                } });
+            for (auto &f : found)
+                matches->insert(matches->end(), f.begin(), f.end());
+        },
+        [this, matches](bool cancelled)
+        {
+            set_busy(false);
+            if (cancelled)
+            {
+                set_status("Search cancelled.");
+                return;
+            }
+            m_matches = std::move(*matches);
+            m_match_cursor = 0;
+            if (m_matches.empty())
+            {
+                m_grid.highlight = SIZE_MAX;
+                m_grid.redraw();
+                set_status("Not found in this column.");
+                return;
+            }
+            show_match();
+        });
+}
+
+void CsvPanel::show_match()
+{
+    const std::size_t row = m_matches[m_match_cursor];
+    m_grid.highlight = row;
+    m_grid.scroll_to_row(row > 2 ? row - 2 : 0);
+    m_grid.redraw();
+    set_status("Match " + std::to_string(m_match_cursor + 1) + " of " + std::to_string(m_matches.size()) +
+               " (row " + std::to_string(index_row(row)) + ").");
+}
+
+void CsvPanel::Grid::layout_columns()
+{
+    const auto &index = m_panel.m_index;
+    const auto text = m_panel.m_snapshot.text;
+
+    m_col_chars.assign(index.max_fields(), kMinColumnChars);
+    const std::size_t sample = std::min(index.row_count(), kWidthSampleRows + 1);
+    for (std::size_t r = 0; r < sample; ++r)
+    {
+        for (std::size_t c = 0; c < index.field_count(r); ++c)
+            m_col_chars[c] = std::max(m_col_chars[c], std::min(kMaxColumnChars, display_chars(index.display(text, r, c))));
+    }
+
+    m_gutter_chars = static_cast<int>(std::to_string(index.row_count()).size());
+    m_col_x.resize(m_col_chars.size());
+    int x = m_gutter_chars + kColumnGap;
+    for (std::size_t c = 0; c < m_col_chars.size(); ++c)
+    {
+        m_col_x[c] = x;
+        x += m_col_chars[c] + kColumnGap;
+    }
+    set_content_width(x * char_width() + 8.0);
+}
+
+void CsvPanel::Grid::draw_cells(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                                std::size_t index_row, const std::string &gutter, double y, int width)
+{
+    const auto &index = m_panel.m_index;
+    const auto text = m_panel.m_snapshot.text;
+    const double cw = char_width();
+    const double left = h_offset();
+
+    layout->set_text(gutter);
+    cr->move_to(4.0, y);
+    layout->show_in_cairo_context(cr);
+
+    for (std::size_t c = 0; c < index.field_count(index_row) && c < m_col_x.size(); ++c)
+    {
+        const double x = 4.0 + m_col_x[c] * cw;
+        if (x + m_col_chars[c] * cw < left || x > left + width)
+            continue;
+        layout->set_text(fit(index.display(text, index_row, c), m_col_chars[c]));
+        cr->move_to(x, y);
+        layout->show_in_cairo_context(cr);
+    }
+}
+
+void CsvPanel::Grid::draw_row(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                              std::size_t row, double y, int width)
+{
+    if (row == highlight)
+    {
+        cr->save();
+        cr->set_source_rgba(1.0, 0.85, 0.0, 0.35);
+        cr->rectangle(h_offset(), y, width, row_height());
+        cr->fill();
+        cr->restore();
+    }
+
+    const std::size_t index_row = m_panel.index_row(row);
+    auto gutter = std::to_string(index_row);
+    gutter.insert(0, static_cast<std::size_t>(std::max(0, m_gutter_chars - static_cast<int>(gutter.size()))), ' ');
+    draw_cells(cr, layout, index_row, gutter, y, width);
+}
+
+void CsvPanel::Grid::draw_header(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                                 int width)
+{
+    draw_cells(cr, layout, 0, std::string(static_cast<std::size_t>(m_gutter_chars), ' '), 0.0, width);
+}
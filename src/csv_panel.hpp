@@ -0,0 +1,99 @@
+#pragma once
+
+#include "background_task.hpp"
+#include "csv_index.hpp"
+#include "text_snapshot.hpp"
+#include "virtual_row_view.hpp"
+
+#include <gtkmm.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Column view of delimited text. The dialect is detected from a sample and
+// a CsvIndex is built on a worker thread; the grid then formats only the
+// rows on screen, straight out of the snapshot. The first row is taken as
+// the header.
+//
+// Sorting by a column and searching within a column work on the index (no
+// re-parsing). A sort only reorders the view: the document is unchanged.
+class CsvPanel : public Gtk::Box
+{
+public:
+  CsvPanel();
+  ~CsvPanel() override;
+
+  // Starts indexing `snapshot`; the grid fills in when it is done.
+  void set_snapshot(TextSnapshot snapshot);
+  bool has_snapshot() const { return static_cast<bool>(m_snapshot.owner); }
+
+  // The document changed; the next set_snapshot() rebuilds.
+  void set_stale() { m_stale = true; }
+  bool stale() const { return m_stale; }
+
+  void clear();
+  std::size_t bytes() const;
+
+private:
+  class Grid : public VirtualRowView
+  {
+  public:
+    explicit Grid(CsvPanel &panel) : m_panel(panel) {}
+
+    // Recomputes column widths from the header and the first rows.
+    void layout_columns();
+    std::size_t highlight = SIZE_MAX; // view row of the current match
+
+  protected:
+    void draw_row(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                  std::size_t row, double y, int width) override;
+    bool has_header() const override { return m_panel.m_index.row_count() > 0; }
+    void draw_header(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                     int width) override;
+
+  private:
+    CsvPanel &m_panel;
+    std::vector<int> m_col_x;     // start column, in characters
+    std::vector<int> m_col_chars; // width, in characters
+    int m_gutter_chars = 0;
+
+    void draw_cells(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                    std::size_t index_row, const std::string &gutter, double y, int width);
+  };
+
+  // Data
+  TextSnapshot m_snapshot;
+  CsvIndex m_index;
+  std::vector<std::uint32_t> m_order;   // view row -> index row; empty = file order
+  std::vector<std::uint32_t> m_matches; // view rows matching the column search
+  std::size_t m_match_cursor = 0;
+  bool m_stale = false;
+  BackgroundTask m_task;
+
+  // UI
+  Gtk::Box m_bar{Gtk::Orientation::HORIZONTAL};
+  Gtk::Label m_dialect;
+  Glib::RefPtr<Gtk::StringList> m_columns;
+  Gtk::DropDown m_column;
+  Gtk::Button m_sort_up{"Sort ↑"};
+  Gtk::Button m_sort_down{"Sort ↓"};
+  Gtk::Button m_unsort{"File Order"};
+  Gtk::Entry m_find;
+  Gtk::Button m_find_next{"Find Next"};
+  Grid m_grid{*this};
+  Gtk::Label m_status;
+
+  std::size_t data_rows() const { return m_index.row_count() > 0 ? m_index.row_count() - 1 : 0; }
+  std::size_t index_row(std::size_t view_row) const
+  {
+    return m_order.empty() ? view_row + 1 : m_order[view_row];
+  }
+
+  void on_indexed();
+  void on_sort(bool ascending);
+  void on_unsort();
+  void on_find();
+  void show_match();
+  void set_busy(bool busy);
+  void set_status(const Glib::ustring &s) { m_status.set_text(s); }
+};
@@ -0,0 +1,282 @@
+#include "diff_panel.hpp"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+// Regions still undiffed after this long are shown as whole changes.
+constexpr std::chrono::milliseconds kDiffBudget{5000};
+// Progress is shown this often while the diff runs.
+constexpr unsigned kTickMs = 100;
+// Longest part of a line that is laid out.
+constexpr std::size_t kMaxLineBytes = 1024;
+constexpr int kColumnGap = 1;
+// Rows above a change when jumping to it.
+constexpr std::size_t kContextRows = 3;
+
+// Valid UTF-8 for Pango, without the line break and cut to a screenful.
+std::string display_text(std::string_view line)
+{
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    line = line.substr(0, kMaxLineBytes);
+    if (g_utf8_validate(line.data(), static_cast<gssize>(line.size()), nullptr))
+        return std::string(line);
+    gchar *valid = g_utf8_make_valid(line.data(), static_cast<gssize>(line.size()));
+    std::string out(valid);
+    g_free(valid);
+    return out;
+}
+
+void set_tint(const Cairo::RefPtr<Cairo::Context> &cr, DiffBlock::Kind kind, bool current)
+{
+    const double alpha = current ? 0.35 : 0.2;
+    switch (kind)
+    {
+    case DiffBlock::Kind::Delete:
+        cr->set_source_rgba(0.9, 0.2, 0.2, alpha);
+        break;
+    case DiffBlock::Kind::Insert:
+        cr->set_source_rgba(0.2, 0.75, 0.2, alpha);
+        break;
+    default:
+        cr->set_source_rgba(0.25, 0.5, 0.95, alpha);
+        break;
+    }
+}
+} // namespace
+
+DiffPanel::DiffPanel() : Gtk::Box(Gtk::Orientation::VERTICAL)
+{
+    set_spacing(6);
+
+    m_bar.set_spacing(6);
+    m_summary.set_hexpand(true);
+    m_summary.set_halign(Gtk::Align::START);
+    m_summary.set_ellipsize(Pango::EllipsizeMode::MIDDLE);
+    m_bar.append(m_summary);
+    m_bar.append(m_prev);
+    m_bar.append(m_next);
+    m_bar.append(m_close_button);
+
+    m_rows.set_vexpand(true);
+    m_status.set_halign(Gtk::Align::START);
+
+    append(m_bar);
+    append(m_rows);
+    append(m_status);
+
+    m_prev.signal_clicked().connect([this]()
+                                    { goto_change(false); });
+    m_next.signal_clicked().connect([this]()
+                                    { goto_change(true); });
+    m_close_button.signal_clicked().connect([this]()
+                                            { m_close.emit(); });
+
+    set_busy(false);
+}
+
+DiffPanel::~DiffPanel()
+{
+    m_tick.disconnect();
+    m_task.stop();
+}
+
+void DiffPanel::clear()
+{
+    m_tick.disconnect();
+    m_task.stop();
+    m_diff.clear();
+    m_left = {};
+    m_right = {};
+    m_current = SIZE_MAX;
+    m_rows.set_row_count(0);
+    m_summary.set_text("");
+    set_busy(false);
+    set_status("");
+}
+
+void DiffPanel::set_busy(bool busy)
+{
+    const bool ready = !busy && m_diff.change_count() > 0;
+    m_prev.set_sensitive(ready);
+    m_next.set_sensitive(ready);
+}
+
+void DiffPanel::compare(TextSnapshot left, const std::string &left_name, TextSnapshot right,
+                        const std::string &right_name)
+{
+    clear();
+    m_left = std::move(left);
+    m_right = std::move(right);
+    m_left_name = left_name;
+    m_right_name = right_name;
+    m_summary.set_text(left_name + "  ↔  " + right_name);
+    set_busy(true);
+    set_status("Comparing…");
+
+    // Built aside and moved in when done.
+    auto a = m_left.text;
+    auto b = m_right.text;
+    auto diff = std::make_shared<LineDiff>();
+    m_task.start([a, b, diff](BackgroundTask::Control &control)
+                 { diff->build(a, b, kDiffBudget, &control.cancel, &control.progress); },
+                 [this, diff](bool cancelled)
+                 {
+                     m_tick.disconnect();
+                     if (cancelled || !diff->valid())
+                     {
+                         set_busy(false);
+                         set_status(!cancelled && diff->too_large() ? "Too many lines to compare."
+                                                                    : "Comparison cancelled.");
+                         return;
+                     }
+                     m_diff = std::move(*diff);
+                     on_compared();
+                 });
+    m_tick = Glib::signal_timeout().connect(
+        [this]()
+        {
+            set_status("Comparing… " + std::to_string(static_cast<int>(m_task.progress() * 100)) + "%");
+            return true;
+        },
+        kTickMs);
+}
+
+void DiffPanel::on_compared()
+{
+    m_rows.layout_columns();
+    m_rows.set_row_count(static_cast<std::size_t>(m_diff.row_count()));
+    m_rows.scroll_to_row(0);
+    set_busy(false);
+
+    if (m_diff.change_count() == 0)
+    {
+        set_status("No differences.");
+        return;
+    }
+    Glib::ustring status = std::to_string(m_diff.change_count()) + " changes: " +
+                           std::to_string(m_diff.deleted_lines()) + " lines removed, " +
+                           std::to_string(m_diff.inserted_lines()) + " added.";
+    if (m_diff.coarse())
+        status += " Some regions were too different to align line by line and are shown as whole changes.";
+    set_status(status);
+}
+
+void DiffPanel::goto_change(bool forward)
+{
+    const auto &blocks = m_diff.blocks();
+    if (m_diff.change_count() == 0)
+        return;
+
+    // From the current change, or from what is on screen.
+    std::size_t from = m_current;
+    if (from == SIZE_MAX)
+        from = m_diff.block_of_row(std::min<std::uint64_t>(m_rows.first_visible_row(), m_diff.row_count() - 1));
+
+    const std::size_t n = blocks.size();
+    std::size_t b = from;
+    for (std::size_t step = 0; step < n; ++step)
+    {
+        b = forward ? (b + 1) % n : (b + n - 1) % n;
+        if (blocks[b].kind != DiffBlock::Kind::Equal)
+            break;
+    }
+    m_current = b;
+
+    const std::uint64_t row = m_diff.block_row(b);
+    m_rows.scroll_to_row(static_cast<std::size_t>(row > kContextRows ? row - kContextRows : 0));
+    m_rows.redraw();
+
+    const auto index = std::count_if(blocks.begin(), blocks.begin() + static_cast<std::ptrdiff_t>(b),
+                                     [](const DiffBlock &block)
+                                     { return block.kind != DiffBlock::Kind::Equal; });
+    const auto &block = blocks[b];
+    set_status("Change " + std::to_string(index + 1) + " of " + std::to_string(m_diff.change_count()) + ": " +
+               std::to_string(block.a_count) + " lines at " + std::to_string(block.a_begin + 1) + " → " +
+               std::to_string(block.b_count) + " lines at " + std::to_string(block.b_begin + 1) + ".");
+}
+
+void DiffPanel::Rows::layout_columns()
+{
+    const auto lines = std::max(m_panel.m_diff.line_count(false), m_panel.m_diff.line_count(true));
+    m_gutter_chars = static_cast<int>(std::to_string(lines).size());
+}
+
+void DiffPanel::Rows::draw_side(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                                bool new_side, std::int64_t line, DiffBlock::Kind kind, bool current, double x,
+                                double y, double w)
+{
+    cr->save();
+    cr->rectangle(x, y, w, row_height());
+    cr->clip();
+
+    if (kind != DiffBlock::Kind::Equal)
+    {
+        // The side without a line is greyed rather than tinted.
+        cr->save();
+        if (line < 0)
+            cr->set_source_rgba(0.5, 0.5, 0.5, 0.12);
+        else
+            set_tint(cr, kind, current);
+        cr->rectangle(x, y, w, row_height());
+        cr->fill();
+        cr->restore();
+    }
+
+    if (line >= 0)
+    {
+        auto number = std::to_string(line + 1);
+        number.insert(0, static_cast<std::size_t>(std::max(0, m_gutter_chars - static_cast<int>(number.size()))),
+                      ' ');
+        cr->save();
+        cr->set_source_rgba(0.5, 0.5, 0.5, 1.0);
+        layout->set_text(number);
+        cr->move_to(x + 4.0, y);
+        layout->show_in_cairo_context(cr);
+        cr->restore();
+
+        layout->set_text(display_text(m_panel.m_diff.line(new_side, static_cast<std::size_t>(line))));
+        cr->move_to(x + 4.0 + (m_gutter_chars + kColumnGap) * char_width(), y);
+        layout->show_in_cairo_context(cr);
+    }
+    cr->restore();
+}
+
+void DiffPanel::Rows::draw_row(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                               std::size_t row, double y, int width)
+{
+    const auto &diff = m_panel.m_diff;
+    const auto r = diff.row(row);
+    const bool current = r.kind != DiffBlock::Kind::Equal && diff.block_of_row(row) == m_panel.m_current;
+    const double half = width / 2.0;
+    draw_side(cr, layout, false, r.a_line, r.kind, current, 0.0, y, half - 1.0);
+    draw_side(cr, layout, true, r.b_line, r.kind, current, half + 1.0, y, half - 1.0);
+
+    cr->save();
+    cr->set_source_rgba(0.5, 0.5, 0.5, 0.5);
+    cr->rectangle(half - 0.5, y, 1.0, row_height());
+    cr->fill();
+    cr->restore();
+}
+
+void DiffPanel::Rows::draw_header(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                                  int width)
+{
+    const double half = width / 2.0;
+    const std::string *names[2] = {&m_panel.m_left_name, &m_panel.m_right_name};
+    for (int side = 0; side < 2; ++side)
+    {
+        const double x = side == 0 ? 0.0 : half + 1.0;
+        cr->save();
+        cr->rectangle(x, 0.0, half - 1.0, row_height());
+        cr->clip();
+        layout->set_text(*names[side]);
+        cr->move_to(x + 4.0, 0.0);
+        layout->show_in_cairo_context(cr);
+        cr->restore();
+    }
+}
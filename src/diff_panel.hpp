@@ -0,0 +1,84 @@
+#pragma once
+
+#include "background_task.hpp"
+#include "line_diff.hpp"
+#include "text_snapshot.hpp"
+#include "virtual_row_view.hpp"
+
+#include <gtkmm.h>
+#include <cstddef>
+#include <string>
+
+// Side-by-side comparison of the document with a file. The LineDiff is
+// computed on a worker thread; the view then draws aligned line pairs, old
+// text on the left and new on the right, and only for the rows on screen,
+// so two files of a hundred MB scroll as lightly as two short ones. Both
+// sides are one row view, so they always scroll together.
+class DiffPanel : public Gtk::Box
+{
+public:
+  DiffPanel();
+  ~DiffPanel() override;
+
+  // Starts comparing `left` (old) with `right` (new); the rows fill in
+  // when the diff is done. The names head the two columns.
+  void compare(TextSnapshot left, const std::string &left_name, TextSnapshot right,
+               const std::string &right_name);
+
+  void clear();
+  std::size_t bytes() const { return m_diff.bytes(); }
+
+  // "Close" was clicked.
+  sigc::signal<void()> &signal_close() { return m_close; }
+
+private:
+  class Rows : public VirtualRowView
+  {
+  public:
+    explicit Rows(DiffPanel &panel) : m_panel(panel) {}
+
+    // Sets the gutter width from the line counts.
+    void layout_columns();
+
+  protected:
+    void draw_row(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                  std::size_t row, double y, int width) override;
+    bool has_header() const override { return true; }
+    void draw_header(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                     int width) override;
+
+  private:
+    DiffPanel &m_panel;
+    int m_gutter_chars = 1;
+
+    void draw_side(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                   bool new_side, std::int64_t line, DiffBlock::Kind kind, bool current, double x, double y,
+                   double w);
+  };
+
+  // Data
+  TextSnapshot m_left;
+  TextSnapshot m_right;
+  std::string m_left_name;
+  std::string m_right_name;
+  LineDiff m_diff;
+  std::size_t m_current = SIZE_MAX; // block shown by Previous/Next
+  BackgroundTask m_task;
+  sigc::connection m_tick;
+
+  // UI
+  Gtk::Box m_bar{Gtk::Orientation::HORIZONTAL};
+  Gtk::Label m_summary;
+  Gtk::Button m_prev{"Previous Change"};
+  Gtk::Button m_next{"Next Change"};
+  Gtk::Button m_close_button{"Close"};
+  Rows m_rows{*this};
+  Gtk::Label m_status;
+
+  sigc::signal<void()> m_close;
+
+  void on_compared();
+  void goto_change(bool forward);
+  void set_busy(bool busy);
+  void set_status(const Glib::ustring &s) { m_status.set_text(s); }
+};
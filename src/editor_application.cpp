@@ -0,0 +1,73 @@
+#include "editor_application.hpp"
+
+#include "app_window.hpp"
+#include "startup_profile.hpp"
+
+EditorApplication::EditorApplication()
+    : Gtk::Application("com.example.sophisticatedgtk4", Gio::Application::Flags::HANDLES_OPEN)
+{
+}
+
+Glib::RefPtr<EditorApplication> EditorApplication::create()
+{
+    return Glib::make_refptr_for_instance<EditorApplication>(new EditorApplication());
+}
+
+AppWindow *EditorApplication::create_window()
+{
+    auto window = new AppWindow();
+    add_window(*window);
+
+    // Delete the window when it is hidden (closed).
+    window->signal_hide().connect(
+        sigc::bind(sigc::mem_fun(*this, &EditorApplication::on_hide_window), window));
+
+    return window;
+}
+
+void EditorApplication::on_hide_window(Gtk::Window *window)
+{
+    delete window;
+}
+
+void EditorApplication::on_activate()
+{
+    startup_profile::mark("activate");
+    // Only the first window takes over the last session; a later
+    // activation just adds an empty one.
+    const bool first = get_windows().empty();
+    auto window = create_window();
+    startup_profile::mark("window constructed");
+    if (first)
+    {
+        window->restore_session();
+        startup_profile::mark("session restored");
+    }
+    window->present();
+    startup_profile::mark("present");
+}
+
+void EditorApplication::on_open(const Gio::Application::type_vec_files &files,
+                                const Glib::ustring & /*hint*/)
+{
+    startup_profile::mark("open");
+
+    for (const auto &file : files)
+    {
+        const bool first = get_windows().empty();
+        auto window = create_window();
+        startup_profile::mark("window constructed");
+        if (first)
+            window->own_session();
+
+        // Start loading before the window is mapped: the first screenful is
+        // already in the buffer when the first frame is drawn.
+        window->open_file(file->get_path());
+        startup_profile::mark("first screenful inserted");
+        window->present();
+        startup_profile::mark("present");
+    }
+
+    if (files.empty())
+        on_activate();
+}
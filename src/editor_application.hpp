@@ -0,0 +1,25 @@
+#pragma once
+
+#include <gtkmm.h>
+
+class AppWindow;
+
+// Gtk::Application that also handles `open`, so `sophisticated FILE...`
+// opens each file in its own window.
+class EditorApplication : public Gtk::Application
+{
+protected:
+  EditorApplication();
+
+public:
+  static Glib::RefPtr<EditorApplication> create();
+
+protected:
+  void on_activate() override;
+  void on_open(const Gio::Application::type_vec_files& files,
+               const Glib::ustring& hint) override;
+
+private:
+  AppWindow* create_window();
+  void on_hide_window(Gtk::Window* window);
+};
@@ -0,0 +1,755 @@
+#include "file_index.hpp"
+
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+
+struct FileIndex::IgnoreSet
+{
+    struct Rule
+    {
+        std::string pattern;
+        bool negate = false;
+        bool dir_only = false;
+        bool anchored = false; // matched against the path, not just the name
+    };
+
+    std::string base; // directory of the .gitignore, relative to the root
+    std::vector<Rule> rules;
+    std::shared_ptr<const IgnoreSet> parent;
+};
+
+namespace
+{
+using IgnoreSet = FileIndex::IgnoreSet;
+
+// Entries per parallel search chunk.
+constexpr std::size_t kSearchChunk = 32768;
+
+unsigned char fold(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+// Bit of the character-set mask for `c` (already folded). Letters and
+// digits get their own bits; the rest share a few.
+unsigned mask_bit(unsigned char c)
+{
+    if (c >= 'a' && c <= 'z')
+        return c - 'a';
+    if (c >= '0' && c <= '9')
+        return 26u + (c - '0');
+    switch (c)
+    {
+    case '.':
+        return 36;
+    case '_':
+        return 37;
+    case '-':
+        return 38;
+    case '/':
+        return 39;
+    default:
+        return c >= 0x80 ? 40u + (c & 15u) : 56u + (c & 7u);
+    }
+}
+
+std::uint64_t mask_of(std::string_view s)
+{
+    std::uint64_t mask = 0;
+    for (char c : s)
+        mask |= std::uint64_t{1} << mask_bit(fold(static_cast<unsigned char>(c)));
+    return mask;
+}
+
+// ---- .gitignore ----
+
+// Glob with gitignore semantics: '*' and '?' stop at '/', '**' does not,
+// "[a-z]" / "[!a-z]" classes, '\' escapes.
+bool glob(const char *p, const char *pe, const char *s, const char *se)
+{
+    while (p < pe)
+    {
+        switch (*p)
+        {
+        case '*':
+            if (p + 1 < pe && p[1] == '*')
+            {
+                p += 2;
+                if (p < pe && *p == '/')
+                    ++p;
+                for (const char *t = s;; ++t)
+                {
+                    if (glob(p, pe, t, se))
+                        return true;
+                    if (t == se)
+                        return false;
+                }
+            }
+            ++p;
+            for (const char *t = s;; ++t)
+            {
+                if (glob(p, pe, t, se))
+                    return true;
+                if (t == se || *t == '/')
+                    return false;
+            }
+        case '?':
+            if (s == se || *s == '/')
+                return false;
+            ++p;
+            ++s;
+            break;
+        case '[':
+        {
+            if (s == se || *s == '/')
+                return false;
+            const char *q = p + 1;
+            const bool negate = q < pe && (*q == '!' || *q == '^');
+            if (negate)
+                ++q;
+            bool matched = false;
+            bool first = true;
+            for (; q < pe && (first || *q != ']'); ++q, first = false)
+            {
+                if (q + 2 < pe && q[1] == '-' && q[2] != ']')
+                {
+                    matched |= *s >= q[0] && *s <= q[2];
+                    q += 2;
+                }
+                else
+                {
+                    matched |= *s == *q;
+                }
+            }
+            if (q >= pe) // no closing ']': a literal '['
+            {
+                if (*s != '[')
+                    return false;
+                ++p;
+                ++s;
+                break;
+            }
+            if (matched == negate)
+                return false;
+            p = q + 1;
+            ++s;
+            break;
+        }
+        case '\\':
+            if (p + 1 < pe)
+                ++p;
+            [[fallthrough]];
+        default:
+            if (s == se || *p != *s)
+                return false;
+            ++p;
+            ++s;
+            break;
+        }
+    }
+    return s == se;
+}
+
+std::vector<IgnoreSet::Rule> parse_gitignore(std::string_view text)
+{
+    std::vector<IgnoreSet::Rule> rules;
+    while (!text.empty())
+    {
+        const auto nl = text.find('\n');
+        auto line = text.substr(0, nl);
+        text = nl == std::string_view::npos ? std::string_view{} : text.substr(nl + 1);
+
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        while (!line.empty() && line.back() == ' ' && !(line.size() > 1 && line[line.size() - 2] == '\\'))
+            line.remove_suffix(1);
+        if (line.empty() || line.front() == '#')
+            continue;
+
+        IgnoreSet::Rule rule;
+        if (line.front() == '!')
+        {
+            rule.negate = true;
+            line.remove_prefix(1);
+        }
+        else if (line.front() == '\\')
+        {
+            line.remove_prefix(1);
+        }
+        if (!line.empty() && line.back() == '/')
+        {
+            rule.dir_only = true;
+            line.remove_suffix(1);
+        }
+        rule.anchored = line.find('/') != std::string_view::npos;
+        if (!line.empty() && line.front() == '/')
+            line.remove_prefix(1);
+        if (line.empty())
+            continue;
+        rule.pattern = line;
+        rules.push_back(std::move(rule));
+    }
+    return rules;
+}
+
+// 1: ignored, 0: re-included, -1: no rule in `set` says.
+int match_rules(const IgnoreSet &set, std::string_view rel, bool is_dir)
+{
+    std::string_view sub = rel;
+    if (!set.base.empty())
+    {
+        if (rel.size() <= set.base.size() || rel.compare(0, set.base.size(), set.base) != 0 ||
+            rel[set.base.size()] != '/')
+            return -1;
+        sub = rel.substr(set.base.size() + 1);
+    }
+    const auto slash = sub.rfind('/');
+    const auto name = slash == std::string_view::npos ? sub : sub.substr(slash + 1);
+
+    // The last matching rule wins.
+    for (auto it = set.rules.rbegin(); it != set.rules.rend(); ++it)
+    {
+        if (it->dir_only && !is_dir)
+            continue;
+        const auto target = it->anchored ? sub : name;
+        const auto &p = it->pattern;
+        if (glob(p.data(), p.data() + p.size(), target.data(), target.data() + target.size()))
+            return it->negate ? 0 : 1;
+    }
+    return -1;
+}
+
+// Deeper .gitignore files override shallower ones.
+bool is_ignored(const IgnoreSet *set, std::string_view rel, bool is_dir)
+{
+    for (; set; set = set->parent.get())
+    {
+        const int r = match_rules(*set, rel, is_dir);
+        if (r >= 0)
+            return r == 1;
+    }
+    return false;
+}
+
+std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+std::string join(const std::string &root, std::string_view rel)
+{
+    std::string path = root;
+    if (!rel.empty())
+    {
+        if (path.empty() || path.back() != '/')
+            path += '/';
+        path += rel;
+    }
+    return path;
+}
+
+// ---- Parallel walk ----
+
+struct PendingDir
+{
+    std::string rel;
+    std::shared_ptr<const IgnoreSet> ignores;
+};
+
+struct Walk
+{
+    Walk(const std::string &root, const std::atomic<bool> *cancel) : root(root), cancel(cancel) {}
+
+    const std::string &root;
+    const std::atomic<bool> *cancel;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<PendingDir> queue;
+    unsigned active = 0;
+    std::atomic<std::size_t> files{0};
+    std::atomic<bool> stop{false};
+
+    // Results, merged as each worker finishes.
+    std::vector<std::string> found;
+    std::vector<PendingDir> dirs;
+
+    bool halted() const
+    {
+        return stop.load(std::memory_order_relaxed) || (cancel && cancel->load(std::memory_order_relaxed));
+    }
+};
+
+// Reads directory `dir`: files go to `files`, subdirectories to `subdirs`.
+// Returns the ignore rules that apply inside it.
+std::shared_ptr<const IgnoreSet> scan_dir(Walk &walk, const PendingDir &dir, std::vector<std::string> &files,
+                                          std::vector<PendingDir> &subdirs)
+{
+    const auto path = join(walk.root, dir.rel);
+    std::error_code ec;
+    std::filesystem::directory_iterator it(path, ec);
+    if (ec)
+        return dir.ignores;
+
+    struct Item
+    {
+        std::string name;
+        bool is_dir;
+    };
+    std::vector<Item> items;
+    bool has_gitignore = false;
+    for (; it != std::filesystem::directory_iterator(); it.increment(ec))
+    {
+        if (ec)
+            break;
+        const auto &entry = *it;
+        auto name = entry.path().filename().string();
+        if (name == ".git")
+            continue;
+        // Types come from the directory listing where the platform has
+        // them. Linked directories are not followed, so there are no cycles.
+        const bool link = entry.is_symlink(ec);
+        if (entry.is_directory(ec) && !link)
+            items.push_back({name, true});
+        else if (entry.is_regular_file(ec))
+            items.push_back({name, false});
+        has_gitignore |= name == ".gitignore";
+    }
+
+    auto ignores = dir.ignores;
+    if (has_gitignore)
+    {
+        auto set = std::make_shared<IgnoreSet>();
+        set->base = dir.rel;
+        set->rules = parse_gitignore(read_file(join(path, ".gitignore")));
+        set->parent = dir.ignores;
+        ignores = std::move(set);
+    }
+
+    for (const auto &item : items)
+    {
+        auto rel = dir.rel.empty() ? item.name : dir.rel + "/" + item.name;
+        if (is_ignored(ignores.get(), rel, item.is_dir))
+            continue;
+        if (item.is_dir)
+        {
+            subdirs.push_back({std::move(rel), ignores});
+        }
+        else
+        {
+            files.push_back(std::move(rel));
+            if (walk.files.fetch_add(1, std::memory_order_relaxed) + 1 >= FileIndex::kMaxFiles)
+                walk.stop.store(true, std::memory_order_relaxed);
+        }
+    }
+    return ignores;
+}
+
+void walk_worker(Walk &walk)
+{
+    std::vector<std::string> files;
+    std::vector<PendingDir> walked;
+    std::vector<PendingDir> subdirs;
+
+    for (;;)
+    {
+        PendingDir dir;
+        {
+            std::unique_lock lock(walk.mutex);
+            walk.cv.wait(lock, [&]()
+                         { return !walk.queue.empty() || walk.active == 0 || walk.halted(); });
+            if (walk.queue.empty() || walk.halted())
+                break;
+            // Last in, first out: the queue stays short on deep trees.
+            dir = std::move(walk.queue.back());
+            walk.queue.pop_back();
+            ++walk.active;
+        }
+
+        subdirs.clear();
+        auto ignores = scan_dir(walk, dir, files, subdirs);
+        // Kept with the rules inside it, for ignored().
+        walked.push_back({std::move(dir.rel), std::move(ignores)});
+
+        {
+            std::lock_guard lock(walk.mutex);
+            for (auto &sub : subdirs)
+                walk.queue.push_back(std::move(sub));
+            --walk.active;
+        }
+        walk.cv.notify_all();
+    }
+    walk.cv.notify_all();
+
+    std::lock_guard lock(walk.mutex);
+    walk.found.insert(walk.found.end(), std::make_move_iterator(files.begin()), std::make_move_iterator(files.end()));
+    walk.dirs.insert(walk.dirs.end(), std::make_move_iterator(walked.begin()), std::make_move_iterator(walked.end()));
+}
+
+// ---- Fuzzy scoring ----
+
+bool is_boundary(std::string_view path, std::size_t i)
+{
+    if (i == 0)
+        return true;
+    const char prev = path[i - 1];
+    if (prev == '/' || prev == '_' || prev == '-' || prev == '.' || prev == ' ')
+        return true;
+    // camelCase
+    return prev >= 'a' && prev <= 'z' && path[i] >= 'A' && path[i] <= 'Z';
+}
+
+// Score of the tightest match of `q` in `path` from `from` on, or -1.
+// Matches on word boundaries and runs of consecutive characters score
+// most; skipped characters cost a little.
+int score_from(std::string_view path, std::size_t from, std::string_view q)
+{
+    const std::size_t n = path.size();
+
+    // Forward: where the first complete match ends…
+    std::size_t qi = 0, end = n;
+    for (std::size_t i = from; i < n; ++i)
+    {
+        if (fold(static_cast<unsigned char>(path[i])) == static_cast<unsigned char>(q[qi]) && ++qi == q.size())
+        {
+            end = i;
+            break;
+        }
+    }
+    if (end == n)
+        return -1;
+
+    // …backward: the latest start that still reaches it.
+    std::size_t start = end;
+    qi = q.size();
+    for (std::size_t i = end + 1; i-- > from;)
+    {
+        if (fold(static_cast<unsigned char>(path[i])) == static_cast<unsigned char>(q[qi - 1]) && --qi == 0)
+        {
+            start = i;
+            break;
+        }
+    }
+
+    int score = 0, gaps = 0;
+    bool run = false;
+    qi = 0;
+    for (std::size_t i = start; i <= end && qi < q.size(); ++i)
+    {
+        if (fold(static_cast<unsigned char>(path[i])) == static_cast<unsigned char>(q[qi]))
+        {
+            score += 16;
+            if (is_boundary(path, i))
+                score += 24;
+            if (run)
+                score += 16;
+            run = true;
+            ++qi;
+        }
+        else
+        {
+            run = false;
+            ++gaps;
+        }
+    }
+    return score - std::min(gaps, 48);
+}
+
+int fuzzy_score(std::string_view path, std::size_t base, std::string_view q)
+{
+    const int whole = score_from(path, 0, q);
+    if (whole < 0)
+        return -1;
+    // All of it in the file name beats a match spread over directories.
+    const int name = score_from(path, base, q);
+    return name < 0 ? whole : std::max(whole, name + 40);
+}
+} // namespace
+
+void FileIndex::clear()
+{
+    m_root.clear();
+    m_text.clear();
+    m_text.shrink_to_fit();
+    m_entries.clear();
+    m_entries.shrink_to_fit();
+    m_masks.clear();
+    m_masks.shrink_to_fit();
+    m_sorted = 0;
+    m_live = 0;
+    m_dirs.clear();
+    m_dirs.shrink_to_fit();
+    m_ignores.clear();
+    m_valid = false;
+    m_truncated = false;
+}
+
+std::string FileIndex::project_root(const std::string &dir)
+{
+    std::error_code ec;
+    for (std::filesystem::path at(dir); !at.empty(); at = at.parent_path())
+    {
+        if (std::filesystem::exists(at / ".git", ec))
+            return at.string();
+        if (at == at.parent_path())
+            break;
+    }
+    return dir;
+}
+
+bool FileIndex::build(const std::string &root, const std::atomic<bool> *cancel)
+{
+    TRACE_SCOPE("files.build");
+    clear();
+    m_root = root;
+    while (m_root.size() > 1 && m_root.back() == '/')
+        m_root.pop_back();
+
+    Walk walk(m_root, cancel);
+    walk.queue.push_back({"", nullptr});
+    // Mostly waiting on the file system, so a thread per core at least.
+    const unsigned threads = std::max(4u, std::thread::hardware_concurrency());
+    parallel_for(threads, [&](std::size_t)
+                 { walk_worker(walk); },
+                 threads);
+
+    if (cancel && cancel->load(std::memory_order_relaxed))
+    {
+        clear();
+        return false;
+    }
+    m_truncated = walk.stop.load();
+
+    parallel_stable_sort(walk.found, std::less<>{});
+    std::size_t total = 0;
+    for (const auto &f : walk.found)
+        total += f.size();
+    m_text.reserve(total);
+    m_entries.reserve(walk.found.size());
+    m_masks.reserve(walk.found.size());
+    for (const auto &f : walk.found)
+        append(f);
+    m_sorted = m_entries.size();
+
+    std::sort(walk.dirs.begin(), walk.dirs.end(), [](const PendingDir &a, const PendingDir &b)
+              {
+        const auto da = std::count(a.rel.begin(), a.rel.end(), '/') + !a.rel.empty();
+        const auto db = std::count(b.rel.begin(), b.rel.end(), '/') + !b.rel.empty();
+        return da != db ? da < db : a.rel < b.rel; });
+    m_dirs.reserve(walk.dirs.size());
+    for (auto &d : walk.dirs)
+    {
+        m_dirs.push_back(d.rel);
+        m_ignores.emplace(std::move(d.rel), std::move(d.ignores));
+    }
+
+    m_valid = true;
+    return true;
+}
+
+std::string_view FileIndex::path(std::uint32_t entry) const
+{
+    const auto &e = m_entries[entry];
+    return std::string_view(m_text).substr(e.offset, e.length);
+}
+
+bool FileIndex::ignored(std::string_view rel, bool is_dir) const
+{
+    // The set of the nearest walked directory above it.
+    std::string_view dir = rel;
+    for (;;)
+    {
+        const auto slash = dir.rfind('/');
+        dir = slash == std::string_view::npos ? std::string_view{} : dir.substr(0, slash);
+        if (auto it = m_ignores.find(std::string(dir)); it != m_ignores.end())
+            return is_ignored(it->second.get(), rel, is_dir);
+        if (dir.empty())
+            return false;
+    }
+}
+
+void FileIndex::add(std::string_view rel)
+{
+    if (const auto i = find(rel); i >= 0)
+    {
+        if (m_masks[static_cast<std::size_t>(i)] == 0)
+        {
+            m_masks[static_cast<std::size_t>(i)] = mask_of(rel);
+            ++m_live;
+        }
+        return;
+    }
+    append(rel);
+}
+
+bool FileIndex::remove(std::string_view rel)
+{
+    const auto i = find(rel);
+    if (i < 0 || m_masks[static_cast<std::size_t>(i)] == 0)
+        return false;
+    drop(static_cast<std::size_t>(i));
+    return true;
+}
+
+std::size_t FileIndex::remove_tree(std::string_view rel)
+{
+    const std::string prefix = std::string(rel) + "/";
+    auto under = [&](std::size_t i)
+    { return path(static_cast<std::uint32_t>(i)).starts_with(prefix); };
+
+    std::size_t removed = 0;
+    auto drop_if = [&](std::size_t i)
+    {
+        if (m_masks[i] != 0)
+        {
+            drop(i);
+            ++removed;
+        }
+    };
+
+    // Sorted entries under it are contiguous.
+    auto first = std::lower_bound(m_entries.begin(), m_entries.begin() + static_cast<std::ptrdiff_t>(m_sorted),
+                                  prefix, [&](const Entry &e, const std::string &p)
+                                  { return std::string_view(m_text).substr(e.offset, e.length) < p; });
+    for (auto i = static_cast<std::size_t>(first - m_entries.begin()); i < m_sorted && under(i); ++i)
+        drop_if(i);
+    for (std::size_t i = m_sorted; i < m_entries.size(); ++i)
+        if (under(i))
+            drop_if(i);
+    return removed;
+}
+
+void FileIndex::search(std::string_view query, std::size_t limit, std::vector<FileHit> &out) const
+{
+    TRACE_SCOPE("files.search");
+    out.clear();
+    if (limit == 0)
+        return;
+
+    std::string q;
+    for (char c : query)
+        if (c != ' ')
+            q += static_cast<char>(fold(static_cast<unsigned char>(c)));
+    if (q.empty())
+    {
+        for (std::size_t i = 0; i < m_entries.size() && out.size() < limit; ++i)
+            if (m_masks[i] != 0)
+                out.push_back({static_cast<std::uint32_t>(i), 0});
+        return;
+    }
+
+    // Higher scores first, then shorter paths, then path order.
+    auto better = [this](const FileHit &a, const FileHit &b)
+    {
+        if (a.score != b.score)
+            return a.score > b.score;
+        const auto la = m_entries[a.entry].length, lb = m_entries[b.entry].length;
+        return la != lb ? la < lb : a.entry < b.entry;
+    };
+    auto keep_best = [&](std::vector<FileHit> &hits)
+    {
+        if (hits.size() > limit)
+        {
+            std::nth_element(hits.begin(), hits.begin() + static_cast<std::ptrdiff_t>(limit), hits.end(), better);
+            hits.resize(limit);
+        }
+    };
+
+    const std::uint64_t qmask = mask_of(q);
+    const std::size_t n = m_entries.size();
+    const std::size_t chunks = (n + kSearchChunk - 1) / kSearchChunk;
+    std::vector<std::vector<FileHit>> found(chunks);
+
+    parallel_for(chunks, [&](std::size_t c)
+                 {
+        const std::size_t from = c * kSearchChunk;
+        const std::size_t to = std::min(n, from + kSearchChunk);
+        const std::uint64_t *masks = m_masks.data();
+        auto &hits = found[c];
+
+        for (std::size_t block = from; block < to; block += 64)
+        {
+            // Branch-free subset test over 64 masks, then score the survivors.
+            const std::size_t count = std::min<std::size_t>(64, to - block);
+            std::uint64_t pass = 0;
+            for (std::size_t k = 0; k < count; ++k)
+                pass |= static_cast<std::uint64_t>((masks[block + k] & qmask) == qmask) << k;
+            while (pass)
+            {
+                const std::size_t i = block + static_cast<std::size_t>(std::countr_zero(pass));
+                pass &= pass - 1;
+                const auto &e = m_entries[i];
+                const int score = fuzzy_score(std::string_view(m_text).substr(e.offset, e.length), e.base, q);
+                if (score >= 0)
+                    hits.push_back({static_cast<std::uint32_t>(i), score});
+            }
+        }
+        keep_best(hits); });
+
+    for (auto &hits : found)
+        out.insert(out.end(), hits.begin(), hits.end());
+    keep_best(out);
+    std::sort(out.begin(), out.end(), better);
+}
+
+std::size_t FileIndex::bytes() const
+{
+    std::size_t total = m_text.capacity() + m_entries.capacity() * sizeof(Entry) +
+                        m_masks.capacity() * sizeof(std::uint64_t) + m_dirs.capacity() * sizeof(std::string);
+    for (const auto &d : m_dirs)
+        total += d.capacity();
+    return total;
+}
+
+void FileIndex::append(std::string_view rel)
+{
+    if (rel.empty() || rel.size() > std::numeric_limits<std::uint16_t>::max() ||
+        m_text.size() + rel.size() > std::numeric_limits<std::uint32_t>::max())
+    {
+        m_truncated = true;
+        return;
+    }
+    Entry e;
+    e.offset = static_cast<std::uint32_t>(m_text.size());
+    e.length = static_cast<std::uint16_t>(rel.size());
+    const auto slash = rel.rfind('/');
+    e.base = static_cast<std::uint16_t>(slash == std::string_view::npos ? 0 : slash + 1);
+    m_text.append(rel);
+    m_entries.push_back(e);
+    m_masks.push_back(mask_of(rel));
+    ++m_live;
+}
+
+std::int64_t FileIndex::find(std::string_view rel) const
+{
+    const std::string_view text(m_text);
+    auto it = std::lower_bound(m_entries.begin(), m_entries.begin() + static_cast<std::ptrdiff_t>(m_sorted), rel,
+                               [&](const Entry &e, std::string_view p)
+                               { return text.substr(e.offset, e.length) < p; });
+    if (it != m_entries.begin() + static_cast<std::ptrdiff_t>(m_sorted) &&
+        text.substr(it->offset, it->length) == rel)
+        return it - m_entries.begin();
+    for (std::size_t i = m_sorted; i < m_entries.size(); ++i)
+        if (path(static_cast<std::uint32_t>(i)) == rel)
+            return static_cast<std::int64_t>(i);
+    return -1;
+}
+
+void FileIndex::drop(std::size_t entry)
+{
+    // The path stays in the arena (and in order) so lookups still work.
+    m_masks[entry] = 0;
+    --m_live;
+}
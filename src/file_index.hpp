@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// One quick-open result: an entry of the index and how well it matched.
+struct FileHit
+{
+  std::uint32_t entry = 0;
+  int score = 0;
+};
+
+// The files under a directory, for quick open.
+//
+// build() walks the tree on all cores, skipping what .gitignore files (and
+// .git itself) exclude, and keeps the relative paths in one arena with an
+// 8-byte entry and an 8-byte character-set mask each, so half a million
+// files cost a few tens of MB. search() ranks them against a fuzzy query:
+// the masks reject most candidates in a tight loop over one array, and
+// only the survivors are scored, in parallel chunks.
+//
+// add(), remove() and remove_tree() keep the index current from file
+// monitor events; entries added after build() sit unsorted after the
+// sorted ones.
+class FileIndex
+{
+public:
+  // Walks stop (and truncated() is set) past this many files.
+  static constexpr std::size_t kMaxFiles = 2'000'000;
+
+  void clear();
+
+  // The nearest directory at or above `dir` holding a .git, else `dir`.
+  static std::string project_root(const std::string &dir);
+
+  // Indexes everything under `root`. Returns false if cancelled.
+  bool build(const std::string &root, const std::atomic<bool> *cancel = nullptr);
+
+  const std::string &root() const { return m_root; }
+  bool valid() const { return m_valid; }
+  bool truncated() const { return m_truncated; }
+
+  // Live files, and entry slots (removed ones included).
+  std::size_t size() const { return m_live; }
+  std::size_t entry_count() const { return m_entries.size(); }
+  std::string_view path(std::uint32_t entry) const;
+
+  // Directories walked, shallowest first.
+  const std::vector<std::string> &directories() const { return m_dirs; }
+
+  // Whether .gitignore rules exclude `rel` (relative to root()).
+  bool ignored(std::string_view rel, bool is_dir) const;
+  // Adds `rel` unless present. Paths are relative to root().
+  void add(std::string_view rel);
+  bool remove(std::string_view rel);
+  // Removes every file under directory `rel`; returns how many.
+  std::size_t remove_tree(std::string_view rel);
+
+  // At most `limit` best matches for `query`, best first. Case-insensitive
+  // (ASCII); spaces in the query are ignored. An empty query lists paths
+  // in order.
+  void search(std::string_view query, std::size_t limit, std::vector<FileHit> &out) const;
+
+  std::size_t bytes() const;
+
+  struct IgnoreSet; // one .gitignore, chained to those of parent directories
+
+private:
+  struct Entry
+  {
+    std::uint32_t offset = 0; // into m_text
+    std::uint16_t length = 0; // 0: removed
+    std::uint16_t base = 0;   // start of the file name
+  };
+
+  std::string m_root;
+  std::string m_text;
+  std::vector<Entry> m_entries;
+  std::vector<std::uint64_t> m_masks; // characters present, per entry
+  std::size_t m_sorted = 0;           // entries [0, m_sorted) are in path order
+  std::size_t m_live = 0;
+  std::vector<std::string> m_dirs;
+  std::unordered_map<std::string, std::shared_ptr<const IgnoreSet>> m_ignores; // by directory
+  bool m_valid = false;
+  bool m_truncated = false;
+
+  void append(std::string_view rel);
+  // Entry holding `rel`, or -1.
+  std::int64_t find(std::string_view rel) const;
+  void drop(std::size_t entry);
+};
@@ -0,0 +1,383 @@
+#include "filter_command_dialog.hpp"
+
+#include "trace.hpp"
+
+#include <algorithm>
+
+namespace
+{
+constexpr int kChunkChars = 64 * 1024;
+constexpr gsize kReadBytes = 64 * 1024;
+constexpr std::size_t kStderrTail = 4 * 1024;
+} // namespace
+
+FilterCommandDialog::FilterCommandDialog(Gtk::Window &parent, Gtk::TextView &textview)
+    : m_parent(parent), m_textview(textview)
+{
+    m_buffer = m_textview.get_buffer();
+
+    build_ui();
+    connect_signals();
+}
+
+FilterCommandDialog::~FilterCommandDialog()
+{
+    if (m_run_state)
+    {
+        m_run_state->owner = nullptr;
+        m_run_state->cancellable->cancel();
+        m_run_state->process->force_exit();
+    }
+}
+
+void FilterCommandDialog::present()
+{
+    m_win.present();
+    m_command.grab_focus();
+}
+
+void FilterCommandDialog::build_ui()
+{
+    m_win.set_title("Filter Through Command");
+    m_win.set_transient_for(m_parent);
+    m_win.set_destroy_with_parent(true);
+    m_win.set_default_size(560, 150);
+
+    m_root.set_margin(12);
+    m_root.set_spacing(10);
+    m_win.set_child(m_root);
+
+    // Row 1: command
+    m_row1.set_spacing(8);
+    m_command.set_placeholder_text("Command (runs in a shell; selection or whole document on stdin)");
+    m_command.set_hexpand(true);
+    m_row1.append(m_command);
+
+    m_progress.set_show_text(true);
+    m_progress.set_text("");
+
+    // Buttons
+    m_buttons.set_spacing(8);
+    m_buttons.append(m_run);
+    m_buttons.append(m_cancel);
+
+    auto spacer = Gtk::make_managed<Gtk::Label>("");
+    spacer->set_hexpand(true);
+    m_buttons.append(*spacer);
+    m_buttons.append(m_close);
+
+    m_cancel.set_sensitive(false);
+
+    m_status.set_halign(Gtk::Align::START);
+
+    m_root.append(m_row1);
+    m_root.append(m_progress);
+    m_root.append(m_buttons);
+    m_root.append(m_status);
+
+    m_win.signal_close_request().connect([this]() -> bool
+                                         {
+    m_win.hide();
+    return false; }, false);
+}
+
+void FilterCommandDialog::connect_signals()
+{
+    m_run.signal_clicked().connect(sigc::mem_fun(*this, &FilterCommandDialog::on_run));
+    m_command.signal_activate().connect(sigc::mem_fun(*this, &FilterCommandDialog::on_run));
+    m_cancel.signal_clicked().connect(sigc::mem_fun(*this, &FilterCommandDialog::on_cancel));
+    m_close.signal_clicked().connect([this]()
+                                     { m_win.hide(); });
+}
+
+void FilterCommandDialog::set_status(const Glib::ustring &s)
+{
+    m_status.set_text(s);
+}
+
+void FilterCommandDialog::set_running(bool running)
+{
+    m_run.set_sensitive(!running);
+    m_command.set_sensitive(!running);
+    m_cancel.set_sensitive(running);
+
+    // Offsets into the buffer must stay valid while the command runs.
+    m_textview.set_editable(!running);
+}
+
+void FilterCommandDialog::on_run()
+{
+    if (m_run_state)
+        return;
+
+    const auto command = m_command.get_text();
+    if (command.empty())
+    {
+        set_status("Enter a command.");
+        return;
+    }
+
+    Gtk::TextBuffer::iterator s, e;
+    if (!m_buffer->get_selection_bounds(s, e))
+    {
+        s = m_buffer->begin();
+        e = m_buffer->end();
+    }
+
+#ifdef _WIN32
+    const std::vector<std::string> argv{"cmd.exe", "/c", command.raw()};
+#else
+    const std::vector<std::string> argv{"/bin/sh", "-c", command.raw()};
+#endif
+
+    auto run = std::make_shared<Run>();
+    try
+    {
+        run->process = Gio::Subprocess::create(argv, Gio::Subprocess::Flags::STDIN_PIPE |
+                                                         Gio::Subprocess::Flags::STDOUT_PIPE |
+                                                         Gio::Subprocess::Flags::STDERR_PIPE);
+    }
+    catch (const Glib::Error &err)
+    {
+        set_status(Glib::ustring("Could not start command: ") + err.what());
+        return;
+    }
+
+    run->owner = this;
+    run->cancellable = Gio::Cancellable::create();
+    run->start = m_buffer->create_mark(s, /*left_gravity=*/true);
+    run->end = m_buffer->create_mark(e, /*left_gravity=*/false);
+    run->start_offset = s.get_offset();
+    run->end_offset = e.get_offset();
+    m_run_state = run;
+
+    set_running(true);
+    set_status("Running…");
+    update_progress();
+
+    // Feed stdin and drain stdout/stderr at the same time.
+    write_next(run);
+    read_stdout(run);
+    read_stderr(run);
+
+    run->process->wait_async([run](const Glib::RefPtr<Gio::AsyncResult> &res)
+                             {
+        try
+        {
+            run->process->wait_finish(res);
+        }
+        catch (const Glib::Error &)
+        {
+        }
+        run->exited = true;
+        maybe_finish(run); }, run->cancellable);
+}
+
+void FilterCommandDialog::on_cancel()
+{
+    if (!m_run_state)
+        return;
+    m_run_state->cancellable->cancel();
+    m_run_state->process->force_exit();
+    set_status("Cancelling…");
+}
+
+void FilterCommandDialog::write_next(const std::shared_ptr<Run> &run)
+{
+    auto self = run->owner;
+    if (!self || run->cancellable->is_cancelled())
+        return;
+
+    auto in = run->process->get_stdin_pipe();
+    const int total = run->end_offset - run->start_offset;
+
+    if (run->sent >= total)
+    {
+        // EOF for the command.
+        in->close_async([in](const Glib::RefPtr<Gio::AsyncResult> &res)
+                        {
+            try
+            {
+                in->close_finish(res);
+            }
+            catch (const Glib::Error &)
+            {
+            } }, run->cancellable);
+        return;
+    }
+
+    // Only one chunk of the range is ever copied out of the buffer.
+    const int from = run->start_offset + run->sent;
+    const int to = std::min(run->end_offset, from + kChunkChars);
+    {
+        TRACE_SCOPE("filter.chunk");
+        run->chunk = self->m_buffer->get_text(self->m_buffer->get_iter_at_offset(from),
+                                              self->m_buffer->get_iter_at_offset(to), true)
+                         .raw();
+    }
+    run->sent = to - run->start_offset;
+
+    in->write_all_async(run->chunk.data(), run->chunk.size(),
+                        [run, in](const Glib::RefPtr<Gio::AsyncResult> &res)
+                        {
+        try
+        {
+            gsize written = 0;
+            in->write_all_finish(res, written);
+        }
+        catch (const Glib::Error &)
+        {
+            // The command stopped reading (head, grep -m…) or we were
+            // cancelled; its output so far is still what we want.
+            return;
+        }
+
+        if (run->owner)
+            run->owner->update_progress();
+        write_next(run); }, run->cancellable);
+}
+
+void FilterCommandDialog::read_stdout(const std::shared_ptr<Run> &run)
+{
+    auto out = run->process->get_stdout_pipe();
+    out->read_bytes_async(kReadBytes, [run, out](const Glib::RefPtr<Gio::AsyncResult> &res)
+                          {
+        Glib::RefPtr<Glib::Bytes> bytes;
+        try
+        {
+            bytes = out->read_bytes_finish(res);
+        }
+        catch (const Glib::Error &err)
+        {
+            run->failed = true;
+            run->failure = err.what();
+            run->stdout_done = true;
+            maybe_finish(run);
+            return;
+        }
+
+        gsize size = 0;
+        auto data = bytes ? static_cast<const char *>(bytes->get_data(size)) : nullptr;
+        if (!data || size == 0)
+        {
+            run->stdout_done = true;
+            maybe_finish(run);
+            return;
+        }
+
+        run->output.append(data, size);
+        if (run->owner)
+            run->owner->update_progress();
+        read_stdout(run); }, run->cancellable);
+}
+
+void FilterCommandDialog::read_stderr(const std::shared_ptr<Run> &run)
+{
+    auto err_pipe = run->process->get_stderr_pipe();
+    err_pipe->read_bytes_async(kReadBytes, [run, err_pipe](const Glib::RefPtr<Gio::AsyncResult> &res)
+                               {
+        Glib::RefPtr<Glib::Bytes> bytes;
+        try
+        {
+            bytes = err_pipe->read_bytes_finish(res);
+        }
+        catch (const Glib::Error &)
+        {
+            return;
+        }
+
+        gsize size = 0;
+        auto data = bytes ? static_cast<const char *>(bytes->get_data(size)) : nullptr;
+        if (!data || size == 0)
+            return;
+
+        // Keep only the tail for the status line.
+        run->errors.append(data, size);
+        if (run->errors.size() > kStderrTail)
+            run->errors.erase(0, run->errors.size() - kStderrTail);
+        read_stderr(run); }, run->cancellable);
+}
+
+void FilterCommandDialog::maybe_finish(const std::shared_ptr<Run> &run)
+{
+    if (run->stdout_done && run->exited && run->owner)
+        run->owner->finish(run);
+}
+
+void FilterCommandDialog::finish(const std::shared_ptr<Run> &run)
+{
+    if (run != m_run_state)
+        return;
+    m_run_state.reset();
+    set_running(false);
+
+    auto cleanup = [this, run]()
+    {
+        m_buffer->delete_mark(run->start);
+        m_buffer->delete_mark(run->end);
+    };
+
+    if (run->cancellable->is_cancelled())
+    {
+        cleanup();
+        m_progress.set_fraction(0.0);
+        set_status("Cancelled; document unchanged.");
+        return;
+    }
+
+    if (run->failed)
+    {
+        cleanup();
+        set_status("Reading output failed: " + run->failure);
+        return;
+    }
+
+    if (!run->process->get_successful())
+    {
+        cleanup();
+        Glib::ustring msg = "Command failed";
+        if (run->process->get_if_exited())
+            msg += " (exit " + std::to_string(run->process->get_exit_status()) + ")";
+        auto tail = run->errors;
+        while (!tail.empty() && (tail.back() == '\n' || tail.back() == '\r'))
+            tail.pop_back();
+        if (!tail.empty() && g_utf8_validate(tail.data(), static_cast<gssize>(tail.size()), nullptr))
+            msg += ": " + tail.substr(tail.rfind('\n') == std::string::npos ? 0 : tail.rfind('\n') + 1);
+        set_status(msg + "; document unchanged.");
+        return;
+    }
+
+    if (!g_utf8_validate(run->output.data(), static_cast<gssize>(run->output.size()), nullptr))
+    {
+        cleanup();
+        set_status("Output is not valid UTF-8; document unchanged.");
+        return;
+    }
+
+    {
+        TRACE_SCOPE("filter.replace");
+
+        // One user action: a single Undo restores the original text.
+        m_buffer->begin_user_action();
+        auto pos = m_buffer->erase(m_buffer->get_iter_at_mark(run->start), m_buffer->get_iter_at_mark(run->end));
+        m_buffer->insert(pos, run->output.data(), run->output.data() + run->output.size());
+        m_buffer->end_user_action();
+    }
+
+    cleanup();
+    m_progress.set_fraction(1.0);
+    set_status("Replaced " + std::to_string(run->end_offset - run->start_offset) + " chars with " +
+               std::to_string(run->output.size()) + " bytes of output.");
+}
+
+void FilterCommandDialog::update_progress()
+{
+    if (!m_run_state)
+        return;
+
+    const auto &run = *m_run_state;
+    const int total = run.end_offset - run.start_offset;
+    m_progress.set_fraction(total > 0 ? static_cast<double>(run.sent) / total : 1.0);
+    m_progress.set_text("sent " + std::to_string(run.sent) + " of " + std::to_string(total) +
+                        " chars, read " + std::to_string(run.output.size()) + " bytes");
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <gtkmm.h>
+#include <memory>
+#include <string>
+
+// "Filter through command…": pipes the selection (or the whole document)
+// through a shell command and replaces it with the command's output as a
+// single undoable edit.
+//
+// The text is written to the child's stdin a chunk at a time while stdout
+// and stderr are drained concurrently, so neither side can block the other
+// however large the input or output is.
+class FilterCommandDialog {
+public:
+  FilterCommandDialog(Gtk::Window& parent, Gtk::TextView& textview);
+  ~FilterCommandDialog();
+
+  void present();
+
+private:
+  Gtk::Window& m_parent;
+  Gtk::TextView& m_textview;
+  Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+
+  // UI
+  Gtk::Window m_win;
+  Gtk::Box m_root{Gtk::Orientation::VERTICAL};
+  Gtk::Box m_row1{Gtk::Orientation::HORIZONTAL};
+  Gtk::Box m_buttons{Gtk::Orientation::HORIZONTAL};
+
+  Gtk::Entry m_command;
+  Gtk::ProgressBar m_progress;
+  Gtk::Button m_run{"Run"};
+  Gtk::Button m_cancel{"Cancel"};
+  Gtk::Button m_close{"Close"};
+
+  Gtk::Label m_status{"Enter a command, e.g. sort -u"};
+
+  // One run of the command; async callbacks hold a reference and check
+  // `owner` so they are harmless after the dialog is gone.
+  struct Run {
+    FilterCommandDialog* owner = nullptr;
+    Glib::RefPtr<Gio::Subprocess> process;
+    Glib::RefPtr<Gio::Cancellable> cancellable;
+    Glib::RefPtr<Gtk::TextBuffer::Mark> start;
+    Glib::RefPtr<Gtk::TextBuffer::Mark> end;
+    int start_offset = 0;
+    int end_offset = 0;
+    int sent = 0;             // characters written to stdin
+    std::string chunk;        // stdin chunk in flight
+    std::string output;       // collected stdout
+    std::string errors;       // tail of stderr
+    bool stdout_done = false;
+    bool exited = false;
+    bool failed = false;
+    std::string failure;
+  };
+  std::shared_ptr<Run> m_run_state;
+
+private:
+  void build_ui();
+  void connect_signals();
+
+  void on_run();
+  void on_cancel();
+
+  static void write_next(const std::shared_ptr<Run>& run);
+  static void read_stdout(const std::shared_ptr<Run>& run);
+  static void read_stderr(const std::shared_ptr<Run>& run);
+  static void maybe_finish(const std::shared_ptr<Run>& run);
+
+  void finish(const std::shared_ptr<Run>& run);
+  void update_progress();
+  void set_running(bool running);
+  void set_status(const Glib::ustring& s);
+};
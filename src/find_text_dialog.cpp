@@ -1,7 +1,10 @@
 #include "find_text_dialog.hpp"
 
-FindTextDialog::FindTextDialog(Gtk::Window &parent, Gtk::TextView &textview)
-    : m_parent(parent), m_textview(textview)
+#include "buffer_search.hpp"
+#include "trace.hpp"
+
+FindTextDialog::FindTextDialog(Gtk::Window &parent, Gtk::TextView &textview, MatchIndex &matches)
+    : m_parent(parent), m_textview(textview), m_matches(matches), m_scope(textview.get_buffer(), "find_scope")
 {
     m_buffer = m_textview.get_buffer();
 
@@ -26,6 +29,17 @@ FindTextDialog::~FindTextDialog()
 
 void FindTextDialog::present()
 {
+    // A selection over several lines is a block to search in, not a term.
+    Gtk::TextBuffer::iterator s, e;
+    if (m_buffer->get_selection_bounds(s, e) && s.get_line() != e.get_line())
+    {
+        m_scope.clear();
+        if (m_in_selection.get_active())
+            on_scope_toggled();
+        else
+            m_in_selection.set_active(true);
+    }
+
     m_win.present();
     m_query.grab_focus();
 }
@@ -58,8 +72,11 @@ void FindTextDialog::build_ui()
     m_highlight_all.set_active(true);
 
     m_row2.append(m_case);
+    m_row2.append(m_word);
+    m_row2.append(m_regex);
     m_row2.append(m_wrap);
     m_row2.append(m_highlight_all);
+    m_row2.append(m_in_selection);
 
     // spacer
     auto spacer = Gtk::make_managed<Gtk::Label>("");
@@ -91,16 +108,32 @@ void FindTextDialog::connect_signals()
     m_query.signal_activate().connect(sigc::mem_fun(*this, &FindTextDialog::on_next));
 
     m_case.signal_toggled().connect(sigc::mem_fun(*this, &FindTextDialog::on_options_changed));
+    m_word.signal_toggled().connect(sigc::mem_fun(*this, &FindTextDialog::on_options_changed));
+    m_regex.signal_toggled().connect(sigc::mem_fun(*this, &FindTextDialog::on_options_changed));
     m_wrap.signal_toggled().connect(sigc::mem_fun(*this, &FindTextDialog::on_options_changed));
     m_highlight_all.signal_toggled().connect(sigc::mem_fun(*this, &FindTextDialog::on_options_changed));
+    m_in_selection.signal_toggled().connect(sigc::mem_fun(*this, &FindTextDialog::on_scope_toggled));
 }
 
-Gtk::TextSearchFlags FindTextDialog::search_flags() const
+SearchOptions FindTextDialog::search_options() const
 {
-    Gtk::TextSearchFlags flags{};
-    if (!m_case.get_active())
-        flags |= Gtk::TextSearchFlags::CASE_INSENSITIVE;
-    return flags;
+    SearchOptions opts;
+    opts.case_sensitive = m_case.get_active();
+    opts.whole_word = m_word.get_active();
+    opts.regex = m_regex.get_active();
+    opts.wrap = m_wrap.get_active();
+    return opts;
+}
+
+bool FindTextDialog::make_engine(const Glib::ustring &term, SearchEngine &out)
+{
+    out = SearchEngine(term.raw(), search_options());
+    if (!out.valid())
+    {
+        set_status("Invalid pattern: " + out.error());
+        return false;
+    }
+    return true;
 }
 
 void FindTextDialog::set_status(const Glib::ustring &s)
@@ -113,66 +146,44 @@ void FindTextDialog::clear_highlights()
     auto start = m_buffer->begin();
     auto end = m_buffer->end();
     m_buffer->remove_tag_by_name("find_hl", start, end);
+    m_matches.set_tagged(0);
+    m_matches.assign({});
 }
 
-void FindTextDialog::highlight_all(const Glib::ustring &term, Gtk::TextSearchFlags flags)
+void FindTextDialog::highlight_all(const SearchEngine &engine)
 {
+    TRACE_SCOPE("find.highlight_all");
+
     clear_highlights();
-    if (term.empty())
+    if (!engine.valid())
         return;
 
-    auto it = m_buffer->begin();
-    Gtk::TextBuffer::iterator s, e;
+    auto matches = buffer_search::match_offsets(m_buffer, engine, m_scope.start(), m_scope.end());
 
-    while (find_from(it, term, flags, s, e))
     {
-        m_buffer->apply_tag_by_name("find_hl", s, e);
-        it = e;
+        TRACE_SCOPE("find.apply_tags");
+        for (const auto &[s, e] : matches)
+            m_buffer->apply_tag_by_name("find_hl", m_buffer->get_iter_at_offset(s), m_buffer->get_iter_at_offset(e));
     }
+
+    m_matches.set_tagged(matches.size());
+    m_matches.assign(std::move(matches));
 }
 
 bool FindTextDialog::find_from(Gtk::TextBuffer::iterator from,
-                               const Glib::ustring &term,
-                               Gtk::TextSearchFlags flags,
+                               const SearchEngine &engine,
                                Gtk::TextBuffer::iterator &out_start,
                                Gtk::TextBuffer::iterator &out_end)
 {
-    out_start = from;
-    out_end = from;
-    return out_start.forward_search(term, flags, out_start, out_end);
+    return buffer_search::find_forward(m_buffer, engine, from, m_scope.end(), out_start, out_end);
 }
 
-// GTKmm doesn’t provide a neat “backward_search” helper on iterator in all versions,
-// so we implement prev by scanning forward and remembering the last match before "from".
 bool FindTextDialog::find_backward_from(Gtk::TextBuffer::iterator from,
-                                        const Glib::ustring &term,
-                                        Gtk::TextSearchFlags flags,
+                                        const SearchEngine &engine,
                                         Gtk::TextBuffer::iterator &out_start,
                                         Gtk::TextBuffer::iterator &out_end)
 {
-    auto it = m_buffer->begin();
-    Gtk::TextBuffer::iterator s, e;
-
-    bool found = false;
-    Gtk::TextBuffer::iterator best_s = m_buffer->begin();
-    Gtk::TextBuffer::iterator best_e = m_buffer->begin();
-
-    while (find_from(it, term, flags, s, e))
-    {
-        // stop once match starts at/after "from"
-        if (s >= from)
-            break;
-        found = true;
-        best_s = s;
-        best_e = e;
-        it = e;
-    }
-
-    if (!found)
-        return false;
-    out_start = best_s;
-    out_end = best_e;
-    return true;
+    return buffer_search::find_backward(m_buffer, engine, m_scope.start(), from, m_scope.end(), out_start, out_end);
 }
 
 void FindTextDialog::select_and_scroll(Gtk::TextBuffer::iterator s,
@@ -192,16 +203,29 @@ void FindTextDialog::on_term_changed()
     m_has_last = false;
 
     auto term = m_query.get_text();
-    if (m_highlight_all.get_active())
+    if (term.empty())
     {
-        highlight_all(term, search_flags());
+        clear_highlights();
+        set_status("Type a term and press Next.");
+        return;
     }
-    else
+
+    SearchEngine engine;
+    if (!make_engine(term, engine))
     {
         clear_highlights();
+        return;
     }
 
-    set_status(term.empty() ? "Type a term and press Next." : "Ready.");
+    if (m_highlight_all.get_active())
+    {
+        highlight_all(engine);
+        set_status(std::to_string(m_matches.size()) + " match(es).");
+        return;
+    }
+
+    clear_highlights();
+    set_status("Ready.");
 }
 
 void FindTextDialog::on_options_changed()
@@ -209,6 +233,24 @@ void FindTextDialog::on_options_changed()
     on_term_changed();
 }
 
+void FindTextDialog::on_scope_toggled()
+{
+    if (m_in_selection.get_active() && !m_scope.active())
+    {
+        if (!m_scope.set_from_selection())
+        {
+            m_in_selection.set_active(false);
+            set_status("Select the text to search in first.");
+            return;
+        }
+    }
+    else if (!m_in_selection.get_active())
+    {
+        m_scope.clear();
+    }
+    on_term_changed();
+}
+
 void FindTextDialog::on_next()
 {
     const auto term = m_query.get_text();
@@ -218,7 +260,10 @@ void FindTextDialog::on_next()
         return;
     }
 
-    auto flags = search_flags();
+    SearchEngine engine;
+    if (!make_engine(term, engine))
+        return;
+
     Gtk::TextBuffer::iterator s, e;
 
     // Start search from end of last match, or current cursor position
@@ -231,8 +276,10 @@ void FindTextDialog::on_next()
     {
         start_from = m_buffer->get_insert()->get_iter();
     }
+    if (!m_scope.contains(start_from))
+        start_from = m_scope.start();
 
-    if (find_from(start_from, term, flags, s, e))
+    if (find_from(start_from, engine, s, e))
     {
         select_and_scroll(s, e);
         set_status("Match found.");
@@ -241,8 +288,8 @@ void FindTextDialog::on_next()
 
     if (m_wrap.get_active())
     {
-        auto begin = m_buffer->begin();
-        if (find_from(begin, term, flags, s, e))
+        auto begin = m_scope.start();
+        if (find_from(begin, engine, s, e))
         {
             select_and_scroll(s, e);
             set_status("Wrapped to start.");
@@ -262,7 +309,10 @@ void FindTextDialog::on_prev()
         return;
     }
 
-    auto flags = search_flags();
+    SearchEngine engine;
+    if (!make_engine(term, engine))
+        return;
+
     Gtk::TextBuffer::iterator s, e;
 
     // Search backward from start of last match, or cursor
@@ -275,8 +325,10 @@ void FindTextDialog::on_prev()
     {
         from = m_buffer->get_insert()->get_iter();
     }
+    if (!m_scope.contains(from))
+        from = m_scope.end();
 
-    if (find_backward_from(from, term, flags, s, e))
+    if (find_backward_from(from, engine, s, e))
     {
         select_and_scroll(s, e);
         set_status("Match found.");
@@ -286,8 +338,8 @@ void FindTextDialog::on_prev()
     if (m_wrap.get_active())
     {
         // wrap to end: find last match in buffer
-        auto endpos = m_buffer->end();
-        if (find_backward_from(endpos, term, flags, s, e))
+        auto endpos = m_scope.end();
+        if (find_backward_from(endpos, engine, s, e))
         {
             select_and_scroll(s, e);
             set_status("Wrapped to end.");
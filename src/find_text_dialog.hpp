@@ -1,18 +1,27 @@
 #pragma once
+#include "match_index.hpp"
+#include "search_engine.hpp"
+#include "search_scope.hpp"
+
 #include <gtkmm.h>
 #include <string>
 
 class FindTextDialog {
 public:
-  explicit FindTextDialog(Gtk::Window& parent, Gtk::TextView& textview);
+  FindTextDialog(Gtk::Window& parent, Gtk::TextView& textview, MatchIndex& matches);
   ~FindTextDialog();
 
   void present();
 
+  // The search term, as kept in the session file.
+  Glib::ustring term() const { return m_query.get_text(); }
+  void set_term(const Glib::ustring& term) { m_query.set_text(term); }
+
 private:
   Gtk::Window& m_parent;
   Gtk::TextView& m_textview;
   Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+  MatchIndex& m_matches;
 
   // UI
   Gtk::Window m_win;
@@ -22,8 +31,11 @@ private:
 
   Gtk::Entry m_query;
   Gtk::CheckButton m_case{"Case sensitive"};
+  Gtk::CheckButton m_word{"Whole word"};
+  Gtk::CheckButton m_regex{"Regex"};
   Gtk::CheckButton m_wrap{"Wrap around"};
   Gtk::CheckButton m_highlight_all{"Highlight all"};
+  Gtk::CheckButton m_in_selection{"In selection"};
 
   Gtk::Button m_prev{"Previous"};
   Gtk::Button m_next{"Next"};
@@ -32,6 +44,7 @@ private:
   Gtk::Label m_status{"Type a term and press Next."};
 
   // Search state
+  SearchScope m_scope;
   Gtk::TextBuffer::iterator m_last_start;
   Gtk::TextBuffer::iterator m_last_end;
   bool m_has_last = false;
@@ -44,21 +57,22 @@ private:
   void on_prev();
   void on_term_changed();
   void on_options_changed();
+  void on_scope_toggled();
 
   void clear_highlights();
-  void highlight_all(const Glib::ustring& term, Gtk::TextSearchFlags flags);
+  void highlight_all(const SearchEngine& engine);
 
-  Gtk::TextSearchFlags search_flags() const;
+  SearchOptions search_options() const;
+  // Builds the engine for the current term/options; reports bad patterns in the status line.
+  bool make_engine(const Glib::ustring& term, SearchEngine& out);
 
   bool find_from(Gtk::TextBuffer::iterator from,
-                 const Glib::ustring& term,
-                 Gtk::TextSearchFlags flags,
+                 const SearchEngine& engine,
                  Gtk::TextBuffer::iterator& out_start,
                  Gtk::TextBuffer::iterator& out_end);
 
   bool find_backward_from(Gtk::TextBuffer::iterator from,
-                          const Glib::ustring& term,
-                          Gtk::TextSearchFlags flags,
+                          const SearchEngine& engine,
                           Gtk::TextBuffer::iterator& out_start,
                           Gtk::TextBuffer::iterator& out_end);
 
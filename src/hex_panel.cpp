@@ -0,0 +1,255 @@
+#include "hex_panel.hpp"
+
+#include "byte_search.hpp"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+
+namespace
+{
+constexpr std::size_t kBytesPerRow = 16;
+// How much of a file looks_binary() inspects.
+constexpr std::size_t kSniffBytes = 64 * 1024;
+// Search slice between cancellation checks.
+constexpr std::size_t kSearchSlice = 64 * 1024 * 1024;
+// Rows shown above a match when scrolling to it.
+constexpr std::size_t kContextRows = 2;
+
+std::string hex_offset(std::size_t v)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "0x%zx", v);
+    return buf;
+}
+} // namespace
+
+HexPanel::HexPanel() : Gtk::Box(Gtk::Orientation::VERTICAL)
+{
+    set_spacing(6);
+
+    m_bar.set_spacing(6);
+    m_pattern.set_placeholder_text("Bytes: de ad be ef or \"text\"");
+    m_pattern.set_hexpand(true);
+    m_offset.set_placeholder_text("Go to offset (hex)");
+    m_offset.set_width_chars(18);
+    m_bar.append(m_pattern);
+    m_bar.append(m_find);
+    m_bar.append(m_offset);
+
+    m_rows.set_vexpand(true);
+    m_status.set_halign(Gtk::Align::START);
+
+    append(m_bar);
+    append(m_rows);
+    append(m_status);
+
+    m_find.signal_clicked().connect(sigc::mem_fun(*this, &HexPanel::on_find));
+    m_pattern.signal_activate().connect(sigc::mem_fun(*this, &HexPanel::on_find));
+    m_pattern.signal_changed().connect([this]()
+                                       { m_next_from = 0; });
+    m_offset.signal_activate().connect(sigc::mem_fun(*this, &HexPanel::on_goto));
+}
+
+HexPanel::~HexPanel()
+{
+    m_search.stop();
+}
+
+bool HexPanel::looks_binary(std::string_view data)
+{
+    const auto head = data.substr(0, kSniffBytes);
+    if (head.find('\0') != std::string_view::npos)
+        return true;
+
+    // A sequence cut off by the sniff window is not evidence of binary.
+    const char *end = nullptr;
+    if (g_utf8_validate(head.data(), static_cast<gssize>(head.size()), &end))
+        return false;
+    return head.size() < data.size() ? static_cast<std::size_t>(end - head.data()) + 4 < head.size() : true;
+}
+
+void HexPanel::set_file(std::shared_ptr<MappedFile> file)
+{
+    m_search.stop();
+    m_file = std::move(file);
+    m_next_from = 0;
+    m_rows.set_data(m_file ? m_file->view() : std::string_view{});
+    m_rows.scroll_to_row(0);
+    m_find.set_label("Find Next");
+    set_status(m_file ? m_file->path() + " — " + std::to_string(m_file->size()) + " bytes" : "");
+}
+
+void HexPanel::on_find()
+{
+    if (m_search.running())
+    {
+        m_search.cancel();
+        return;
+    }
+    if (!m_file)
+        return;
+
+    std::string needle, error;
+    if (!byte_search::parse_pattern(m_pattern.get_text().raw(), needle, error))
+    {
+        set_status(error);
+        return;
+    }
+
+    struct Found
+    {
+        std::size_t offset = std::string_view::npos;
+        bool wrapped = false;
+    };
+    auto found = std::make_shared<Found>();
+    auto file = m_file;
+    const std::size_t from = m_next_from;
+
+    m_find.set_label("Cancel");
+    set_status("Searching…");
+
+    m_search.start(
+        [file, needle, from, found](BackgroundTask::Control &control)
+        {
+            const std::string_view data = file->view();
+            // From `from` to the end, then from the top back to `from`.
+            auto scan = [&](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t pos = begin; pos < end; pos += kSearchSlice)
+                {
+                    if (control.cancel.load(std::memory_order_relaxed))
+                        return false;
+                    const std::size_t stop = std::min(end, pos + kSearchSlice);
+                    const auto hay = data.substr(0, std::min(data.size(), stop + needle.size() - 1));
+                    const auto hit = byte_search::find(hay, needle, pos);
+                    if (hit != std::string_view::npos && hit < stop)
+                    {
+                        found->offset = hit;
+                        return false;
+                    }
+                    control.progress.store(static_cast<double>(stop) / static_cast<double>(data.size()),
+                                           std::memory_order_relaxed);
+                }
+                return true;
+            };
+            if (scan(from, data.size()) && from > 0)
+            {
+                found->wrapped = true;
+                scan(0, from);
+            }
+        },
+        [this, found, needle](bool cancelled)
+        {
+            m_find.set_label("Find Next");
+            if (cancelled)
+            {
+                set_status("Search cancelled.");
+                return;
+            }
+            if (found->offset == std::string_view::npos)
+            {
+                m_rows.set_match(0, 0);
+                set_status("Not found.");
+                return;
+            }
+
+            m_rows.set_match(found->offset, needle.size());
+            const std::size_t row = found->offset / kBytesPerRow;
+            m_rows.scroll_to_row(row > kContextRows ? row - kContextRows : 0);
+            m_next_from = found->offset + 1;
+            set_status("Found at " + hex_offset(found->offset) + (found->wrapped ? " (wrapped)." : "."));
+        });
+}
+
+void HexPanel::on_goto()
+{
+    if (!m_file)
+        return;
+
+    auto text = m_offset.get_text().raw();
+    std::string_view v = text;
+    if (v.starts_with("0x") || v.starts_with("0X"))
+        v.remove_prefix(2);
+
+    std::size_t offset = 0;
+    const auto res = std::from_chars(v.data(), v.data() + v.size(), offset, 16);
+    if (res.ec != std::errc() || res.ptr != v.data() + v.size())
+    {
+        set_status("Not a hex offset: " + text);
+        return;
+    }
+    if (offset >= m_file->size())
+    {
+        set_status("Offset past the end (" + hex_offset(m_file->size()) + " bytes).");
+        return;
+    }
+    m_rows.scroll_to_row(offset / kBytesPerRow);
+    set_status("At " + hex_offset(offset) + ".");
+}
+
+void HexPanel::Rows::set_data(std::string_view data)
+{
+    m_data = data;
+    m_offset_digits = data.size() > 0xFFFFFFFFull ? 16 : 8;
+    m_match = m_match_len = 0;
+    set_row_count((data.size() + kBytesPerRow - 1) / kBytesPerRow);
+}
+
+void HexPanel::Rows::set_match(std::size_t offset, std::size_t length)
+{
+    m_match = offset;
+    m_match_len = length;
+    redraw();
+}
+
+void HexPanel::Rows::draw_row(const Cairo::RefPtr<Cairo::Context> &cr,
+                              const Glib::RefPtr<Pango::Layout> &layout, std::size_t row, double y, int)
+{
+    static constexpr char kHex[] = "0123456789abcdef";
+
+    const std::size_t begin = row * kBytesPerRow;
+    const std::size_t count = std::min(kBytesPerRow, m_data.size() - begin);
+    const auto *bytes = reinterpret_cast<const unsigned char *>(m_data.data() + begin);
+
+    // "00000000  de ad be ef 00 11 22 33  44 55 66 77 88 99 aa bb  |................|"
+    const int hex_col = m_offset_digits + 2;
+    const int ascii_col = hex_col + static_cast<int>(kBytesPerRow) * 3 + 2;
+    std::string line(static_cast<std::size_t>(ascii_col) + kBytesPerRow + 2, ' ');
+
+    for (int d = 0; d < m_offset_digits; ++d)
+        line[static_cast<std::size_t>(d)] = kHex[(begin >> (4 * (m_offset_digits - 1 - d))) & 0xF];
+    line[static_cast<std::size_t>(ascii_col)] = '|';
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const auto at = static_cast<std::size_t>(hex_col) + i * 3 + (i >= 8 ? 1 : 0);
+        line[at] = kHex[bytes[i] >> 4];
+        line[at + 1] = kHex[bytes[i] & 0xF];
+        line[static_cast<std::size_t>(ascii_col) + 1 + i] = (bytes[i] >= 0x20 && bytes[i] < 0x7F) ? static_cast<char>(bytes[i]) : '.';
+    }
+    line[static_cast<std::size_t>(ascii_col) + 1 + count] = '|';
+
+    // Match highlight behind the hex digits and the ASCII cells.
+    if (m_match_len > 0 && m_match < begin + count && m_match + m_match_len > begin)
+    {
+        const std::size_t from = std::max(m_match, begin) - begin;
+        const std::size_t to = std::min(m_match + m_match_len, begin + count) - begin;
+        const double cw = char_width();
+        cr->save();
+        cr->set_source_rgba(1.0, 0.85, 0.0, 0.5);
+        for (std::size_t i = from; i < to; ++i)
+        {
+            const double hx = 4.0 + cw * static_cast<double>(hex_col + static_cast<int>(i * 3 + (i >= 8 ? 1 : 0)));
+            cr->rectangle(hx, y, cw * 2, row_height());
+            cr->rectangle(4.0 + cw * static_cast<double>(ascii_col + 1 + static_cast<int>(i)), y, cw, row_height());
+        }
+        cr->fill();
+        cr->restore();
+    }
+
+    layout->set_text(line);
+    cr->move_to(4.0, y);
+    layout->show_in_cairo_context(cr);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "background_task.hpp"
+#include "mapped_file.hpp"
+#include "virtual_row_view.hpp"
+
+#include <gtkmm.h>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+// Hex view of a mapped file: offset, 16 bytes in hex and an ASCII gutter
+// per row. Only visible rows are formatted, straight from the mapping, so
+// a multi-gigabyte file opens instantly and costs no memory beyond the
+// mapping's resident pages.
+//
+// Byte patterns (hex pairs or a quoted string) are searched on a worker
+// thread with byte_search::find.
+class HexPanel : public Gtk::Box
+{
+public:
+  HexPanel();
+  ~HexPanel() override;
+
+  void set_file(std::shared_ptr<MappedFile> file);
+  const std::shared_ptr<MappedFile> &file() const { return m_file; }
+
+  // NUL bytes or invalid UTF-8 in the start of a file.
+  static bool looks_binary(std::string_view data);
+
+private:
+  class Rows : public VirtualRowView
+  {
+  public:
+    void set_data(std::string_view data);
+    void set_match(std::size_t offset, std::size_t length);
+
+  protected:
+    void draw_row(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                  std::size_t row, double y, int width) override;
+
+  private:
+    std::string_view m_data;
+    int m_offset_digits = 8;
+    std::size_t m_match = 0;
+    std::size_t m_match_len = 0;
+  };
+
+  std::shared_ptr<MappedFile> m_file;
+
+  Gtk::Box m_bar{Gtk::Orientation::HORIZONTAL};
+  Gtk::Entry m_pattern;
+  Gtk::Button m_find{"Find Next"};
+  Gtk::Entry m_offset;
+  Rows m_rows;
+  Gtk::Label m_status;
+
+  BackgroundTask m_search;
+  std::size_t m_next_from = 0; // where Find Next resumes
+
+  void on_find();
+  void on_goto();
+  void set_status(const Glib::ustring &s) { m_status.set_text(s); }
+};
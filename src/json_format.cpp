@@ -0,0 +1,457 @@
+#include "json_format.hpp"
+
+#include "trace.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JSON_FORMAT_SSE2 1
+#endif
+
+namespace
+{
+// Input bytes between cancellation / progress checks.
+constexpr std::size_t kCheckBytes = 1u << 20;
+
+bool is_ws(unsigned char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool is_digit(unsigned char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+bool is_hex(unsigned char c)
+{
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// What may follow a number or a literal: "0100" or "nulltrue" is not two
+// values run together, it is invalid.
+bool ends_token(unsigned char c)
+{
+    return is_ws(c) || c == ',' || c == ']' || c == '}' || c == ':';
+}
+
+// First byte at or after `i` that is not JSON whitespace, or `n`.
+std::size_t skip_ws(const unsigned char *p, std::size_t i, std::size_t n)
+{
+#ifdef JSON_FORMAT_SSE2
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        const __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, nl)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab)));
+        const unsigned other = ~static_cast<unsigned>(_mm_movemask_epi8(ws)) & 0xFFFFu;
+        if (other)
+            return i + static_cast<std::size_t>(std::countr_zero(other));
+    }
+#endif
+    while (i < n && is_ws(p[i]))
+        ++i;
+    return i;
+}
+
+// First '"', '\\' or control character at or after `i`, or `n`.
+std::size_t find_string_special(const unsigned char *p, std::size_t i, std::size_t n)
+{
+#ifdef JSON_FORMAT_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i ctl = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        // Control characters: unsigned v <= 0x1F.
+        const __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                             _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask)
+            return i + static_cast<std::size_t>(std::countr_zero(mask));
+    }
+#endif
+    while (i < n && p[i] != '"' && p[i] != '\\' && p[i] >= 0x20)
+        ++i;
+    return i;
+}
+
+class Formatter
+{
+public:
+    Formatter(std::string_view text, JsonStyle style, int indent, std::string &out, JsonError &error)
+        : m_p(reinterpret_cast<const unsigned char *>(text.data())), m_n(text.size()), m_pretty(style == JsonStyle::Pretty),
+          m_indent(indent < 0 ? 0 : static_cast<std::size_t>(indent)), m_out(out), m_error(error)
+    {
+    }
+
+    bool run(const std::atomic<bool> *cancel, std::atomic<double> *progress);
+
+private:
+    // What may come next.
+    enum class Expect
+    {
+        Value,
+        ValueOrEnd, // just after '['
+        Key,
+        KeyOrEnd,   // just after '{'
+        Colon,
+        CommaOrEnd,
+        Top,        // between top-level values
+    };
+
+    struct Open
+    {
+        char close;
+        std::size_t offset;
+    };
+
+    const unsigned char *m_p;
+    std::size_t m_n;
+    std::size_t m_i = 0;
+    bool m_pretty;
+    std::size_t m_indent;
+    std::string &m_out;
+    JsonError &m_error;
+    std::vector<Open> m_stack;
+
+    bool fail(std::size_t offset, std::string message)
+    {
+        m_error.offset = offset;
+        m_error.message = std::move(message);
+        return false;
+    }
+    bool unexpected(const char *wanted);
+
+    void newline()
+    {
+        if (!m_pretty)
+            return;
+        m_out += '\n';
+        m_out.append(m_stack.size() * m_indent, ' ');
+    }
+
+    Expect after_value() const { return m_stack.empty() ? Expect::Top : Expect::CommaOrEnd; }
+
+    bool value(Expect &expect);
+    bool string();
+    bool number();
+    bool literal(const char *word);
+    bool close(unsigned char c);
+};
+
+bool Formatter::unexpected(const char *wanted)
+{
+    if (m_i >= m_n)
+        return fail(m_n, std::string("Unexpected end of input; expected ") + wanted);
+    const unsigned char c = m_p[m_i];
+    std::string found = c >= 0x20 && c < 0x7F ? std::string("'") + static_cast<char>(c) + "'" : "a non-ASCII character";
+    if (c < 0x20)
+        found = "a control character";
+    return fail(m_i, "Expected " + std::string(wanted) + ", found " + found);
+}
+
+bool Formatter::run(const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    Expect expect = Expect::Value;
+    bool any = false;
+    std::size_t next_check = kCheckBytes;
+
+    for (;;)
+    {
+        m_i = skip_ws(m_p, m_i, m_n);
+        if (m_i >= m_n)
+            break;
+
+        if (m_i >= next_check)
+        {
+            if (cancel && cancel->load(std::memory_order_relaxed))
+            {
+                m_error = JsonError{};
+                return false;
+            }
+            if (progress)
+                progress->store(static_cast<double>(m_i) / static_cast<double>(m_n), std::memory_order_relaxed);
+            next_check = m_i + kCheckBytes;
+        }
+
+        const unsigned char c = m_p[m_i];
+        switch (expect)
+        {
+        case Expect::Top:
+            // Top-level values (JSON Lines) are whitespace-separated.
+            if (!is_ws(m_p[m_i - 1]))
+                return unexpected("whitespace between top-level values");
+            m_out += '\n';
+            [[fallthrough]];
+        case Expect::Value:
+            any = true;
+            if (!value(expect))
+                return false;
+            break;
+        case Expect::ValueOrEnd:
+            if (c == ']')
+            {
+                if (!close(c))
+                    return false;
+                expect = after_value();
+                break;
+            }
+            newline();
+            if (!value(expect))
+                return false;
+            break;
+        case Expect::KeyOrEnd:
+            if (c == '}')
+            {
+                if (!close(c))
+                    return false;
+                expect = after_value();
+                break;
+            }
+            if (c != '"')
+                return unexpected("a string key or '}'");
+            newline();
+            if (!string())
+                return false;
+            expect = Expect::Colon;
+            break;
+        case Expect::Key:
+            if (c != '"')
+                return unexpected("a string key");
+            if (!string())
+                return false;
+            expect = Expect::Colon;
+            break;
+        case Expect::Colon:
+            if (c != ':')
+                return unexpected("':'");
+            ++m_i;
+            m_out += m_pretty ? ": " : ":";
+            expect = Expect::Value;
+            break;
+        case Expect::CommaOrEnd:
+            if (c == ',')
+            {
+                ++m_i;
+                m_out += ',';
+                newline();
+                expect = m_stack.back().close == '}' ? Expect::Key : Expect::Value;
+                break;
+            }
+            if (c != '}' && c != ']')
+                return unexpected(m_stack.back().close == '}' ? "',' or '}'" : "',' or ']'");
+            if (m_pretty)
+            {
+                m_out += '\n';
+                m_out.append((m_stack.size() - 1) * m_indent, ' ');
+            }
+            if (!close(c))
+                return false;
+            expect = after_value();
+            break;
+        }
+    }
+
+    if (!m_stack.empty())
+        return fail(m_n, std::string("Unexpected end of input; '") + (m_stack.back().close == '}' ? "{" : "[") +
+                             "' at byte " + std::to_string(m_stack.back().offset) + " is not closed");
+    if (expect != Expect::Top)
+        return any ? unexpected("a value") : fail(0, "No JSON value");
+
+    if (m_n > 0 && m_p[m_n - 1] == '\n')
+        m_out += '\n';
+    if (progress)
+        progress->store(1.0, std::memory_order_relaxed);
+    return true;
+}
+
+bool Formatter::value(Expect &expect)
+{
+    const unsigned char c = m_p[m_i];
+    switch (c)
+    {
+    case '{':
+    case '[':
+        m_stack.push_back({c == '{' ? '}' : ']', m_i});
+        m_out += static_cast<char>(c);
+        ++m_i;
+        expect = c == '{' ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+        return true;
+    case '"':
+        if (!string())
+            return false;
+        break;
+    case 't':
+        if (!literal("true"))
+            return false;
+        break;
+    case 'f':
+        if (!literal("false"))
+            return false;
+        break;
+    case 'n':
+        if (!literal("null"))
+            return false;
+        break;
+    default:
+        if (c != '-' && !is_digit(c))
+            return unexpected("a value");
+        if (!number())
+            return false;
+        break;
+    }
+    expect = after_value();
+    return true;
+}
+
+bool Formatter::string()
+{
+    const std::size_t start = m_i;
+    std::size_t i = m_i + 1;
+    for (;;)
+    {
+        i = find_string_special(m_p, i, m_n);
+        if (i >= m_n)
+            return fail(start, "Unterminated string");
+        const unsigned char c = m_p[i];
+        if (c == '"')
+            break;
+        if (c < 0x20)
+            return fail(i, "Control character in string; it must be escaped");
+
+        // A backslash: check the escape.
+        if (i + 1 >= m_n)
+            return fail(start, "Unterminated string");
+        switch (m_p[i + 1])
+        {
+        case '"':
+        case '\\':
+        case '/':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+            i += 2;
+            break;
+        case 'u':
+            for (std::size_t k = 2; k < 6; ++k)
+                if (i + k >= m_n || !is_hex(m_p[i + k]))
+                    return fail(i, "Invalid \\u escape; expected four hex digits");
+            i += 6;
+            break;
+        default:
+            return fail(i, "Invalid escape sequence");
+        }
+    }
+    ++i;
+    m_out.append(reinterpret_cast<const char *>(m_p + start), i - start);
+    m_i = i;
+    return true;
+}
+
+bool Formatter::number()
+{
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    const std::size_t start = m_i;
+    std::size_t i = m_i;
+    auto digits = [&]()
+    {
+        const std::size_t from = i;
+        while (i < m_n && is_digit(m_p[i]))
+            ++i;
+        return i > from;
+    };
+
+    if (m_p[i] == '-')
+        ++i;
+    if (i < m_n && m_p[i] == '0')
+        ++i;
+    else if (!digits())
+        return fail(i, "Invalid number; expected a digit");
+    if (i < m_n && m_p[i] == '.')
+    {
+        ++i;
+        if (!digits())
+            return fail(i, "Invalid number; expected a digit after '.'");
+    }
+    if (i < m_n && (m_p[i] == 'e' || m_p[i] == 'E'))
+    {
+        ++i;
+        if (i < m_n && (m_p[i] == '+' || m_p[i] == '-'))
+            ++i;
+        if (!digits())
+            return fail(i, "Invalid number; expected a digit in the exponent");
+    }
+    if (i < m_n && !ends_token(m_p[i]))
+        return fail(i, "Invalid number; unexpected character after it");
+    m_out.append(reinterpret_cast<const char *>(m_p + start), i - start);
+    m_i = i;
+    return true;
+}
+
+bool Formatter::literal(const char *word)
+{
+    const std::size_t len = std::strlen(word);
+    if (m_n - m_i < len || std::memcmp(m_p + m_i, word, len) != 0)
+        return unexpected("a value");
+    if (m_i + len < m_n && !ends_token(m_p[m_i + len]))
+        return fail(m_i + len, std::string("Unexpected character after '") + word + "'");
+    m_out.append(word, len);
+    m_i += len;
+    return true;
+}
+
+bool Formatter::close(unsigned char c)
+{
+    if (m_stack.empty() || m_stack.back().close != static_cast<char>(c))
+        return fail(m_i, std::string("Mismatched '") + static_cast<char>(c) + "'");
+    m_stack.pop_back();
+    m_out += static_cast<char>(c);
+    ++m_i;
+    return true;
+}
+} // namespace
+
+bool parse_json_style(std::string_view name, JsonStyle &out)
+{
+    if (name == "format")
+        out = JsonStyle::Pretty;
+    else if (name == "minify")
+        out = JsonStyle::Minify;
+    else
+        return false;
+    return true;
+}
+
+const char *json_style_label(JsonStyle style)
+{
+    return style == JsonStyle::Pretty ? "Format JSON" : "Minify JSON";
+}
+
+bool format_json(std::string_view text, JsonStyle style, int indent, std::string &out, JsonError &error,
+                 const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    TRACE_SCOPE("json.format");
+    out.clear();
+    error = JsonError{};
+    // Minified output is at most the input; pretty output usually a bit more.
+    out.reserve(style == JsonStyle::Pretty ? text.size() + text.size() / 4 : text.size());
+
+    Formatter formatter(text, style, indent, out, error);
+    if (formatter.run(cancel, progress))
+        return true;
+    out.clear();
+    out.shrink_to_fit();
+    return false;
+}
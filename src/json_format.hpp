@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+enum class JsonStyle
+{
+  Pretty, // one member or element per line, indented
+  Minify, // no insignificant whitespace
+};
+
+// Parses the names used by the "win.json" action ("format", "minify").
+bool parse_json_style(std::string_view name, JsonStyle &out);
+// Status-line name, e.g. "Format JSON".
+const char *json_style_label(JsonStyle style);
+
+struct JsonError
+{
+  std::size_t offset = 0; // bytes into the input
+  std::string message;    // empty when cancelled
+};
+
+// Re-emits the JSON in `text` in `style`, validating it on the way.
+//
+// A single forward pass with an explicit container stack (no recursion, so
+// nesting depth is unbounded) and no tree: tokens are copied to `out` as
+// they are read. Whitespace runs and string bodies are skipped 16 bytes at
+// a time with SSE2 where available. Several top-level values (JSON Lines)
+// come out one per line; a trailing newline is preserved.
+//
+// Returns false on invalid input, with `error` set to the offending byte,
+// or when cancelled. `progress` (0..1) follows the input.
+bool format_json(std::string_view text, JsonStyle style, int indent, std::string &out, JsonError &error,
+                 const std::atomic<bool> *cancel = nullptr, std::atomic<double> *progress = nullptr);
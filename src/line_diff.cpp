@@ -0,0 +1,464 @@
+#include "line_diff.hpp"
+
+#include "content_hash.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace
+{
+// Lines per parallel hashing job.
+constexpr std::size_t kLinesPerJob = 1 << 16;
+// Regions up to this many lines (both sides) skip the anchor search.
+constexpr std::uint32_t kSmallRegion = 64;
+// Diagonal and snake steps between looks at the clock.
+constexpr std::uint64_t kStepsPerCheck = 1 << 16;
+// Anchor table: no line yet, and a line seen more than once.
+constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+constexpr std::uint32_t kMany = kNone - 1;
+
+using Kind = DiffBlock::Kind;
+
+std::string_view line_text(std::string_view text, const LineIndex &lines, std::size_t line)
+{
+    const auto begin = lines.line_start(line);
+    const auto end = line + 1 < lines.line_count() ? lines.line_start(line + 1) - 1 : text.size();
+    return text.substr(static_cast<std::size_t>(begin), static_cast<std::size_t>(end - begin));
+}
+
+void hash_lines(std::string_view text, const LineIndex &lines, std::vector<std::uint64_t> &out)
+{
+    const std::size_t n = lines.line_count();
+    out.resize(n);
+    parallel_for((n + kLinesPerJob - 1) / kLinesPerJob, [&](std::size_t job)
+                 {
+        const std::size_t end = std::min(n, (job + 1) * kLinesPerJob);
+        for (std::size_t i = job * kLinesPerJob; i < end; ++i)
+            out[i] = content_hash::xxh64(line_text(text, lines, i)); });
+}
+
+// The diff proper, over line hashes. Regions wait on an explicit stack,
+// pushed so that they come off in text order: every block is emitted
+// after the one before it.
+class Differ
+{
+public:
+    Differ(const std::vector<std::uint64_t> &a, const std::vector<std::uint64_t> &b,
+           std::chrono::steady_clock::time_point deadline, const std::atomic<bool> *cancel,
+           std::atomic<double> *progress, std::vector<DiffBlock> &out)
+        : m_a(a), m_b(b), m_deadline(deadline), m_cancel(cancel), m_progress(progress), m_out(out)
+    {
+    }
+
+    // False if cancelled.
+    bool run()
+    {
+        const double total = static_cast<double>(m_a.size() + m_b.size());
+        m_stack.push_back({0, static_cast<std::uint32_t>(m_a.size()), 0, static_cast<std::uint32_t>(m_b.size()), false});
+        while (!m_stack.empty())
+        {
+            if (m_cancel && m_cancel->load(std::memory_order_relaxed))
+                return false;
+            const Region r = m_stack.back();
+            m_stack.pop_back();
+            if (r.equal)
+                emit(Kind::Equal, r.a1 - r.a0, r.b1 - r.b0);
+            else
+                diff(r);
+            if (m_progress && total > 0)
+                m_progress->store(static_cast<double>(m_a_pos + m_b_pos) / total, std::memory_order_relaxed);
+        }
+        return !(m_cancel && m_cancel->load(std::memory_order_relaxed));
+    }
+
+    bool coarse() const { return m_coarse; }
+
+private:
+    struct Region
+    {
+        std::uint32_t a0, a1, b0, b1;
+        bool equal; // a run of equal lines, already matched
+    };
+
+    struct Slot
+    {
+        std::uint64_t hash;
+        std::uint32_t a; // kNone: empty slot
+        std::uint32_t b;
+    };
+
+    const std::vector<std::uint64_t> &m_a;
+    const std::vector<std::uint64_t> &m_b;
+    std::chrono::steady_clock::time_point m_deadline;
+    const std::atomic<bool> *m_cancel;
+    std::atomic<double> *m_progress;
+    std::vector<DiffBlock> &m_out;
+
+    std::vector<Region> m_stack;
+    std::vector<Slot> m_slots;
+    std::vector<std::int32_t> m_v;
+    std::vector<std::int32_t> m_trace;
+    std::uint32_t m_a_pos = 0;
+    std::uint32_t m_b_pos = 0;
+    std::uint64_t m_steps = 0;
+    std::uint64_t m_next_check = kStepsPerCheck;
+    bool m_coarse = false;
+
+    bool out_of_budget() const
+    {
+        return (m_cancel && m_cancel->load(std::memory_order_relaxed)) ||
+               std::chrono::steady_clock::now() >= m_deadline;
+    }
+
+    // Counts `steps` of work and, every kStepsPerCheck of them, looks at
+    // the budget; a step count, unlike the edit cost, follows the time a
+    // region really takes (long snakes cost as much as many edits).
+    bool spent(std::uint64_t steps)
+    {
+        m_steps += steps;
+        if (m_steps < m_next_check)
+            return false;
+        m_next_check = m_steps + kStepsPerCheck;
+        return out_of_budget();
+    }
+
+    // Appends lines to the script. Neighbouring non-equal runs become one
+    // block, so a replacement shows as a single Change.
+    void emit(Kind kind, std::uint32_t a_count, std::uint32_t b_count)
+    {
+        if (a_count == 0 && b_count == 0)
+            return;
+        const bool equal = kind == Kind::Equal;
+        if (!m_out.empty() && (m_out.back().kind == Kind::Equal) == equal)
+        {
+            auto &last = m_out.back();
+            last.a_count += a_count;
+            last.b_count += b_count;
+            if (!equal)
+                last.kind = last.a_count == 0 ? Kind::Insert : last.b_count == 0 ? Kind::Delete : Kind::Change;
+        }
+        else
+        {
+            m_out.push_back({kind, m_a_pos, a_count, m_b_pos, b_count});
+        }
+        m_a_pos += a_count;
+        m_b_pos += b_count;
+    }
+
+    void give_up(const Region &r)
+    {
+        m_coarse = true;
+        emit(Kind::Delete, r.a1 - r.a0, 0);
+        emit(Kind::Insert, 0, r.b1 - r.b0);
+    }
+
+    void diff(Region r)
+    {
+        // Common prefix now, common suffix after the middle.
+        std::uint32_t prefix = 0;
+        while (r.a0 + prefix < r.a1 && r.b0 + prefix < r.b1 && m_a[r.a0 + prefix] == m_b[r.b0 + prefix])
+            ++prefix;
+        emit(Kind::Equal, prefix, prefix);
+        r.a0 += prefix;
+        r.b0 += prefix;
+
+        std::uint32_t suffix = 0;
+        while (r.a1 - suffix > r.a0 && r.b1 - suffix > r.b0 && m_a[r.a1 - 1 - suffix] == m_b[r.b1 - 1 - suffix])
+            ++suffix;
+        r.a1 -= suffix;
+        r.b1 -= suffix;
+        if (suffix > 0)
+            m_stack.push_back({r.a1, r.a1 + suffix, r.b1, r.b1 + suffix, true});
+
+        if (r.a0 == r.a1 || r.b0 == r.b1)
+        {
+            emit(r.a0 == r.a1 ? Kind::Insert : Kind::Delete, r.a1 - r.a0, r.b1 - r.b0);
+            return;
+        }
+        if (out_of_budget())
+        {
+            give_up(r);
+            return;
+        }
+        if ((r.a1 - r.a0) + (r.b1 - r.b0) > kSmallRegion && split_on_unique_lines(r))
+            return;
+        myers(r);
+    }
+
+    Slot &slot(std::uint64_t hash)
+    {
+        const std::size_t mask = m_slots.size() - 1;
+        for (std::size_t i = static_cast<std::size_t>(hash) & mask;; i = (i + 1) & mask)
+        {
+            auto &s = m_slots[i];
+            if (s.a == kNone || s.hash == hash)
+                return s;
+        }
+    }
+
+    // Patience step: lines occurring exactly once on each side, kept where
+    // they appear in the same order on both (longest increasing run of
+    // their new-side positions), are matched; the gaps between them are
+    // pushed as regions of their own. False if there is no such line.
+    bool split_on_unique_lines(const Region &r)
+    {
+        m_slots.assign(std::bit_ceil(std::size_t{2} * (r.a1 - r.a0)), Slot{0, kNone, kNone});
+        for (std::uint32_t i = r.a0; i < r.a1; ++i)
+        {
+            auto &s = slot(m_a[i]);
+            if (s.a == kNone)
+                s = Slot{m_a[i], i, kNone};
+            else
+                s.a = kMany;
+        }
+        for (std::uint32_t j = r.b0; j < r.b1; ++j)
+        {
+            auto &s = slot(m_b[j]);
+            if (s.a != kNone && s.a != kMany)
+                s.b = s.b == kNone ? j : kMany;
+        }
+
+        // Candidates in old-side order; `tails[k]` ends the best run of
+        // length k + 1 seen so far.
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+        for (std::uint32_t i = r.a0; i < r.a1; ++i)
+        {
+            const auto &s = slot(m_a[i]);
+            if (s.a == i && s.b < kMany)
+                pairs.emplace_back(i, s.b);
+        }
+        if (pairs.empty())
+            return false;
+
+        std::vector<std::uint32_t> tails;
+        std::vector<std::uint32_t> prev(pairs.size(), kNone);
+        for (std::uint32_t p = 0; p < pairs.size(); ++p)
+        {
+            const auto it = std::lower_bound(tails.begin(), tails.end(), pairs[p].second,
+                                             [&](std::uint32_t t, std::uint32_t b)
+                                             { return pairs[t].second < b; });
+            if (it != tails.begin())
+                prev[p] = *(it - 1);
+            if (it == tails.end())
+                tails.push_back(p);
+            else
+                *it = p;
+        }
+
+        // Pushed last to first, so they come off in order. Anchors with
+        // nothing between them extend one equal run.
+        std::uint32_t next_a = r.a1, next_b = r.b1;
+        for (std::uint32_t p = tails.back(); p != kNone; p = prev[p])
+        {
+            const auto [i, j] = pairs[p];
+            if (i + 1 == next_a && j + 1 == next_b && !m_stack.empty() && m_stack.back().equal &&
+                m_stack.back().a0 == next_a && m_stack.back().b0 == next_b)
+            {
+                m_stack.back().a0 = i;
+                m_stack.back().b0 = j;
+            }
+            else
+            {
+                m_stack.push_back({i + 1, next_a, j + 1, next_b, false});
+                m_stack.push_back({i, i + 1, j, j + 1, true});
+            }
+            next_a = i;
+            next_b = j;
+        }
+        m_stack.push_back({r.a0, next_a, r.b0, next_b, false});
+        return true;
+    }
+
+    // Myers' greedy algorithm, keeping the furthest-reaching diagonals of
+    // every step for the walk back. Past kMaxCost steps (or the time
+    // budget) the region is left as one change.
+    void myers(const Region &r)
+    {
+        const auto n = static_cast<std::int32_t>(r.a1 - r.a0);
+        const auto m = static_cast<std::int32_t>(r.b1 - r.b0);
+        const std::int32_t max = static_cast<std::int32_t>(
+            std::min<std::int64_t>(std::int64_t{n} + m, LineDiff::kMaxCost));
+        const std::int32_t offset = max + 1;
+        m_v.assign(static_cast<std::size_t>(2 * max + 3), 0);
+        m_trace.clear();
+
+        const std::uint64_t *a = m_a.data() + r.a0;
+        const std::uint64_t *b = m_b.data() + r.b0;
+        std::int32_t *v = m_v.data() + offset;
+        for (std::int32_t d = 0; d <= max; ++d)
+        {
+            // Step d reads what steps before it left in v[-d..d].
+            m_trace.insert(m_trace.end(), v - d, v + d + 1);
+            for (std::int32_t k = -d; k <= d; k += 2)
+            {
+                std::int32_t x = (k == -d || (k != d && v[k - 1] < v[k + 1])) ? v[k + 1] : v[k - 1] + 1;
+                std::int32_t y = x - k;
+                const std::int32_t snake_from = x;
+                while (x < n && y < m && a[x] == b[y])
+                {
+                    ++x;
+                    ++y;
+                }
+                v[k] = x;
+                if (spent(static_cast<std::uint64_t>(x - snake_from) + 1))
+                {
+                    give_up(r);
+                    return;
+                }
+                if (x >= n && y >= m)
+                {
+                    walk_back(d, n, m);
+                    return;
+                }
+            }
+        }
+        give_up(r);
+    }
+
+    void walk_back(std::int32_t cost, std::int32_t x, std::int32_t y)
+    {
+        // Runs from the end backwards, then emitted forwards.
+        struct Run
+        {
+            Kind kind;
+            std::uint32_t count;
+        };
+        std::vector<Run> runs;
+        for (std::int32_t d = cost; d > 0; --d)
+        {
+            const std::int32_t *v = m_trace.data() + static_cast<std::size_t>(d) * d + d; // centred on k = 0
+            const std::int32_t k = x - y;
+            const bool down = k == -d || (k != d && v[k - 1] < v[k + 1]);
+            const std::int32_t prev_k = down ? k + 1 : k - 1;
+            const std::int32_t prev_x = v[prev_k];
+            const std::int32_t prev_y = prev_x - prev_k;
+            const std::int32_t start_x = down ? prev_x : prev_x + 1;
+            runs.push_back({Kind::Equal, static_cast<std::uint32_t>(x - start_x)});
+            runs.push_back({down ? Kind::Insert : Kind::Delete, 1});
+            x = prev_x;
+            y = prev_y;
+        }
+        runs.push_back({Kind::Equal, static_cast<std::uint32_t>(x)});
+
+        for (auto it = runs.rbegin(); it != runs.rend(); ++it)
+        {
+            switch (it->kind)
+            {
+            case Kind::Equal:
+                emit(Kind::Equal, it->count, it->count);
+                break;
+            case Kind::Delete:
+                emit(Kind::Delete, it->count, 0);
+                break;
+            default:
+                emit(Kind::Insert, 0, it->count);
+                break;
+            }
+        }
+    }
+};
+} // namespace
+
+void LineDiff::clear()
+{
+    m_a = {};
+    m_b = {};
+    m_a_lines.clear();
+    m_b_lines.clear();
+    m_blocks = {};
+    m_row_starts = {};
+    m_changes = 0;
+    m_deleted = 0;
+    m_inserted = 0;
+    m_valid = false;
+    m_coarse = false;
+    m_too_large = false;
+}
+
+bool LineDiff::build(std::string_view a, std::string_view b, std::chrono::milliseconds budget,
+                     const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    TRACE_SCOPE("diff.build");
+    clear();
+    const auto deadline = budget.count() > 0 ? std::chrono::steady_clock::now() + budget
+                                             : std::chrono::steady_clock::time_point::max();
+
+    m_a = a;
+    m_b = b;
+    m_a_lines.append(a);
+    m_b_lines.append(b);
+    if (m_a_lines.line_count() >= kMany || m_b_lines.line_count() >= kMany)
+    {
+        clear();
+        m_too_large = true;
+        return false;
+    }
+
+    std::vector<std::uint64_t> ha, hb;
+    {
+        TRACE_SCOPE("diff.hash");
+        hash_lines(a, m_a_lines, ha);
+        hash_lines(b, m_b_lines, hb);
+    }
+
+    Differ differ(ha, hb, deadline, cancel, progress, m_blocks);
+    {
+        TRACE_SCOPE("diff.script");
+        if (!differ.run())
+        {
+            clear();
+            return false;
+        }
+    }
+    m_coarse = differ.coarse();
+
+    m_row_starts.reserve(m_blocks.size() + 1);
+    std::uint64_t rows = 0;
+    for (const auto &block : m_blocks)
+    {
+        m_row_starts.push_back(rows);
+        rows += std::max(block.a_count, block.b_count);
+        if (block.kind != DiffBlock::Kind::Equal)
+        {
+            ++m_changes;
+            m_deleted += block.a_count;
+            m_inserted += block.b_count;
+        }
+    }
+    m_row_starts.push_back(rows);
+    m_valid = true;
+    return true;
+}
+
+std::string_view LineDiff::line(bool new_side, std::size_t line) const
+{
+    return line_text(new_side ? m_b : m_a, new_side ? m_b_lines : m_a_lines, line);
+}
+
+std::size_t LineDiff::block_of_row(std::uint64_t row) const
+{
+    const auto it = std::upper_bound(m_row_starts.begin(), m_row_starts.end() - 1, row);
+    return static_cast<std::size_t>(it - m_row_starts.begin()) - 1;
+}
+
+LineDiff::Row LineDiff::row(std::uint64_t row) const
+{
+    const auto &block = m_blocks[block_of_row(row)];
+    const auto at = row - m_row_starts[static_cast<std::size_t>(&block - m_blocks.data())];
+    Row out;
+    out.kind = block.kind;
+    if (at < block.a_count)
+        out.a_line = static_cast<std::int64_t>(block.a_begin + at);
+    if (at < block.b_count)
+        out.b_line = static_cast<std::int64_t>(block.b_begin + at);
+    return out;
+}
+
+std::size_t LineDiff::bytes() const
+{
+    return m_a_lines.bytes() + m_b_lines.bytes() + m_blocks.capacity() * sizeof(DiffBlock) +
+           m_row_starts.capacity() * sizeof(std::uint64_t);
+}
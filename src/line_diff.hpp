@@ -0,0 +1,100 @@
+#pragma once
+
+#include "line_index.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// One run of a line diff: `a_count` lines of the old text from `a_begin`
+// stand against `b_count` lines of the new one from `b_begin`.
+struct DiffBlock
+{
+  enum class Kind : std::uint8_t
+  {
+    Equal,
+    Delete, // only in the old text
+    Insert, // only in the new text
+    Change, // replaced; both sides have lines
+  };
+  Kind kind = Kind::Equal;
+  std::uint32_t a_begin = 0;
+  std::uint32_t a_count = 0;
+  std::uint32_t b_begin = 0;
+  std::uint32_t b_count = 0;
+};
+
+// Line-by-line comparison of two texts, for a side-by-side view.
+//
+// Lines are compared by XXH64 (hashed on all cores), so the diff itself
+// only touches two arrays of integers. Common prefix and suffix are
+// trimmed first; what remains is split on lines that occur once on each
+// side (patience diff), and the gaps between those anchors are diffed with
+// Myers' O(ND) algorithm. Neither recurses on the C++ stack.
+//
+// Two budgets keep huge or unrelated inputs bounded: a gap needing more
+// than kMaxCost edits, and everything left once `budget` has run out, is
+// reported as one Change block instead of being refined (coarse() says
+// so). The result is the same alignment, only less detailed there.
+//
+// The diff keeps views of both texts; they must outlive it.
+class LineDiff
+{
+public:
+  static constexpr std::uint32_t kMaxCost = 2048;
+
+  void clear();
+
+  // Compares `a` (old) with `b` (new). Returns false if cancelled, or if
+  // a side has more lines than the diff can number (too_large()).
+  // `progress` (0..1) follows the lines already placed.
+  bool build(std::string_view a, std::string_view b, std::chrono::milliseconds budget,
+             const std::atomic<bool> *cancel = nullptr, std::atomic<double> *progress = nullptr);
+
+  bool valid() const { return m_valid; }
+  bool coarse() const { return m_coarse; }
+  bool too_large() const { return m_too_large; }
+
+  const std::vector<DiffBlock> &blocks() const { return m_blocks; }
+  // Blocks other than Equal, and the lines they hold on each side.
+  std::size_t change_count() const { return m_changes; }
+  std::uint64_t deleted_lines() const { return m_deleted; }
+  std::uint64_t inserted_lines() const { return m_inserted; }
+
+  std::size_t line_count(bool new_side) const { return (new_side ? m_b_lines : m_a_lines).line_count(); }
+  // Line `line` of one side, without its line break.
+  std::string_view line(bool new_side, std::size_t line) const;
+
+  // Display rows: an Equal block is one row per line pair, a Change block
+  // pairs its lines up (the shorter side runs out first), Delete and
+  // Insert blocks leave the other side empty.
+  struct Row
+  {
+    DiffBlock::Kind kind = DiffBlock::Kind::Equal;
+    std::int64_t a_line = -1; // -1: nothing on this side
+    std::int64_t b_line = -1;
+  };
+  std::uint64_t row_count() const { return m_row_starts.empty() ? 0 : m_row_starts.back(); }
+  Row row(std::uint64_t row) const;
+  std::size_t block_of_row(std::uint64_t row) const;
+  std::uint64_t block_row(std::size_t block) const { return m_row_starts[block]; }
+
+  std::size_t bytes() const;
+
+private:
+  std::string_view m_a;
+  std::string_view m_b;
+  LineIndex m_a_lines;
+  LineIndex m_b_lines;
+  std::vector<DiffBlock> m_blocks;
+  std::vector<std::uint64_t> m_row_starts; // per block, plus the total
+  std::size_t m_changes = 0;
+  std::uint64_t m_deleted = 0;
+  std::uint64_t m_inserted = 0;
+  bool m_valid = false;
+  bool m_coarse = false;
+  bool m_too_large = false;
+};
@@ -0,0 +1,152 @@
+#include "line_filter.hpp"
+
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace
+{
+constexpr std::size_t kChunkBytes = 4 * 1024 * 1024;
+
+struct Chunk
+{
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  std::vector<std::uint64_t> offsets;
+  std::vector<std::uint32_t> lines; // relative to the chunk's first line
+  std::size_t newlines = 0;
+};
+
+std::string level_pattern(unsigned levels)
+{
+    std::string alt;
+    auto add = [&](const char *words)
+    {
+        if (!alt.empty())
+            alt += '|';
+        alt += words;
+    };
+    if (levels & kLevelError)
+        add("ERROR|ERR|FATAL|CRITICAL|SEVERE");
+    if (levels & kLevelWarn)
+        add("WARN|WARNING");
+    if (levels & kLevelInfo)
+        add("INFO");
+    if (levels & kLevelDebug)
+        add("DEBUG|TRACE");
+    return alt;
+}
+
+// Chunk boundaries just after a line break, so no line is split.
+std::vector<Chunk> make_chunks(std::string_view text)
+{
+    std::vector<Chunk> chunks;
+    std::size_t begin = 0;
+    while (begin < text.size())
+    {
+        std::size_t end = std::min(text.size(), begin + kChunkBytes);
+        if (end < text.size())
+        {
+            auto nl = static_cast<const char *>(
+                std::memchr(text.data() + end, '\n', text.size() - end));
+            end = nl ? static_cast<std::size_t>(nl - text.data()) + 1 : text.size();
+        }
+        Chunk c;
+        c.begin = begin;
+        c.end = end;
+        chunks.push_back(std::move(c));
+        begin = end;
+    }
+    return chunks;
+}
+
+void scan_chunk(std::string_view text, Chunk &chunk, const SearchEngine &primary,
+                const SearchEngine *secondary)
+{
+    const std::string_view part = text.substr(chunk.begin, chunk.end - chunk.begin);
+
+    // One walk over the matches (GRegex validates and scans the chunk once,
+    // not once per match); the rest of a line already taken is skipped.
+    std::size_t next_line = 0;
+    std::size_t counted_to = 0;
+    std::uint32_t line = 0;
+    primary.for_each(part, [&](const SearchMatch &m)
+                     {
+        if (m.begin < next_line)
+            return true;
+        const std::size_t ls = m.begin == 0 ? 0 : part.rfind('\n', m.begin - 1) + 1;
+        std::size_t le = part.find('\n', m.begin);
+        if (le == std::string_view::npos)
+            le = part.size();
+        next_line = le + 1;
+
+        SearchMatch unused;
+        if (!secondary || secondary->find(part.substr(ls, le - ls), 0, unused))
+        {
+            line += static_cast<std::uint32_t>(std::count(part.begin() + static_cast<std::ptrdiff_t>(counted_to),
+                                                          part.begin() + static_cast<std::ptrdiff_t>(ls), '\n'));
+            counted_to = ls;
+            chunk.offsets.push_back(chunk.begin + ls);
+            chunk.lines.push_back(line);
+        }
+        return next_line < part.size(); });
+
+    chunk.newlines = line + static_cast<std::size_t>(
+                                std::count(part.begin() + static_cast<std::ptrdiff_t>(counted_to), part.end(), '\n'));
+}
+} // namespace
+
+bool filter_lines(std::string_view text, unsigned levels, const SearchEngine *term,
+                  LineFilterResult &out, const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    TRACE_SCOPE("filter_lines");
+
+    out.offsets.clear();
+    out.lines.clear();
+
+    SearchEngine level_engine;
+    if (levels != 0)
+        level_engine = SearchEngine(level_pattern(levels),
+                                    SearchOptions{.case_sensitive = true, .whole_word = true, .regex = true});
+
+    // Scan for the rarer criterion first when there is a choice: the level
+    // words are everywhere in a log, a search term usually is not.
+    const SearchEngine *primary = term ? term : &level_engine;
+    const SearchEngine *secondary = (term && levels != 0) ? &level_engine : nullptr;
+    if (!primary->valid())
+        return true;
+
+    auto chunks = make_chunks(text);
+    std::atomic<std::size_t> done{0};
+    parallel_for(chunks.size(), [&](std::size_t i)
+                 {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return;
+        scan_chunk(text, chunks[i], *primary, secondary);
+        const auto n = done.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (progress)
+            progress->store(static_cast<double>(n) / static_cast<double>(chunks.size()), std::memory_order_relaxed); });
+
+    if (cancel && cancel->load(std::memory_order_relaxed))
+        return false;
+
+    std::size_t total = 0;
+    for (const auto &c : chunks)
+        total += c.offsets.size();
+    out.offsets.reserve(total);
+    out.lines.reserve(total);
+
+    std::uint64_t base_line = 0;
+    for (auto &c : chunks)
+    {
+        out.offsets.insert(out.offsets.end(), c.offsets.begin(), c.offsets.end());
+        for (const auto l : c.lines)
+            out.lines.push_back(static_cast<std::uint32_t>(base_line + l));
+        base_line += c.newlines;
+        c = Chunk{};
+    }
+    return true;
+}
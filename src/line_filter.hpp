@@ -0,0 +1,43 @@
+#pragma once
+
+#include "search_engine.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Log levels a line filter can select (bit mask).
+enum LogLevel : unsigned
+{
+  kLevelError = 1u << 0, // ERROR, ERR, FATAL, CRITICAL, SEVERE
+  kLevelWarn = 1u << 1,  // WARN, WARNING
+  kLevelInfo = 1u << 2,  // INFO
+  kLevelDebug = 1u << 3, // DEBUG, TRACE
+};
+
+// Lines of a document that passed a filter: where each starts and its line
+// number. Only these two integers are kept per line, never the text.
+struct LineFilterResult
+{
+  std::vector<std::uint64_t> offsets; // byte offset of the line start
+  std::vector<std::uint32_t> lines;   // 0-based line number
+
+  std::size_t size() const { return offsets.size(); }
+  std::size_t bytes() const
+  {
+    return offsets.capacity() * sizeof(std::uint64_t) + lines.capacity() * sizeof(std::uint32_t);
+  }
+};
+
+// Keeps the lines of `text` that carry one of `levels` (as a whole word, in
+// capitals) and, if `term` is given, also contain a match of it. Either
+// criterion may be left out, but not both.
+//
+// The text is cut into chunks at line breaks that are scanned on all cores;
+// per-chunk results are stitched together in document order. Returns false
+// if cancelled.
+bool filter_lines(std::string_view text, unsigned levels, const SearchEngine *term,
+                  LineFilterResult &out, const std::atomic<bool> *cancel = nullptr,
+                  std::atomic<double> *progress = nullptr);
@@ -0,0 +1,46 @@
+#include "line_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+void LineIndex::clear()
+{
+    m_starts.clear();
+    m_starts.shrink_to_fit();
+    m_indexed = 0;
+}
+
+void LineIndex::append(std::string_view chunk)
+{
+    if (m_starts.empty())
+        m_starts.push_back(0);
+
+    // memchr is vectorised in every libc we care about.
+    const char *p = chunk.data();
+    const char *end = p + chunk.size();
+    while (p < end)
+    {
+        auto nl = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+        if (!nl)
+            break;
+        m_starts.push_back(m_indexed + static_cast<std::uint64_t>(nl - chunk.data()) + 1);
+        p = nl + 1;
+    }
+
+    m_indexed += chunk.size();
+}
+
+std::size_t LineIndex::line_of(std::uint64_t offset) const
+{
+    if (m_starts.empty())
+        return 0;
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), offset);
+    return static_cast<std::size_t>(it - m_starts.begin()) - 1;
+}
+
+void LineIndex::assign(std::vector<std::uint64_t> starts, std::uint64_t indexed)
+{
+    m_starts = std::move(starts);
+    m_indexed = indexed;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Byte offsets of line starts in a document. Filled with append() as the
+// text streams in, so it can be built alongside a progressive load.
+class LineIndex
+{
+public:
+  void clear();
+
+  // Indexes `chunk`, which sits at byte offset indexed() of the document.
+  void append(std::string_view chunk);
+
+  bool empty() const { return m_starts.empty(); }
+  std::size_t line_count() const { return m_starts.size(); }
+  std::uint64_t indexed() const { return m_indexed; }
+  std::uint64_t line_start(std::size_t line) const { return m_starts[line]; }
+  const std::vector<std::uint64_t> &starts() const { return m_starts; }
+
+  // Line containing byte `offset` (binary search).
+  std::size_t line_of(std::uint64_t offset) const;
+
+  // Replaces the contents (e.g. from a cache) without scanning.
+  void assign(std::vector<std::uint64_t> starts, std::uint64_t indexed);
+
+  std::size_t bytes() const { return m_starts.capacity() * sizeof(std::uint64_t); }
+
+private:
+  std::vector<std::uint64_t> m_starts;
+  std::uint64_t m_indexed = 0;
+};
@@ -0,0 +1,338 @@
+#include "line_ops.hpp"
+
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+// Lines per join/hash job.
+constexpr std::size_t kLinesPerJob = 1 << 16;
+
+using Lines = std::vector<std::string_view>;
+
+bool cancelled(const std::atomic<bool> *cancel)
+{
+    return cancel && cancel->load(std::memory_order_relaxed);
+}
+
+void advance(std::atomic<double> *progress, double value)
+{
+    if (progress)
+        progress->store(value, std::memory_order_relaxed);
+}
+
+Lines split_lines(std::string_view text)
+{
+    TRACE_SCOPE("lines.split");
+
+    Lines lines;
+    lines.reserve(text.size() / 48 + 1);
+
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p < end)
+    {
+        auto nl = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+        if (!nl)
+        {
+            lines.emplace_back(p, static_cast<std::size_t>(end - p));
+            break;
+        }
+        lines.emplace_back(p, static_cast<std::size_t>(nl - p));
+        p = nl + 1;
+    }
+    return lines;
+}
+
+unsigned char fold(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// ASCII case folding; ties fall back to bytes so the order is total.
+bool less_caseless(std::string_view a, std::string_view b)
+{
+    const std::size_t n = std::min(a.size(), b.size());
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const auto ca = fold(static_cast<unsigned char>(a[i]));
+        const auto cb = fold(static_cast<unsigned char>(b[i]));
+        if (ca != cb)
+            return ca < cb;
+    }
+    if (a.size() != b.size())
+        return a.size() < b.size();
+    return a < b;
+}
+
+// Digit runs compare by value ("file9" < "file10"), everything else by byte.
+bool less_natural(std::string_view a, std::string_view b)
+{
+    std::size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size())
+    {
+        if (is_digit(a[i]) && is_digit(b[j]))
+        {
+            std::size_t ia = i, jb = j;
+            while (ia < a.size() && a[ia] == '0')
+                ++ia;
+            while (jb < b.size() && b[jb] == '0')
+                ++jb;
+            std::size_t ea = ia, eb = jb;
+            while (ea < a.size() && is_digit(a[ea]))
+                ++ea;
+            while (eb < b.size() && is_digit(b[eb]))
+                ++eb;
+
+            // Longer significant run is larger; equal lengths compare as text.
+            if (ea - ia != eb - jb)
+                return ea - ia < eb - jb;
+            const int c = a.substr(ia, ea - ia).compare(b.substr(jb, eb - jb));
+            if (c != 0)
+                return c < 0;
+            i = ea;
+            j = eb;
+            continue;
+        }
+        if (a[i] != b[j])
+            return static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[j]);
+        ++i;
+        ++j;
+    }
+    if (a.size() - i != b.size() - j)
+        return a.size() - i < b.size() - j;
+    return a < b;
+}
+
+// Leading number like `sort -n`: optional blanks and sign, digits, fraction.
+// Lines without one sort as zero, and so do "nan" and "inf", which
+// from_chars also accepts: a NaN key would break the ordering.
+double numeric_key(std::string_view s)
+{
+    std::size_t i = 0;
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t'))
+        ++i;
+    if (i < s.size() && s[i] == '+')
+        ++i;
+    double value = 0.0;
+    const auto res = std::from_chars(s.data() + i, s.data() + s.size(), value, std::chars_format::fixed);
+    return res.ec == std::errc() && std::isfinite(value) ? value : 0.0;
+}
+
+template <typename Less>
+bool sort_lines(Lines &lines, Less less, const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    TRACE_SCOPE("lines.sort");
+    return parallel_stable_sort(lines, less, cancel, progress);
+}
+
+bool sort_numeric(Lines &lines, const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    // Parse every key once, in parallel, instead of O(n log n) times.
+    struct Item
+    {
+        double key;
+        std::string_view line;
+    };
+    std::vector<Item> items(lines.size());
+    const std::size_t jobs = (lines.size() + kLinesPerJob - 1) / kLinesPerJob;
+    parallel_for(jobs, [&](std::size_t j)
+                 {
+        const std::size_t end = std::min(lines.size(), (j + 1) * kLinesPerJob);
+        for (std::size_t i = j * kLinesPerJob; i < end; ++i)
+            items[i] = Item{numeric_key(lines[i]), lines[i]}; });
+    if (cancelled(cancel))
+        return false;
+
+    auto less = [](const Item &a, const Item &b)
+    {
+        if (a.key != b.key)
+            return a.key < b.key;
+        return a.line < b.line;
+    };
+    TRACE_SCOPE("lines.sort");
+    if (!parallel_stable_sort(items, less, cancel, progress))
+        return false;
+
+    for (std::size_t i = 0; i < items.size(); ++i)
+        lines[i] = items[i].line;
+    return true;
+}
+
+bool unique_lines(Lines &lines, const std::atomic<bool> *cancel)
+{
+    TRACE_SCOPE("lines.unique");
+
+    // Hashing is the expensive part and is done in parallel; the set then
+    // reuses the stored hashes.
+    struct Key
+    {
+        std::size_t hash;
+        std::string_view line;
+        bool operator==(const Key &o) const { return line == o.line; }
+    };
+    struct KeyHash
+    {
+        std::size_t operator()(const Key &k) const { return k.hash; }
+    };
+
+    std::vector<std::size_t> hashes(lines.size());
+    const std::size_t jobs = (lines.size() + kLinesPerJob - 1) / kLinesPerJob;
+    parallel_for(jobs, [&](std::size_t j)
+                 {
+        const std::size_t end = std::min(lines.size(), (j + 1) * kLinesPerJob);
+        for (std::size_t i = j * kLinesPerJob; i < end; ++i)
+            hashes[i] = std::hash<std::string_view>{}(lines[i]); });
+    if (cancelled(cancel))
+        return false;
+
+    std::unordered_set<Key, KeyHash> seen;
+    seen.reserve(lines.size());
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < lines.size(); ++i)
+    {
+        if (seen.insert(Key{hashes[i], lines[i]}).second)
+            lines[kept++] = lines[i];
+    }
+    lines.resize(kept);
+    return true;
+}
+
+void join_lines(const Lines &lines, bool trailing_newline, std::string &out)
+{
+    TRACE_SCOPE("lines.join");
+
+    const std::size_t jobs = (lines.size() + kLinesPerJob - 1) / kLinesPerJob;
+
+    // Byte offset of every job, then each job copies its lines in place.
+    std::vector<std::size_t> offsets(jobs + 1, 0);
+    for (std::size_t j = 0; j < jobs; ++j)
+    {
+        const std::size_t end = std::min(lines.size(), (j + 1) * kLinesPerJob);
+        std::size_t bytes = 0;
+        for (std::size_t i = j * kLinesPerJob; i < end; ++i)
+            bytes += lines[i].size() + 1;
+        offsets[j + 1] = offsets[j] + bytes;
+    }
+
+    out.clear();
+    out.resize(offsets[jobs]);
+    parallel_for(jobs, [&](std::size_t j)
+                 {
+        char *dst = out.data() + offsets[j];
+        const std::size_t end = std::min(lines.size(), (j + 1) * kLinesPerJob);
+        for (std::size_t i = j * kLinesPerJob; i < end; ++i)
+        {
+            std::memcpy(dst, lines[i].data(), lines[i].size());
+            dst += lines[i].size();
+            *dst++ = '\n';
+        } });
+
+    if (!trailing_newline && !out.empty())
+        out.pop_back();
+}
+} // namespace
+
+bool parse_line_op(std::string_view name, LineOp &out)
+{
+    static constexpr std::pair<std::string_view, LineOp> kNames[] = {
+        {"sort", LineOp::SortLexical},
+        {"sort-numeric", LineOp::SortNumeric},
+        {"sort-natural", LineOp::SortNatural},
+        {"sort-caseless", LineOp::SortCaseInsensitive},
+        {"unique", LineOp::Unique},
+        {"reverse", LineOp::Reverse},
+        {"shuffle", LineOp::Shuffle},
+    };
+    for (const auto &[n, op] : kNames)
+    {
+        if (n == name)
+        {
+            out = op;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *line_op_label(LineOp op)
+{
+    switch (op)
+    {
+    case LineOp::SortLexical:
+        return "Sort lines";
+    case LineOp::SortNumeric:
+        return "Sort lines (numeric)";
+    case LineOp::SortNatural:
+        return "Sort lines (natural)";
+    case LineOp::SortCaseInsensitive:
+        return "Sort lines (ignore case)";
+    case LineOp::Unique:
+        return "Remove duplicate lines";
+    case LineOp::Reverse:
+        return "Reverse lines";
+    case LineOp::Shuffle:
+        return "Shuffle lines";
+    }
+    return "Line operation";
+}
+
+bool apply_line_op(std::string_view text, LineOp op, std::string &out,
+                   const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    const bool trailing_newline = !text.empty() && text.back() == '\n';
+    Lines lines = split_lines(text);
+    advance(progress, 0.1);
+    if (cancelled(cancel))
+        return false;
+
+    bool ok = true;
+    switch (op)
+    {
+    case LineOp::SortLexical:
+        ok = sort_lines(lines, std::less<std::string_view>{}, cancel, progress);
+        break;
+    case LineOp::SortNumeric:
+        ok = sort_numeric(lines, cancel, progress);
+        break;
+    case LineOp::SortNatural:
+        ok = sort_lines(lines, less_natural, cancel, progress);
+        break;
+    case LineOp::SortCaseInsensitive:
+        ok = sort_lines(lines, less_caseless, cancel, progress);
+        break;
+    case LineOp::Unique:
+        ok = unique_lines(lines, cancel);
+        break;
+    case LineOp::Reverse:
+        std::reverse(lines.begin(), lines.end());
+        break;
+    case LineOp::Shuffle:
+    {
+        std::mt19937_64 rng{std::random_device{}()};
+        std::shuffle(lines.begin(), lines.end(), rng);
+        break;
+    }
+    }
+    if (!ok || cancelled(cancel))
+        return false;
+    advance(progress, 0.9);
+
+    join_lines(lines, trailing_newline, out);
+    advance(progress, 1.0);
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+
+enum class LineOp
+{
+  SortLexical,
+  SortNumeric,
+  SortNatural,
+  SortCaseInsensitive,
+  Unique,
+  Reverse,
+  Shuffle,
+};
+
+// Parses the names used by the "win.line_op" action ("sort", "sort-numeric", …).
+bool parse_line_op(std::string_view name, LineOp &out);
+// Status-line name, e.g. "Sort lines (numeric)".
+const char *line_op_label(LineOp op);
+
+// Line operations over a text snapshot, run on all cores.
+//
+// The text is split into a vector of line views (no per-line copies). Sorts
+// are stable parallel merge sorts: each worker sorts a run, then runs are
+// merged pairwise in parallel. Unique is hash based and keeps the first
+// occurrence. The result is joined in parallel into one string.
+//
+// A trailing newline is preserved. `cancel` is polled between phases;
+// `progress` (0..1) is advanced as phases complete. Returns false if
+// cancelled.
+bool apply_line_op(std::string_view text, LineOp op, std::string &out,
+                   const std::atomic<bool> *cancel = nullptr,
+                   std::atomic<double> *progress = nullptr);
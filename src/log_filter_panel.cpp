@@ -0,0 +1,109 @@
+#include "log_filter_panel.hpp"
+
+#include <algorithm>
+
+namespace
+{
+// Longest part of a line drawn in a row; the rest is off screen anyway.
+constexpr std::size_t kMaxRowBytes = 2048;
+constexpr int kGutterChars = 9;
+} // namespace
+
+LogFilterPanel::LogFilterPanel() : Gtk::Box(Gtk::Orientation::VERTICAL)
+{
+    set_spacing(6);
+    set_size_request(320, -1);
+
+    m_bar.set_spacing(6);
+    m_error.set_active(true);
+    m_warn.set_active(true);
+    m_term.set_placeholder_text("Term (optional)");
+    m_term.set_hexpand(true);
+    m_bar.append(m_error);
+    m_bar.append(m_warn);
+    m_bar.append(m_info);
+    m_bar.append(m_debug);
+    m_bar.append(m_term);
+    m_bar.append(m_run);
+
+    m_rows.set_vexpand(true);
+    m_status.set_halign(Gtk::Align::START);
+
+    append(m_bar);
+    append(m_rows);
+    append(m_status);
+
+    m_run.signal_clicked().connect([this]()
+                                   { m_apply.emit(); });
+    m_term.signal_activate().connect([this]()
+                                     { m_apply.emit(); });
+    m_rows.signal_row_activated().connect([this](std::size_t row)
+                                          { m_line_activated.emit(m_rows.result().lines[row]); });
+}
+
+unsigned LogFilterPanel::levels() const
+{
+    unsigned levels = 0;
+    if (m_error.get_active())
+        levels |= kLevelError;
+    if (m_warn.get_active())
+        levels |= kLevelWarn;
+    if (m_info.get_active())
+        levels |= kLevelInfo;
+    if (m_debug.get_active())
+        levels |= kLevelDebug;
+    return levels;
+}
+
+void LogFilterPanel::set_result(TextSnapshot snapshot, LineFilterResult result)
+{
+    const auto n = result.size();
+    m_rows.set(std::move(snapshot), std::move(result));
+    m_rows.scroll_to_row(0);
+    set_status(std::to_string(n) + (n == 1 ? " line." : " lines."));
+}
+
+void LogFilterPanel::clear()
+{
+    m_rows.set({}, {});
+    set_status("Cleared.");
+}
+
+void LogFilterPanel::set_stale()
+{
+    if (!empty())
+        set_status(std::to_string(m_rows.result().size()) + " lines (document changed; Filter again to refresh).");
+}
+
+void LogFilterPanel::Rows::set(TextSnapshot snapshot, LineFilterResult result)
+{
+    m_snapshot = std::move(snapshot);
+    m_result = std::move(result);
+    set_row_count(m_result.size());
+}
+
+void LogFilterPanel::Rows::draw_row(const Cairo::RefPtr<Cairo::Context> &cr,
+                                    const Glib::RefPtr<Pango::Layout> &layout, std::size_t row, double y, int)
+{
+    const std::string_view text = m_snapshot.text;
+    const auto begin = static_cast<std::size_t>(m_result.offsets[row]);
+    auto end = text.find('\n', begin);
+    if (end == std::string_view::npos)
+        end = text.size();
+    end = std::min(end, begin + kMaxRowBytes);
+
+    // A cut at kMaxRowBytes may split a character; draw only what is valid.
+    const char *valid_end = nullptr;
+    g_utf8_validate(text.data() + begin, static_cast<gssize>(end - begin), &valid_end);
+
+    std::string line = std::to_string(m_result.lines[row] + 1);
+    line.insert(0, static_cast<std::size_t>(std::max(0, kGutterChars - static_cast<int>(line.size()))), ' ');
+    line += "  ";
+    line.append(text.data() + begin, valid_end);
+    if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+
+    layout->set_text(line);
+    cr->move_to(4.0, y);
+    layout->show_in_cairo_context(cr);
+}
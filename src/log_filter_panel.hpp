@@ -0,0 +1,66 @@
+#pragma once
+
+#include "line_filter.hpp"
+#include "text_snapshot.hpp"
+#include "virtual_row_view.hpp"
+
+#include <gtkmm.h>
+#include <cstdint>
+
+// Side panel that shows only the lines of the document that passed a
+// filter (log levels and/or a search term). It holds the snapshot the scan
+// ran over plus one offset and line number per matching line; the rows on
+// screen are read straight out of the snapshot when drawn.
+//
+// The owner runs the scan (see AppWindow::on_log_filter_apply) and hands the
+// result over with set_result(). Clicking a row reports its line number in
+// the full document.
+class LogFilterPanel : public Gtk::Box
+{
+public:
+  LogFilterPanel();
+
+  unsigned levels() const;
+  Glib::ustring term() const { return m_term.get_text(); }
+
+  void set_result(TextSnapshot snapshot, LineFilterResult result);
+  void clear();
+  // The document changed after the scan; line numbers may be off.
+  void set_stale();
+  void set_status(const Glib::ustring &s) { m_status.set_text(s); }
+
+  bool empty() const { return m_rows.result().size() == 0; }
+  std::size_t bytes() const { return m_rows.result().bytes(); }
+
+  sigc::signal<void()> &signal_apply() { return m_apply; }
+  sigc::signal<void(std::uint32_t)> &signal_line_activated() { return m_line_activated; }
+
+private:
+  class Rows : public VirtualRowView
+  {
+  public:
+    void set(TextSnapshot snapshot, LineFilterResult result);
+    const LineFilterResult &result() const { return m_result; }
+
+  protected:
+    void draw_row(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                  std::size_t row, double y, int width) override;
+
+  private:
+    TextSnapshot m_snapshot;
+    LineFilterResult m_result;
+  };
+
+  Gtk::Box m_bar{Gtk::Orientation::HORIZONTAL};
+  Gtk::CheckButton m_error{"Error"};
+  Gtk::CheckButton m_warn{"Warn"};
+  Gtk::CheckButton m_info{"Info"};
+  Gtk::CheckButton m_debug{"Debug"};
+  Gtk::Entry m_term;
+  Gtk::Button m_run{"Filter"};
+  Rows m_rows;
+  Gtk::Label m_status{"Pick levels and/or a term, then Filter."};
+
+  sigc::signal<void()> m_apply;
+  sigc::signal<void(std::uint32_t)> m_line_activated;
+};
@@ -0,0 +1,398 @@
+#include "log_time_index.hpp"
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+constexpr std::int64_t kDayMs = 24 * 60 * 60 * 1000;
+// Lines read when detecting the format, and per sample before giving up.
+constexpr int kDetectLines = 200;
+constexpr int kSampleLines = 32;
+// Only the start of a line is ever looked at.
+constexpr std::size_t kPrefixBytes = 64;
+
+constexpr std::array<const char *, 12> kMonths = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// Days since 1970-01-01 of a proleptic Gregorian date.
+std::int64_t days_from_civil(std::int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const auto yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+class Cursor
+{
+public:
+    explicit Cursor(std::string_view s) : m_s(s) {}
+
+    bool digits(int n, int &out)
+    {
+        out = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            if (m_i >= m_s.size() || m_s[m_i] < '0' || m_s[m_i] > '9')
+                return false;
+            out = out * 10 + (m_s[m_i++] - '0');
+        }
+        return true;
+    }
+
+    // One or two digits.
+    bool small_number(int &out)
+    {
+        if (!digits(1, out))
+            return false;
+        int next = 0;
+        const auto save = m_i;
+        if (digits(1, next))
+            out = out * 10 + next;
+        else
+            m_i = save;
+        return true;
+    }
+
+    bool literal(char c)
+    {
+        if (m_i < m_s.size() && m_s[m_i] == c)
+        {
+            ++m_i;
+            return true;
+        }
+        return false;
+    }
+
+    bool one_of(const char *set)
+    {
+        if (m_i < m_s.size() && m_s[m_i] != '\0' && std::strchr(set, m_s[m_i]))
+        {
+            ++m_i;
+            return true;
+        }
+        return false;
+    }
+
+    void skip(const char *set)
+    {
+        while (one_of(set))
+        {
+        }
+    }
+
+    bool month(int &out)
+    {
+        if (m_i + 3 > m_s.size())
+            return false;
+        for (std::size_t k = 0; k < kMonths.size(); ++k)
+        {
+            if (m_s.compare(m_i, 3, kMonths[k]) == 0)
+            {
+                out = static_cast<int>(k) + 1;
+                m_i += 3;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // HH:MM[:SS[.fff]] as milliseconds since midnight.
+    bool time_of_day(std::int64_t &ms, bool seconds_required)
+    {
+        int h = 0, m = 0, s = 0;
+        if (!small_number(h) || !literal(':') || !digits(2, m))
+            return false;
+        if (literal(':'))
+        {
+            if (!digits(2, s))
+                return false;
+        }
+        else if (seconds_required)
+        {
+            return false;
+        }
+        int frac = 0;
+        if (one_of(".,"))
+        {
+            // Up to millisecond precision; finer digits are skipped.
+            int scale = 100;
+            while (m_i < m_s.size() && m_s[m_i] >= '0' && m_s[m_i] <= '9')
+            {
+                frac += (m_s[m_i++] - '0') * scale;
+                scale /= 10;
+            }
+        }
+        if (h > 23 || m > 59 || s > 60)
+            return false;
+        ms = ((h * 60 + m) * 60 + s) * 1000LL + frac;
+        return true;
+    }
+
+private:
+    std::string_view m_s;
+    std::size_t m_i = 0;
+};
+
+bool parse_iso(std::string_view s, std::int64_t &key, bool seconds_required = true)
+{
+    Cursor c(s);
+    int y = 0, mo = 0, d = 0;
+    std::int64_t tod = 0;
+    if (!c.digits(4, y) || !c.literal('-') || !c.digits(2, mo) || !c.literal('-') || !c.digits(2, d) ||
+        !c.one_of("T ") || !c.time_of_day(tod, seconds_required))
+        return false;
+    if (mo < 1 || mo > 12 || d < 1 || d > 31)
+        return false;
+    key = days_from_civil(y, static_cast<unsigned>(mo), static_cast<unsigned>(d)) * kDayMs + tod;
+    return true;
+}
+
+bool parse_syslog(std::string_view s, std::int64_t &key, bool seconds_required = true)
+{
+    Cursor c(s);
+    int mo = 0, d = 0;
+    std::int64_t tod = 0;
+    if (!c.month(mo) || !c.literal(' '))
+        return false;
+    c.skip(" ");
+    if (!c.small_number(d) || !c.literal(' ') || !c.time_of_day(tod, seconds_required))
+        return false;
+    // No year: order within one year is all a time-sorted syslog needs.
+    key = days_from_civil(1970, static_cast<unsigned>(mo), static_cast<unsigned>(d)) * kDayMs + tod;
+    return true;
+}
+
+bool parse_apache(std::string_view s, std::int64_t &key, bool seconds_required = true)
+{
+    Cursor c(s);
+    int d = 0, mo = 0, y = 0;
+    std::int64_t tod = 0;
+    if (!c.digits(2, d) || !c.literal('/') || !c.month(mo) || !c.literal('/') || !c.digits(4, y) ||
+        !c.literal(':') || !c.time_of_day(tod, seconds_required))
+        return false;
+    key = days_from_civil(y, static_cast<unsigned>(mo), static_cast<unsigned>(d)) * kDayMs + tod;
+    return true;
+}
+
+bool parse_time_only(std::string_view s, std::int64_t &key, bool seconds_required = true)
+{
+    Cursor c(s);
+    return c.time_of_day(key, seconds_required);
+}
+
+// Start of the timestamp: after leading blanks and an opening bracket.
+std::string_view stamp_prefix(std::string_view line)
+{
+    std::size_t i = 0;
+    while (i < line.size() && i < 4 && (line[i] == ' ' || line[i] == '\t' || line[i] == '['))
+        ++i;
+    return line.substr(i, kPrefixBytes);
+}
+
+bool parse_as(LogTimeIndex::Format f, std::string_view line, std::int64_t &key)
+{
+    const auto s = stamp_prefix(line);
+    switch (f)
+    {
+    case LogTimeIndex::Format::Iso:
+        return parse_iso(s, key);
+    case LogTimeIndex::Format::Syslog:
+        return parse_syslog(s, key);
+    case LogTimeIndex::Format::Apache:
+    {
+        // Access logs put the client first: "1.2.3.4 - - [01/May/2024:…".
+        const auto head = line.substr(0, kPrefixBytes);
+        const auto open = head.find('[');
+        return open != std::string_view::npos && parse_apache(line.substr(open + 1, kPrefixBytes), key);
+    }
+    case LogTimeIndex::Format::TimeOnly:
+        return parse_time_only(s, key);
+    case LogTimeIndex::Format::None:
+        break;
+    }
+    return false;
+}
+
+// Line starting at `begin` (without its newline).
+std::string_view line_at(std::string_view text, std::size_t begin)
+{
+    auto end = text.find('\n', begin);
+    if (end == std::string_view::npos)
+        end = text.size();
+    return text.substr(begin, end - begin);
+}
+} // namespace
+
+const char *LogTimeIndex::format_name(Format f)
+{
+    switch (f)
+    {
+    case Format::Iso:
+        return "ISO 8601";
+    case Format::Syslog:
+        return "syslog";
+    case Format::Apache:
+        return "Apache";
+    case Format::TimeOnly:
+        return "time of day";
+    case Format::None:
+        break;
+    }
+    return "none";
+}
+
+void LogTimeIndex::clear()
+{
+    m_format = Format::None;
+    m_samples.clear();
+    m_samples.shrink_to_fit();
+}
+
+bool LogTimeIndex::build(std::string_view text, const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    TRACE_SCOPE("log_time_index.build");
+    clear();
+
+    // Detect: the first format that parses one of the first lines wins.
+    std::size_t pos = 0;
+    for (int n = 0; n < kDetectLines && pos < text.size() && m_format == Format::None; ++n)
+    {
+        const auto line = line_at(text, pos);
+        std::int64_t key = 0;
+        for (auto f : {Format::Iso, Format::Apache, Format::Syslog, Format::TimeOnly})
+        {
+            if (parse_as(f, line, key))
+            {
+                m_format = f;
+                break;
+            }
+        }
+        pos += line.size() + 1;
+    }
+    if (m_format == Format::None)
+        return true;
+
+    // Sample the first stamped line at or after every stride boundary.
+    std::uint64_t line_no = 0;
+    std::size_t counted_to = 0;
+    for (std::size_t target = 0; target < text.size(); target += kStrideBytes)
+    {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+        {
+            clear();
+            return false;
+        }
+
+        std::size_t begin = 0;
+        if (target > 0)
+        {
+            const auto nl = text.find('\n', target - 1);
+            if (nl == std::string_view::npos)
+                break;
+            begin = nl + 1;
+        }
+        if (begin < counted_to)
+            continue; // a long line spans the whole stride
+
+        line_no += static_cast<std::uint64_t>(std::count(text.begin() + static_cast<std::ptrdiff_t>(counted_to),
+                                                         text.begin() + static_cast<std::ptrdiff_t>(begin), '\n'));
+        counted_to = begin;
+
+        for (int n = 0; n < kSampleLines && begin < text.size(); ++n)
+        {
+            const auto line = line_at(text, begin);
+            std::int64_t key = 0;
+            if (parse_as(m_format, line, key))
+            {
+                m_samples.push_back({key, begin, line_no});
+                break;
+            }
+            begin += line.size() + 1;
+            ++line_no;
+            counted_to = begin;
+        }
+
+        if (progress)
+            progress->store(static_cast<double>(target) / static_cast<double>(text.size()),
+                            std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool LogTimeIndex::seek(std::string_view text, std::string_view query, Position &out, std::string &error) const
+{
+    if (m_samples.empty())
+    {
+        error = "No timestamps found in this document.";
+        return false;
+    }
+
+    while (!query.empty() && query.front() == ' ')
+        query.remove_prefix(1);
+    while (!query.empty() && query.back() == ' ')
+        query.remove_suffix(1);
+
+    // The log's own format first, then ISO; seconds are optional in a query.
+    std::int64_t key = 0;
+    bool parsed = false;
+    switch (m_format)
+    {
+    case Format::Syslog:
+        parsed = parse_syslog(query, key, false);
+        break;
+    case Format::Apache:
+        parsed = parse_apache(query, key, false);
+        break;
+    default:
+        break;
+    }
+    if (!parsed && m_format != Format::TimeOnly)
+        parsed = parse_iso(query, key, false);
+    if (!parsed)
+    {
+        std::int64_t tod = 0;
+        Cursor c(query);
+        if (!c.time_of_day(tod, false))
+        {
+            error = "Not a time: use HH:MM[:SS], or a date and time like the log's.";
+            return false;
+        }
+        key = tod;
+        if (m_format != Format::TimeOnly)
+            key += (m_samples.front().key / kDayMs) * kDayMs;
+    }
+
+    // Last sample before the instant; the answer lies after it.
+    auto it = std::lower_bound(m_samples.begin(), m_samples.end(), key,
+                               [](const Sample &s, std::int64_t k)
+                               { return s.key < k; });
+    Position pos;
+    if (it != m_samples.begin())
+    {
+        const auto &prev = *std::prev(it);
+        pos = {prev.offset, prev.line};
+    }
+
+    while (pos.offset < text.size())
+    {
+        const auto line = line_at(text, static_cast<std::size_t>(pos.offset));
+        std::int64_t stamp = 0;
+        if (parse_as(m_format, line, stamp) && stamp >= key)
+        {
+            out = pos;
+            return true;
+        }
+        pos.offset += line.size() + 1;
+        ++pos.line;
+    }
+
+    error = "The log ends before that time.";
+    return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sparse timestamp → position index over a time-ordered log.
+//
+// The timestamp format is detected from the first lines (ISO 8601,
+// "2024-05-01 14:03:20", syslog "May  1 14:03:20", Apache
+// "[01/May/2024:14:03:20 +0000]" or a bare "14:03:20"). build() then samples
+// one line every kStrideBytes, so the index has a few thousand entries even
+// for a gigabyte of log. seek() binary-searches the samples and scans at
+// most about one stride of lines to land on the first line at or after the
+// requested instant.
+class LogTimeIndex
+{
+public:
+  enum class Format
+  {
+    None,
+    Iso,      // 2024-05-01T14:03:20.123 / 2024-05-01 14:03:20,123
+    Syslog,   // May  1 14:03:20 (no year)
+    Apache,   // 01/May/2024:14:03:20
+    TimeOnly, // 14:03:20.123
+  };
+
+  struct Position
+  {
+    std::uint64_t offset = 0; // byte offset of the line start
+    std::uint64_t line = 0;   // 0-based line number
+  };
+
+  static constexpr std::size_t kStrideBytes = 64 * 1024;
+
+  void clear();
+
+  // Detects the format and samples `text`. Returns false if cancelled; a log
+  // without recognisable timestamps leaves format() == Format::None.
+  bool build(std::string_view text, const std::atomic<bool> *cancel = nullptr,
+             std::atomic<double> *progress = nullptr);
+
+  Format format() const { return m_format; }
+  bool empty() const { return m_samples.empty(); }
+  std::size_t bytes() const { return m_samples.capacity() * sizeof(Sample); }
+
+  // First line of `text` (the text build() ran over) stamped at or after
+  // `query`. A query without a date means that time on the log's first day.
+  bool seek(std::string_view text, std::string_view query, Position &out, std::string &error) const;
+
+  static const char *format_name(Format f);
+
+private:
+  struct Sample
+  {
+    std::int64_t key = 0; // milliseconds; since 1970 if dated, else since midnight
+    std::uint64_t offset = 0;
+    std::uint64_t line = 0;
+  };
+
+  Format m_format = Format::None;
+  std::vector<Sample> m_samples;
+};
@@ -1,7 +1,34 @@
 #include <gtkmm.h>
-#include "app_window.hpp"
+#include "batch_replace.hpp"
+#include "editor_application.hpp"
+#include "startup_profile.hpp"
+#include "trace.hpp"
+
+#ifndef _WIN32
+#include <csignal>
+#endif
 
 int main(int argc, char* argv[]) {
-  auto app = Gtk::Application::create("com.example.sophisticatedgtk4");
-  return app->make_window_and_run<AppWindow>(argc, argv);
+  startup_profile::init(argc, argv);
+  trace::init();
+
+#ifndef _WIN32
+  // Writing to a pipe whose reader has exited (Filter Through Command with
+  // `head`, for example) must fail with EPIPE, not kill the editor.
+  std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+  int status = 0;
+
+  // Headless mode: handled before GTK is initialised, so no display is needed.
+  if (is_batch_replace(argc, argv)) {
+    status = run_batch_replace(argc, argv);
+  } else {
+    auto app = EditorApplication::create();
+    startup_profile::mark("application created");
+    status = app->run(argc, argv);
+  }
+
+  trace::shutdown();
+  return status;
 }
@@ -0,0 +1,32 @@
+#include "mapped_file.hpp"
+
+#include <glib.h>
+
+MappedFile::~MappedFile()
+{
+    if (m_file)
+        g_mapped_file_unref(m_file);
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &path, std::string &error)
+{
+    GError *err = nullptr;
+    GMappedFile *file = g_mapped_file_new(path.c_str(), FALSE, &err);
+    if (!file)
+    {
+        error = err ? err->message : "cannot map file";
+        if (err)
+            g_error_free(err);
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+    mapped->m_file = file;
+    mapped->m_path = path;
+
+    // Empty files map to a null pointer.
+    if (const gchar *data = g_mapped_file_get_contents(file))
+        mapped->m_view = std::string_view(data, g_mapped_file_get_length(file));
+
+    return mapped;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+typedef struct _GMappedFile GMappedFile;
+
+// Read-only memory mapping of a file (GMappedFile, so it also works on
+// Windows). Shared ownership lets views outlive the code that opened them.
+class MappedFile
+{
+public:
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Returns null and fills `error` on failure.
+  static std::shared_ptr<MappedFile> open(const std::string &path, std::string &error);
+
+  std::string_view view() const { return m_view; }
+  std::size_t size() const { return m_view.size(); }
+  const std::string &path() const { return m_path; }
+
+private:
+  MappedFile() = default;
+
+  GMappedFile *m_file = nullptr;
+  std::string_view m_view;
+  std::string m_path;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Character ranges of the current "Highlight all" matches. Owned by the
+// window and shared by the Find and Replace dialogs, which also report how
+// many "find_hl" tag ranges they applied.
+class MatchIndex
+{
+public:
+  using Range = std::pair<int, int>;
+
+  void assign(std::vector<Range> matches)
+  {
+    m_matches = std::move(matches);
+    if (m_listener)
+      m_listener();
+  }
+
+  // Called after every assign(), e.g. to redraw the overview ruler.
+  void set_listener(std::function<void()> listener) { m_listener = std::move(listener); }
+
+  // Forgets the cached ranges; highlights already applied stay.
+  void drop()
+  {
+    m_matches.clear();
+    m_matches.shrink_to_fit();
+  }
+
+  const std::vector<Range> &matches() const { return m_matches; }
+  std::size_t size() const { return m_matches.size(); }
+  std::size_t bytes() const { return m_matches.capacity() * sizeof(Range); }
+
+  void set_tagged(std::size_t n) { m_tagged = n; }
+  std::size_t tagged() const { return m_tagged; }
+
+private:
+  std::vector<Range> m_matches;
+  std::size_t m_tagged = 0;
+  std::function<void()> m_listener;
+};
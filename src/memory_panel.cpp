@@ -0,0 +1,114 @@
+#include "memory_panel.hpp"
+
+MemoryPanel::MemoryPanel(Gtk::Window &parent, MemoryStats &stats)
+    : m_parent(parent), m_stats(stats)
+{
+    build_ui();
+}
+
+MemoryPanel::~MemoryPanel()
+{
+    m_timer.disconnect();
+}
+
+void MemoryPanel::present()
+{
+    on_refresh();
+    if (!m_timer.connected())
+        m_timer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &MemoryPanel::on_refresh), 1000);
+    m_win.present();
+}
+
+void MemoryPanel::build_ui()
+{
+    m_win.set_title("Memory");
+    m_win.set_transient_for(m_parent);
+    m_win.set_destroy_with_parent(true);
+    m_win.set_default_size(480, 260);
+
+    m_root.set_margin(12);
+    m_root.set_spacing(10);
+    m_win.set_child(m_root);
+
+    m_grid.set_row_spacing(6);
+    m_grid.set_column_spacing(16);
+
+    int row = 0;
+    for (const auto &counter : m_stats.counters())
+    {
+        auto name = Gtk::make_managed<Gtk::Label>(counter.name);
+        name->set_halign(Gtk::Align::START);
+        name->set_hexpand(true);
+
+        auto bytes = Gtk::make_managed<Gtk::Label>();
+        bytes->set_halign(Gtk::Align::END);
+
+        auto detail = Gtk::make_managed<Gtk::Label>();
+        detail->set_halign(Gtk::Align::START);
+        detail->add_css_class("dim-label");
+
+        m_grid.attach(*name, 0, row, 1, 1);
+        m_grid.attach(*bytes, 1, row, 1, 1);
+        m_grid.attach(*detail, 2, row, 1, 1);
+
+        if (counter.drop)
+        {
+            auto drop = Gtk::make_managed<Gtk::Button>("Drop");
+            drop->signal_clicked().connect([this, row]()
+                                           {
+                m_stats.counters()[row].drop();
+                on_refresh(); });
+            m_grid.attach(*drop, 3, row, 1, 1);
+        }
+
+        m_rows.push_back(Row{bytes, detail});
+        ++row;
+    }
+
+    m_total.set_halign(Gtk::Align::START);
+    m_rss.set_halign(Gtk::Align::START);
+
+    auto buttons = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::HORIZONTAL);
+    auto spacer = Gtk::make_managed<Gtk::Label>("");
+    spacer->set_hexpand(true);
+    buttons->append(*spacer);
+    buttons->append(m_close);
+
+    m_root.append(m_grid);
+    m_root.append(*Gtk::make_managed<Gtk::Separator>(Gtk::Orientation::HORIZONTAL));
+    m_root.append(m_total);
+    m_root.append(m_rss);
+    m_root.append(*buttons);
+
+    m_close.signal_clicked().connect([this]()
+                                     { m_win.hide(); });
+
+    // Only sample while visible.
+    m_win.signal_hide().connect([this]()
+                                { m_timer.disconnect(); });
+
+    m_win.signal_close_request().connect([this]() -> bool
+                                         {
+    m_win.hide();
+    return false; }, false);
+}
+
+bool MemoryPanel::on_refresh()
+{
+    std::size_t total = 0;
+    const auto &counters = m_stats.counters();
+    for (std::size_t i = 0; i < counters.size() && i < m_rows.size(); ++i)
+    {
+        const auto bytes = counters[i].bytes();
+        total += bytes;
+        m_rows[i].bytes->set_text(MemoryStats::format_bytes(bytes));
+        m_rows[i].detail->set_text(counters[i].detail ? counters[i].detail() : "");
+    }
+
+    m_total.set_text("Tracked: " + MemoryStats::format_bytes(total));
+
+    const auto rss = MemoryStats::process_rss();
+    m_rss.set_text(rss ? "Process RSS: " + MemoryStats::format_bytes(rss) : "Process RSS: n/a");
+
+    return true;
+}
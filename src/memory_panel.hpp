@@ -0,0 +1,40 @@
+#pragma once
+#include "memory_stats.hpp"
+
+#include <gtkmm.h>
+#include <vector>
+
+// Diagnostics window listing the editor's memory counters and process RSS,
+// refreshed once a second while visible. Caches that can be freed get a
+// "Drop" button.
+class MemoryPanel {
+public:
+  MemoryPanel(Gtk::Window& parent, MemoryStats& stats);
+  ~MemoryPanel();
+
+  void present();
+
+private:
+  Gtk::Window& m_parent;
+  MemoryStats& m_stats;
+
+  // UI
+  Gtk::Window m_win;
+  Gtk::Box m_root{Gtk::Orientation::VERTICAL};
+  Gtk::Grid m_grid;
+  Gtk::Label m_rss;
+  Gtk::Label m_total;
+  Gtk::Button m_close{"Close"};
+
+  struct Row {
+    Gtk::Label* bytes = nullptr;
+    Gtk::Label* detail = nullptr;
+  };
+  std::vector<Row> m_rows;
+
+  sigc::connection m_timer;
+
+private:
+  void build_ui();
+  bool on_refresh();
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Memory counters published by the editor's subsystems for the memory
+// panel. Each counter reads a number its owner already keeps up to date, so
+// sampling is cheap enough to run on a timer.
+struct MemoryCounter
+{
+  std::string name;
+  std::function<std::size_t()> bytes;
+  std::function<std::string()> detail; // optional, e.g. "1234 ranges"
+  std::function<void()> drop;          // optional; frees the cache
+};
+
+class MemoryStats
+{
+public:
+  void add(MemoryCounter counter) { m_counters.push_back(std::move(counter)); }
+  const std::vector<MemoryCounter> &counters() const { return m_counters; }
+
+  // Resident set size of this process, or 0 where unsupported.
+  static std::size_t process_rss();
+
+  static std::string format_bytes(std::size_t bytes);
+
+private:
+  std::vector<MemoryCounter> m_counters;
+};
@@ -0,0 +1,386 @@
+#include "outline_index.hpp"
+
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+// Slice of the document scanned by one job during build().
+constexpr std::size_t kChunkBytes = 4u << 20;
+// Titles are cut to this many bytes (at a character boundary).
+constexpr std::size_t kMaxTitleBytes = 120;
+
+bool ends_with_ci(std::string_view path, std::string_view ext)
+{
+    if (path.size() < ext.size())
+        return false;
+    for (std::size_t i = 0; i < ext.size(); ++i)
+    {
+        char c = path[path.size() - ext.size() + i];
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c + ('a' - 'A'));
+        if (c != ext[i])
+            return false;
+    }
+    return true;
+}
+
+unsigned char fold(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+bool contains_ci(std::string_view hay, std::string_view needle)
+{
+    if (needle.size() > hay.size())
+        return false;
+    for (std::size_t i = 0; i + needle.size() <= hay.size(); ++i)
+    {
+        std::size_t k = 0;
+        while (k < needle.size() &&
+               fold(static_cast<unsigned char>(hay[i + k])) == fold(static_cast<unsigned char>(needle[k])))
+            ++k;
+        if (k == needle.size())
+            return true;
+    }
+    return false;
+}
+
+std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+        s.remove_suffix(1);
+    return s;
+}
+
+std::string make_title(std::string_view s)
+{
+    s = trim(s);
+    if (s.size() > kMaxTitleBytes)
+    {
+        std::size_t cut = kMaxTitleBytes;
+        while (cut > 0 && (static_cast<unsigned char>(s[cut]) & 0xC0) == 0x80)
+            --cut;
+        s = s.substr(0, cut);
+    }
+    return std::string(s);
+}
+
+bool is_ident(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+bool scan_markdown(std::string_view line, OutlineEntry &e)
+{
+    std::size_t i = 0;
+    while (i < 3 && i < line.size() && line[i] == ' ')
+        ++i;
+    const auto rest = line.substr(i);
+    if (rest.starts_with("```") || rest.starts_with("~~~"))
+    {
+        e.level = 0;
+        return true;
+    }
+
+    std::size_t hashes = 0;
+    while (hashes < rest.size() && rest[hashes] == '#')
+        ++hashes;
+    if (hashes == 0 || hashes > 6 || (hashes < rest.size() && rest[hashes] != ' ' && rest[hashes] != '\t'))
+        return false;
+
+    auto title = trim(rest.substr(hashes));
+    while (!title.empty() && title.back() == '#')
+        title.remove_suffix(1);
+    e.level = static_cast<std::uint8_t>(hashes);
+    e.title = make_title(title);
+    return true;
+}
+
+bool scan_yaml(std::string_view line, OutlineEntry &e)
+{
+    if (line.empty())
+        return false;
+    const char c = line[0];
+    if (c == ' ' || c == '\t' || c == '#' || c == '-' || c == '%' || c == '.' || c == '\r')
+        return false;
+
+    // "key:" followed by a blank or the end of the line.
+    for (std::size_t i = 0; i < line.size(); ++i)
+    {
+        if (line[i] == ':' && (i + 1 == line.size() || line[i + 1] == ' ' || line[i + 1] == '\t' ||
+                               line[i + 1] == '\r'))
+        {
+            e.level = 1;
+            e.title = make_title(line.substr(0, i));
+            return !e.title.empty();
+        }
+        if (line[i] == '#' && i > 0 && line[i - 1] == ' ')
+            return false;
+    }
+    return false;
+}
+
+bool scan_cpp(std::string_view line, OutlineEntry &e)
+{
+    if (line.empty())
+        return false;
+    const char c = line[0];
+    if (!is_ident(c) && c != '~')
+        return false;
+
+    const auto body = trim(line);
+    if (body.ends_with(";") || body.ends_with(","))
+        return false;
+
+    // First word: statements and declarations that are not definitions.
+    std::size_t w = 0;
+    while (w < body.size() && is_ident(body[w]))
+        ++w;
+    const auto word = body.substr(0, w);
+    static constexpr std::string_view kSkip[] = {
+        "if", "else", "for", "while", "do", "switch", "case", "return", "goto", "break", "continue",
+        "typedef", "using", "namespace", "template", "public", "private", "protected", "default",
+    };
+    if (std::find(std::begin(kSkip), std::end(kSkip), word) != std::end(kSkip))
+        return false;
+
+    if (word == "class" || word == "struct" || word == "enum" || word == "union")
+    {
+        auto head = body;
+        const auto brace = head.find('{');
+        if (brace != std::string_view::npos)
+            head = head.substr(0, brace);
+        // "class Foo : public Bar" -> "class Foo"
+        const auto colon = head.find(" :");
+        if (colon != std::string_view::npos)
+            head = head.substr(0, colon);
+        e.level = 1;
+        e.title = make_title(head);
+        return true;
+    }
+
+    // A call-shaped head: an identifier (or operator) right before '(' and
+    // no '=' ahead of it.
+    const auto paren = body.find('(');
+    if (paren == std::string_view::npos || paren == 0)
+        return false;
+    const auto head = body.substr(0, paren);
+    if (head.find('=') != std::string_view::npos && head.find("operator") == std::string_view::npos)
+        return false;
+    std::size_t end = paren;
+    while (end > 0 && body[end - 1] == ' ')
+        --end;
+    if (end == 0 || (!is_ident(body[end - 1]) && head.find("operator") == std::string_view::npos))
+        return false;
+
+    // Title: through the closing parenthesis when it is on this line.
+    int depth = 0;
+    std::size_t close = body.size();
+    for (std::size_t i = paren; i < body.size(); ++i)
+    {
+        if (body[i] == '(')
+            ++depth;
+        else if (body[i] == ')' && --depth == 0)
+        {
+            close = i + 1;
+            break;
+        }
+    }
+    e.level = 1;
+    e.title = make_title(body.substr(0, close));
+    return true;
+}
+
+bool scan_line(OutlineLanguage language, std::string_view line, OutlineEntry &e)
+{
+    line = line.substr(0, OutlineIndex::kLinePrefixBytes);
+    switch (language)
+    {
+    case OutlineLanguage::Markdown:
+        return scan_markdown(line, e);
+    case OutlineLanguage::Yaml:
+        return scan_yaml(line, e);
+    case OutlineLanguage::Cpp:
+        return scan_cpp(line, e);
+    case OutlineLanguage::None:
+        break;
+    }
+    return false;
+}
+
+// Scans `text` line by line from line `first`; returns the number of lines.
+std::uint32_t scan(OutlineLanguage language, std::string_view text, std::uint32_t first,
+                   std::vector<OutlineEntry> &out)
+{
+    std::uint32_t line = first;
+    std::size_t at = 0;
+    while (true)
+    {
+        const auto *nl = static_cast<const char *>(std::memchr(text.data() + at, '\n', text.size() - at));
+        const std::size_t end = nl ? static_cast<std::size_t>(nl - text.data()) : text.size();
+        OutlineEntry e;
+        if (scan_line(language, text.substr(at, end - at), e))
+        {
+            e.line = line;
+            out.push_back(std::move(e));
+        }
+        if (!nl)
+            break;
+        at = end + 1;
+        ++line;
+    }
+    return line - first + 1;
+}
+} // namespace
+
+OutlineLanguage outline_language_for(std::string_view path)
+{
+    for (auto ext : {".md", ".markdown", ".mdown"})
+        if (ends_with_ci(path, ext))
+            return OutlineLanguage::Markdown;
+    for (auto ext : {".yaml", ".yml"})
+        if (ends_with_ci(path, ext))
+            return OutlineLanguage::Yaml;
+    for (auto ext : {".c", ".cc", ".cpp", ".cxx", ".h", ".hh", ".hpp", ".hxx", ".ipp", ".inl"})
+        if (ends_with_ci(path, ext))
+            return OutlineLanguage::Cpp;
+    return OutlineLanguage::None;
+}
+
+const char *outline_language_name(OutlineLanguage language)
+{
+    switch (language)
+    {
+    case OutlineLanguage::Markdown:
+        return "Markdown";
+    case OutlineLanguage::Yaml:
+        return "YAML";
+    case OutlineLanguage::Cpp:
+        return "C/C++";
+    case OutlineLanguage::None:
+        break;
+    }
+    return "none";
+}
+
+void OutlineIndex::clear()
+{
+    m_entries.clear();
+    m_entries.shrink_to_fit();
+    m_valid = false;
+}
+
+bool OutlineIndex::build(std::string_view text, const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    TRACE_SCOPE("outline.build");
+    clear();
+
+    // Chunks end after a line break so each job starts on a line of its own.
+    std::vector<std::string_view> chunks;
+    for (std::size_t at = 0; at < text.size();)
+    {
+        std::size_t end = std::min(text.size(), at + kChunkBytes);
+        const auto nl = text.find('\n', end);
+        end = nl == std::string_view::npos ? text.size() : nl + 1;
+        chunks.push_back(text.substr(at, end - at));
+        at = end;
+    }
+
+    // Lines are numbered per chunk, then offset by the lines before it.
+    struct Part
+    {
+        std::vector<OutlineEntry> entries;
+        std::uint32_t lines = 0;
+    };
+    std::vector<Part> parts(chunks.size());
+    std::atomic<std::size_t> done{0};
+    parallel_for(chunks.size(), [&](std::size_t c)
+                 {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return;
+        // Every chunk but the last ends in '\n'; don't count the empty line after it.
+        auto chunk = chunks[c];
+        if (c + 1 < chunks.size())
+            chunk.remove_suffix(1);
+        parts[c].lines = scan(m_language, chunk, 0, parts[c].entries);
+        if (progress)
+            progress->store(static_cast<double>(++done) / static_cast<double>(chunks.size()),
+                            std::memory_order_relaxed); });
+    if (cancel && cancel->load(std::memory_order_relaxed))
+        return false;
+
+    std::uint32_t base = 0;
+    for (auto &part : parts)
+    {
+        for (auto &e : part.entries)
+        {
+            e.line += base;
+            m_entries.push_back(std::move(e));
+        }
+        base += part.lines;
+    }
+    m_valid = true;
+    return true;
+}
+
+void OutlineIndex::replace_lines(std::uint32_t first, std::uint32_t old_lines, std::string_view text)
+{
+    if (!m_valid)
+        return;
+
+    std::vector<OutlineEntry> added;
+    const std::uint32_t new_lines = scan(m_language, text, first, added);
+
+    auto by_line = [](const OutlineEntry &e, std::uint32_t line)
+    { return e.line < line; };
+    auto from = std::lower_bound(m_entries.begin(), m_entries.end(), first, by_line);
+    auto to = std::lower_bound(from, m_entries.end(), first + old_lines, by_line);
+    for (auto it = to; it != m_entries.end(); ++it)
+        it->line = it->line + new_lines - old_lines;
+
+    // Most edits replace one entry by one (or none by none).
+    const auto removed = static_cast<std::size_t>(to - from);
+    const auto common = std::min(removed, added.size());
+    std::move(added.begin(), added.begin() + static_cast<std::ptrdiff_t>(common), from);
+    from += static_cast<std::ptrdiff_t>(common);
+    if (removed > common)
+        m_entries.erase(from, to);
+    else
+        m_entries.insert(from, std::make_move_iterator(added.begin() + static_cast<std::ptrdiff_t>(common)),
+                         std::make_move_iterator(added.end()));
+}
+
+void OutlineIndex::visible(std::string_view filter, std::vector<std::uint32_t> &out) const
+{
+    out.clear();
+    bool in_fence = false;
+    for (std::size_t i = 0; i < m_entries.size(); ++i)
+    {
+        const auto &e = m_entries[i];
+        if (e.level == 0)
+        {
+            in_fence = !in_fence;
+            continue;
+        }
+        if (in_fence || (!filter.empty() && !contains_ci(e.title, filter)))
+            continue;
+        out.push_back(static_cast<std::uint32_t>(i));
+    }
+}
+
+std::size_t OutlineIndex::bytes() const
+{
+    std::size_t n = m_entries.capacity() * sizeof(OutlineEntry);
+    for (const auto &e : m_entries)
+    {
+        if (e.title.capacity() > 15)
+            n += e.title.capacity() + 1;
+    }
+    return n;
+}
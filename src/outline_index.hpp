@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class OutlineLanguage
+{
+  None,
+  Markdown, // ATX headings (# … ######), outside ``` / ~~~ fences
+  Yaml,     // top-level keys
+  Cpp,      // definitions that start in column 0: functions, classes, structs, enums
+};
+
+// Picks the scanner from the file name's extension.
+OutlineLanguage outline_language_for(std::string_view path);
+const char *outline_language_name(OutlineLanguage language);
+
+struct OutlineEntry
+{
+  std::uint32_t line = 0; // 0-based
+  std::uint8_t level = 1; // 1 = top; 0 marks a Markdown code fence (never listed)
+  std::string title;
+};
+
+// Headings / keys / definitions of a document, by line.
+//
+// Every scanner looks at one line at a time (and only at its first
+// kLinePrefixBytes), so an edit is handled by rescanning just the lines it
+// touched: replace_lines() swaps their entries and shifts the line numbers
+// after them. Code fences are kept as entries and resolved when listing.
+class OutlineIndex
+{
+public:
+  static constexpr std::size_t kLinePrefixBytes = 256;
+
+  void set_language(OutlineLanguage language) { m_language = language; }
+  OutlineLanguage language() const { return m_language; }
+
+  void clear();
+
+  // Scans all of `text` (line 0 onwards) on all cores. Returns false if
+  // cancelled.
+  bool build(std::string_view text, const std::atomic<bool> *cancel = nullptr,
+             std::atomic<double> *progress = nullptr);
+
+  bool valid() const { return m_valid; }
+
+  // Lines [first, first + old_lines) are now `text`: the new lines, joined
+  // with '\n' (each may be cut to its first kLinePrefixBytes).
+  void replace_lines(std::uint32_t first, std::uint32_t old_lines, std::string_view text);
+
+  // Indexes of the entries to list, in document order: outside code fences
+  // and, if `filter` is not empty, with a title containing it (ASCII case
+  // folded).
+  void visible(std::string_view filter, std::vector<std::uint32_t> &out) const;
+
+  const OutlineEntry &entry(std::size_t i) const { return m_entries[i]; }
+  std::size_t size() const { return m_entries.size(); }
+  std::size_t bytes() const;
+
+private:
+  OutlineLanguage m_language = OutlineLanguage::None;
+  std::vector<OutlineEntry> m_entries;
+  bool m_valid = false;
+};
@@ -0,0 +1,59 @@
+#include "outline_panel.hpp"
+
+OutlinePanel::OutlinePanel() : Gtk::Box(Gtk::Orientation::VERTICAL)
+{
+    set_spacing(6);
+    set_size_request(240, -1);
+
+    m_filter.set_placeholder_text("Filter outline");
+    m_rows.set_vexpand(true);
+    m_status.set_halign(Gtk::Align::START);
+
+    append(m_filter);
+    append(m_rows);
+    append(m_status);
+
+    m_filter.signal_search_changed().connect(sigc::mem_fun(*this, &OutlinePanel::refresh));
+    m_filter.signal_activate().connect([this]()
+                                       {
+        if (!m_rows.shown.empty())
+            m_line_activated.emit(m_rows.index->entry(m_rows.shown[0]).line); });
+    m_rows.signal_row_activated().connect([this](std::size_t row)
+                                          {
+        if (m_rows.index && row < m_rows.shown.size())
+            m_line_activated.emit(m_rows.index->entry(m_rows.shown[row]).line); });
+}
+
+void OutlinePanel::set_index(const OutlineIndex *index)
+{
+    m_rows.index = index;
+    refresh();
+}
+
+void OutlinePanel::refresh()
+{
+    if (!m_rows.index || !m_rows.index->valid())
+    {
+        m_rows.shown.clear();
+        m_rows.set_row_count(0);
+        return;
+    }
+
+    m_rows.index->visible(m_filter.get_text().raw(), m_rows.shown);
+    m_rows.set_row_count(m_rows.shown.size());
+    m_rows.redraw();
+    set_status(std::to_string(m_rows.shown.size()) + " entries (" +
+               outline_language_name(m_rows.index->language()) + ").");
+}
+
+void OutlinePanel::Rows::draw_row(const Cairo::RefPtr<Cairo::Context> &cr,
+                                  const Glib::RefPtr<Pango::Layout> &layout, std::size_t row, double y, int)
+{
+    // A row can outlive its entry until the next refresh() after an edit.
+    if (shown[row] >= index->size())
+        return;
+    const auto &e = index->entry(shown[row]);
+    layout->set_text(e.title);
+    cr->move_to(4.0 + (e.level - 1) * 2 * char_width(), y);
+    layout->show_in_cairo_context(cr);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "outline_index.hpp"
+#include "virtual_row_view.hpp"
+
+#include <gtkmm.h>
+#include <cstdint>
+#include <vector>
+
+// Side panel listing the document outline (see OutlineIndex), narrowed by a
+// filter as it is typed. The index belongs to the window; the panel only
+// keeps the indexes of the entries it lists and refreshes them when told.
+// Clicking a row reports the entry's line.
+class OutlinePanel : public Gtk::Box
+{
+public:
+  OutlinePanel();
+
+  // Lists `index` (which must outlive the panel or be reset with nullptr).
+  void set_index(const OutlineIndex *index);
+  // Re-reads the index after it changed.
+  void refresh();
+  void set_status(const Glib::ustring &s) { m_status.set_text(s); }
+
+  sigc::signal<void(std::uint32_t)> &signal_line_activated() { return m_line_activated; }
+
+private:
+  class Rows : public VirtualRowView
+  {
+  public:
+    const OutlineIndex *index = nullptr;
+    std::vector<std::uint32_t> shown;
+
+  protected:
+    void draw_row(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                  std::size_t row, double y, int width) override;
+  };
+
+  Gtk::SearchEntry m_filter;
+  Rows m_rows;
+  Gtk::Label m_status;
+
+  sigc::signal<void(std::uint32_t)> m_line_activated;
+};
@@ -0,0 +1,126 @@
+#include "overview_histogram.hpp"
+
+#include "trace.hpp"
+
+#include <algorithm>
+
+void OverviewHistogram::reset(std::uint64_t chars)
+{
+    m_length = 0;
+    m_width = 1;
+    std::fill(m_matches.begin(), m_matches.end(), 0);
+    std::fill(m_edited.begin(), m_edited.end(), 0);
+    m_max_matches = 0;
+    fit(chars);
+    m_length = chars;
+}
+
+void OverviewHistogram::insert(std::uint64_t offset, std::uint64_t chars, bool edited)
+{
+    fit(m_length + chars);
+    m_length += chars;
+    shift(bucket_of(offset), static_cast<std::int64_t>(chars / m_width));
+    if (edited)
+        mark_edited(offset, offset + chars);
+}
+
+void OverviewHistogram::erase(std::uint64_t offset, std::uint64_t chars, bool edited)
+{
+    chars = std::min(chars, m_length);
+    m_length -= chars;
+    shift(bucket_of(offset), -static_cast<std::int64_t>(chars / m_width));
+    if (edited)
+        mark_edited(offset, offset);
+}
+
+void OverviewHistogram::mark_edited(std::uint64_t from, std::uint64_t to)
+{
+    // An empty range (an erase) still marks the bucket it happened in.
+    const std::size_t last = bucket_of(std::max(from + 1, to) - 1);
+    for (std::size_t b = bucket_of(from); b <= last; ++b)
+        m_edited[b] = 1;
+}
+
+void OverviewHistogram::clear_edited()
+{
+    std::fill(m_edited.begin(), m_edited.end(), 0);
+}
+
+void OverviewHistogram::set_matches(const std::vector<std::pair<int, int>> &ranges)
+{
+    TRACE_SCOPE("overview.matches");
+    std::fill(m_matches.begin(), m_matches.end(), 0);
+    for (const auto &[s, e] : ranges)
+        ++m_matches[bucket_of(static_cast<std::uint64_t>(std::max(s, 0)))];
+    m_max_matches = *std::max_element(m_matches.begin(), m_matches.end());
+}
+
+std::size_t OverviewHistogram::bucket_count() const
+{
+    return static_cast<std::size_t>(std::max<std::uint64_t>(1, (m_length + m_width - 1) / m_width));
+}
+
+void OverviewHistogram::range(std::uint64_t from, std::uint64_t to, std::uint32_t &matches, bool &edited) const
+{
+    matches = 0;
+    edited = false;
+    const std::size_t first = bucket_of(from);
+    const std::size_t last = bucket_of(std::max(from, to > 0 ? to - 1 : 0));
+    for (std::size_t b = first; b <= last; ++b)
+    {
+        matches += m_matches[b];
+        edited |= m_edited[b] != 0;
+    }
+}
+
+std::size_t OverviewHistogram::bytes() const
+{
+    return m_matches.capacity() * sizeof(std::uint32_t) + m_edited.capacity();
+}
+
+std::size_t OverviewHistogram::bucket_of(std::uint64_t offset) const
+{
+    return static_cast<std::size_t>(std::min<std::uint64_t>(offset / m_width, kMaxBuckets - 1));
+}
+
+void OverviewHistogram::shift(std::size_t bucket, std::int64_t n)
+{
+    if (n == 0 || bucket + 1 >= kMaxBuckets)
+        return;
+    const auto first = static_cast<std::ptrdiff_t>(bucket + 1);
+    const auto end = static_cast<std::ptrdiff_t>(kMaxBuckets);
+    const auto by = static_cast<std::ptrdiff_t>(std::min<std::uint64_t>(n > 0 ? n : -n, kMaxBuckets - bucket - 1));
+    const auto move = [&](auto &v)
+    {
+        if (n > 0)
+        {
+            std::copy_backward(v.begin() + first, v.begin() + (end - by), v.begin() + end);
+            std::fill(v.begin() + first, v.begin() + first + by, 0);
+        }
+        else
+        {
+            std::copy(v.begin() + first + by, v.begin() + end, v.begin() + first);
+            std::fill(v.begin() + (end - by), v.begin() + end, 0);
+        }
+    };
+    move(m_matches);
+    move(m_edited);
+    m_max_matches = *std::max_element(m_matches.begin(), m_matches.end());
+}
+
+void OverviewHistogram::fit(std::uint64_t length)
+{
+    // Double the width, merging bucket pairs, until the document fits.
+    while (length > m_width * kMaxBuckets)
+    {
+        for (std::size_t b = 0; b < kMaxBuckets / 2; ++b)
+        {
+            m_matches[b] = m_matches[2 * b] + m_matches[2 * b + 1];
+            m_edited[b] = m_edited[2 * b] | m_edited[2 * b + 1];
+        }
+        std::fill(m_matches.begin() + kMaxBuckets / 2, m_matches.end(), 0);
+        std::fill(m_edited.begin() + kMaxBuckets / 2, m_edited.end(), 0);
+        m_width *= 2;
+        m_max_matches = *std::max_element(m_matches.begin(), m_matches.end());
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// What the overview ruler draws, bucketed by character offset: "Highlight
+// all" matches per bucket and whether the bucket was edited since the
+// last load or save.
+//
+// Buckets are a fixed number of characters wide; when the document
+// outgrows kMaxBuckets of them the width doubles and neighbours merge, so
+// no update costs more than O(kMaxBuckets) and nothing ever walks the
+// text. An edit moves the buckets after it by the whole buckets it
+// inserted or erased; what is left over, less than a bucket per edit,
+// is not tracked.
+class OverviewHistogram
+{
+public:
+  static constexpr std::size_t kMaxBuckets = 1024;
+
+  // Empty, for a document of `chars` characters.
+  void reset(std::uint64_t chars);
+
+  // Text was inserted or erased at `offset`; `edited` marks the bucket.
+  void insert(std::uint64_t offset, std::uint64_t chars, bool edited);
+  void erase(std::uint64_t offset, std::uint64_t chars, bool edited);
+  // Marks [from, to) edited, for text that went in with `edited` unset.
+  void mark_edited(std::uint64_t from, std::uint64_t to);
+  void clear_edited();
+
+  // Recounts the matches from their character ranges.
+  void set_matches(const std::vector<std::pair<int, int>> &ranges);
+
+  std::uint64_t length() const { return m_length; }
+  std::uint64_t bucket_chars() const { return m_width; }
+  // Buckets covering [0, length()).
+  std::size_t bucket_count() const;
+  std::uint32_t matches(std::size_t bucket) const { return m_matches[bucket]; }
+  std::uint32_t max_matches() const { return m_max_matches; }
+  bool edited(std::size_t bucket) const { return m_edited[bucket] != 0; }
+
+  // Sum of matches and whether any bucket was edited over [from, to).
+  void range(std::uint64_t from, std::uint64_t to, std::uint32_t &matches, bool &edited) const;
+
+  std::size_t bytes() const;
+
+private:
+  std::uint64_t m_length = 0;
+  std::uint64_t m_width = 1;
+  std::vector<std::uint32_t> m_matches = std::vector<std::uint32_t>(kMaxBuckets, 0);
+  std::vector<std::uint8_t> m_edited = std::vector<std::uint8_t>(kMaxBuckets, 0);
+  std::uint32_t m_max_matches = 0;
+
+  std::size_t bucket_of(std::uint64_t offset) const;
+  // Moves the buckets after `bucket` by `n` buckets (back if negative).
+  void shift(std::size_t bucket, std::int64_t n);
+  void fit(std::uint64_t length);
+};
@@ -0,0 +1,101 @@
+#include "overview_ruler.hpp"
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr int kRulerWidth = 14;
+// Left columns for edited regions; the rest is match density.
+constexpr int kEditedWidth = 3;
+} // namespace
+
+OverviewRuler::OverviewRuler()
+{
+    set_content_width(kRulerWidth);
+    set_vexpand(true);
+    set_draw_func(sigc::mem_fun(*this, &OverviewRuler::on_draw));
+
+    auto drag = Gtk::GestureDrag::create();
+    drag->signal_drag_begin().connect([this](double, double y)
+                                      {
+        m_drag_y = y;
+        seek_to(y); });
+    drag->signal_drag_update().connect([this](double, double dy)
+                                       { seek_to(m_drag_y + dy); });
+    add_controller(drag);
+}
+
+void OverviewRuler::set_histogram(const OverviewHistogram *histogram)
+{
+    m_histogram = histogram;
+    queue_draw();
+}
+
+void OverviewRuler::set_viewport(std::uint64_t top, std::uint64_t bottom)
+{
+    if (top == m_top && bottom == m_bottom)
+        return;
+    m_top = top;
+    m_bottom = bottom;
+    queue_draw();
+}
+
+void OverviewRuler::seek_to(double y)
+{
+    const int height = get_height();
+    if (!m_histogram || height <= 0)
+        return;
+    const double at = std::clamp(y / height, 0.0, 1.0);
+    m_seek.emit(static_cast<std::uint64_t>(at * static_cast<double>(m_histogram->length())));
+}
+
+void OverviewRuler::on_draw(const Cairo::RefPtr<Cairo::Context> &cr, int width, int height)
+{
+    TRACE_SCOPE("overview.draw");
+
+    cr->set_source_rgba(0.5, 0.5, 0.5, 0.08);
+    cr->paint();
+    if (!m_histogram || m_histogram->length() == 0 || height <= 0)
+        return;
+
+    // One pixel row at a time: the buckets under it are summed, so the
+    // cost follows the ruler's height, not the document.
+    const double length = static_cast<double>(m_histogram->length());
+    const double scale = std::log1p(static_cast<double>(std::max<std::uint32_t>(1, m_histogram->max_matches())));
+    for (int y = 0; y < height; ++y)
+    {
+        const auto from = static_cast<std::uint64_t>(length * y / height);
+        const auto to = static_cast<std::uint64_t>(length * (y + 1) / height);
+        std::uint32_t matches = 0;
+        bool edited = false;
+        m_histogram->range(from, std::max(to, from + 1), matches, edited);
+
+        if (edited)
+        {
+            cr->set_source_rgb(0.25, 0.55, 0.95);
+            cr->rectangle(0, y, kEditedWidth, 1);
+            cr->fill();
+        }
+        if (matches > 0)
+        {
+            // Log scale, so a few hits next to a dense cluster still show.
+            const double alpha = 0.25 + 0.75 * std::log1p(static_cast<double>(matches)) / scale;
+            cr->set_source_rgba(0.95, 0.6, 0.0, std::min(1.0, alpha));
+            cr->rectangle(kEditedWidth + 1, y, width - kEditedWidth - 1, 1);
+            cr->fill();
+        }
+    }
+
+    // The part on screen, at least a few pixels tall.
+    const double top = std::floor(static_cast<double>(m_top) / length * height);
+    const double bottom = std::max(top + 4.0, std::ceil(static_cast<double>(m_bottom) / length * height));
+    cr->set_source_rgba(0.4, 0.4, 0.4, 0.18);
+    cr->rectangle(0, top, width, bottom - top);
+    cr->fill_preserve();
+    cr->set_source_rgba(0.3, 0.3, 0.3, 0.6);
+    cr->set_line_width(1.0);
+    cr->stroke();
+}
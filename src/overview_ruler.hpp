@@ -0,0 +1,34 @@
+#pragma once
+
+#include "overview_histogram.hpp"
+
+#include <gtkmm.h>
+#include <cstdint>
+
+// Narrow strip beside the editor drawing an OverviewHistogram over the
+// whole document: match density on the right, edited regions on the left
+// and the part on screen as a frame. Clicking or dragging asks for the
+// document to be scrolled to that point (signal_seek, a character offset).
+class OverviewRuler : public Gtk::DrawingArea
+{
+public:
+  OverviewRuler();
+
+  // The histogram is owned by the window and must outlive the ruler.
+  void set_histogram(const OverviewHistogram *histogram);
+  // Characters [top, bottom) are on screen.
+  void set_viewport(std::uint64_t top, std::uint64_t bottom);
+
+  sigc::signal<void(std::uint64_t)> &signal_seek() { return m_seek; }
+
+private:
+  const OverviewHistogram *m_histogram = nullptr;
+  std::uint64_t m_top = 0;
+  std::uint64_t m_bottom = 0;
+  double m_drag_y = 0.0;
+
+  sigc::signal<void(std::uint64_t)> m_seek;
+
+  void on_draw(const Cairo::RefPtr<Cairo::Context> &cr, int width, int height);
+  void seek_to(double y);
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Worker count for CPU-bound jobs: one per core, never more than there is work.
+inline unsigned worker_count(std::size_t jobs)
+{
+  unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  return static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(hw, jobs)));
+}
+
+// Runs fn(i) for every i in [0, n). Workers pull indices from a shared
+// counter, so uneven jobs (big and small files, dense and sparse chunks)
+// still balance. Runs inline when there is only one worker.
+template <typename Fn>
+void parallel_for(std::size_t n, Fn &&fn, unsigned threads = 0)
+{
+  if (n == 0)
+    return;
+  if (threads == 0)
+    threads = worker_count(n);
+  threads = static_cast<unsigned>(std::min<std::size_t>(threads, n));
+
+  if (threads <= 1)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+      fn(i);
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  auto worker = [&]()
+  {
+    for (std::size_t i = next.fetch_add(1, std::memory_order_relaxed); i < n;
+         i = next.fetch_add(1, std::memory_order_relaxed))
+      fn(i);
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (unsigned t = 1; t < threads; ++t)
+    pool.emplace_back(worker);
+  worker();
+  for (auto &th : pool)
+    th.join();
+}
+
+// Stable parallel merge sort: each worker sorts a run, then pairs of runs
+// are merged in parallel, ping-ponging between two buffers. `cancel` is
+// polled between merge passes; `progress` reaches 0.6 once the runs are
+// sorted. Returns false if cancelled (the order of `items` is then
+// unspecified).
+template <typename T, typename Less>
+bool parallel_stable_sort(std::vector<T> &items, Less less, const std::atomic<bool> *cancel = nullptr,
+                          std::atomic<double> *progress = nullptr)
+{
+  // Below this many items a single-threaded sort wins.
+  constexpr std::size_t kMinParallel = 1 << 16;
+
+  const std::size_t n = items.size();
+  const unsigned runs = n < kMinParallel ? 1u : worker_count(n / (kMinParallel / 4));
+
+  std::vector<std::size_t> bounds(runs + 1);
+  for (unsigned r = 0; r <= runs; ++r)
+    bounds[r] = n * r / runs;
+
+  parallel_for(runs, [&](std::size_t r)
+               { std::stable_sort(items.begin() + static_cast<std::ptrdiff_t>(bounds[r]),
+                                  items.begin() + static_cast<std::ptrdiff_t>(bounds[r + 1]), less); });
+  if (progress)
+    progress->store(0.6, std::memory_order_relaxed);
+
+  std::vector<T> scratch(n);
+  std::vector<T> *from = &items, *to = &scratch;
+  while (bounds.size() > 2)
+  {
+    if (cancel && cancel->load(std::memory_order_relaxed))
+      return false;
+
+    const std::size_t spans = bounds.size() / 2;
+    parallel_for(spans, [&](std::size_t p)
+                 {
+      const std::size_t lo = bounds[2 * p];
+      const std::size_t mid = bounds[std::min(2 * p + 1, bounds.size() - 1)];
+      const std::size_t hi = bounds[std::min(2 * p + 2, bounds.size() - 1)];
+      std::merge(std::make_move_iterator(from->begin() + static_cast<std::ptrdiff_t>(lo)),
+                 std::make_move_iterator(from->begin() + static_cast<std::ptrdiff_t>(mid)),
+                 std::make_move_iterator(from->begin() + static_cast<std::ptrdiff_t>(mid)),
+                 std::make_move_iterator(from->begin() + static_cast<std::ptrdiff_t>(hi)),
+                 to->begin() + static_cast<std::ptrdiff_t>(lo), less); });
+
+    std::vector<std::size_t> next;
+    for (std::size_t i = 0; i < bounds.size(); i += 2)
+      next.push_back(bounds[i]);
+    if (next.back() != n)
+      next.push_back(n);
+    bounds = std::move(next);
+    std::swap(from, to);
+  }
+  if (from != &items)
+    items.swap(*from);
+  return true;
+}
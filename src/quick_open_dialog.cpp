@@ -0,0 +1,370 @@
+#include "quick_open_dialog.hpp"
+
+#include "trace.hpp"
+
+#include <algorithm>
+
+namespace
+{
+// Rows listed per query.
+constexpr std::size_t kMaxResults = 200;
+// Each directory monitor is an inotify watch, a per-user resource; past
+// this many, the deepest directories go unwatched.
+constexpr std::size_t kMaxMonitors = 4096;
+// Quiet period before re-indexing after new directories or .gitignore edits.
+constexpr unsigned kReindexDelayMs = 1000;
+} // namespace
+
+QuickOpenDialog::QuickOpenDialog(Gtk::Window &parent, OpenFn open) : m_parent(parent), m_open(std::move(open))
+{
+    m_rows.index = &m_index;
+    build_ui();
+    connect_signals();
+}
+
+QuickOpenDialog::~QuickOpenDialog()
+{
+    m_task.stop();
+    m_reindex_timer.disconnect();
+    m_refresh_idle.disconnect();
+    unwatch();
+}
+
+void QuickOpenDialog::present(const std::string &dir)
+{
+    const auto root = m_root_chosen ? m_wanted_root : FileIndex::project_root(dir);
+    if (root != m_wanted_root || (!m_index.valid() && !m_task.running()))
+        index(root);
+    else
+        refresh();
+
+    m_win.present();
+    m_query.grab_focus();
+    m_query.select_region(0, -1);
+}
+
+void QuickOpenDialog::drop()
+{
+    m_task.stop();
+    m_reindex_timer.disconnect();
+    unwatch();
+    m_index.clear();
+    m_rows.hits.clear();
+    m_rows.set_row_count(0);
+    if (!m_root_chosen)
+        m_wanted_root.clear();
+}
+
+void QuickOpenDialog::build_ui()
+{
+    m_win.set_title("Quick Open");
+    m_win.set_transient_for(m_parent);
+    m_win.set_destroy_with_parent(true);
+    m_win.set_modal(true);
+    m_win.set_default_size(640, 420);
+
+    m_root.set_margin(12);
+    m_root.set_spacing(8);
+    m_win.set_child(m_root);
+
+    m_bar.set_spacing(8);
+    m_folder.set_hexpand(true);
+    m_folder.set_halign(Gtk::Align::START);
+    m_folder.set_ellipsize(Pango::EllipsizeMode::START);
+    m_bar.append(m_folder);
+    m_bar.append(m_choose);
+
+    m_query.set_placeholder_text("File name…");
+    m_rows.set_vexpand(true);
+    m_status.set_halign(Gtk::Align::START);
+
+    m_root.append(m_bar);
+    m_root.append(m_query);
+    m_root.append(m_rows);
+    m_root.append(m_status);
+
+    m_win.signal_close_request().connect([this]() -> bool
+                                         {
+    m_win.hide();
+    return false; }, false);
+}
+
+void QuickOpenDialog::connect_signals()
+{
+    m_choose.signal_clicked().connect(sigc::mem_fun(*this, &QuickOpenDialog::on_choose_folder));
+    m_query.signal_search_changed().connect(sigc::mem_fun(*this, &QuickOpenDialog::refresh));
+    m_query.signal_activate().connect([this]()
+                                      { activate(m_rows.selected); });
+    m_query.signal_stop_search().connect([this]()
+                                         { m_win.hide(); });
+    m_rows.signal_row_activated().connect(sigc::mem_fun(*this, &QuickOpenDialog::activate));
+
+    // Up/Down move through the results while the entry keeps focus.
+    auto keys = Gtk::EventControllerKey::create();
+    keys->set_propagation_phase(Gtk::PropagationPhase::CAPTURE);
+    keys->signal_key_pressed().connect([this](guint keyval, guint, Gdk::ModifierType)
+                                       {
+        switch (keyval)
+        {
+        case GDK_KEY_Up:
+            move_selection(-1);
+            return true;
+        case GDK_KEY_Down:
+            move_selection(1);
+            return true;
+        case GDK_KEY_Page_Up:
+            move_selection(-10);
+            return true;
+        case GDK_KEY_Page_Down:
+            move_selection(10);
+            return true;
+        default:
+            return false;
+        } },
+                                       false);
+    m_win.add_controller(keys);
+}
+
+// -------- Index --------
+void QuickOpenDialog::index(const std::string &root)
+{
+    m_task.stop();
+    m_reindex_timer.disconnect();
+    m_wanted_root = root;
+    m_folder.set_text(root);
+    if (m_index.root() != root)
+    {
+        // Another project: its results would only mislead.
+        unwatch();
+        m_index.clear();
+        refresh();
+    }
+
+    auto built = std::make_shared<FileIndex>();
+    m_task.start([root, built](BackgroundTask::Control &control)
+                 { built->build(root, &control.cancel); },
+                 [this, built](bool cancelled)
+                 {
+                     if (cancelled)
+                         return;
+                     unwatch();
+                     m_index = std::move(*built);
+                     watch();
+                     refresh();
+                 });
+    set_status("Indexing " + root + "…");
+}
+
+void QuickOpenDialog::watch()
+{
+    TRACE_SCOPE("quick_open.watch");
+    m_root_file = Gio::File::create_for_path(m_index.root());
+    const auto &dirs = m_index.directories();
+    const std::size_t n = std::min(dirs.size(), kMaxMonitors);
+    m_monitors.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        try
+        {
+            auto dir = dirs[i].empty() ? m_root_file : m_root_file->resolve_relative_path(dirs[i]);
+            auto monitor = dir->monitor_directory(Gio::FileMonitorFlags::WATCH_MOVES);
+            monitor->signal_changed().connect(sigc::mem_fun(*this, &QuickOpenDialog::on_monitor_event));
+            m_monitors.push_back(std::move(monitor));
+        }
+        catch (const Glib::Error &)
+        {
+            break; // out of watches; the rest stays as indexed
+        }
+    }
+}
+
+void QuickOpenDialog::unwatch()
+{
+    for (auto &monitor : m_monitors)
+        monitor->cancel();
+    m_monitors.clear();
+}
+
+void QuickOpenDialog::on_monitor_event(const Glib::RefPtr<Gio::File> &file, const Glib::RefPtr<Gio::File> &other,
+                                       Gio::FileMonitor::Event event)
+{
+    if (!m_index.valid() || !file)
+        return;
+
+    // New files go in when .gitignore lets them; new directories and rule
+    // changes need a walk, so they re-index.
+    auto appeared = [this](const Glib::RefPtr<Gio::File> &f)
+    {
+        const auto rel = m_root_file->get_relative_path(f);
+        if (rel.empty())
+            return;
+        if (f->get_basename() == ".gitignore")
+        {
+            queue_reindex();
+            return;
+        }
+        const auto type = f->query_file_type();
+        if (type == Gio::FileType::DIRECTORY)
+            queue_reindex();
+        else if (type == Gio::FileType::REGULAR && !m_index.ignored(rel, false))
+            m_index.add(rel);
+    };
+    auto vanished = [this](const Glib::RefPtr<Gio::File> &f)
+    {
+        const auto rel = m_root_file->get_relative_path(f);
+        if (rel.empty())
+            return;
+        if (f->get_basename() == ".gitignore")
+            queue_reindex();
+        if (!m_index.remove(rel))
+            m_index.remove_tree(rel);
+    };
+
+    using Event = Gio::FileMonitor::Event;
+    switch (event)
+    {
+    case Event::CREATED:
+    case Event::MOVED_IN:
+        appeared(file);
+        break;
+    case Event::DELETED:
+    case Event::MOVED_OUT:
+        vanished(file);
+        break;
+    case Event::RENAMED:
+        vanished(file);
+        if (other)
+            appeared(other);
+        break;
+    default:
+        return;
+    }
+    queue_refresh();
+}
+
+void QuickOpenDialog::queue_reindex()
+{
+    m_reindex_timer.disconnect();
+    m_reindex_timer = Glib::signal_timeout().connect([this]()
+                                                     {
+        index(m_wanted_root);
+        return false; },
+                                                     kReindexDelayMs);
+}
+
+void QuickOpenDialog::queue_refresh()
+{
+    // A burst of events (a checkout, a build) refreshes the list once.
+    if (m_refresh_idle.connected())
+        return;
+    m_refresh_idle = Glib::signal_idle().connect([this]()
+                                                 {
+        if (m_win.get_visible())
+            refresh();
+        return false; });
+}
+
+// -------- Results --------
+void QuickOpenDialog::refresh()
+{
+    TRACE_SCOPE("quick_open.refresh");
+    m_index.search(m_query.get_text().raw(), kMaxResults, m_rows.hits);
+    m_rows.selected = 0;
+    m_rows.set_row_count(m_rows.hits.size());
+    m_rows.scroll_to_row(0);
+    m_rows.redraw();
+
+    if (m_task.running())
+    {
+        set_status("Indexing " + m_wanted_root + "…");
+        return;
+    }
+    Glib::ustring status = std::to_string(m_rows.hits.size()) + " of " + std::to_string(m_index.size()) + " files";
+    if (m_index.truncated())
+        status += " (index stopped at " + std::to_string(FileIndex::kMaxFiles) + ")";
+    if (m_monitors.size() < m_index.directories().size())
+        status += "; watching " + std::to_string(m_monitors.size()) + " of " +
+                  std::to_string(m_index.directories().size()) + " folders";
+    set_status(status + ".");
+}
+
+void QuickOpenDialog::move_selection(int delta)
+{
+    if (m_rows.hits.empty())
+        return;
+    const auto last = static_cast<long long>(m_rows.hits.size()) - 1;
+    m_rows.selected = static_cast<std::size_t>(std::clamp(static_cast<long long>(m_rows.selected) + delta, 0LL, last));
+    m_rows.reveal_selected();
+}
+
+void QuickOpenDialog::activate(std::size_t row)
+{
+    if (row >= m_rows.hits.size())
+        return;
+    auto path = m_index.root();
+    if (path.back() != '/')
+        path += '/';
+    path += m_index.path(m_rows.hits[row].entry);
+    m_win.hide();
+    m_open(path);
+}
+
+void QuickOpenDialog::on_choose_folder()
+{
+    auto dlg = Gtk::FileDialog::create();
+    dlg->set_title("Quick Open Folder");
+    if (!m_wanted_root.empty())
+        dlg->set_initial_folder(Gio::File::create_for_path(m_wanted_root));
+
+    dlg->select_folder(m_win, [this, dlg](const Glib::RefPtr<Gio::AsyncResult> &res)
+                       {
+        try {
+            auto folder = dlg->select_folder_finish(res);
+            if (!folder) return;
+            m_root_chosen = true;
+            index(folder->get_path());
+        } catch (const Glib::Error &) {
+            // Dismissed; keep the current folder.
+        } });
+}
+
+void QuickOpenDialog::set_status(const Glib::ustring &s)
+{
+    m_status.set_text(s);
+}
+
+void QuickOpenDialog::Rows::reveal_selected()
+{
+    const std::size_t first = first_visible_row();
+    const std::size_t page = static_cast<std::size_t>(std::max(1, get_height() / row_height()));
+    if (selected < first)
+        scroll_to_row(selected);
+    else if (selected >= first + page)
+        scroll_to_row(selected - page + 1);
+    redraw();
+}
+
+void QuickOpenDialog::Rows::draw_row(const Cairo::RefPtr<Cairo::Context> &cr,
+                                     const Glib::RefPtr<Pango::Layout> &layout, std::size_t row, double y, int width)
+{
+    if (!index || row >= hits.size())
+        return;
+    if (row == selected)
+    {
+        cr->save();
+        cr->set_source_rgba(0.35, 0.55, 0.95, 0.25);
+        cr->rectangle(0.0, y, width, row_height());
+        cr->fill();
+        cr->restore();
+    }
+
+    // File name first, then the folder it is in.
+    const auto path = index->path(hits[row].entry);
+    const auto slash = path.rfind('/');
+    std::string text(slash == std::string_view::npos ? path : path.substr(slash + 1));
+    if (slash != std::string_view::npos)
+        text += "    " + std::string(path.substr(0, slash));
+    layout->set_text(text);
+    cr->move_to(4.0, y);
+    layout->show_in_cairo_context(cr);
+}
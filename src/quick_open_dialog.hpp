@@ -0,0 +1,92 @@
+#pragma once
+#include "background_task.hpp"
+#include "file_index.hpp"
+#include "virtual_row_view.hpp"
+
+#include <gtkmm.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Ctrl+P palette: type part of a file name, pick from the best matches.
+//
+// The files under the project folder are indexed once on a worker (see
+// FileIndex) and kept current from directory monitors, so every keystroke
+// is a search of the in-memory index. New directories and .gitignore
+// changes are picked up by a debounced re-index.
+class QuickOpenDialog {
+public:
+  // Opens the chosen file (absolute path).
+  using OpenFn = std::function<void(const std::string&)>;
+
+  QuickOpenDialog(Gtk::Window& parent, OpenFn open);
+  ~QuickOpenDialog();
+
+  // Shows the palette over the project that `dir` is in, unless a folder
+  // was picked by hand.
+  void present(const std::string& dir);
+
+  std::size_t bytes() const { return m_index.bytes(); }
+  std::size_t file_count() const { return m_index.size(); }
+  // Forgets the index and stops watching; the next present() rebuilds it.
+  void drop();
+
+private:
+  Gtk::Window& m_parent;
+  OpenFn m_open;
+
+  // UI
+  Gtk::Window m_win;
+  Gtk::Box m_root{Gtk::Orientation::VERTICAL};
+  Gtk::Box m_bar{Gtk::Orientation::HORIZONTAL};
+  Gtk::Label m_folder;
+  Gtk::Button m_choose{"Folder…"};
+  Gtk::SearchEntry m_query;
+
+  class Rows : public VirtualRowView
+  {
+  public:
+    const FileIndex* index = nullptr;
+    std::vector<FileHit> hits;
+    std::size_t selected = 0;
+
+    // Scrolls just enough to show the selected row.
+    void reveal_selected();
+
+  protected:
+    void draw_row(const Cairo::RefPtr<Cairo::Context>& cr, const Glib::RefPtr<Pango::Layout>& layout,
+                  std::size_t row, double y, int width) override;
+  };
+  Rows m_rows;
+
+  Gtk::Label m_status;
+
+  // Index state
+  FileIndex m_index;
+  BackgroundTask m_task;
+  std::string m_wanted_root;     // what the running or next build indexes
+  bool m_root_chosen = false;    // picked with "Folder…"; present() keeps it
+  Glib::RefPtr<Gio::File> m_root_file;
+  std::vector<Glib::RefPtr<Gio::FileMonitor>> m_monitors;
+  sigc::connection m_reindex_timer;
+  sigc::connection m_refresh_idle;
+
+private:
+  void build_ui();
+  void connect_signals();
+
+  void index(const std::string& root);
+  void watch();
+  void unwatch();
+  void on_monitor_event(const Glib::RefPtr<Gio::File>& file, const Glib::RefPtr<Gio::File>& other,
+                        Gio::FileMonitor::Event event);
+  void queue_reindex();
+  void queue_refresh();
+
+  void refresh();
+  void move_selection(int delta);
+  void activate(std::size_t row);
+  void on_choose_folder();
+
+  void set_status(const Glib::ustring& s);
+};
@@ -0,0 +1,257 @@
+#include "recent_cache.hpp"
+
+#include "binary_io.hpp"
+#include "content_hash.hpp"
+#include "mapped_file.hpp"
+#include "trace.hpp"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <algorithm>
+#include <cstring>
+
+using binary_io::put;
+using binary_io::Reader;
+
+namespace
+{
+constexpr char kIndexMagic[4] = {'S', 'R', 'C', '1'};
+constexpr char kLinesMagic[4] = {'S', 'L', 'I', '1'};
+// Longest path accepted when reading (anything longer is a corrupt file).
+constexpr std::uint32_t kMaxPathBytes = 64 * 1024;
+
+// Cache files are rebuilt when lost, so other users may read them.
+constexpr int kFileMode = 0644;
+
+// Whether remembering `b` over `a` would store nothing new. A line index
+// `b` claims but `a` lacks counts as unchanged: remember() drops it.
+bool same_entry(const RecentEntry &a, const RecentEntry &b)
+{
+    return a.path == b.path && a.size == b.size && a.mtime == b.mtime && a.fingerprint == b.fingerprint &&
+           a.cursor_line == b.cursor_line && a.cursor_column == b.cursor_column && a.top_line == b.top_line &&
+           a.format.bom == b.format.bom && a.format.eol == b.format.eol &&
+           (b.has_line_index || !a.has_line_index);
+}
+} // namespace
+
+RecentCache::RecentCache(std::string dir) : m_dir(std::move(dir))
+{
+    if (m_dir.empty())
+    {
+        gchar *d = g_build_filename(g_get_user_cache_dir(), "sophisticated", nullptr);
+        m_dir = d;
+        g_free(d);
+    }
+}
+
+std::string RecentCache::index_path() const
+{
+    return m_dir + G_DIR_SEPARATOR_S "recent.bin";
+}
+
+std::string RecentCache::lines_path(const std::string &path) const
+{
+    char name[32];
+    g_snprintf(name, sizeof name, "%016" G_GINT64_MODIFIER "x.lines",
+               static_cast<guint64>(content_hash::xxh64(path)));
+    return m_dir + G_DIR_SEPARATOR_S + name;
+}
+
+bool RecentCache::stat_file(const std::string &path, std::uint64_t &size, std::int64_t &mtime)
+{
+    GStatBuf st;
+    if (g_stat(path.c_str(), &st) != 0)
+        return false;
+    size = static_cast<std::uint64_t>(st.st_size);
+    mtime = static_cast<std::int64_t>(st.st_mtime);
+    return true;
+}
+
+void RecentCache::load()
+{
+    TRACE_SCOPE("recent.load");
+    read(m_entries);
+    m_remembered.clear();
+    m_forgotten.clear();
+}
+
+void RecentCache::read(std::vector<RecentEntry> &out) const
+{
+    out.clear();
+
+    std::string error;
+    auto file = MappedFile::open(index_path(), error);
+    if (!file)
+        return;
+
+    Reader in(file->view());
+    char magic[4];
+    std::uint32_t count = 0;
+    if (!in.get(magic) || std::memcmp(magic, kIndexMagic, sizeof magic) != 0 || !in.get(count))
+        return;
+
+    for (std::uint32_t i = 0; i < count && out.size() < kMaxEntries; ++i)
+    {
+        RecentEntry e;
+        std::uint8_t bom = 0, eol = 0, has_lines = 0, reserved = 0;
+        if (!in.get_string(e.path, kMaxPathBytes) ||
+            !in.get(e.size) || !in.get(e.mtime) || !in.get(e.fingerprint) || !in.get(e.cursor_line) ||
+            !in.get(e.cursor_column) || !in.get(e.top_line) || !in.get(bom) || !in.get(eol) ||
+            !in.get(has_lines) || !in.get(reserved) || eol > static_cast<std::uint8_t>(LineEnding::Mixed))
+            break;
+        e.format.bom = bom != 0;
+        e.format.eol = static_cast<LineEnding>(eol);
+        e.has_line_index = has_lines != 0;
+        out.push_back(std::move(e));
+    }
+}
+
+bool RecentCache::save()
+{
+    if (m_remembered.empty() && m_forgotten.empty())
+        return true;
+    TRACE_SCOPE("recent.save");
+
+    // Another window may have saved since: start from what is on disk and
+    // apply this window's changes, oldest first, on top.
+    std::vector<RecentEntry> mine = std::move(m_entries);
+    read(m_entries);
+    for (const auto &path : m_forgotten)
+        std::erase_if(m_entries, [&](const RecentEntry &e)
+                      { return e.path == path; });
+    for (const auto &path : m_remembered)
+    {
+        const auto it = std::find_if(mine.begin(), mine.end(), [&](const RecentEntry &e)
+                                     { return e.path == path; });
+        if (it == mine.end())
+            continue;
+        std::erase_if(m_entries, [&](const RecentEntry &e)
+                      { return e.path == path; });
+        m_entries.insert(m_entries.begin(), *it);
+    }
+    while (m_entries.size() > kMaxEntries)
+    {
+        if (m_entries.back().has_line_index)
+            g_remove(lines_path(m_entries.back().path).c_str());
+        m_entries.pop_back();
+    }
+    m_remembered.clear();
+    m_forgotten.clear();
+
+    g_mkdir_with_parents(m_dir.c_str(), 0700);
+
+    std::string out;
+    out.append(kIndexMagic, sizeof kIndexMagic);
+    put(out, static_cast<std::uint32_t>(m_entries.size()));
+    for (const auto &e : m_entries)
+    {
+        put(out, static_cast<std::uint32_t>(e.path.size()));
+        out += e.path;
+        put(out, e.size);
+        put(out, e.mtime);
+        put(out, e.fingerprint);
+        put(out, e.cursor_line);
+        put(out, e.cursor_column);
+        put(out, e.top_line);
+        put(out, static_cast<std::uint8_t>(e.format.bom));
+        put(out, static_cast<std::uint8_t>(e.format.eol));
+        put(out, static_cast<std::uint8_t>(e.has_line_index));
+        put(out, std::uint8_t{0});
+    }
+    return binary_io::write_file(index_path(), out, kFileMode);
+}
+
+const RecentEntry *RecentCache::find(const std::string &path, std::uint64_t size, std::int64_t mtime,
+                                     std::uint64_t fingerprint) const
+{
+    for (const auto &e : m_entries)
+    {
+        if (e.path == path)
+            return e.size == size && e.mtime == mtime && e.fingerprint == fingerprint ? &e : nullptr;
+    }
+    return nullptr;
+}
+
+void RecentCache::remember(RecentEntry entry, const LineIndex *lines)
+{
+    TRACE_SCOPE("recent.remember");
+
+    if (!lines && !m_entries.empty() && same_entry(m_entries.front(), entry))
+        return;
+
+    if (lines)
+    {
+        // Header, then the line starts as they are in memory.
+        std::string out;
+        out.reserve(32 + lines->line_count() * sizeof(std::uint64_t));
+        out.append(kLinesMagic, sizeof kLinesMagic);
+        put(out, entry.size);
+        put(out, entry.fingerprint);
+        put(out, static_cast<std::uint64_t>(lines->line_count()));
+        out.append(reinterpret_cast<const char *>(lines->starts().data()),
+                   lines->line_count() * sizeof(std::uint64_t));
+        g_mkdir_with_parents(m_dir.c_str(), 0700);
+        entry.has_line_index = binary_io::write_file(lines_path(entry.path), out, kFileMode);
+    }
+    else if (entry.has_line_index)
+    {
+        // Kept from before: still valid only if it describes this file.
+        const auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const RecentEntry &e)
+                                     { return e.path == entry.path; });
+        entry.has_line_index = it != m_entries.end() && it->has_line_index && it->size == entry.size &&
+                               it->fingerprint == entry.fingerprint;
+    }
+    if (!entry.has_line_index)
+        g_remove(lines_path(entry.path).c_str());
+
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [&](const RecentEntry &e)
+                                   { return e.path == entry.path; }),
+                    m_entries.end());
+    std::erase(m_remembered, entry.path);
+    std::erase(m_forgotten, entry.path);
+    m_remembered.push_back(entry.path);
+    m_entries.insert(m_entries.begin(), std::move(entry));
+    while (m_entries.size() > kMaxEntries)
+    {
+        if (m_entries.back().has_line_index)
+            g_remove(lines_path(m_entries.back().path).c_str());
+        m_entries.pop_back();
+    }
+}
+
+void RecentCache::forget(const std::string &path)
+{
+    std::erase(m_remembered, path);
+    if (std::find(m_forgotten.begin(), m_forgotten.end(), path) == m_forgotten.end())
+        m_forgotten.push_back(path);
+    g_remove(lines_path(path).c_str());
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [&](const RecentEntry &e)
+                                   { return e.path == path; }),
+                    m_entries.end());
+}
+
+bool RecentCache::load_line_index(const RecentEntry &entry, LineIndex &out) const
+{
+    if (!entry.has_line_index)
+        return false;
+    TRACE_SCOPE("recent.lines");
+
+    std::string error;
+    auto file = MappedFile::open(lines_path(entry.path), error);
+    if (!file)
+        return false;
+
+    Reader in(file->view());
+    char magic[4];
+    std::uint64_t size = 0, fingerprint = 0, count = 0;
+    if (!in.get(magic) || std::memcmp(magic, kLinesMagic, sizeof magic) != 0 || !in.get(size) ||
+        !in.get(fingerprint) || !in.get(count) || size != entry.size || fingerprint != entry.fingerprint ||
+        in.rest().size() != count * sizeof(std::uint64_t) || count == 0)
+        return false;
+
+    std::vector<std::uint64_t> starts(count);
+    std::memcpy(starts.data(), in.rest().data(), in.rest().size());
+    out.assign(std::move(starts), size);
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "line_index.hpp"
+#include "text_format.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the editor remembers about a recently opened file.
+struct RecentEntry
+{
+  std::string path;
+  // Identity of the file the rest describes.
+  std::uint64_t size = 0;
+  std::int64_t mtime = 0; // seconds since the epoch
+  std::uint64_t fingerprint = 0; // content_hash::fingerprint
+  // View state.
+  std::uint32_t cursor_line = 0;
+  std::uint32_t cursor_column = 0; // characters
+  std::uint32_t top_line = 0;      // first visible line
+  TextFormat format;
+  bool has_line_index = false; // a matching .lines file was written
+};
+
+// Recent-files list with per-file metadata, persisted in the user cache
+// directory so a reopen can skip the line scan and restore the view. Only
+// the line index is kept; the bracket, word and outline indexes are
+// rebuilt in the background after every open.
+//
+// recent.bin holds the entries (most recent first) in a small binary format
+// in host byte order; it is a cache, so anything unreadable is dropped. The
+// line-start index of a large file goes into a file of its own, named
+// after the path hash, and is only used while size, mtime and fingerprint
+// still match. Writes go through a temporary file and a rename.
+//
+// Several windows share the file: save() re-reads it and replays only the
+// paths this cache remembered or forgot since, so entries another window
+// wrote meanwhile survive, and it writes nothing when nothing changed.
+class RecentCache
+{
+public:
+  static constexpr std::size_t kMaxEntries = 12;
+
+  // `dir` defaults to $XDG_CACHE_HOME/sophisticated.
+  explicit RecentCache(std::string dir = {});
+
+  void load();
+  bool save();
+
+  const std::vector<RecentEntry> &entries() const { return m_entries; }
+
+  // Entry for `path` if it still describes the file with this identity.
+  const RecentEntry *find(const std::string &path, std::uint64_t size, std::int64_t mtime,
+                          std::uint64_t fingerprint) const;
+
+  // Moves `entry` to the front (replacing an older one for the same path)
+  // and, if `lines` is given, stores it as the file's line index. An entry
+  // already in front and unchanged leaves nothing to save.
+  void remember(RecentEntry entry, const LineIndex *lines);
+  void forget(const std::string &path);
+
+  bool load_line_index(const RecentEntry &entry, LineIndex &out) const;
+
+  // Size and modification time of `path`; false if it cannot be stat'ed.
+  static bool stat_file(const std::string &path, std::uint64_t &size, std::int64_t &mtime);
+
+private:
+  std::string m_dir;
+  std::vector<RecentEntry> m_entries;
+  // Changes since the last load() or save(), replayed over the file.
+  std::vector<std::string> m_remembered; // oldest first
+  std::vector<std::string> m_forgotten;
+
+  void read(std::vector<RecentEntry> &out) const;
+  std::string index_path() const;
+  std::string lines_path(const std::string &path) const;
+};
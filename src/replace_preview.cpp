@@ -0,0 +1,182 @@
+#include "replace_preview.hpp"
+
+#include "trace.hpp"
+
+#include <algorithm>
+
+namespace
+{
+// Hits between cancellation / progress checks.
+constexpr std::size_t kCheckEvery = 4096;
+// Longer matches and replacements are cut in snippets.
+constexpr std::size_t kMaxSnippetMatch = 200;
+
+bool is_continuation(char c)
+{
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+int char_count(std::string_view text)
+{
+    int n = 0;
+    for (char c : text)
+        n += !is_continuation(c);
+    return n;
+}
+
+// Up to `max` bytes of the line before `at`, starting on a character.
+std::string_view line_before(std::string_view text, std::size_t at, std::size_t max, bool &cut)
+{
+    const std::size_t from = at - std::min(at, max);
+    auto s = text.substr(from, at - from);
+    if (auto nl = s.rfind('\n'); nl != std::string_view::npos)
+    {
+        cut = false;
+        return s.substr(nl + 1);
+    }
+    cut = from > 0;
+    while (!s.empty() && is_continuation(s.front()))
+        s.remove_prefix(1);
+    return s;
+}
+
+// Up to `max` bytes of the line from `at`, ending on a character.
+std::string_view line_after(std::string_view text, std::size_t at, std::size_t max, bool &cut)
+{
+    auto s = text.substr(at, max);
+    if (auto nl = s.find('\n'); nl != std::string_view::npos)
+    {
+        cut = false;
+        return s.substr(0, nl);
+    }
+    cut = at + s.size() < text.size();
+    if (cut)
+    {
+        std::size_t n = s.size();
+        while (n > 0 && is_continuation(text[at + n]))
+            --n;
+        s = s.substr(0, n);
+    }
+    return s;
+}
+
+// First `max` bytes of `s`, ending on a character.
+std::string_view clip(std::string_view s, std::size_t max, bool &cut)
+{
+    cut = s.size() > max;
+    if (!cut)
+        return s;
+    std::size_t n = max;
+    while (n > 0 && is_continuation(s[n]))
+        --n;
+    return s.substr(0, n);
+}
+
+void append_flat(std::string &out, std::string_view s)
+{
+    for (char c : s)
+        out += (c == '\t' || c == '\r' || c == '\n') ? ' ' : c;
+}
+} // namespace
+
+void ReplacePreview::clear()
+{
+    m_hits.clear();
+    m_hits.shrink_to_fit();
+    m_excluded.clear();
+    m_excluded.shrink_to_fit();
+    m_excluded_count = 0;
+}
+
+bool ReplacePreview::build(std::string_view text, std::size_t from, int first_char, std::uint32_t first_line,
+                           const SearchEngine &engine, const std::string &replacement,
+                           const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    TRACE_SCOPE("replace.preview");
+    clear();
+
+    // Matches come in order, so lines and characters are running counts.
+    std::size_t byte_pos = 0;
+    int char_pos = first_char;
+    std::uint32_t line = first_line;
+    bool cancelled = false;
+
+    engine.for_each_replacement(text, replacement, [&](const SearchMatch &m, const std::string &with)
+                                {
+        const auto gap = text.substr(byte_pos, m.begin - byte_pos);
+        line += static_cast<std::uint32_t>(std::count(gap.begin(), gap.end(), '\n'));
+        char_pos += char_count(gap);
+
+        ReplaceHit hit;
+        hit.begin = m.begin;
+        hit.end = m.end;
+        hit.char_begin = char_pos;
+        hit.line = line;
+        const auto matched = text.substr(m.begin, m.end - m.begin);
+        line += static_cast<std::uint32_t>(std::count(matched.begin(), matched.end(), '\n'));
+        char_pos += char_count(matched);
+        hit.char_end = char_pos;
+        hit.with = with;
+        m_hits.push_back(std::move(hit));
+        byte_pos = m.end;
+
+        if (m_hits.size() % kCheckEvery == 0)
+        {
+            if (cancel && cancel->load(std::memory_order_relaxed))
+            {
+                cancelled = true;
+                return false;
+            }
+            if (progress && !text.empty())
+                progress->store(static_cast<double>(m.end) / static_cast<double>(text.size()),
+                                std::memory_order_relaxed);
+        }
+        return true; }, from);
+
+    if (cancelled)
+    {
+        clear();
+        return false;
+    }
+    m_excluded.assign(m_hits.size(), false);
+    return true;
+}
+
+void ReplacePreview::toggle(std::size_t i)
+{
+    m_excluded[i] = !m_excluded[i];
+    if (m_excluded[i])
+        ++m_excluded_count;
+    else
+        --m_excluded_count;
+}
+
+void ReplacePreview::snippet(std::string_view text, std::size_t i, std::size_t context, std::string &before,
+                             std::string &after) const
+{
+    const auto &h = m_hits[i];
+
+    bool cut_left, cut_right, cut_match, cut_with;
+    const auto left = line_before(text, h.begin, context, cut_left);
+    const auto right = line_after(text, h.end, context, cut_right);
+    const auto match = clip(text.substr(h.begin, h.end - h.begin), kMaxSnippetMatch, cut_match);
+    const auto with = clip(h.with, kMaxSnippetMatch, cut_with);
+
+    auto build = [&](std::string &out, std::string_view middle, bool cut_middle)
+    {
+        out.clear();
+        if (cut_left)
+            out += "…";
+        append_flat(out, left);
+        out += "[";
+        append_flat(out, middle);
+        if (cut_middle)
+            out += "…";
+        out += "]";
+        append_flat(out, right);
+        if (cut_right)
+            out += "…";
+    };
+    build(before, match, cut_match);
+    build(after, with, cut_with);
+}
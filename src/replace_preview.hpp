@@ -0,0 +1,55 @@
+#pragma once
+
+#include "search_engine.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One match of a Replace All dry run.
+struct ReplaceHit
+{
+  std::size_t begin = 0; // bytes into the previewed text
+  std::size_t end = 0;
+  int char_begin = 0;    // characters, for buffer iterators
+  int char_end = 0;
+  std::uint32_t line = 0; // 0-based
+  std::string with;       // replacement, back-references expanded
+};
+
+// Every replacement Replace All would make, computed over a snapshot
+// without touching the buffer, each of which can be left out before the
+// rest are applied.
+class ReplacePreview
+{
+public:
+  void clear();
+
+  // Finds all matches starting at or after byte `from` of `text`, which
+  // starts at character `first_char` on line `first_line` of the document.
+  // Returns false if cancelled.
+  bool build(std::string_view text, std::size_t from, int first_char, std::uint32_t first_line,
+             const SearchEngine &engine, const std::string &replacement, const std::atomic<bool> *cancel = nullptr,
+             std::atomic<double> *progress = nullptr);
+
+  std::size_t size() const { return m_hits.size(); }
+  const ReplaceHit &hit(std::size_t i) const { return m_hits[i]; }
+
+  bool included(std::size_t i) const { return !m_excluded[i]; }
+  void toggle(std::size_t i);
+  std::size_t included_count() const { return m_hits.size() - m_excluded_count; }
+
+  // Hit `i` in its line as it reads now and after the replacement, with at
+  // most `context` bytes either side; tabs and line breaks inside the
+  // match are shown as spaces.
+  void snippet(std::string_view text, std::size_t i, std::size_t context, std::string &before,
+               std::string &after) const;
+
+private:
+  std::vector<ReplaceHit> m_hits;
+  std::vector<bool> m_excluded;
+  std::size_t m_excluded_count = 0;
+};
@@ -1,7 +1,22 @@
 #include "replace_text_dialog.hpp"
 
-ReplaceTextDialog::ReplaceTextDialog(Gtk::Window &parent, Gtk::TextView &textview)
-    : m_parent(parent), m_textview(textview)
+#include "buffer_search.hpp"
+#include "trace.hpp"
+
+#include <memory>
+
+namespace
+{
+// Bytes of line shown either side of a hit in the preview.
+constexpr std::size_t kSnippetContext = 40;
+// How often the status line follows a running preview.
+constexpr unsigned kPreviewTickMs = 100;
+} // namespace
+
+ReplaceTextDialog::ReplaceTextDialog(Gtk::Window &parent, Gtk::TextView &textview, MatchIndex &matches,
+                                     SnapshotFn snapshot)
+    : m_parent(parent), m_textview(textview), m_matches(matches), m_scope(textview.get_buffer(), "replace_scope"),
+      m_snapshot(std::move(snapshot))
 {
     m_buffer = m_textview.get_buffer();
 
@@ -21,12 +36,26 @@ ReplaceTextDialog::ReplaceTextDialog(Gtk::Window &parent, Gtk::TextView &textvie
 
 ReplaceTextDialog::~ReplaceTextDialog()
 {
+    m_preview_task.stop();
+    m_preview_tick.disconnect();
+    m_buffer_changed.disconnect();
     // optional: keep highlights, but usually nicer to clear
     clear_highlights();
 }
 
 void ReplaceTextDialog::present()
 {
+    // A selection over several lines is a block to replace in, not a term.
+    Gtk::TextBuffer::iterator s, e;
+    if (m_buffer->get_selection_bounds(s, e) && s.get_line() != e.get_line())
+    {
+        m_scope.clear();
+        if (m_in_selection.get_active())
+            on_scope_toggled();
+        else
+            m_in_selection.set_active(true);
+    }
+
     m_win.present();
     m_find.grab_focus();
 }
@@ -64,8 +93,11 @@ void ReplaceTextDialog::build_ui()
     m_highlight_all.set_active(true);
 
     m_opts.append(m_case);
+    m_opts.append(m_word);
+    m_opts.append(m_regex);
     m_opts.append(m_wrap);
     m_opts.append(m_highlight_all);
+    m_opts.append(m_in_selection);
 
     // Buttons
     m_buttons.set_spacing(8);
@@ -73,6 +105,8 @@ void ReplaceTextDialog::build_ui()
     m_buttons.append(m_find_next);
     m_buttons.append(m_replace_next);
     m_buttons.append(m_replace_all);
+    m_buttons.append(m_preview_btn);
+    m_buttons.append(m_apply);
 
     // spacer
     auto spacer = Gtk::make_managed<Gtk::Label>("");
@@ -83,9 +117,16 @@ void ReplaceTextDialog::build_ui()
 
     m_status.set_halign(Gtk::Align::START);
 
+    // Shown once there is a preview.
+    m_preview_rows.set_size_request(640, 280);
+    m_preview_rows.set_vexpand(true);
+    m_preview_rows.set_visible(false);
+    m_apply.set_visible(false);
+
     m_root.append(m_grid);
     m_root.append(m_opts);
     m_root.append(m_buttons);
+    m_root.append(m_preview_rows);
     m_root.append(m_status);
 
     m_win.signal_close_request().connect([this]() -> bool
@@ -101,23 +142,53 @@ void ReplaceTextDialog::connect_signals()
     m_replace.signal_activate().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_replace_next));
 
     m_case.signal_toggled().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_options_changed));
+    m_word.signal_toggled().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_options_changed));
+    m_regex.signal_toggled().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_options_changed));
     m_wrap.signal_toggled().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_options_changed));
     m_highlight_all.signal_toggled().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_options_changed));
+    m_in_selection.signal_toggled().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_scope_toggled));
 
     m_find_next.signal_clicked().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_find_next));
     m_replace_next.signal_clicked().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_replace_next));
     m_replace_all.signal_clicked().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_replace_all));
+    m_preview_btn.signal_clicked().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_preview));
+    m_apply.signal_clicked().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_apply_preview));
+    m_preview_rows.signal_row_activated().connect(sigc::mem_fun(*this, &ReplaceTextDialog::on_preview_row));
+    m_replace.signal_changed().connect(sigc::mem_fun(*this, &ReplaceTextDialog::drop_preview));
+
+    // A preview describes the text it was computed over; any edit makes its
+    // offsets meaningless.
+    m_buffer_changed = m_buffer->signal_changed().connect([this]()
+                                                          {
+        if (m_preview_rows.get_visible() || m_preview_task.running())
+        {
+            m_preview_stale = true;
+            update_preview_status();
+        } });
 
     m_close.signal_clicked().connect([this]()
                                      { m_win.hide(); });
 }
 
-Gtk::TextSearchFlags ReplaceTextDialog::search_flags() const
+SearchOptions ReplaceTextDialog::search_options() const
+{
+    SearchOptions opts;
+    opts.case_sensitive = m_case.get_active();
+    opts.whole_word = m_word.get_active();
+    opts.regex = m_regex.get_active();
+    opts.wrap = m_wrap.get_active();
+    return opts;
+}
+
+bool ReplaceTextDialog::make_engine(const Glib::ustring &term, SearchEngine &out)
 {
-    Gtk::TextSearchFlags flags{};
-    if (!m_case.get_active())
-        flags |= Gtk::TextSearchFlags::CASE_INSENSITIVE;
-    return flags;
+    out = SearchEngine(term.raw(), search_options());
+    if (!out.valid())
+    {
+        set_status("Invalid pattern: " + out.error());
+        return false;
+    }
+    return true;
 }
 
 void ReplaceTextDialog::set_status(const Glib::ustring &s)
@@ -130,32 +201,36 @@ void ReplaceTextDialog::clear_highlights()
     auto b = m_buffer->begin();
     auto e = m_buffer->end();
     m_buffer->remove_tag_by_name("find_hl", b, e);
+    m_matches.set_tagged(0);
+    m_matches.assign({});
 }
 
 bool ReplaceTextDialog::find_from(Gtk::TextBuffer::iterator from,
-                                  const Glib::ustring &term,
-                                  Gtk::TextSearchFlags flags,
+                                  const SearchEngine &engine,
                                   Gtk::TextBuffer::iterator &out_start,
                                   Gtk::TextBuffer::iterator &out_end)
 {
-    out_start = from;
-    out_end = from;
-    return out_start.forward_search(term, flags, out_start, out_end);
+    return buffer_search::find_forward(m_buffer, engine, from, m_scope.end(), out_start, out_end);
 }
 
-void ReplaceTextDialog::highlight_all(const Glib::ustring &term, Gtk::TextSearchFlags flags)
+void ReplaceTextDialog::highlight_all(const SearchEngine &engine)
 {
+    TRACE_SCOPE("replace.highlight_all");
+
     clear_highlights();
-    if (term.empty())
+    if (!engine.valid())
         return;
-    auto it = m_buffer->begin();
-    Gtk::TextBuffer::iterator s, e;
 
-    while (find_from(it, term, flags, s, e))
+    auto matches = buffer_search::match_offsets(m_buffer, engine, m_scope.start(), m_scope.end());
+
     {
-        m_buffer->apply_tag_by_name("find_hl", s, e);
-        it = e;
+        TRACE_SCOPE("replace.apply_tags");
+        for (const auto &[s, e] : matches)
+            m_buffer->apply_tag_by_name("find_hl", m_buffer->get_iter_at_offset(s), m_buffer->get_iter_at_offset(e));
     }
+
+    m_matches.set_tagged(matches.size());
+    m_matches.assign(std::move(matches));
 }
 
 void ReplaceTextDialog::select_and_scroll(Gtk::TextBuffer::iterator s,
@@ -173,14 +248,32 @@ void ReplaceTextDialog::select_and_scroll(Gtk::TextBuffer::iterator s,
 void ReplaceTextDialog::on_term_changed()
 {
     m_has_last = false;
+    drop_preview();
 
     auto term = m_find.get_text();
-    if (m_highlight_all.get_active())
-        highlight_all(term, search_flags());
-    else
+    if (term.empty())
+    {
+        clear_highlights();
+        set_status("Type a term to find.");
+        return;
+    }
+
+    SearchEngine engine;
+    if (!make_engine(term, engine))
+    {
         clear_highlights();
+        return;
+    }
 
-    set_status(term.empty() ? "Type a term to find." : "Ready.");
+    if (m_highlight_all.get_active())
+    {
+        highlight_all(engine);
+        set_status(std::to_string(m_matches.size()) + " match(es).");
+        return;
+    }
+
+    clear_highlights();
+    set_status("Ready.");
 }
 
 void ReplaceTextDialog::on_options_changed()
@@ -188,6 +281,24 @@ void ReplaceTextDialog::on_options_changed()
     on_term_changed();
 }
 
+void ReplaceTextDialog::on_scope_toggled()
+{
+    if (m_in_selection.get_active() && !m_scope.active())
+    {
+        if (!m_scope.set_from_selection())
+        {
+            m_in_selection.set_active(false);
+            set_status("Select the text to replace in first.");
+            return;
+        }
+    }
+    else if (!m_in_selection.get_active())
+    {
+        m_scope.clear();
+    }
+    on_term_changed();
+}
+
 void ReplaceTextDialog::on_find_next()
 {
     const auto term = m_find.get_text();
@@ -197,16 +308,20 @@ void ReplaceTextDialog::on_find_next()
         return;
     }
 
-    auto flags = search_flags();
+    SearchEngine engine;
+    if (!make_engine(term, engine))
+        return;
 
     Gtk::TextBuffer::iterator start_from;
     if (m_has_last)
         start_from = m_last_end;
     else
         start_from = m_buffer->get_insert()->get_iter();
+    if (!m_scope.contains(start_from))
+        start_from = m_scope.start();
 
     Gtk::TextBuffer::iterator s, e;
-    if (find_from(start_from, term, flags, s, e))
+    if (find_from(start_from, engine, s, e))
     {
         select_and_scroll(s, e);
         set_status("Match found.");
@@ -215,8 +330,8 @@ void ReplaceTextDialog::on_find_next()
 
     if (m_wrap.get_active())
     {
-        auto begin = m_buffer->begin();
-        if (find_from(begin, term, flags, s, e))
+        auto begin = m_scope.start();
+        if (find_from(begin, engine, s, e))
         {
             select_and_scroll(s, e);
             set_status("Wrapped to start.");
@@ -229,6 +344,8 @@ void ReplaceTextDialog::on_find_next()
 
 void ReplaceTextDialog::on_replace_next()
 {
+    TRACE_SCOPE("replace.next");
+
     const auto term = m_find.get_text();
     if (term.empty())
     {
@@ -238,7 +355,9 @@ void ReplaceTextDialog::on_replace_next()
 
     const auto repl = m_replace.get_text();
 
-    auto flags = search_flags();
+    SearchEngine engine;
+    if (!make_engine(term, engine))
+        return;
 
     // If we currently have a selected match equal to last, replace it; otherwise find next first.
     Gtk::TextBuffer::iterator s, e;
@@ -248,7 +367,7 @@ void ReplaceTextDialog::on_replace_next()
     {
         // Ensure last match is still valid: simplest is to search from last_start again
         auto check_from = m_last_start;
-        if (find_from(check_from, term, flags, s, e) && s == m_last_start)
+        if (find_from(check_from, engine, s, e) && s == m_last_start)
         {
             have_match = true;
         }
@@ -268,6 +387,9 @@ void ReplaceTextDialog::on_replace_next()
         m_last_end = e;
     }
 
+    // Expand back-references while the match is still in the buffer
+    const auto with = buffer_search::expand(m_buffer, engine, s, e, repl.raw());
+
     // Replace selection [s, e] safely
     m_buffer->begin_user_action();
 
@@ -281,13 +403,14 @@ void ReplaceTextDialog::on_replace_next()
     auto pos = m_buffer->get_iter_at_mark(mark);
     m_buffer->delete_mark(mark);
 
-    m_buffer->insert(pos, repl);
+    m_buffer->insert(pos, with);
 
     m_buffer->end_user_action();
+    m_scope.retag();
 
     m_has_last = false; // reset, then find next occurrence after inserted text
     if (m_highlight_all.get_active())
-        highlight_all(term, flags);
+        highlight_all(engine);
 
     set_status("Replaced. Finding next…");
     on_find_next();
@@ -295,6 +418,8 @@ void ReplaceTextDialog::on_replace_next()
 
 void ReplaceTextDialog::on_replace_all()
 {
+    TRACE_SCOPE("replace.all");
+
     const auto term = m_find.get_text();
     if (term.empty())
     {
@@ -306,7 +431,9 @@ void ReplaceTextDialog::on_replace_all()
     // Optional: prevent accidental delete-all
     // if (repl.empty()) { set_status("Replacement is empty (would delete matches)."); return; }
 
-    auto flags = search_flags();
+    SearchEngine engine;
+    if (!make_engine(term, engine))
+        return;
 
     // Clear highlights first (optional)
     if (m_highlight_all.get_active())
@@ -318,57 +445,164 @@ void ReplaceTextDialog::on_replace_all()
         clear_highlights();
     }
 
-    int count = 0;
-
-    // Use a MARK as the moving cursor so we never keep iterators across edits
-    auto cursor = m_buffer->create_mark(m_buffer->begin(), true);
+    // One scan for all matches, then edits applied back to front inside a
+    // single user action (one undo step).
+    const auto count = buffer_search::replace_all(m_buffer, engine, repl.raw(),
+                                                  m_scope.start(), m_scope.end());
+    m_scope.retag();
 
-    m_buffer->begin_user_action();
+    m_has_last = false;
 
-    while (true)
+    // re-highlight if enabled
+    if (m_highlight_all.get_active())
     {
-        // Recreate iterator from mark each loop (always valid)
-        auto it = m_buffer->get_iter_at_mark(cursor);
+        highlight_all(engine);
+    }
 
-        Gtk::TextBuffer::iterator s, e;
-        s = it;
-        e = it;
+    set_status(Glib::ustring("Replaced ") + std::to_string(count) + " occurrence(s).");
+}
 
-        if (!s.forward_search(term, flags, s, e))
-            break;
+void ReplaceTextDialog::on_preview()
+{
+    const auto term = m_find.get_text();
+    if (term.empty())
+    {
+        set_status("Enter a search term.");
+        return;
+    }
 
-        // Mark where to continue AFTER replacement (at end of match, before we mutate)
-        auto after = m_buffer->create_mark(e, true);
+    auto engine = std::make_shared<SearchEngine>();
+    if (!make_engine(term, *engine))
+        return;
 
-        // Replace using a mark at match start (safe across erase)
-        auto start_mark = m_buffer->create_mark(s, true);
+    drop_preview();
+    // In a selection only that range (from context_start(), as Next reads
+    // it) is copied; otherwise the whole buffer, without a copy when it is
+    // still the file on disk.
+    TextSnapshot snapshot;
+    std::size_t from = 0;
+    int first_char = 0;
+    std::uint32_t first_line = 0;
+    if (m_scope.active())
+    {
+        const auto start = m_scope.start();
+        const auto base = buffer_search::context_start(start);
+        auto copy = std::make_shared<const Glib::ustring>(m_buffer->get_text(base, m_scope.end(), true));
+        snapshot = {copy, copy->raw()};
+        from = m_buffer->get_text(base, start, true).bytes();
+        first_char = base.get_offset();
+        first_line = static_cast<std::uint32_t>(base.get_line());
+    }
+    else
+    {
+        snapshot = m_snapshot();
+    }
+    auto preview = std::make_shared<ReplacePreview>();
+    const auto repl = m_replace.get_text().raw();
+    m_preview_stale = false;
+    m_preview_btn.set_sensitive(false);
+
+    m_preview_task.start([snapshot, engine, preview, repl, from, first_char, first_line](BackgroundTask::Control &control)
+                         { preview->build(snapshot.text, from, first_char, first_line, *engine, repl, &control.cancel,
+                                          &control.progress); },
+                         [this, snapshot, preview](bool cancelled)
+                         {
+                             m_preview_tick.disconnect();
+                             m_preview_btn.set_sensitive(true);
+                             if (cancelled)
+                                 return;
+                             m_preview = std::move(*preview);
+                             m_preview_text = snapshot;
+                             m_preview_rows.preview = &m_preview;
+                             m_preview_rows.text = m_preview_text.text;
+                             m_preview_rows.set_row_count(m_preview.size());
+                             m_preview_rows.scroll_to_row(0);
+                             m_preview_rows.set_visible(true);
+                             m_apply.set_visible(true);
+                             update_preview_status();
+                         });
+
+    m_preview_tick = Glib::signal_timeout().connect([this]()
+                                                    {
+        set_status("Previewing… " + std::to_string(static_cast<int>(m_preview_task.progress() * 100)) + "%");
+        return true; }, kPreviewTickMs);
+}
 
-        // Mutations invalidate iterators -> do not use s/e after this
-        m_buffer->erase(s, e);
+void ReplaceTextDialog::on_preview_row(std::size_t row)
+{
+    if (row >= m_preview.size())
+        return;
+    m_preview.toggle(row);
+    m_preview_rows.redraw();
+    update_preview_status();
+}
 
-        auto insert_pos = m_buffer->get_iter_at_mark(start_mark);
-        m_buffer->delete_mark(start_mark);
-        m_buffer->insert(insert_pos, repl);
+void ReplaceTextDialog::on_apply_preview()
+{
+    if (m_preview_stale || m_preview.included_count() == 0)
+        return;
 
-        ++count;
+    TRACE_SCOPE("replace.apply_preview");
 
-        // Continue from the "after" mark (which tracks position through edits)
-        m_buffer->delete_mark(cursor);
-        cursor = after;
+    std::vector<buffer_search::Edit> edits;
+    edits.reserve(m_preview.included_count());
+    for (std::size_t i = 0; i < m_preview.size(); ++i)
+    {
+        if (!m_preview.included(i))
+            continue;
+        const auto &hit = m_preview.hit(i);
+        edits.push_back(buffer_search::Edit{hit.char_begin, hit.char_end, hit.with});
     }
 
-    m_buffer->end_user_action();
+    drop_preview();
+    buffer_search::apply_edits(m_buffer, edits);
+    m_scope.retag();
+    m_has_last = false;
 
-    // cleanup
-    m_buffer->delete_mark(cursor);
+    SearchEngine engine;
+    if (m_highlight_all.get_active() && make_engine(m_find.get_text(), engine))
+        highlight_all(engine);
+    set_status(Glib::ustring("Replaced ") + std::to_string(edits.size()) + " occurrence(s).");
+}
 
-    m_has_last = false;
+void ReplaceTextDialog::drop_preview()
+{
+    m_preview_task.stop();
+    m_preview_tick.disconnect();
+    m_preview_btn.set_sensitive(true);
+    m_preview_rows.preview = nullptr;
+    m_preview_rows.text = {};
+    m_preview_rows.set_row_count(0);
+    m_preview_rows.set_visible(false);
+    m_apply.set_visible(false);
+    m_preview.clear();
+    m_preview_text = {};
+    m_preview_stale = false;
+}
 
-    // re-highlight if enabled
-    if (m_highlight_all.get_active())
+void ReplaceTextDialog::update_preview_status()
+{
+    if (m_preview_stale)
     {
-        highlight_all(term, flags);
+        m_apply.set_sensitive(false);
+        set_status("The document has changed; preview again.");
+        return;
     }
+    m_apply.set_sensitive(m_preview.included_count() > 0);
+    set_status(std::to_string(m_preview.size()) + " match(es), " + std::to_string(m_preview.included_count()) +
+               " selected. Click a row to leave it out.");
+}
 
-    set_status(Glib::ustring("Replaced ") + std::to_string(count) + " occurrence(s).");
+void ReplaceTextDialog::PreviewRows::draw_row(const Cairo::RefPtr<Cairo::Context> &cr,
+                                              const Glib::RefPtr<Pango::Layout> &layout, std::size_t row, double y,
+                                              int)
+{
+    if (!preview)
+        return;
+    std::string before, after;
+    preview->snippet(text, row, kSnippetContext, before, after);
+    layout->set_text((preview->included(row) ? "[x] " : "[ ] ") + std::to_string(preview->hit(row).line + 1) +
+                     ": " + before + "  →  " + after);
+    cr->move_to(4.0, y);
+    layout->show_in_cairo_context(cr);
 }
@@ -1,18 +1,40 @@
 #pragma once
+#include "background_task.hpp"
+#include "match_index.hpp"
+#include "replace_preview.hpp"
+#include "search_engine.hpp"
+#include "search_scope.hpp"
+#include "text_snapshot.hpp"
+#include "virtual_row_view.hpp"
+
 #include <gtkmm.h>
+#include <functional>
 #include <string>
 
 class ReplaceTextDialog {
 public:
-  explicit ReplaceTextDialog(Gtk::Window& parent, Gtk::TextView& textview);
+  // Text of the whole buffer for a worker thread (see AppWindow::snapshot_text).
+  using SnapshotFn = std::function<TextSnapshot()>;
+
+  ReplaceTextDialog(Gtk::Window& parent, Gtk::TextView& textview, MatchIndex& matches, SnapshotFn snapshot);
   ~ReplaceTextDialog();
 
   void present();
 
+  // The terms, as kept in the session file.
+  Glib::ustring find_term() const { return m_find.get_text(); }
+  Glib::ustring replacement() const { return m_replace.get_text(); }
+  void set_terms(const Glib::ustring& find, const Glib::ustring& with)
+  {
+    m_find.set_text(find);
+    m_replace.set_text(with);
+  }
+
 private:
   Gtk::Window& m_parent;
   Gtk::TextView& m_textview;
   Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+  MatchIndex& m_matches;
 
   // UI
   Gtk::Window m_win;
@@ -28,18 +50,46 @@ private:
 
   Gtk::Box m_opts{Gtk::Orientation::HORIZONTAL};
   Gtk::CheckButton m_case{"Case sensitive"};
+  Gtk::CheckButton m_word{"Whole word"};
+  Gtk::CheckButton m_regex{"Regex"};
   Gtk::CheckButton m_wrap{"Wrap around"};
   Gtk::CheckButton m_highlight_all{"Highlight all"};
+  Gtk::CheckButton m_in_selection{"In selection"};
 
   Gtk::Box m_buttons{Gtk::Orientation::HORIZONTAL};
   Gtk::Button m_find_next{"Find Next"};
   Gtk::Button m_replace_next{"Replace Next"};
   Gtk::Button m_replace_all{"Replace All"};
+  Gtk::Button m_preview_btn{"Preview"};
+  Gtk::Button m_apply{"Apply Selected"};
   Gtk::Button m_close{"Close"};
 
   Gtk::Label m_status{"Type a term to find."};
 
+  // Replace All dry run: every hit, before and after, one row each; a
+  // click leaves a hit out (or puts it back).
+  class PreviewRows : public VirtualRowView
+  {
+  public:
+    const ReplacePreview* preview = nullptr;
+    std::string_view text;
+
+  protected:
+    void draw_row(const Cairo::RefPtr<Cairo::Context>& cr, const Glib::RefPtr<Pango::Layout>& layout,
+                  std::size_t row, double y, int width) override;
+  };
+  PreviewRows m_preview_rows;
+
+  SnapshotFn m_snapshot;
+  TextSnapshot m_preview_text;   // what m_preview was computed over
+  ReplacePreview m_preview;
+  BackgroundTask m_preview_task;
+  sigc::connection m_preview_tick;
+  sigc::connection m_buffer_changed;
+  bool m_preview_stale = false;  // the buffer changed since
+
   // Search state
+  SearchScope m_scope;
   Gtk::TextBuffer::iterator m_last_start;
   Gtk::TextBuffer::iterator m_last_end;
   bool m_has_last = false;
@@ -48,21 +98,28 @@ private:
   void build_ui();
   void connect_signals();
 
-  Gtk::TextSearchFlags search_flags() const;
+  SearchOptions search_options() const;
+  // Builds the engine for the current term/options; reports bad patterns in the status line.
+  bool make_engine(const Glib::ustring& term, SearchEngine& out);
 
   void on_term_changed();
   void on_options_changed();
+  void on_scope_toggled();
 
   void on_find_next();
   void on_replace_next();
   void on_replace_all();
+  void on_preview();
+  void on_apply_preview();
+  void on_preview_row(std::size_t row);
+  void drop_preview();
+  void update_preview_status();
 
   void clear_highlights();
-  void highlight_all(const Glib::ustring& term, Gtk::TextSearchFlags flags);
+  void highlight_all(const SearchEngine& engine);
 
   bool find_from(Gtk::TextBuffer::iterator from,
-                 const Glib::ustring& term,
-                 Gtk::TextSearchFlags flags,
+                 const SearchEngine& engine,
                  Gtk::TextBuffer::iterator& out_start,
                  Gtk::TextBuffer::iterator& out_end);
 
@@ -0,0 +1,274 @@
+#include "search_engine.hpp"
+
+#include <glib.h>
+
+#include <utility>
+
+SearchEngine::SearchEngine(std::string pattern, const SearchOptions &opts)
+    : m_pattern(std::move(pattern)), m_opts(opts)
+{
+    if (m_pattern.empty())
+    {
+        m_error = "empty pattern";
+        return;
+    }
+
+    // Fast path: nothing to compile.
+    if (!m_opts.regex && !m_opts.whole_word && m_opts.case_sensitive)
+    {
+        m_valid = true;
+        return;
+    }
+
+    std::string source;
+    if (m_opts.regex)
+    {
+        source = m_pattern;
+    }
+    else
+    {
+        gchar *escaped = g_regex_escape_string(m_pattern.c_str(), static_cast<gint>(m_pattern.size()));
+        source = escaped;
+        g_free(escaped);
+    }
+
+    if (m_opts.whole_word)
+        source = "\\b(?:" + source + ")\\b";
+
+    int flags = G_REGEX_OPTIMIZE | G_REGEX_MULTILINE;
+    if (!m_opts.case_sensitive)
+        flags |= G_REGEX_CASELESS;
+
+    GError *err = nullptr;
+    m_regex = g_regex_new(source.c_str(), static_cast<GRegexCompileFlags>(flags),
+                          static_cast<GRegexMatchFlags>(0), &err);
+    if (!m_regex)
+    {
+        m_error = err ? err->message : "invalid pattern";
+        if (err)
+            g_error_free(err);
+        return;
+    }
+
+    m_valid = true;
+}
+
+SearchEngine::~SearchEngine()
+{
+    if (m_regex)
+        g_regex_unref(m_regex);
+}
+
+SearchEngine::SearchEngine(SearchEngine &&other) noexcept
+    : m_pattern(std::move(other.m_pattern)),
+      m_opts(other.m_opts),
+      m_regex(std::exchange(other.m_regex, nullptr)),
+      m_valid(std::exchange(other.m_valid, false)),
+      m_error(std::move(other.m_error))
+{
+}
+
+SearchEngine &SearchEngine::operator=(SearchEngine &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_regex)
+            g_regex_unref(m_regex);
+        m_pattern = std::move(other.m_pattern);
+        m_opts = other.m_opts;
+        m_regex = std::exchange(other.m_regex, nullptr);
+        m_valid = std::exchange(other.m_valid, false);
+        m_error = std::move(other.m_error);
+    }
+    return *this;
+}
+
+void SearchEngine::scan(std::string_view text, std::size_t from,
+                        const std::function<bool(const SearchMatch &, GMatchInfo *info)> &fn) const
+{
+    if (!m_valid || from > text.size())
+        return;
+
+    if (!m_regex)
+    {
+        std::size_t pos = from;
+        while ((pos = text.find(m_pattern, pos)) != std::string_view::npos)
+        {
+            SearchMatch m{pos, pos + m_pattern.size()};
+            if (!fn(m, nullptr))
+                return;
+            pos = m.end;
+        }
+        return;
+    }
+
+    // One GMatchInfo for the whole walk: GLib only validates the subject on
+    // the first call and takes care of stepping over empty matches.
+    const gchar *data = text.empty() ? "" : text.data();
+    GMatchInfo *info = nullptr;
+    g_regex_match_full(m_regex, data, static_cast<gssize>(text.size()), static_cast<gint>(from),
+                       static_cast<GRegexMatchFlags>(0), &info, nullptr);
+
+    while (info && g_match_info_matches(info))
+    {
+        gint s = 0, e = 0;
+        if (!g_match_info_fetch_pos(info, 0, &s, &e))
+            break;
+
+        SearchMatch m{static_cast<std::size_t>(s), static_cast<std::size_t>(e)};
+        if (!fn(m, info))
+            break;
+
+        if (!g_match_info_next(info, nullptr))
+            break;
+    }
+
+    if (info)
+        g_match_info_free(info);
+}
+
+bool SearchEngine::find(std::string_view text, std::size_t from, SearchMatch &out) const
+{
+    bool found = false;
+    scan(text, from, [&](const SearchMatch &m, GMatchInfo *)
+         {
+        out = m;
+        found = true;
+        return false; });
+    return found;
+}
+
+bool SearchEngine::find_next(std::string_view text, std::size_t from, SearchMatch &out, bool &wrapped) const
+{
+    wrapped = false;
+    if (find(text, from, out))
+        return true;
+
+    if (!m_opts.wrap || from == 0)
+        return false;
+
+    SearchMatch m;
+    if (find(text, 0, m) && m.begin < from)
+    {
+        out = m;
+        wrapped = true;
+        return true;
+    }
+    return false;
+}
+
+bool SearchEngine::find_prev(std::string_view text, std::size_t before, SearchMatch &out, bool &wrapped) const
+{
+    wrapped = false;
+
+    // Scan forward and keep the last match before "before" (and the very
+    // last one, in case we need to wrap).
+    bool found = false;
+    bool any = false;
+    SearchMatch last;
+    scan(text, 0, [&](const SearchMatch &m, GMatchInfo *)
+         {
+        if (m.begin < before)
+        {
+            out = m;
+            found = true;
+        }
+        else if (!m_opts.wrap)
+        {
+            return false;
+        }
+        last = m;
+        any = true;
+        return true; });
+
+    if (found)
+        return true;
+
+    if (m_opts.wrap && any)
+    {
+        out = last;
+        wrapped = true;
+        return true;
+    }
+    return false;
+}
+
+void SearchEngine::for_each(std::string_view text, const std::function<bool(const SearchMatch &)> &fn,
+                            std::size_t from) const
+{
+    scan(text, from, [&](const SearchMatch &m, GMatchInfo *)
+         { return fn(m); });
+}
+
+std::vector<SearchMatch> SearchEngine::find_all(std::string_view text) const
+{
+    std::vector<SearchMatch> out;
+    scan(text, 0, [&](const SearchMatch &m, GMatchInfo *)
+         {
+        out.push_back(m);
+        return true; });
+    return out;
+}
+
+std::string SearchEngine::expand(std::string_view text, const SearchMatch &m, const std::string &replacement) const
+{
+    if (!m_opts.regex || !m_regex)
+        return replacement;
+
+    // Re-run the match anchored at its start so the groups are available.
+    std::string result = replacement;
+    const gchar *data = text.empty() ? "" : text.data();
+    GMatchInfo *info = nullptr;
+    if (g_regex_match_full(m_regex, data, static_cast<gssize>(text.size()), static_cast<gint>(m.begin),
+                           G_REGEX_MATCH_ANCHORED, &info, nullptr))
+    {
+        if (gchar *expanded = g_match_info_expand_references(info, replacement.c_str(), nullptr))
+        {
+            result = expanded;
+            g_free(expanded);
+        }
+    }
+    if (info)
+        g_match_info_free(info);
+    return result;
+}
+
+void SearchEngine::for_each_replacement(std::string_view text, const std::string &replacement,
+                                        const std::function<bool(const SearchMatch &, const std::string &)> &fn,
+                                        std::size_t from) const
+{
+    // Back-references are only meaningful for regex patterns; plain
+    // replacements are used verbatim.
+    const bool expand_refs = m_opts.regex && m_regex;
+
+    std::string expanded;
+    scan(text, from, [&](const SearchMatch &m, GMatchInfo *info)
+         {
+        expanded = replacement;
+        if (expand_refs && info)
+        {
+            if (gchar *e = g_match_info_expand_references(info, replacement.c_str(), nullptr))
+            {
+                expanded = e;
+                g_free(e);
+            }
+        }
+        return fn(m, expanded); });
+}
+
+std::size_t SearchEngine::replace_all(std::string_view text, const std::string &replacement, std::string &out) const
+{
+    std::size_t count = 0;
+    std::size_t copied = 0;
+
+    for_each_replacement(text, replacement, [&](const SearchMatch &m, const std::string &with)
+                         {
+        out.append(text.substr(copied, m.begin - copied));
+        out.append(with);
+        copied = m.end;
+        ++count;
+        return true; });
+
+    out.append(text.substr(copied));
+    return count;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+typedef struct _GRegex GRegex;
+typedef struct _GMatchInfo GMatchInfo;
+
+struct SearchOptions
+{
+  bool case_sensitive = false;
+  bool whole_word = false;
+  bool regex = false;
+  bool wrap = true;
+};
+
+// Byte offsets into the searched UTF-8 text.
+struct SearchMatch
+{
+  std::size_t begin = 0;
+  std::size_t end = 0;
+};
+
+// Display-free find/replace engine. The Find/Replace dialogs and the
+// headless `--replace` mode both go through this, so they agree on what
+// "case sensitive", "whole word" and "regex" mean.
+//
+// Plain case-sensitive terms are a memchr/memcmp scan; everything else is
+// compiled into a GRegex (UTF-8 aware case folding, \b for words).
+// A compiled engine is immutable and may be shared between threads.
+class SearchEngine
+{
+public:
+  SearchEngine() = default;
+  SearchEngine(std::string pattern, const SearchOptions &opts);
+  ~SearchEngine();
+
+  SearchEngine(const SearchEngine &) = delete;
+  SearchEngine &operator=(const SearchEngine &) = delete;
+  SearchEngine(SearchEngine &&other) noexcept;
+  SearchEngine &operator=(SearchEngine &&other) noexcept;
+
+  bool valid() const { return m_valid; }
+  const std::string &error() const { return m_error; }
+  const SearchOptions &options() const { return m_opts; }
+
+  // First match starting at or after `from`.
+  bool find(std::string_view text, std::size_t from, SearchMatch &out) const;
+
+  // Like find(), but restarts at the top when `wrap` is set.
+  bool find_next(std::string_view text, std::size_t from, SearchMatch &out, bool &wrapped) const;
+
+  // Last match starting before `before`; wraps to the last match in the text.
+  bool find_prev(std::string_view text, std::size_t before, SearchMatch &out, bool &wrapped) const;
+
+  // Calls `fn` for every match starting at or after `from`, in order; stop
+  // early by returning false.
+  void for_each(std::string_view text, const std::function<bool(const SearchMatch &)> &fn,
+                std::size_t from = 0) const;
+
+  std::vector<SearchMatch> find_all(std::string_view text) const;
+
+  // Replacement text for one match (expands \0..\9 and \g<name> in regex mode).
+  std::string expand(std::string_view text, const SearchMatch &m, const std::string &replacement) const;
+
+  // Calls `fn` with every match from `from` on and its expanded replacement; stop early by returning false.
+  void for_each_replacement(std::string_view text, const std::string &replacement,
+                            const std::function<bool(const SearchMatch &, const std::string &)> &fn,
+                            std::size_t from = 0) const;
+
+  // Appends `text` with every match replaced to `out`; returns the number of replacements.
+  std::size_t replace_all(std::string_view text, const std::string &replacement, std::string &out) const;
+
+private:
+  std::string m_pattern;
+  SearchOptions m_opts;
+  GRegex *m_regex = nullptr;
+  bool m_valid = false;
+  std::string m_error;
+
+  // Walks matches from `from`; `info` is null on the literal path.
+  void scan(std::string_view text, std::size_t from,
+            const std::function<bool(const SearchMatch &, GMatchInfo *info)> &fn) const;
+};
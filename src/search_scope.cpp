@@ -0,0 +1,66 @@
+#include "search_scope.hpp"
+
+SearchScope::SearchScope(Glib::RefPtr<Gtk::TextBuffer> buffer, Glib::ustring tag_name)
+    : m_buffer(std::move(buffer)), m_tag(std::move(tag_name))
+{
+    auto table = m_buffer->get_tag_table();
+    if (!table->lookup(m_tag))
+    {
+        auto tag = Gtk::TextBuffer::Tag::create(m_tag);
+        tag->property_background() = "#e3ecf8";
+        table->add(tag);
+        // Under the match highlights, which also set a background.
+        tag->set_priority(0);
+    }
+}
+
+SearchScope::~SearchScope()
+{
+    clear();
+}
+
+bool SearchScope::set_from_selection()
+{
+    clear();
+
+    Gtk::TextBuffer::iterator s, e;
+    if (!m_buffer->get_selection_bounds(s, e))
+        return false;
+
+    m_start = m_buffer->create_mark(s, /*left_gravity=*/true);
+    m_end = m_buffer->create_mark(e, /*left_gravity=*/false);
+    m_buffer->apply_tag_by_name(m_tag, s, e);
+    return true;
+}
+
+void SearchScope::clear()
+{
+    if (!active())
+        return;
+    m_buffer->remove_tag_by_name(m_tag, start(), end());
+    m_buffer->delete_mark(m_start);
+    m_buffer->delete_mark(m_end);
+    m_start.reset();
+    m_end.reset();
+}
+
+void SearchScope::retag()
+{
+    if (active())
+        m_buffer->apply_tag_by_name(m_tag, start(), end());
+}
+
+Gtk::TextBuffer::iterator SearchScope::start() const
+{
+    return m_start ? m_buffer->get_iter_at_mark(m_start) : m_buffer->begin();
+}
+
+Gtk::TextBuffer::iterator SearchScope::end() const
+{
+    return m_end ? m_buffer->get_iter_at_mark(m_end) : m_buffer->end();
+}
+
+bool SearchScope::contains(const Gtk::TextBuffer::iterator &it) const
+{
+    return it.compare(start()) >= 0 && it.compare(end()) <= 0;
+}
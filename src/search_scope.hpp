@@ -0,0 +1,42 @@
+#pragma once
+
+#include <gtkmm.h>
+
+// The "In selection" scope of the Find and Replace dialogs: a range of the
+// buffer pinned by two marks, so it follows edits before, inside and
+// after it (including replacements made inside it). The start mark has
+// left gravity and the end mark right gravity, so text inserted at either
+// edge ends up inside. Each dialog shades its range with a tag of its own,
+// so clearing one scope leaves the other's shading alone.
+//
+// Inactive, it stands for the whole buffer. Searches read it from
+// buffer_search::context_start(), so ^, \b and look-behinds see the text
+// before it the same way Next, Previous, Replace All and the preview all do.
+class SearchScope
+{
+public:
+  // `tag` names the shading tag, created on first use.
+  SearchScope(Glib::RefPtr<Gtk::TextBuffer> buffer, Glib::ustring tag);
+  ~SearchScope();
+
+  SearchScope(const SearchScope &) = delete;
+  SearchScope &operator=(const SearchScope &) = delete;
+
+  // Pins the current selection; false (and inactive) if nothing is selected.
+  bool set_from_selection();
+  void clear();
+  // Re-tags the range; text typed or replaced inside it is not tagged.
+  void retag();
+
+  bool active() const { return static_cast<bool>(m_start); }
+
+  Gtk::TextBuffer::iterator start() const;
+  Gtk::TextBuffer::iterator end() const;
+  bool contains(const Gtk::TextBuffer::iterator &it) const;
+
+private:
+  Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+  Glib::ustring m_tag;
+  Glib::RefPtr<Gtk::TextBuffer::Mark> m_start;
+  Glib::RefPtr<Gtk::TextBuffer::Mark> m_end;
+};
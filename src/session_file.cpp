@@ -0,0 +1,187 @@
+#include "session_file.hpp"
+
+#include "binary_io.hpp"
+#include "mapped_file.hpp"
+#include "trace.hpp"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+using binary_io::put;
+using binary_io::put_string;
+using binary_io::Reader;
+
+namespace
+{
+constexpr char kSessionMagic[4] = {'S', 'S', 'N', '2'};
+constexpr char kEditMagic[4] = {'S', 'S', 'E', '1'};
+// Longest path or search term accepted when reading.
+constexpr std::uint32_t kMaxStringBytes = 64 * 1024;
+// Unsaved work is private to the user.
+constexpr int kFileMode = 0600;
+
+// Everything but the edit text; `edit_id` names the edit record that goes
+// with it (0: none).
+std::string serialize_view(const SessionState &s, std::uint64_t edit_id)
+{
+    std::string out;
+    out.reserve(128 + s.path.size());
+    out.append(kSessionMagic, sizeof kSessionMagic);
+    put(out, static_cast<std::uint8_t>(s.dark));
+    put(out, std::uint8_t{0});
+    put(out, std::uint16_t{0});
+    put_string(out, s.find_term);
+    put_string(out, s.replace_find);
+    put_string(out, s.replace_with);
+    put_string(out, s.path);
+    put(out, s.size);
+    put(out, s.mtime);
+    put(out, s.fingerprint);
+    put(out, s.cursor_line);
+    put(out, s.cursor_column);
+    put(out, s.top_line);
+    put(out, edit_id);
+    return out;
+}
+
+void serialize_edit(std::string &out, const SessionState &s, std::uint64_t edit_id)
+{
+    out.reserve(out.size() + 32 + s.text.text.size());
+    out.append(kEditMagic, sizeof kEditMagic);
+    put(out, edit_id);
+    put(out, s.first_line);
+    put(out, s.removed_lines);
+    put(out, static_cast<std::uint64_t>(s.text.text.size()));
+    out.append(s.text.text.data(), s.text.text.size());
+}
+
+bool read_view(Reader &in, SessionState &s, std::uint64_t &edit_id)
+{
+    char magic[4];
+    std::uint8_t dark = 0, reserved8 = 0;
+    std::uint16_t reserved16 = 0;
+    if (!in.get(magic) || std::memcmp(magic, kSessionMagic, sizeof magic) != 0 || !in.get(dark) ||
+        !in.get(reserved8) || !in.get(reserved16) || !in.get_string(s.find_term, kMaxStringBytes) ||
+        !in.get_string(s.replace_find, kMaxStringBytes) || !in.get_string(s.replace_with, kMaxStringBytes) ||
+        !in.get_string(s.path, kMaxStringBytes) || !in.get(s.size) || !in.get(s.mtime) || !in.get(s.fingerprint) ||
+        !in.get(s.cursor_line) || !in.get(s.cursor_column) || !in.get(s.top_line) || !in.get(edit_id))
+        return false;
+    s.dark = dark != 0;
+    return true;
+}
+
+// The edit text is left pointing into `owner`'s bytes.
+bool read_edit(Reader &in, std::uint64_t edit_id, std::shared_ptr<const void> owner, SessionState &s)
+{
+    char magic[4];
+    std::uint64_t id = 0, bytes = 0;
+    std::string_view text;
+    if (!in.get(magic) || std::memcmp(magic, kEditMagic, sizeof magic) != 0 || !in.get(id) || id != edit_id ||
+        !in.get(s.first_line) || !in.get(s.removed_lines) || !in.get(bytes) || !in.get_view(text, bytes))
+        return false;
+    s.has_edit = true;
+    s.text = TextSnapshot{std::move(owner), text};
+    return true;
+}
+} // namespace
+
+SessionFile::SessionFile(std::string dir) : m_dir(std::move(dir))
+{
+    if (m_dir.empty())
+    {
+        gchar *d = g_build_filename(g_get_user_data_dir(), "sophisticated", nullptr);
+        m_dir = d;
+        g_free(d);
+    }
+}
+
+std::string SessionFile::session_path() const
+{
+    return m_dir + G_DIR_SEPARATOR_S "session.bin";
+}
+
+std::string SessionFile::backup_path() const
+{
+    return m_dir + G_DIR_SEPARATOR_S "session.bak";
+}
+
+std::string SessionFile::edit_path() const
+{
+    return m_dir + G_DIR_SEPARATOR_S "session.edit";
+}
+
+bool SessionFile::load(SessionState &out)
+{
+    TRACE_SCOPE("session.load");
+    out = SessionState{};
+
+    std::string error;
+    auto file = MappedFile::open(session_path(), error);
+    if (!file)
+        return false;
+
+    Reader in(file->view());
+    SessionState s;
+    std::uint64_t edit_id = 0;
+    if (!read_view(in, s, edit_id))
+        return false;
+
+    // An edit file from another save (cut short between the two writes)
+    // does not belong to this view and is dropped.
+    if (edit_id != 0)
+    {
+        auto edit = MappedFile::open(edit_path(), error);
+        if (edit)
+        {
+            Reader edit_in(edit->view());
+            if (!read_edit(edit_in, edit_id, edit, s))
+                s.has_edit = false;
+        }
+    }
+    m_edit_id = s.has_edit ? edit_id : 0;
+    out = std::move(s);
+    return true;
+}
+
+bool SessionFile::save(const SessionState &state, bool with_edit)
+{
+    TRACE_SCOPE("session.save");
+    g_mkdir_with_parents(m_dir.c_str(), 0700);
+
+    if (with_edit && state.has_edit)
+    {
+        // A new id for each edit written, so a view never pairs up with an
+        // edit it was not saved with.
+        const auto id = std::max(m_edit_id + 1, static_cast<std::uint64_t>(g_get_real_time()));
+        std::string edit;
+        serialize_edit(edit, state, id);
+        if (!binary_io::write_file(edit_path(), edit, kFileMode))
+            return false;
+        m_edit_id = id;
+    }
+    else if (with_edit)
+    {
+        m_edit_id = 0;
+    }
+
+    if (!binary_io::write_file(session_path(), serialize_view(state, m_edit_id), kFileMode))
+        return false;
+    if (m_edit_id == 0)
+        g_remove(edit_path().c_str());
+    return true;
+}
+
+bool SessionFile::keep_backup(const SessionState &loaded)
+{
+    g_mkdir_with_parents(m_dir.c_str(), 0700);
+    // View and edit in one file; it is only read by hand.
+    auto out = serialize_view(loaded, loaded.has_edit ? 1 : 0);
+    if (loaded.has_edit)
+        serialize_edit(out, loaded, 1);
+    return binary_io::write_file(backup_path(), out, kFileMode);
+}
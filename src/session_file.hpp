@@ -0,0 +1,73 @@
+#pragma once
+
+#include "text_snapshot.hpp"
+
+#include <cstdint>
+#include <string>
+
+// The workspace as it was when the editor last went idle or closed.
+struct SessionState
+{
+  bool dark = false;
+  std::string find_term;    // Find dialog
+  std::string replace_find; // Replace dialog
+  std::string replace_with;
+
+  // Open file; empty for an untitled buffer.
+  std::string path;
+  // Identity of the file on disk that `edit` applies to (see RecentEntry).
+  std::uint64_t size = 0;
+  std::int64_t mtime = 0;
+  std::uint64_t fingerprint = 0;
+
+  std::uint32_t cursor_line = 0;
+  std::uint32_t cursor_column = 0; // characters
+  std::uint32_t top_line = 0;
+
+  // Unsaved changes as one line-range replacement: lines
+  // [first_line, first_line + removed_lines) of the file on disk become
+  // `text`. An untitled buffer is all `text`.
+  bool has_edit = false;
+  std::uint32_t first_line = 0;
+  std::uint32_t removed_lines = 0;
+  TextSnapshot text;
+};
+
+// session.bin in $XDG_DATA_HOME/sophisticated: the same small binary format
+// as recent.bin (host byte order, written through a temporary file and a
+// rename). Unlike the recent-files cache it holds unsaved work, so it lives
+// in the data directory, and a session whose edit could not be applied is
+// kept as session.bak instead of being overwritten.
+//
+// The edit text is in session.edit, written only when the edit changed:
+// the cursor moves far more often than the text, and session.bin alone is
+// a few hundred bytes. Each edit written gets a new id, recorded in both
+// files, so a crash between the two writes loses the edit rather than
+// pairing it with the wrong file.
+//
+// load() maps the files; the edit text of the loaded state points into
+// the mapping, which its owner keeps alive, so restoring a large edit
+// copies nothing up front.
+class SessionFile
+{
+public:
+  // `dir` defaults to $XDG_DATA_HOME/sophisticated.
+  explicit SessionFile(std::string dir = {});
+
+  bool load(SessionState &out);
+  // Writes `state`. Without `with_edit` its edit fields are ignored and the
+  // edit last written (or loaded) stays.
+  bool save(const SessionState &state, bool with_edit);
+
+  // Writes `loaded` (as read by load()), edit included, to session.bak,
+  // for an edit that no longer applies to the file on disk.
+  bool keep_backup(const SessionState &loaded);
+
+  std::string session_path() const;
+  std::string edit_path() const;
+  std::string backup_path() const;
+
+private:
+  std::string m_dir;
+  std::uint64_t m_edit_id = 0; // of the edit in session.edit; 0: none
+};
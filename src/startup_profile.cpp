@@ -0,0 +1,88 @@
+#include "startup_profile.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+bool g_enabled = false;
+bool g_first_frame_seen = false;
+Clock::time_point g_start;
+Clock::time_point g_last;
+Clock::time_point g_deferred_start;
+
+double ms(Clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+} // namespace
+
+namespace startup_profile
+{
+void init(int &argc, char *argv[])
+{
+    g_start = g_last = Clock::now();
+
+    if (const char *env = std::getenv("SOPHISTICATED_PROFILE_STARTUP"))
+        g_enabled = *env && std::strcmp(env, "0") != 0;
+
+    // Remove our flag so GApplication does not reject it.
+    int out = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--profile-startup") == 0)
+        {
+            g_enabled = true;
+            continue;
+        }
+        argv[out++] = argv[i];
+    }
+    argc = out;
+    argv[argc] = nullptr;
+
+    if (g_enabled)
+        std::fprintf(stderr, "[startup] %9s %10s  phase\n", "at ms", "(+ms)");
+}
+
+bool enabled()
+{
+    return g_enabled;
+}
+
+void mark(const char *phase)
+{
+    if (!g_enabled)
+        return;
+
+    const auto now = Clock::now();
+    std::fprintf(stderr, "[startup] %9.2f (%+8.2f)  %s\n", ms(now - g_start), ms(now - g_last), phase);
+    g_last = now;
+}
+
+void begin_deferred()
+{
+    if (!g_enabled)
+        return;
+    g_deferred_start = g_last = Clock::now();
+}
+
+void end_deferred()
+{
+    if (!g_enabled)
+        return;
+    std::fprintf(stderr, "[startup] deferred until after first frame: %.2f ms\n",
+                 ms(Clock::now() - g_deferred_start));
+}
+
+void first_frame()
+{
+    if (!g_enabled || g_first_frame_seen)
+        return;
+    g_first_frame_seen = true;
+    mark("first frame painted");
+}
+} // namespace startup_profile
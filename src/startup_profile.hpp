@@ -0,0 +1,22 @@
+#pragma once
+
+// Start-up timeline. Off unless SOPHISTICATED_PROFILE_STARTUP is set or
+// --profile-startup is passed; then every mark is printed to stderr as
+// "time since start (time since previous mark) phase".
+namespace startup_profile
+{
+// Call first thing in main(). Strips --profile-startup from argv.
+void init(int &argc, char *argv[]);
+
+bool enabled();
+
+void mark(const char *phase);
+
+// Work that has been moved off the critical path; the total is reported
+// once the deferred phase is over.
+void begin_deferred();
+void end_deferred();
+
+// Called from the first after-paint of the first window.
+void first_frame();
+} // namespace startup_profile
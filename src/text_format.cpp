@@ -0,0 +1,66 @@
+#include "text_format.hpp"
+
+#include <cstring>
+
+TextFormat detect_text_format(std::string_view sample)
+{
+    TextFormat format;
+    format.bom = sample.starts_with("\xEF\xBB\xBF");
+
+    std::size_t lf = 0, crlf = 0, cr = 0;
+    const char *p = sample.data();
+    const char *end = p + sample.size();
+    while (p < end)
+    {
+        const char *nl = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+        const char *stop = nl ? nl : end;
+        // Lone CRs before this LF (old Mac files have no LFs at all).
+        for (const char *q = static_cast<const char *>(std::memchr(p, '\r', static_cast<std::size_t>(stop - p)));
+             q; q = static_cast<const char *>(std::memchr(q + 1, '\r', static_cast<std::size_t>(stop - q - 1))))
+        {
+            if (q + 1 < stop || !nl)
+                ++cr;
+        }
+        if (!nl)
+            break;
+        if (nl > p && nl[-1] == '\r')
+            ++crlf;
+        else
+            ++lf;
+        p = nl + 1;
+    }
+
+    const int kinds = (lf > 0) + (crlf > 0) + (cr > 0);
+    if (kinds > 1)
+        format.eol = LineEnding::Mixed;
+    else if (lf > 0)
+        format.eol = LineEnding::Lf;
+    else if (crlf > 0)
+        format.eol = LineEnding::CrLf;
+    else if (cr > 0)
+        format.eol = LineEnding::Cr;
+    return format;
+}
+
+const char *encoding_name(const TextFormat &format)
+{
+    return format.bom ? "UTF-8 with BOM" : "UTF-8";
+}
+
+const char *line_ending_name(LineEnding eol)
+{
+    switch (eol)
+    {
+    case LineEnding::Lf:
+        return "LF";
+    case LineEnding::CrLf:
+        return "CRLF";
+    case LineEnding::Cr:
+        return "CR";
+    case LineEnding::Mixed:
+        return "mixed line endings";
+    case LineEnding::None:
+        break;
+    }
+    return "no line breaks";
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+enum class LineEnding : std::uint8_t
+{
+  None, // no line breaks seen
+  Lf,
+  CrLf,
+  Cr,
+  Mixed,
+};
+
+// Encoding details and line-ending style of a text file.
+struct TextFormat
+{
+  bool bom = false; // starts with a UTF-8 byte order mark
+  LineEnding eol = LineEnding::None;
+};
+
+// Looks at `sample` (the start of the file; 64 KiB is plenty).
+TextFormat detect_text_format(std::string_view sample);
+
+// "UTF-8", "UTF-8 with BOM"; "LF", "CRLF", "CR", "mixed line endings".
+const char *encoding_name(const TextFormat &format);
+const char *line_ending_name(LineEnding eol);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+// Read-only document text that a worker thread can scan after the UI thread
+// has moved on. `owner` keeps the bytes alive: the mapped file when the
+// buffer still matches it (no copy), otherwise a private copy of the text.
+struct TextSnapshot
+{
+  std::shared_ptr<const void> owner;
+  std::string_view text;
+};
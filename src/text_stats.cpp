@@ -0,0 +1,138 @@
+#include "text_stats.hpp"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXT_STATS_SSE2 1
+#endif
+
+void TextCounts::append(const TextCounts &next)
+{
+    if (next.bytes == 0)
+        return;
+
+    // A word split across the seam was counted on both sides.
+    words += next.words;
+    if (bytes > 0 && ends_in_word && next.starts_in_word)
+        --words;
+
+    if (bytes == 0)
+        starts_in_word = next.starts_in_word;
+    ends_in_word = next.ends_in_word;
+    bytes += next.bytes;
+    chars += next.chars;
+    newlines += next.newlines;
+}
+
+namespace text_stats
+{
+TextCounts count_scalar(std::string_view text)
+{
+    TextCounts c;
+    if (text.empty())
+        return c;
+
+    bool in_word = false;
+    for (const char ch : text)
+    {
+        const auto b = static_cast<unsigned char>(ch);
+        if ((b & 0xC0) != 0x80)
+            ++c.chars;
+        if (b == '\n')
+            ++c.newlines;
+        const bool word = !is_space(b);
+        if (word && !in_word)
+            ++c.words;
+        in_word = word;
+    }
+
+    c.bytes = text.size();
+    c.starts_in_word = !is_space(static_cast<unsigned char>(text.front()));
+    c.ends_in_word = in_word;
+    return c;
+}
+
+#ifdef TEXT_STATS_SSE2
+TextCounts count(std::string_view text)
+{
+    const auto *p = reinterpret_cast<const unsigned char *>(text.data());
+    const std::size_t n = text.size();
+    const std::size_t vec_end = n & ~std::size_t{15};
+
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i top2 = _mm_set1_epi8(static_cast<char>(0xC0));
+    const __m128i cont = _mm_set1_epi8(static_cast<char>(0x80));
+
+    std::size_t newlines = 0, continuation = 0, words = 0;
+    unsigned prev_word = 0; // bit 0: previous byte was a word byte
+
+    for (std::size_t i = 0; i < vec_end; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+
+        const unsigned nl_mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+        const unsigned cont_mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, top2), cont)));
+
+        // Whitespace: ' ' or '\t'..'\r' (unsigned v - '\t' <= 4).
+        const __m128i rel = _mm_sub_epi8(v, tab);
+        const __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(rel, four), rel);
+        const unsigned space_mask =
+            static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(ctl, _mm_cmpeq_epi8(v, sp))));
+
+        // Word starts: word bytes whose predecessor is not one.
+        const unsigned word_mask = ~space_mask & 0xFFFFu;
+        const unsigned starts = word_mask & ~((word_mask << 1) | prev_word);
+
+        newlines += static_cast<std::size_t>(std::popcount(nl_mask));
+        continuation += static_cast<std::size_t>(std::popcount(cont_mask));
+        words += static_cast<std::size_t>(std::popcount(starts));
+        prev_word = (word_mask >> 15) & 1u;
+    }
+
+    TextCounts c;
+    c.bytes = vec_end;
+    c.chars = vec_end - continuation;
+    c.words = words;
+    c.newlines = newlines;
+    if (vec_end > 0)
+    {
+        c.starts_in_word = !is_space(p[0]);
+        c.ends_in_word = prev_word != 0;
+    }
+
+    c.append(count_scalar(text.substr(vec_end)));
+    return c;
+}
+#else
+TextCounts count(std::string_view text)
+{
+    return count_scalar(text);
+}
+#endif
+
+long long word_delta(const TextCounts &piece, char32_t before, char32_t after)
+{
+    if (piece.bytes == 0)
+        return 0;
+
+    const bool b = is_word_char(before);
+    const bool a = is_word_char(after);
+
+    // Words of the piece, minus those merged with a neighbour, plus the one
+    // the piece splits apart when it lands inside a word.
+    long long delta = static_cast<long long>(piece.words);
+    if (b && piece.starts_in_word)
+        --delta;
+    if (a && piece.ends_in_word)
+        --delta;
+    if (b && a)
+        ++delta;
+    return delta;
+}
+} // namespace text_stats
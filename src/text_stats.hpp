@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Character, word, line and byte counts of UTF-8 text.
+//
+// A word is a run of bytes that are not ASCII whitespace (as `wc -w` in the
+// C locale). Counts of adjacent pieces combine with append(), which is how
+// chunked scans and incremental edits stay exact at word boundaries.
+struct TextCounts
+{
+  std::size_t bytes = 0;
+  std::size_t chars = 0;
+  std::size_t words = 0;
+  std::size_t newlines = 0;
+  bool starts_in_word = false; // first byte is a word byte
+  bool ends_in_word = false;   // last byte is a word byte
+
+  // Lines as an editor shows them: an empty document is one line.
+  std::size_t lines() const { return newlines + 1; }
+
+  // `*this` followed immediately by `next`.
+  void append(const TextCounts &next);
+};
+
+namespace text_stats
+{
+// Counts `text`: SSE2 kernel on x86-64, scalar elsewhere.
+TextCounts count(std::string_view text);
+
+// Scalar reference, also used for the tails the kernel leaves.
+TextCounts count_scalar(std::string_view text);
+
+inline bool is_space(char32_t c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// True for a character that belongs to a word; 0 stands for "no character"
+// (start or end of the buffer).
+inline bool is_word_char(char32_t c)
+{
+  return c != 0 && !is_space(c);
+}
+
+// Change in the document's word count when text with counts `piece` is
+// inserted between the characters `before` and `after` (0 at the buffer
+// edges). Negate for a deletion of `piece` from between them.
+long long word_delta(const TextCounts &piece, char32_t before, char32_t after);
+} // namespace text_stats
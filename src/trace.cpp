@@ -0,0 +1,183 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace trace
+{
+std::atomic<bool> g_enabled{false};
+}
+
+namespace
+{
+struct Event
+{
+    const char *name;
+    std::uint64_t begin_us;
+    std::uint64_t end_us;
+};
+
+// Single producer (the owning thread); read once at shutdown. When it
+// wraps, the oldest spans are overwritten.
+struct Ring
+{
+    static constexpr std::size_t kCapacity = 1 << 16;
+
+    std::array<Event, kCapacity> events;
+    std::atomic<std::uint64_t> head{0};
+    unsigned tid = 0;
+};
+
+std::string g_path;
+std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+
+// Every ring, so spans from finished worker threads still make it into the
+// file. A finished thread's ring is handed to the next new thread (it
+// keeps its tid, one lane per concurrent thread), so memory follows the
+// most threads alive at once rather than every thread ever started. After
+// shutdown() a ring is freed as soon as its thread ends.
+std::mutex g_rings_mutex;
+std::vector<std::unique_ptr<Ring>> g_rings;
+std::vector<Ring *> g_idle_rings;
+bool g_closed = false;
+
+// After shutdown(): idle rings go now, those of running threads as they end.
+void close_rings()
+{
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    g_closed = true;
+    std::erase_if(g_rings, [](const std::unique_ptr<Ring> &r)
+                  { return std::find(g_idle_rings.begin(), g_idle_rings.end(), r.get()) != g_idle_rings.end(); });
+    g_idle_rings.clear();
+    g_idle_rings.shrink_to_fit();
+}
+
+void release(Ring *ring)
+{
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    if (!g_closed)
+    {
+        g_idle_rings.push_back(ring);
+        return;
+    }
+    std::erase_if(g_rings, [ring](const std::unique_ptr<Ring> &r)
+                  { return r.get() == ring; });
+}
+
+// Returns the thread's ring to the pool when the thread ends.
+struct RingHolder
+{
+    Ring *ring = nullptr;
+
+    ~RingHolder()
+    {
+        if (ring)
+            release(ring);
+    }
+};
+
+Ring *this_thread_ring()
+{
+    thread_local RingHolder holder;
+    if (!holder.ring)
+    {
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        if (!g_idle_rings.empty())
+        {
+            holder.ring = g_idle_rings.back();
+            g_idle_rings.pop_back();
+        }
+        else
+        {
+            auto owned = std::make_unique<Ring>();
+            owned->tid = static_cast<unsigned>(g_rings.size() + 1);
+            holder.ring = owned.get();
+            g_rings.push_back(std::move(owned));
+        }
+    }
+    return holder.ring;
+}
+} // namespace
+
+namespace trace
+{
+void init()
+{
+    const char *path = std::getenv("SOPHISTICATED_TRACE");
+    if (!path || !*path)
+        return;
+
+    g_path = path;
+    g_epoch = std::chrono::steady_clock::now();
+    this_thread_ring(); // main thread gets tid 1
+    g_enabled.store(true, std::memory_order_relaxed);
+}
+
+std::uint64_t now_us()
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::steady_clock::now() - g_epoch)
+                                          .count());
+}
+
+void record(const char *name, std::uint64_t begin_us, std::uint64_t end_us)
+{
+    Ring *ring = this_thread_ring();
+    const auto h = ring->head.load(std::memory_order_relaxed);
+    ring->events[h % Ring::kCapacity] = Event{name, begin_us, end_us};
+    ring->head.store(h + 1, std::memory_order_release);
+}
+
+void shutdown()
+{
+    if (!enabled())
+        return;
+    g_enabled.store(false, std::memory_order_relaxed);
+
+    std::FILE *out = std::fopen(g_path.c_str(), "w");
+    if (!out)
+    {
+        std::fprintf(stderr, "trace: cannot write %s\n", g_path.c_str());
+        close_rings();
+        return;
+    }
+
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+    bool first = true;
+    std::size_t total = 0;
+
+    std::unique_lock<std::mutex> lock(g_rings_mutex);
+    for (const auto &ring : g_rings)
+    {
+        const auto head = ring->head.load(std::memory_order_acquire);
+        const auto begin = head > Ring::kCapacity ? head - Ring::kCapacity : 0;
+
+        std::fprintf(out, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                     first ? "" : ",\n", ring->tid, ring->tid == 1 ? "main" : "worker");
+        first = false;
+
+        for (auto i = begin; i < head; ++i)
+        {
+            const Event &e = ring->events[i % Ring::kCapacity];
+            std::fprintf(out, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu}",
+                         e.name, ring->tid, static_cast<unsigned long long>(e.begin_us),
+                         static_cast<unsigned long long>(e.end_us - e.begin_us));
+            ++total;
+        }
+    }
+
+    lock.unlock();
+
+    std::fputs("\n]}\n", out);
+    std::fclose(out);
+    std::fprintf(stderr, "trace: wrote %zu span(s) to %s\n", total, g_path.c_str());
+    close_rings();
+}
+} // namespace trace
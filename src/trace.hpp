@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Scoped trace spans for finding UI-thread stalls.
+//
+// Recording is off unless SOPHISTICATED_TRACE names an output file; then
+// each thread appends spans to its own fixed-size ring buffer (no locks on
+// the hot path) and the file is written in Chrome trace JSON at exit
+// (open it in chrome://tracing or ui.perfetto.dev). When off, a span costs
+// one relaxed atomic load.
+//
+// Span names must be string literals: only the pointer is stored.
+namespace trace
+{
+extern std::atomic<bool> g_enabled;
+
+inline bool enabled()
+{
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+// Reads SOPHISTICATED_TRACE. Call once from main().
+void init();
+
+// Writes the trace file (if enabled). Call after the main loop has exited.
+void shutdown();
+
+std::uint64_t now_us();
+
+void record(const char *name, std::uint64_t begin_us, std::uint64_t end_us);
+
+class Scope
+{
+public:
+  explicit Scope(const char *name)
+      : m_name(enabled() ? name : nullptr), m_begin(m_name ? now_us() : 0)
+  {
+  }
+
+  ~Scope()
+  {
+    if (m_name)
+      record(m_name, m_begin, now_us());
+  }
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  const char *m_name;
+  std::uint64_t m_begin;
+};
+} // namespace trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
@@ -0,0 +1,144 @@
+#include "virtual_row_view.hpp"
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Rows (or characters, horizontally) moved per scroll-wheel step.
+constexpr double kWheelRows = 3.0;
+} // namespace
+
+VirtualRowView::VirtualRowView()
+    : Gtk::Box(Gtk::Orientation::VERTICAL),
+      m_adjustment(Gtk::Adjustment::create(0.0, 0.0, 0.0, 1.0, 10.0, 0.0)),
+      m_hadjustment(Gtk::Adjustment::create(0.0, 0.0, 0.0, 10.0, 100.0, 0.0)),
+      m_scrollbar(m_adjustment, Gtk::Orientation::VERTICAL),
+      m_hscrollbar(m_hadjustment, Gtk::Orientation::HORIZONTAL)
+{
+    m_area.set_hexpand(true);
+    m_area.set_vexpand(true);
+    m_area.set_focusable(true);
+    m_area.set_draw_func(sigc::mem_fun(*this, &VirtualRowView::on_draw));
+    m_area.signal_resize().connect([this](int, int)
+                                   { update_adjustment(); });
+
+    m_body.set_vexpand(true);
+    m_body.append(m_area);
+    m_body.append(m_scrollbar);
+    append(m_body);
+    append(m_hscrollbar);
+    m_hscrollbar.set_visible(false);
+
+    m_adjustment->signal_value_changed().connect([this]()
+                                                 { m_area.queue_draw(); });
+    m_hadjustment->signal_value_changed().connect([this]()
+                                                  { m_area.queue_draw(); });
+
+    // Measure the row height and character advance from the font, once.
+    auto layout = m_area.create_pango_layout("0123456789");
+    layout->set_font_description(m_font);
+    int w = 0, h = 0;
+    layout->get_pixel_size(w, h);
+    m_row_height = std::max(1, h);
+    m_char_width = std::max(1.0, w / 10.0);
+
+    auto scroll = Gtk::EventControllerScroll::create();
+    scroll->set_flags(Gtk::EventControllerScroll::Flags::BOTH_AXES);
+    scroll->signal_scroll().connect([this](double dx, double dy)
+                                    {
+        m_adjustment->set_value(m_adjustment->get_value() + dy * kWheelRows);
+        if (dx != 0.0)
+            m_hadjustment->set_value(m_hadjustment->get_value() + dx * kWheelRows * m_char_width);
+        return true; }, false);
+    m_area.add_controller(scroll);
+
+    auto click = Gtk::GestureClick::create();
+    click->signal_pressed().connect([this](int, double, double y)
+                                    {
+        m_area.grab_focus();
+        y -= header_height();
+        if (y < 0)
+            return;
+        const auto row = first_visible_row() + static_cast<std::size_t>(y / m_row_height);
+        if (row < m_rows)
+            m_row_activated.emit(row); });
+    m_area.add_controller(click);
+}
+
+VirtualRowView::~VirtualRowView() = default;
+
+void VirtualRowView::set_row_count(std::size_t rows)
+{
+    m_rows = rows;
+    update_adjustment();
+    m_area.queue_draw();
+}
+
+void VirtualRowView::set_content_width(double width)
+{
+    m_content_width = width;
+    update_adjustment();
+    m_area.queue_draw();
+}
+
+std::size_t VirtualRowView::first_visible_row() const
+{
+    return static_cast<std::size_t>(std::max(0.0, std::floor(m_adjustment->get_value())));
+}
+
+void VirtualRowView::scroll_to_row(std::size_t row)
+{
+    m_adjustment->set_value(static_cast<double>(row));
+}
+
+void VirtualRowView::update_adjustment()
+{
+    const double page = std::max(1, (m_area.get_height() - header_height()) / m_row_height);
+    const double value = std::min(m_adjustment->get_value(), std::max(0.0, static_cast<double>(m_rows) - page));
+    m_adjustment->configure(value, 0.0, static_cast<double>(m_rows), 1.0, page, page);
+
+    const double width = std::max(1, m_area.get_width());
+    const double hvalue = std::min(m_hadjustment->get_value(), std::max(0.0, m_content_width - width));
+    m_hadjustment->configure(hvalue, 0.0, std::max(m_content_width, width), m_char_width * kWheelRows, width,
+                             width);
+    m_hscrollbar.set_visible(m_content_width > width);
+}
+
+void VirtualRowView::on_draw(const Cairo::RefPtr<Cairo::Context> &cr, int width, int height)
+{
+    TRACE_SCOPE("rows.draw");
+
+    auto layout = m_area.create_pango_layout("");
+    layout->set_font_description(m_font);
+
+    const auto color = m_area.get_color();
+    auto ink = [&]()
+    { cr->set_source_rgba(color.get_red(), color.get_green(), color.get_blue(), color.get_alpha()); };
+
+    cr->translate(-h_offset(), 0.0);
+
+    const double top = header_height();
+    const std::size_t first = first_visible_row();
+    double y = top;
+    for (std::size_t row = first; row < m_rows && y < height; ++row, y += m_row_height)
+    {
+        ink();
+        draw_row(cr, layout, row, y, width);
+    }
+
+    // The header goes on last, over a band of the window background.
+    if (has_header())
+    {
+        cr->save();
+        cr->rectangle(h_offset(), 0.0, width, top);
+        cr->clip();
+        cr->set_source_rgba(0.5, 0.5, 0.5, 0.15);
+        cr->paint();
+        cr->restore();
+        ink();
+        draw_header(cr, layout, width);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <cstddef>
+
+// Fixed-height rows drawn on demand: only the rows on screen are ever
+// touched, so a view over millions of rows costs nothing per row. The
+// vertical scrollbar works in row units; a horizontal one appears when a
+// subclass declares content wider than the view (set_content_width).
+//
+// Subclasses supply draw_row() and, optionally, a header row that stays in
+// place while the rows scroll; everything else (scrolling, resizing,
+// hit-testing clicks) lives here.
+class VirtualRowView : public Gtk::Box
+{
+public:
+  VirtualRowView();
+  ~VirtualRowView() override;
+
+  // Keeps the first visible row where possible.
+  void set_row_count(std::size_t rows);
+  std::size_t row_count() const { return m_rows; }
+
+  std::size_t first_visible_row() const;
+  void scroll_to_row(std::size_t row);
+
+  // Redraws without changing the row count (e.g. new data behind the rows).
+  void redraw() { m_area.queue_draw(); }
+
+  // A row was clicked.
+  sigc::signal<void(std::size_t)> &signal_row_activated() { return m_row_activated; }
+
+protected:
+  // Draws `row` with its top edge at `y`. `layout` already carries the
+  // view's monospace font; the source colour is the theme's text colour.
+  // With horizontal scrolling the context is already translated, so rows
+  // draw at content coordinates; h_offset() says what is on screen.
+  virtual void draw_row(const Cairo::RefPtr<Cairo::Context> &cr, const Glib::RefPtr<Pango::Layout> &layout,
+                        std::size_t row, double y, int width) = 0;
+
+  // Sticky header row, drawn at the top (same conventions as draw_row).
+  virtual bool has_header() const { return false; }
+  virtual void draw_header(const Cairo::RefPtr<Cairo::Context> &, const Glib::RefPtr<Pango::Layout> &, int) {}
+
+  // Width of the content in pixels; 0 (the default) means "fits".
+  void set_content_width(double width);
+  double h_offset() const { return m_hadjustment->get_value(); }
+
+  int row_height() const { return m_row_height; }
+  // Advance of one monospace character, for column-based layouts.
+  double char_width() const { return m_char_width; }
+
+private:
+  Gtk::Box m_body{Gtk::Orientation::HORIZONTAL};
+  Gtk::DrawingArea m_area;
+  Glib::RefPtr<Gtk::Adjustment> m_adjustment;
+  Glib::RefPtr<Gtk::Adjustment> m_hadjustment;
+  Gtk::Scrollbar m_scrollbar;
+  Gtk::Scrollbar m_hscrollbar;
+
+  std::size_t m_rows = 0;
+  int m_row_height = 16;
+  double m_char_width = 8.0;
+  double m_content_width = 0.0;
+  Pango::FontDescription m_font{"monospace"};
+
+  sigc::signal<void(std::size_t)> m_row_activated;
+
+  int header_height() const { return has_header() ? m_row_height : 0; }
+  void on_draw(const Cairo::RefPtr<Cairo::Context> &cr, int width, int height);
+  void update_adjustment();
+};
@@ -0,0 +1,245 @@
+#include "word_index.hpp"
+
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+// Slice of the document counted by one job during build().
+constexpr std::size_t kChunkBytes = 4u << 20;
+// Bytes a std::string holds without a heap allocation (libstdc++ / MSVC).
+constexpr std::size_t kSmallString = 15;
+// Map node overhead: tree links and colour, the key and the count.
+constexpr std::size_t kNodeBytes = 32 + sizeof(std::string) + sizeof(std::uint32_t);
+
+// Open-addressing word -> count table for one build job: flat storage and
+// one hash per word, several times faster than std::unordered_map here.
+class CountTable
+{
+public:
+    struct Slot
+    {
+        std::string_view word;
+        std::size_t hash = 0;
+        std::uint32_t count = 0;
+    };
+
+    CountTable() : m_slots(1024) {}
+
+    void add(std::string_view w, std::uint32_t n = 1)
+    {
+        add_hashed(w, std::hash<std::string_view>{}(w), n);
+    }
+
+    void add_hashed(std::string_view w, std::size_t h, std::uint32_t n)
+    {
+        if ((m_used + 1) * 2 > m_slots.size())
+            grow();
+        const std::size_t mask = m_slots.size() - 1;
+        for (std::size_t i = h & mask;; i = (i + 1) & mask)
+        {
+            auto &s = m_slots[i];
+            if (s.count == 0)
+            {
+                s = Slot{w, h, n};
+                ++m_used;
+                return;
+            }
+            if (s.hash == h && s.word == w)
+            {
+                s.count += n;
+                return;
+            }
+        }
+    }
+
+    const std::vector<Slot> &slots() const { return m_slots; }
+    std::size_t used() const { return m_used; }
+
+private:
+    std::vector<Slot> m_slots;
+    std::size_t m_used = 0;
+
+    void grow()
+    {
+        std::vector<Slot> old(m_slots.size() * 2);
+        old.swap(m_slots);
+        m_used = 0;
+        for (const auto &s : old)
+        {
+            if (s.count != 0)
+                add_hashed(s.word, s.hash, s.count);
+        }
+    }
+};
+
+template <typename Fn>
+void for_each_word(std::string_view text, bool open_left, bool open_right, Fn &&fn)
+{
+    const auto *p = reinterpret_cast<const unsigned char *>(text.data());
+    const std::size_t n = text.size();
+    std::size_t i = 0;
+    while (i < n)
+    {
+        while (i < n && !WordIndex::is_word_byte(p[i]))
+            ++i;
+        const std::size_t start = i;
+        while (i < n && WordIndex::is_word_byte(p[i]))
+            ++i;
+        const std::size_t len = i - start;
+        if (len == 0)
+            break;
+        if ((start == 0 && open_left) || (i == n && open_right))
+            continue;
+        if (len >= WordIndex::kMinWordBytes && len <= WordIndex::kMaxWordBytes)
+            fn(text.substr(start, len));
+    }
+}
+} // namespace
+
+void WordIndex::clear()
+{
+    m_words.clear();
+    m_heap_bytes = 0;
+    m_valid = false;
+}
+
+bool WordIndex::build(std::string_view text, const std::atomic<bool> *cancel, std::atomic<double> *progress)
+{
+    TRACE_SCOPE("words.build");
+    clear();
+
+    // Chunks end between words so no word is split.
+    std::vector<std::string_view> chunks;
+    for (std::size_t at = 0; at < text.size();)
+    {
+        std::size_t end = std::min(text.size(), at + kChunkBytes);
+        while (end < text.size() && is_word_byte(static_cast<unsigned char>(text[end])))
+            ++end;
+        chunks.push_back(text.substr(at, end - at));
+        at = end;
+    }
+
+    // Each job counts into its own table of views into the text; the tables
+    // are merged, sorted once and moved into the map in order.
+    std::vector<CountTable> counts(chunks.size());
+    std::atomic<std::size_t> done{0};
+    parallel_for(chunks.size(), [&](std::size_t c)
+                 {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return;
+        for_each_word(chunks[c], false, false, [&](std::string_view w)
+                      { counts[c].add(w); });
+        if (progress)
+            progress->store(0.8 * static_cast<double>(++done) / static_cast<double>(chunks.size()),
+                            std::memory_order_relaxed); });
+    if (cancel && cancel->load(std::memory_order_relaxed))
+        return false;
+
+    CountTable merged = counts.empty() ? CountTable{} : std::move(counts[0]);
+    for (std::size_t c = 1; c < counts.size(); ++c)
+    {
+        for (const auto &s : counts[c].slots())
+        {
+            if (s.count != 0)
+                merged.add_hashed(s.word, s.hash, s.count);
+        }
+        counts[c] = {};
+    }
+
+    std::vector<std::pair<std::string_view, std::uint32_t>> sorted;
+    sorted.reserve(merged.used());
+    for (const auto &s : merged.slots())
+    {
+        if (s.count != 0)
+            sorted.emplace_back(s.word, s.count);
+    }
+    merged = {};
+    std::sort(sorted.begin(), sorted.end());
+    for (const auto &[w, n] : sorted)
+    {
+        m_words.emplace_hint(m_words.end(), std::string(w), n);
+        if (w.size() > kSmallString)
+            m_heap_bytes += w.size() + 1;
+    }
+    if (progress)
+        progress->store(1.0, std::memory_order_relaxed);
+    m_valid = true;
+    return true;
+}
+
+void WordIndex::count(std::string_view text, bool open_left, bool open_right, int delta)
+{
+    for_each_word(text, open_left, open_right, [&](std::string_view w)
+                  {
+        auto it = m_words.find(w);
+        if (delta > 0)
+        {
+            if (it != m_words.end())
+            {
+                ++it->second;
+                return;
+            }
+            m_words.emplace(std::string(w), 1);
+            if (w.size() > kSmallString)
+                m_heap_bytes += w.size() + 1;
+            return;
+        }
+        if (it == m_words.end())
+            return;
+        if (--it->second == 0)
+        {
+            if (w.size() > kSmallString)
+                m_heap_bytes -= w.size() + 1;
+            m_words.erase(it);
+        } });
+}
+
+void WordIndex::add(std::string_view text, bool open_left, bool open_right)
+{
+    if (m_valid)
+        count(text, open_left, open_right, +1);
+}
+
+void WordIndex::remove(std::string_view text, bool open_left, bool open_right)
+{
+    if (m_valid)
+        count(text, open_left, open_right, -1);
+}
+
+std::vector<std::string> WordIndex::complete(std::string_view prefix, std::size_t limit, std::size_t scan) const
+{
+    TRACE_SCOPE("words.complete");
+
+    std::vector<std::pair<std::uint32_t, const std::string *>> found;
+    for (auto it = m_words.lower_bound(prefix); it != m_words.end() && found.size() < scan; ++it)
+    {
+        if (!it->first.starts_with(prefix))
+            break;
+        if (it->first.size() > prefix.size())
+            found.emplace_back(it->second, &it->first);
+    }
+
+    const std::size_t n = std::min(limit, found.size());
+    std::partial_sort(found.begin(), found.begin() + static_cast<std::ptrdiff_t>(n), found.end(),
+                      [](const auto &a, const auto &b)
+                      {
+                          if (a.first != b.first)
+                              return a.first > b.first;
+                          return *a.second < *b.second;
+                      });
+
+    std::vector<std::string> out;
+    out.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        out.push_back(*found[i].second);
+    return out;
+}
+
+std::size_t WordIndex::bytes() const
+{
+    return m_words.size() * kNodeBytes + m_heap_bytes;
+}
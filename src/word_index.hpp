@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Words of the document with occurrence counts, for completion.
+//
+// A word is a run of ASCII letters, digits and '_' plus any non-ASCII
+// character, between kMinWordBytes and kMaxWordBytes long. Words live in a
+// sorted map, so a prefix query is a lower_bound followed by a short walk,
+// and the index follows edits with add()/remove() of the text around them
+// instead of rescans.
+class WordIndex
+{
+public:
+  static constexpr std::size_t kMinWordBytes = 3;
+  static constexpr std::size_t kMaxWordBytes = 64;
+
+  static bool is_word_byte(unsigned char c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+  }
+  static bool is_word_char(char32_t c)
+  {
+    return c >= 0x80 || (c < 0x80 && is_word_byte(static_cast<unsigned char>(c)));
+  }
+
+  void clear();
+
+  // Counts every word of `text`, in parallel. Returns false if cancelled.
+  bool build(std::string_view text, const std::atomic<bool> *cancel = nullptr,
+             std::atomic<double> *progress = nullptr);
+
+  bool valid() const { return m_valid; }
+
+  // Count (or uncount) the words of `text`. With `open_left`/`open_right`
+  // the first/last run continues past the text and is not a whole word.
+  void add(std::string_view text, bool open_left = false, bool open_right = false);
+  void remove(std::string_view text, bool open_left = false, bool open_right = false);
+
+  // Up to `limit` words starting with `prefix` (longer than it), most
+  // frequent first. At most `scan` candidates are looked at.
+  std::vector<std::string> complete(std::string_view prefix, std::size_t limit, std::size_t scan = 4096) const;
+
+  std::size_t size() const { return m_words.size(); }
+  std::size_t bytes() const;
+
+private:
+  std::map<std::string, std::uint32_t, std::less<>> m_words;
+  std::size_t m_heap_bytes = 0; // text of words too long for the small-string buffer
+  bool m_valid = false;
+
+  void count(std::string_view text, bool open_left, bool open_right, int delta);
+};